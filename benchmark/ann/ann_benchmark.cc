@@ -0,0 +1,549 @@
+// Copyright 2023 The Elastic-AI Authors.
+// part of Elastic AI Search
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+// end to end search benchmark over a standard ann data set, eg. sift1m or
+// gist1m from http://corpus-texmex.irisa.fr. the base vectors are indexed,
+// the queries run at every value of the sweep, and one line per value report
+// the qps, the recall@k against the ground truth and the latencies.
+//
+//   ann_benchmark base=sift_base.fvecs query=sift_query.fvecs gt=sift_groundtruth.ivecs
+//                 index=hnsw k=10 sweep=10,20,40,80,160 threads=8
+//
+// the sweep is the ef of hnsw and disk, the nprobe of ivf, flat has none. without
+// gt the ground truth is computed by a flat index first. the i-th base vector has
+// the label i, the ids of the ground truth.
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <memory>
+#include <string>
+#include <vector>
+#include "turbo/files/sequential_read_file.h"
+#include "zircon/datasets/fvec_vector_io.h"
+#include "zircon/index/disk_index.h"
+#include "zircon/index/flat_index.h"
+#include "zircon/index/hnsw_index.h"
+#include "zircon/index/ivf_index.h"
+#include "zircon/index/vamana_builder.h"
+#include "zircon/utility/thread_pool.h"
+#include "tools/tool_args.h"
+
+namespace {
+
+    using Clock = std::chrono::steady_clock;
+
+    struct HarnessOption {
+        std::string base;
+        std::string query;
+        std::string gt;
+        std::string index{"hnsw"};
+        std::string metric{"l2"};
+        std::size_t k{10};
+        std::vector<std::size_t> sweep{10, 20, 40, 80, 160};
+        // search threads, the queries are spread over them
+        std::size_t threads{1};
+        // build threads, 0 for one per core
+        std::size_t build_threads{0};
+        // queries used, 0 for all of them
+        std::size_t nq{0};
+        // queries of one search_batch call, 1 search them one by one
+        std::size_t batch{1};
+        // hnsw
+        uint32_t m{16};
+        uint32_t ef_construction{200};
+        // ivf
+        uint32_t nlist{1024};
+        std::string code{"flat"};
+        // disk, the index file written and searched
+        std::string index_path{"ann_benchmark.dann"};
+        uint32_t max_degree{64};
+        uint32_t beam_width{4};
+    };
+
+    struct VectorFile {
+        std::size_t n{0};
+        std::size_t dim{0};
+        std::vector<float> data;
+    };
+
+    void usage() {
+        std::fprintf(stderr,
+                     "usage: ann_benchmark base=<fvecs> query=<fvecs> [gt=<ivecs>] [index=flat|hnsw|ivf|disk]\n"
+                     "       [metric=l2|ip|cosine] [k=10] [sweep=10,20,40] [threads=1] [build_threads=0] [nq=0]\n"
+                     "       [batch=1] [m=16] [ef_construction=200] [nlist=1024] [code=flat|sq8|fp16|pq]\n"
+                     "       [index_path=ann_benchmark.dann] [max_degree=64] [beam_width=4]\n");
+    }
+
+    bool parse_sweep(const std::string &value, std::vector<std::size_t> &sweep) {
+        sweep.clear();
+        std::size_t pos = 0;
+        while (pos < value.size()) {
+            auto end = value.find(',', pos);
+            if (end == std::string::npos) {
+                end = value.size();
+            }
+            auto v = std::strtoull(value.substr(pos, end - pos).c_str(), nullptr, 10);
+            if (v == 0) {
+                return false;
+            }
+            sweep.push_back(v);
+            pos = end + 1;
+        }
+        return !sweep.empty();
+    }
+
+    bool parse_args(int argc, char **argv, HarnessOption &option) {
+        zircon::tools::ToolArgs args;
+        if (!args.parse(argc, argv)) {
+            return false;
+        }
+        args.take("base", option.base);
+        args.take("query", option.query);
+        args.take("gt", option.gt);
+        args.take("index", option.index);
+        args.take("metric", option.metric);
+        args.take("code", option.code);
+        args.take("index_path", option.index_path);
+        args.number("k", option.k);
+        args.number("threads", option.threads);
+        args.number("build_threads", option.build_threads);
+        args.number("nq", option.nq);
+        args.number("batch", option.batch);
+        args.number("m", option.m);
+        args.number("ef_construction", option.ef_construction);
+        args.number("nlist", option.nlist);
+        args.number("max_degree", option.max_degree);
+        args.number("beam_width", option.beam_width);
+        std::string sweep;
+        if (args.take("sweep", sweep) && !parse_sweep(sweep, option.sweep)) {
+            return false;
+        }
+        if (!args.all_read()) {
+            return false;
+        }
+        return !option.base.empty() && !option.query.empty() && option.k > 0 && option.threads > 0;
+    }
+
+    /**
+     * @brief read a fvecs or ivecs file, every record is an uint32 dimension then
+     *        dimension 4 bytes elements. the ints of an ivecs are kept as their
+     *        bits in the floats, see read_ivecs.
+     */
+    turbo::ResultStatus<VectorFile> read_vecs(const std::string &path) {
+        VectorFile vf;
+        std::error_code ec;
+        auto bytes = std::filesystem::file_size(path, ec);
+        if (ec) {
+            return turbo::not_found_error("can not stat {}: {}", path, ec.message());
+        }
+        turbo::SequentialReadFile file;
+        auto rs = file.open(path);
+        if (!rs.ok()) {
+            return rs;
+        }
+        uint32_t dim = 0;
+        auto r = file.read(&dim, sizeof(dim));
+        if (!r.ok()) {
+            return r.status();
+        }
+        if (r.value() != sizeof(dim) || dim == 0 || bytes % (sizeof(uint32_t) + dim * sizeof(float)) != 0) {
+            return turbo::data_loss_error("{} is not a vecs file", path);
+        }
+        file.close();
+        vf.dim = dim;
+        vf.n = bytes / (sizeof(uint32_t) + dim * sizeof(float));
+        vf.data.resize(vf.n * vf.dim);
+        rs = file.open(path);
+        if (!rs.ok()) {
+            return rs;
+        }
+        zircon::SerializeOption so;
+        so.dimension = vf.dim;
+        so.n_vectors = vf.n;
+        zircon::FvecVectorSetReader reader;
+        rs = reader.initialize(&file, so);
+        if (!rs.ok()) {
+            return rs;
+        }
+        turbo::Span<uint8_t> span{reinterpret_cast<uint8_t *>(vf.data.data()), vf.data.size() * sizeof(float)};
+        auto n = reader.read_batch(span, vf.n);
+        if (!n.ok()) {
+            return n.status();
+        }
+        if (n.value() != vf.n) {
+            return turbo::data_loss_error("{} truncated, read {} of {} vectors", path, n.value(), vf.n);
+        }
+        return vf;
+    }
+
+    // the ids of an ivecs file, k per query
+    turbo::ResultStatus<std::vector<int32_t>> read_ivecs(const std::string &path, std::size_t nq, std::size_t k) {
+        auto vf = read_vecs(path);
+        if (!vf.ok()) {
+            return vf.status();
+        }
+        auto &f = vf.value();
+        if (f.n < nq || f.dim < k) {
+            return turbo::invalid_argument_error("{} has {} x {} ids, {} x {} needed", path, f.n, f.dim, nq, k);
+        }
+        std::vector<int32_t> ids(nq * k);
+        for (std::size_t q = 0; q < nq; ++q) {
+            std::memcpy(ids.data() + q * k, f.data.data() + q * f.dim, k * sizeof(int32_t));
+        }
+        return ids;
+    }
+
+    turbo::ResultStatus<zircon::MetricType> parse_metric(const std::string &metric) {
+        if (metric == "l2") {
+            return zircon::MetricType::METRIC_L2;
+        }
+        if (metric == "ip") {
+            return zircon::MetricType::METRIC_IP;
+        }
+        if (metric == "cosine") {
+            return zircon::MetricType::METRIC_NORMALIZED_COSINE;
+        }
+        return turbo::invalid_argument_error("unknown metric {}", metric);
+    }
+
+    turbo::ResultStatus<zircon::IvfCode> parse_code(const std::string &code) {
+        if (code == "flat") {
+            return zircon::IvfCode::IVF_FLAT;
+        }
+        if (code == "sq8") {
+            return zircon::IvfCode::IVF_SQ8;
+        }
+        if (code == "fp16") {
+            return zircon::IvfCode::IVF_FP16;
+        }
+        if (code == "pq") {
+            return zircon::IvfCode::IVF_PQ;
+        }
+        return turbo::invalid_argument_error("unknown ivf code {}", code);
+    }
+
+    // the base vectors added on the pool, the label of a vector is its row
+    turbo::Status add_all(zircon::Index &index, const VectorFile &base, zircon::ThreadPool &pool) {
+        constexpr std::size_t kRowsPerTask = 1024;
+        std::atomic<bool> failed{false};
+        pool.parallel_for((base.n + kRowsPerTask - 1) / kRowsPerTask, [&](std::size_t task, std::size_t) {
+            auto end = std::min(base.n, (task + 1) * kRowsPerTask);
+            for (auto i = task * kRowsPerTask; i < end && !failed.load(std::memory_order_relaxed); ++i) {
+                auto *v = const_cast<float *>(base.data.data() + i * base.dim);
+                if (!index.add_vector(static_cast<zircon::label_type>(i), turbo::Span<float>{v, base.dim}).ok()) {
+                    failed = true;
+                }
+            }
+        });
+        if (failed) {
+            return turbo::internal_error("add vector failed");
+        }
+        return turbo::ok_status();
+    }
+
+    zircon::IndexOption make_index_option(zircon::MetricType metric, const VectorFile &base) {
+        zircon::IndexOption op;
+        op.metric = metric;
+        op.dimension = static_cast<uint32_t>(base.dim);
+        op.store_option.max_elements = static_cast<uint32_t>(base.n);
+        return op;
+    }
+
+    turbo::ResultStatus<std::unique_ptr<zircon::Index>>
+    build_index(const HarnessOption &option, zircon::MetricType metric, const VectorFile &base,
+                zircon::ThreadPool &pool) {
+        auto op = make_index_option(metric, base);
+        if (option.index == "flat") {
+            auto index = std::make_unique<zircon::FlatIndex>();
+            zircon::FlatOption flat;
+            // the harness spreads the queries, one thread per search
+            flat.nthreads = 1;
+            auto rs = index->initialize(op, flat);
+            if (!rs.ok()) {
+                return rs;
+            }
+            rs = add_all(*index, base, pool);
+            if (!rs.ok()) {
+                return rs;
+            }
+            return std::unique_ptr<zircon::Index>(std::move(index));
+        }
+        if (option.index == "hnsw") {
+            auto index = std::make_unique<zircon::HnswIndex>();
+            zircon::HnswOption hnsw;
+            hnsw.m = option.m;
+            hnsw.ef_construction = option.ef_construction;
+            auto rs = index->initialize(op, hnsw);
+            if (!rs.ok()) {
+                return rs;
+            }
+            rs = add_all(*index, base, pool);
+            if (!rs.ok()) {
+                return rs;
+            }
+            return std::unique_ptr<zircon::Index>(std::move(index));
+        }
+        if (option.index == "ivf") {
+            auto code = parse_code(option.code);
+            if (!code.ok()) {
+                return code.status();
+            }
+            auto index = std::make_unique<zircon::IvfIndex>();
+            zircon::IvfOption ivf;
+            ivf.nlist = option.nlist;
+            ivf.code = code.value();
+            ivf.nthreads = static_cast<uint32_t>(option.build_threads);
+            auto rs = index->initialize(op, ivf);
+            if (!rs.ok()) {
+                return rs;
+            }
+            // 256 samples per centroid are plenty for the k-means
+            auto nsamples = std::min<std::size_t>(base.n, std::size_t{256} * option.nlist);
+            auto *samples = const_cast<float *>(base.data.data());
+            rs = index->train(turbo::Span<float>{samples, nsamples * base.dim});
+            if (!rs.ok()) {
+                return rs;
+            }
+            rs = add_all(*index, base, pool);
+            if (!rs.ok()) {
+                return rs;
+            }
+            return std::unique_ptr<zircon::Index>(std::move(index));
+        }
+        if (option.index == "disk") {
+            zircon::VamanaBuilder builder;
+            zircon::VamanaOption vamana;
+            vamana.max_degree = option.max_degree;
+            vamana.nthreads = static_cast<uint32_t>(option.build_threads);
+            auto rs = builder.initialize(op, vamana);
+            if (!rs.ok()) {
+                return rs;
+            }
+            for (std::size_t i = 0; i < base.n; ++i) {
+                auto *v = const_cast<float *>(base.data.data() + i * base.dim);
+                auto r = builder.add_vector(static_cast<zircon::label_type>(i), turbo::Span<float>{v, base.dim});
+                if (!r.ok()) {
+                    return r.status();
+                }
+            }
+            rs = builder.build();
+            if (!rs.ok()) {
+                return rs;
+            }
+            rs = builder.save_index(option.index_path);
+            if (!rs.ok()) {
+                return rs;
+            }
+            auto index = std::make_unique<zircon::DiskIndex>();
+            zircon::DiskIndexOption disk;
+            disk.beam_width = option.beam_width;
+            rs = index->initialize(disk);
+            if (!rs.ok()) {
+                return rs;
+            }
+            rs = index->load_index(option.index_path);
+            if (!rs.ok()) {
+                return rs;
+            }
+            return std::unique_ptr<zircon::Index>(std::move(index));
+        }
+        return turbo::invalid_argument_error("unknown index {}", option.index);
+    }
+
+    // the exact k nearest of every query, by a flat index
+    turbo::ResultStatus<std::vector<int32_t>>
+    exact_truth(const HarnessOption &option, zircon::MetricType metric, const VectorFile &base,
+                const VectorFile &query, std::size_t nq, zircon::ThreadPool &pool) {
+        HarnessOption flat_option = option;
+        flat_option.index = "flat";
+        auto flat = build_index(flat_option, metric, base, pool);
+        if (!flat.ok()) {
+            return flat.status();
+        }
+        std::vector<int32_t> ids(nq * option.k, -1);
+        zircon::SearchOption so;
+        so.k = option.k;
+        std::atomic<bool> failed{false};
+        pool.parallel_for(nq, [&](std::size_t q, std::size_t) {
+            std::vector<zircon::QueryResult> result;
+            auto *v = const_cast<float *>(query.data.data() + q * query.dim);
+            if (!flat.value()->search(turbo::Span<float>{v, query.dim}, so, result).ok()) {
+                failed = true;
+                return;
+            }
+            for (std::size_t i = 0; i < result.size(); ++i) {
+                ids[q * option.k + i] = static_cast<int32_t>(result[i].label);
+            }
+        });
+        if (failed) {
+            return turbo::internal_error("ground truth search failed");
+        }
+        return ids;
+    }
+
+    struct SweepResult {
+        double qps{0};
+        double recall{0};
+        double mean_us{0};
+        double p50_us{0};
+        double p99_us{0};
+    };
+
+    // a query of a batch get the latency of the whole batch
+    SweepResult run_queries(const zircon::Index &index, const VectorFile &query, std::size_t nq,
+                            const std::vector<int32_t> &truth, const zircon::SearchOption &so,
+                            std::size_t batch, zircon::ThreadPool &pool) {
+        const std::size_t k = so.k;
+        batch = std::max<std::size_t>(batch, 1);
+        std::vector<double> latency(nq);
+        std::vector<std::size_t> hits(nq, 0);
+        auto count_hits = [&](std::size_t q, const std::vector<zircon::QueryResult> &result) {
+            const int32_t *gt = truth.data() + q * k;
+            for (auto &r: result) {
+                if (std::find(gt, gt + k, static_cast<int32_t>(r.label)) != gt + k) {
+                    ++hits[q];
+                }
+            }
+        };
+        auto start = Clock::now();
+        pool.parallel_for((nq + batch - 1) / batch, [&](std::size_t task, std::size_t) {
+            const std::size_t first = task * batch;
+            const std::size_t n = std::min(batch, nq - first);
+            auto *v = const_cast<float *>(query.data.data() + first * query.dim);
+            auto t0 = Clock::now();
+            if (batch == 1) {
+                std::vector<zircon::QueryResult> result;
+                auto rs = index.search(turbo::Span<float>{v, query.dim}, so, result);
+                latency[first] = std::chrono::duration<double, std::micro>(Clock::now() - t0).count();
+                if (rs.ok()) {
+                    count_hits(first, result);
+                }
+                return;
+            }
+            std::vector<std::vector<zircon::QueryResult>> results;
+            auto rs = index.search_batch(turbo::Span<float>{v, n * query.dim}, n, so, results);
+            auto us = std::chrono::duration<double, std::micro>(Clock::now() - t0).count();
+            for (std::size_t i = 0; i < n; ++i) {
+                latency[first + i] = us;
+                if (rs.ok()) {
+                    count_hits(first + i, results[i]);
+                }
+            }
+        });
+        double seconds = std::chrono::duration<double>(Clock::now() - start).count();
+        SweepResult sr;
+        std::size_t total = 0;
+        double sum = 0;
+        for (std::size_t q = 0; q < nq; ++q) {
+            total += hits[q];
+            sum += latency[q];
+        }
+        sr.qps = static_cast<double>(nq) / seconds;
+        sr.recall = static_cast<double>(total) / static_cast<double>(nq * k);
+        sr.mean_us = sum / static_cast<double>(nq);
+        std::sort(latency.begin(), latency.end());
+        sr.p50_us = latency[nq / 2];
+        sr.p99_us = latency[std::min(nq - 1, nq * 99 / 100)];
+        return sr;
+    }
+
+    int run(const HarnessOption &option) {
+        auto metric = parse_metric(option.metric);
+        if (!metric.ok()) {
+            zircon::tools::report(metric.status());
+            return 1;
+        }
+        auto base = read_vecs(option.base);
+        if (!base.ok()) {
+            zircon::tools::report(base.status());
+            return 1;
+        }
+        auto query = read_vecs(option.query);
+        if (!query.ok()) {
+            zircon::tools::report(query.status());
+            return 1;
+        }
+        if (query.value().dim != base.value().dim) {
+            std::fprintf(stderr, "query dimension %zu, base dimension %zu\n", query.value().dim, base.value().dim);
+            return 1;
+        }
+        std::size_t nq = query.value().n;
+        if (option.nq > 0) {
+            nq = std::min(nq, option.nq);
+        }
+        if (nq == 0) {
+            std::fprintf(stderr, "no query\n");
+            return 1;
+        }
+        zircon::ThreadPool build_pool(option.build_threads);
+        zircon::ThreadPool search_pool(option.threads);
+
+        auto t0 = Clock::now();
+        turbo::ResultStatus<std::vector<int32_t>> truth = option.gt.empty()
+                                                          ? exact_truth(option, metric.value(), base.value(),
+                                                                        query.value(), nq, build_pool)
+                                                          : read_ivecs(option.gt, nq, option.k);
+        if (!truth.ok()) {
+            zircon::tools::report(truth.status());
+            return 1;
+        }
+        auto t1 = Clock::now();
+        auto index = build_index(option, metric.value(), base.value(), build_pool);
+        if (!index.ok()) {
+            zircon::tools::report(index.status());
+            return 1;
+        }
+        auto t2 = Clock::now();
+        std::printf("# base %zu x %zu, queries %zu, k %zu, index %s, ground truth %.1fs, build %.1fs\n",
+                    base.value().n, base.value().dim, nq, option.k, option.index.c_str(),
+                    std::chrono::duration<double>(t1 - t0).count(), std::chrono::duration<double>(t2 - t1).count());
+        std::printf("%10s %12s %12s %12s %12s %12s\n", option.index == "ivf" ? "nprobe" : "ef", "qps",
+                    "recall", "mean_us", "p50_us", "p99_us");
+
+        std::vector<std::size_t> sweep = option.sweep;
+        if (option.index == "flat") {
+            sweep = {0};
+        }
+        for (auto value: sweep) {
+            zircon::SearchOption so;
+            so.k = option.k;
+            if (option.index == "ivf") {
+                so.nprobe = value;
+            } else {
+                so.ef = std::max(value, option.k);
+            }
+            auto sr = run_queries(*index.value(), query.value(), nq, truth.value(), so, option.batch,
+                                  search_pool);
+            std::printf("%10zu %12.1f %12.4f %12.1f %12.1f %12.1f\n", value, sr.qps, sr.recall, sr.mean_us,
+                        sr.p50_us, sr.p99_us);
+        }
+        return 0;
+    }
+
+}  // namespace
+
+int main(int argc, char **argv) {
+    HarnessOption option;
+    if (!parse_args(argc, argv, option)) {
+        usage();
+        return 1;
+    }
+    return run(option);
+}
@@ -0,0 +1,198 @@
+// Copyright 2023 The Elastic-AI Authors.
+// part of Elastic AI Search
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+#include "benchmark/benchmark.h"
+#include "zircon/utility/distance_dispatch.h"
+#include "zircon/utility/float16.h"
+#include "zircon/core/allocator.h"
+#include "turbo/random/random.h"
+#include <string>
+#include <vector>
+
+// every kernel of every table the running cpu support, over the dimensions of
+// the common embedding models. the argument is the dimension, the batch and
+// matrix kernels score kBase vectors, large enough to leave the l1 cache.
+
+namespace {
+
+    using zircon::distance::DistanceKernels;
+
+    template<typename T>
+    using vector_type = std::vector<T, turbo::aligned_allocator<T, 64>>;
+
+    constexpr std::size_t kBase = 4096;
+    constexpr std::size_t kQueries = 16;
+
+    const std::vector<int64_t> kDims = {96, 128, 384, 768, 1536};
+
+    vector_type<float> random_floats(std::size_t n) {
+        vector_type<float> v(n);
+        for (auto &x: v) {
+            x = turbo::uniform(-1.0f, 1.0f);
+        }
+        return v;
+    }
+
+    vector_type<uint8_t> random_bytes(std::size_t n) {
+        vector_type<uint8_t> v(n);
+        for (auto &x: v) {
+            x = static_cast<uint8_t>(turbo::uniform(0, 256));
+        }
+        return v;
+    }
+
+    void set_processed(benchmark::State &state, std::size_t items, std::size_t bytes) {
+        state.SetItemsProcessed(static_cast<int64_t>(state.iterations() * items));
+        state.SetBytesProcessed(static_cast<int64_t>(state.iterations() * bytes));
+    }
+
+    void BM_Float(benchmark::State &state, zircon::distance::float_distance_func fn) {
+        auto dim = static_cast<std::size_t>(state.range(0));
+        auto a = random_floats(dim);
+        auto b = random_floats(dim);
+        for (auto _: state) {
+            benchmark::DoNotOptimize(fn(a.data(), b.data(), dim));
+        }
+        set_processed(state, 1, 2 * dim * sizeof(float));
+    }
+
+    // the argument is the dimension in bits
+    void BM_Binary(benchmark::State &state, zircon::distance::binary_distance_func fn) {
+        auto nbytes = static_cast<std::size_t>(state.range(0)) / 8;
+        auto a = random_bytes(nbytes);
+        auto b = random_bytes(nbytes);
+        for (auto _: state) {
+            benchmark::DoNotOptimize(fn(a.data(), b.data(), nbytes));
+        }
+        set_processed(state, 1, 2 * nbytes);
+    }
+
+    void BM_Sq8(benchmark::State &state, zircon::distance::sq8_distance_func fn) {
+        auto dim = static_cast<std::size_t>(state.range(0));
+        auto query = random_floats(dim);
+        auto code = random_bytes(dim);
+        vector_type<float> vmin(dim, -1.0f);
+        vector_type<float> scale(dim, 2.0f / 255.0f);
+        for (auto _: state) {
+            benchmark::DoNotOptimize(fn(query.data(), code.data(), vmin.data(), scale.data(), dim));
+        }
+        set_processed(state, 1, dim);
+    }
+
+    void BM_Fp16(benchmark::State &state, zircon::distance::fp16_distance_func fn) {
+        auto dim = static_cast<std::size_t>(state.range(0));
+        auto query = random_floats(dim);
+        vector_type<uint16_t> code(dim);
+        for (auto &c: code) {
+            c = zircon::float_to_half(turbo::uniform(-1.0f, 1.0f));
+        }
+        for (auto _: state) {
+            benchmark::DoNotOptimize(fn(query.data(), code.data(), dim));
+        }
+        set_processed(state, 1, dim * sizeof(uint16_t));
+    }
+
+    void BM_Batch(benchmark::State &state, zircon::distance::batch_distance_func fn) {
+        auto dim = static_cast<std::size_t>(state.range(0));
+        auto query = random_floats(dim);
+        auto base = random_floats(kBase * dim);
+        vector_type<float> out(kBase);
+        for (auto _: state) {
+            fn(query.data(), base.data(), dim, kBase, out.data());
+            benchmark::ClobberMemory();
+        }
+        set_processed(state, kBase, kBase * dim * sizeof(float));
+    }
+
+    // the argument is the dimension, coded with one bit per dimension
+    void BM_BatchHamming(benchmark::State &state, zircon::distance::batch_binary_distance_func fn) {
+        auto nbytes = static_cast<std::size_t>(state.range(0)) / 8;
+        auto query = random_bytes(nbytes);
+        auto base = random_bytes(kBase * nbytes);
+        vector_type<float> out(kBase);
+        for (auto _: state) {
+            fn(query.data(), base.data(), nbytes, kBase, out.data());
+            benchmark::ClobberMemory();
+        }
+        set_processed(state, kBase, kBase * nbytes);
+    }
+
+    void BM_Matrix(benchmark::State &state, zircon::distance::matrix_distance_func fn) {
+        auto dim = static_cast<std::size_t>(state.range(0));
+        auto queries = random_floats(kQueries * dim);
+        auto base = random_floats(kBase * dim);
+        vector_type<float> out(kQueries * kBase);
+        for (auto _: state) {
+            fn(queries.data(), kQueries, base.data(), kBase, dim, out.data(), kBase);
+            benchmark::ClobberMemory();
+        }
+        set_processed(state, kQueries * kBase, kBase * dim * sizeof(float));
+    }
+
+    // the argument is the dimension, coded with one 4 bit sub quantizer every 2 floats
+    void BM_Pq4Scan(benchmark::State &state, zircon::distance::pq4_scan_func fn) {
+        auto m = static_cast<std::size_t>(state.range(0)) / 2;
+        const std::size_t nblocks = kBase / 32;
+        auto codes = random_bytes(nblocks * m * 16);
+        auto lut = random_bytes(m * 16);
+        for (auto &l: lut) {
+            l >>= 4;
+        }
+        vector_type<uint16_t> out(kBase);
+        for (auto _: state) {
+            fn(codes.data(), nblocks, m, lut.data(), out.data());
+            benchmark::ClobberMemory();
+        }
+        set_processed(state, kBase, codes.size());
+    }
+
+    template<typename Fn, typename Kernel>
+    void register_kernel(const DistanceKernels *k, const char *name, Fn bm, Kernel fn) {
+        if (fn == nullptr) {
+            return;
+        }
+        auto *b = benchmark::RegisterBenchmark((std::string(name) + "/" + k->arch_name).c_str(), bm, fn);
+        b->ArgName("dim");
+        for (auto dim: kDims) {
+            b->Arg(dim);
+        }
+    }
+
+    bool register_all() {
+        for (auto *k: zircon::distance::available_distance_kernels()) {
+            register_kernel(k, "l1", BM_Float, k->l1);
+            register_kernel(k, "l2", BM_Float, k->l2);
+            register_kernel(k, "ip", BM_Float, k->ip);
+            register_kernel(k, "cosine", BM_Float, k->cosine);
+            register_kernel(k, "hamming", BM_Binary, k->hamming);
+            register_kernel(k, "jaccard", BM_Binary, k->jaccard);
+            register_kernel(k, "sq8_l2", BM_Sq8, k->sq8_l2);
+            register_kernel(k, "sq8_ip", BM_Sq8, k->sq8_ip);
+            register_kernel(k, "fp16_l2", BM_Fp16, k->fp16_l2);
+            register_kernel(k, "fp16_ip", BM_Fp16, k->fp16_ip);
+            register_kernel(k, "batch_hamming", BM_BatchHamming, k->batch_hamming);
+            register_kernel(k, "batch_l1", BM_Batch, k->batch_l1);
+            register_kernel(k, "batch_l2", BM_Batch, k->batch_l2);
+            register_kernel(k, "batch_ip", BM_Batch, k->batch_ip);
+            register_kernel(k, "matrix_l1", BM_Matrix, k->matrix_l1);
+            register_kernel(k, "matrix_l2", BM_Matrix, k->matrix_l2);
+            register_kernel(k, "matrix_ip", BM_Matrix, k->matrix_ip);
+            register_kernel(k, "pq4_scan", BM_Pq4Scan, k->pq4_scan);
+        }
+        return true;
+    }
+
+    [[maybe_unused]] const bool kRegistered = register_all();
+
+}  // namespace
@@ -0,0 +1,177 @@
+// Copyright 2023 The Elastic-AI Authors.
+// part of Elastic AI Search
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+#include "benchmark/benchmark.h"
+#include "zircon/store/mem_vector_store.h"
+#include "turbo/random/random.h"
+#include <memory>
+#include <vector>
+
+// the store operations under contention. the store is shared by the threads of
+// a run, it is set up by thread 0 before the timed loop and freed after it.
+// the argument is the dimension.
+
+namespace {
+
+    // vectors in the store before the timed loop of the read benchmarks
+    constexpr std::size_t kPrefill = 1 << 16;
+    // labels of one thread, the threads never touch the labels of another
+    constexpr zircon::label_type kThreadLabels = 1 << 24;
+    constexpr std::size_t kLookupBatch = 256;
+
+    std::unique_ptr<zircon::MemVectorStore> g_store;
+
+    zircon::VectorStoreOption make_option(std::size_t dim) {
+        zircon::VectorStoreOption op;
+        op.max_elements = kPrefill * 2;
+        op.vector_byte_size = static_cast<uint32_t>(dim * sizeof(float));
+        op.dimension = static_cast<uint32_t>(dim);
+        op.enable_replace_vacant = true;
+        return op;
+    }
+
+    std::vector<float> random_vector(std::size_t dim) {
+        std::vector<float> v(dim);
+        for (auto &x: v) {
+            x = turbo::uniform(-1.0f, 1.0f);
+        }
+        return v;
+    }
+
+    turbo::Span<uint8_t> as_bytes(std::vector<float> &v) {
+        return turbo::Span<uint8_t>{reinterpret_cast<uint8_t *>(v.data()), v.size() * sizeof(float)};
+    }
+
+    void setup_store(benchmark::State &state, bool prefill) {
+        auto dim = static_cast<std::size_t>(state.range(0));
+        g_store = std::make_unique<zircon::MemVectorStore>();
+        if (!g_store->initialize(make_option(dim)).ok()) {
+            state.SkipWithError("initialize store failed");
+            return;
+        }
+        if (!prefill) {
+            return;
+        }
+        auto v = random_vector(dim);
+        for (zircon::label_type l = 0; l < kPrefill; ++l) {
+            if (!g_store->add_vector(l, as_bytes(v)).ok()) {
+                state.SkipWithError("prefill store failed");
+                return;
+            }
+        }
+    }
+
+    // add a vector and remove it, the location left is reused by the next add
+    void BM_AddRemove(benchmark::State &state) {
+        if (state.thread_index() == 0) {
+            setup_store(state, false);
+        }
+        auto v = random_vector(static_cast<std::size_t>(state.range(0)));
+        auto bytes = as_bytes(v);
+        zircon::label_type label = static_cast<zircon::label_type>(state.thread_index() + 1) * kThreadLabels;
+        for (auto _: state) {
+            auto r = g_store->add_vector(label, bytes);
+            benchmark::DoNotOptimize(r);
+            auto s = g_store->remove_vector(label);
+            benchmark::DoNotOptimize(s);
+            ++label;
+        }
+        state.SetItemsProcessed(static_cast<int64_t>(state.iterations() * 2));
+        if (state.thread_index() == 0) {
+            g_store.reset();
+        }
+    }
+
+    // label to location, then a copy of the vector
+    void BM_Get(benchmark::State &state) {
+        if (state.thread_index() == 0) {
+            setup_store(state, true);
+        }
+        std::vector<float> out(static_cast<std::size_t>(state.range(0)));
+        auto des = as_bytes(out);
+        for (auto _: state) {
+            auto label = static_cast<zircon::label_type>(turbo::uniform<std::size_t>(0, kPrefill));
+            auto loc = g_store->get_location(label);
+            if (loc.ok()) {
+                g_store->copy_vector(loc.value(), des);
+            }
+            benchmark::ClobberMemory();
+        }
+        state.SetItemsProcessed(static_cast<int64_t>(state.iterations()));
+        state.SetBytesProcessed(static_cast<int64_t>(state.iterations() * des.size()));
+        if (state.thread_index() == 0) {
+            g_store.reset();
+        }
+    }
+
+    // kLookupBatch labels through the batched lookup, every shard locked once
+    void BM_GetLocations(benchmark::State &state) {
+        if (state.thread_index() == 0) {
+            setup_store(state, true);
+        }
+        std::vector<zircon::label_type> labels(kLookupBatch);
+        std::vector<zircon::location_t> locs(kLookupBatch);
+        for (auto _: state) {
+            state.PauseTiming();
+            for (auto &l: labels) {
+                l = static_cast<zircon::label_type>(turbo::uniform<std::size_t>(0, kPrefill));
+            }
+            state.ResumeTiming();
+            benchmark::DoNotOptimize(g_store->get_locations(turbo::Span<const zircon::label_type>{labels},
+                                                            turbo::Span<zircon::location_t>{locs}));
+        }
+        state.SetItemsProcessed(static_cast<int64_t>(state.iterations() * kLookupBatch));
+        if (state.thread_index() == 0) {
+            g_store.reset();
+        }
+    }
+
+    // thread 0 keeps adding and removing while the others read
+    void BM_ReadWhileWriting(benchmark::State &state) {
+        if (state.thread_index() == 0) {
+            setup_store(state, true);
+        }
+        auto v = random_vector(static_cast<std::size_t>(state.range(0)));
+        auto bytes = as_bytes(v);
+        std::vector<float> out(v.size());
+        auto des = as_bytes(out);
+        zircon::label_type label = kThreadLabels;
+        for (auto _: state) {
+            if (state.thread_index() == 0) {
+                auto r = g_store->add_vector(label, bytes);
+                benchmark::DoNotOptimize(r);
+                auto s = g_store->remove_vector(label);
+                benchmark::DoNotOptimize(s);
+                ++label;
+            } else {
+                auto loc = g_store->get_location(
+                        static_cast<zircon::label_type>(turbo::uniform<std::size_t>(0, kPrefill)));
+                if (loc.ok()) {
+                    g_store->copy_vector(loc.value(), des);
+                }
+                benchmark::ClobberMemory();
+            }
+        }
+        state.SetItemsProcessed(static_cast<int64_t>(state.iterations()));
+        if (state.thread_index() == 0) {
+            g_store.reset();
+        }
+    }
+
+}  // namespace
+
+BENCHMARK(BM_AddRemove)->ArgName("dim")->Arg(128)->Arg(768)->ThreadRange(1, 8)->UseRealTime();
+BENCHMARK(BM_Get)->ArgName("dim")->Arg(128)->Arg(768)->ThreadRange(1, 8)->UseRealTime();
+BENCHMARK(BM_GetLocations)->ArgName("dim")->Arg(128)->ThreadRange(1, 8)->UseRealTime();
+BENCHMARK(BM_ReadWhileWriting)->ArgName("dim")->Arg(128)->Arg(768)->ThreadRange(2, 8)->UseRealTime();
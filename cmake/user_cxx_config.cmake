@@ -37,7 +37,23 @@ endif ()
 # ${CARBIN_RANDOM_RANDEN_COPTS}
 # set it to haswell arch
 ##############################################################################
-set(CARBIN_CXX_OPTIONS ${CARBIN_DEFAULT_COPTS} ${CARBIN_ARCH_OPTION} ${CARBIN_RANDOM_RANDEN_COPTS})
+##############################################################################
+# ZIRCON_RUNTIME_DISPATCH
+# build the library with the baseline flags of the target cpu family, and
+# compile the simd kernels for every instruction set with its own flags,
+# the best one is selected when the process start, so one binary can run
+# on a mixed fleet. turn it off to build everything with the carbin arch
+# option, the binary then only run on cpus like the build host.
+##############################################################################
+option(ZIRCON_RUNTIME_DISPATCH "select simd kernels at runtime" ON)
+set(ZIRCON_AVX2_FLAGS "-mavx2" "-mfma" "-mf16c" "-mpopcnt")
+set(ZIRCON_AVX512_FLAGS "-mavx512f" "-mavx512bw" "-mavx512dq" "-mavx512vl" "-mfma" "-mf16c" "-mpopcnt")
+set(ZIRCON_AVX512_VPOPCNT_FLAGS ${ZIRCON_AVX512_FLAGS} "-mavx512vpopcntdq")
+if (ZIRCON_RUNTIME_DISPATCH)
+    set(CARBIN_CXX_OPTIONS ${CARBIN_DEFAULT_COPTS} ${CARBIN_RANDOM_RANDEN_COPTS})
+else ()
+    set(CARBIN_CXX_OPTIONS ${CARBIN_DEFAULT_COPTS} ${CARBIN_ARCH_OPTION} ${CARBIN_RANDOM_RANDEN_COPTS})
+endif ()
 ###############################
 #
 # define you options here
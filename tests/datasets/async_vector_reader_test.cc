@@ -0,0 +1,166 @@
+// Copyright 2023 The Elastic-AI Authors.
+// part of Elastic AI Search
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#define DOCTEST_CONFIG_IMPLEMENT_WITH_MAIN
+#include "turbo/testing/test.h"
+#include "zircon/datasets/async_vector_reader.h"
+#include <filesystem>
+#include <fstream>
+#include <string>
+#include <vector>
+
+namespace {
+    constexpr std::size_t kDim = 13;
+    constexpr std::size_t kRows = 5000;
+
+    float value(std::size_t row, std::size_t d) {
+        return static_cast<float>(row) * 100.0f + static_cast<float>(d);
+    }
+
+    std::string write_file(zircon::VectorFileFormat format) {
+        auto path = (std::filesystem::temp_directory_path() /
+                     (format == zircon::VectorFileFormat::FORMAT_BIN ? "zircon_async_test.bin"
+                                                                    : "zircon_async_test.fvecs")).string();
+        std::ofstream out(path, std::ios::binary);
+        uint32_t dim = kDim;
+        if (format == zircon::VectorFileFormat::FORMAT_BIN) {
+            uint32_t header[2] = {static_cast<uint32_t>(kRows), dim};
+            out.write(reinterpret_cast<const char *>(header), sizeof(header));
+        }
+        for (std::size_t i = 0; i < kRows; ++i) {
+            if (format == zircon::VectorFileFormat::FORMAT_FVECS) {
+                out.write(reinterpret_cast<const char *>(&dim), sizeof(dim));
+            }
+            for (std::size_t d = 0; d < kDim; ++d) {
+                float v = value(i, d);
+                out.write(reinterpret_cast<const char *>(&v), sizeof(v));
+            }
+        }
+        return path;
+    }
+
+    void check_reader(zircon::VectorFileFormat format, zircon::AsyncIoBackend backend, bool direct_io) {
+        auto path = write_file(format);
+        zircon::SerializeOption option;
+        option.dimension = kDim;
+        zircon::AsyncReadOption aop;
+        aop.format = format;
+        aop.batch_size = 333;
+        aop.queue_depth = 3;
+        aop.backend = backend;
+        aop.direct_io = direct_io;
+        zircon::AsyncVectorSetReader reader;
+        REQUIRE(reader.open(path, option, aop).ok());
+        CHECK(reader.backend() != zircon::AsyncIoBackend::IO_AUTO);
+        if (backend != zircon::AsyncIoBackend::IO_AUTO) {
+            CHECK(reader.backend() == backend);
+        }
+        CHECK_EQ(reader.num_vectors(), kRows);
+
+        zircon::VectorBatch batch;
+        std::size_t row = 0;
+        while (true) {
+            auto rs = reader.next_batch(&batch);
+            if (turbo::is_reach_file_end(rs)) {
+                break;
+            }
+            REQUIRE(rs.ok());
+            const auto *v = reinterpret_cast<const float *>(batch.data());
+            for (std::size_t i = 0; i < batch.size(); ++i, ++row) {
+                CHECK_EQ(v[i * kDim], value(row, 0));
+                CHECK_EQ(v[i * kDim + kDim - 1], value(row, kDim - 1));
+            }
+            if (row == 999) {
+                // gather in the middle of the stream
+                std::vector<std::size_t> ids = {4999, 0, 17, 2500, 17, 1234, 3};
+                std::vector<float> out(ids.size() * kDim);
+                turbo::Span<uint8_t> span{reinterpret_cast<uint8_t *>(out.data()), out.size() * sizeof(float)};
+                REQUIRE(reader.gather(turbo::Span<const std::size_t>{ids}, span).ok());
+                for (std::size_t i = 0; i < ids.size(); ++i) {
+                    CHECK_EQ(out[i * kDim + 5], value(ids[i], 5));
+                }
+            }
+        }
+        CHECK_EQ(row, kRows);
+        CHECK_EQ(reader.has_read(), kRows);
+        reader.close();
+        std::filesystem::remove(path);
+    }
+}  // namespace
+
+TEST_CASE("async reader thread pool") {
+    check_reader(zircon::VectorFileFormat::FORMAT_BIN, zircon::AsyncIoBackend::IO_THREAD_POOL, false);
+    check_reader(zircon::VectorFileFormat::FORMAT_FVECS, zircon::AsyncIoBackend::IO_THREAD_POOL, true);
+}
+
+TEST_CASE("async reader auto") {
+    check_reader(zircon::VectorFileFormat::FORMAT_BIN, zircon::AsyncIoBackend::IO_AUTO, true);
+    check_reader(zircon::VectorFileFormat::FORMAT_FVECS, zircon::AsyncIoBackend::IO_AUTO, false);
+}
+
+TEST_CASE("async reader bad file") {
+    auto path = (std::filesystem::temp_directory_path() / "zircon_async_bad.fvecs").string();
+    {
+        std::ofstream out(path, std::ios::binary);
+        uint32_t dim = kDim;
+        out.write(reinterpret_cast<const char *>(&dim), sizeof(dim));
+        float v = 1.0f;
+        out.write(reinterpret_cast<const char *>(&v), sizeof(v));
+    }
+    zircon::SerializeOption option;
+    option.dimension = kDim;
+    zircon::AsyncReadOption aop;
+    aop.format = zircon::VectorFileFormat::FORMAT_FVECS;
+    zircon::AsyncVectorSetReader reader;
+    CHECK_FALSE(reader.open(path, option, aop).ok());
+    aop.format = zircon::VectorFileFormat::FORMAT_TSV;
+    CHECK_FALSE(reader.open(path, option, aop).ok());
+    std::filesystem::remove(path);
+}
+
+TEST_CASE("async reader corrupt record") {
+    auto path = write_file(zircon::VectorFileFormat::FORMAT_FVECS);
+    {
+        // the dimension of the first record of the second chunk
+        std::fstream out(path, std::ios::binary | std::ios::in | std::ios::out);
+        out.seekp(static_cast<std::streamoff>(100 * (sizeof(uint32_t) + kDim * sizeof(float))));
+        uint32_t dim = kDim + 1;
+        out.write(reinterpret_cast<const char *>(&dim), sizeof(dim));
+    }
+    zircon::SerializeOption option;
+    option.dimension = kDim;
+    for (auto backend : {zircon::AsyncIoBackend::IO_THREAD_POOL, zircon::AsyncIoBackend::IO_AUTO}) {
+        zircon::AsyncReadOption aop;
+        aop.format = zircon::VectorFileFormat::FORMAT_FVECS;
+        aop.batch_size = 100;
+        aop.queue_depth = 2;
+        aop.backend = backend;
+        zircon::AsyncVectorSetReader reader;
+        REQUIRE(reader.open(path, option, aop).ok());
+        zircon::VectorBatch batch;
+        REQUIRE(reader.next_batch(&batch).ok());
+        CHECK_FALSE(reader.next_batch(&batch).ok());
+        // the error again, no wait for a read never submitted
+        auto rs = reader.next_batch(&batch);
+        CHECK_FALSE(rs.ok());
+        CHECK_FALSE(turbo::is_reach_file_end(rs));
+        std::vector<std::size_t> ids = {0};
+        std::vector<uint8_t> out(kDim * sizeof(float));
+        CHECK_FALSE(reader.gather(turbo::Span<const std::size_t>{ids}, turbo::Span<uint8_t>{out}).ok());
+        CHECK_EQ(reader.has_read(), 100);
+        reader.close();
+    }
+    std::filesystem::remove(path);
+}
@@ -0,0 +1,155 @@
+// Copyright 2023 The Elastic-AI Authors.
+// part of Elastic AI Search
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#define DOCTEST_CONFIG_IMPLEMENT_WITH_MAIN
+#include "turbo/testing/test.h"
+#include "zircon/datasets/tsv_codec.h"
+#include "zircon/datasets/tsv_vector_io.h"
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <random>
+#include <string>
+#include <vector>
+
+TEST_CASE("tsv find line end") {
+    std::string buf(200, 'x');
+    for (std::size_t pos = 0; pos < buf.size(); ++pos) {
+        auto s = buf;
+        s[pos] = '\n';
+        CHECK_EQ(zircon::tsv::find_line_end(s.data(), s.data() + s.size()), s.data() + pos);
+        // a line end past the range is not seen
+        CHECK_EQ(zircon::tsv::find_line_end(s.data(), s.data() + pos), s.data() + pos);
+    }
+    CHECK_EQ(zircon::tsv::find_line_end(buf.data(), buf.data() + buf.size()), buf.data() + buf.size());
+}
+
+TEST_CASE("tsv parse float") {
+    std::mt19937 rng(7);
+    std::uniform_real_distribution<float> mant(-10.0f, 10.0f);
+    std::uniform_int_distribution<int> expo(-40, 38);
+    const char *formats[] = {"%.9g", "%g", "%.3f", "%e", "%.12e"};
+    char buf[64];
+    for (int i = 0; i < 20000; ++i) {
+        auto v = mant(rng) * std::pow(10.0f, static_cast<float>(expo(rng) / 4));
+        std::snprintf(buf, sizeof(buf), formats[i % 5], static_cast<double>(v));
+        auto len = std::strlen(buf);
+        float expect = std::strtof(buf, nullptr);
+        float got = 0;
+        auto *end = zircon::tsv::parse_float(buf, buf + len, &got);
+        REQUIRE(end == buf + len);
+        CHECK_EQ(got, expect);
+        float generic = 0;
+        end = zircon::tsv::detail::parse_float_generic(buf, buf + len, &generic);
+        REQUIRE(end == buf + len);
+        CHECK_EQ(generic, expect);
+    }
+    const char *special[] = {"+1.5", "-0", "0.000000000000000000000000000000000000000001", "1e50", "inf", "-nan",
+                             "123456789012345678901234567890", ".5", "5."};
+    for (auto *s: special) {
+        auto len = std::strlen(s);
+        float expect = std::strtof(s, nullptr);
+        float got = 0;
+        float generic = 0;
+        REQUIRE(zircon::tsv::parse_float(s, s + len, &got) == s + len);
+        REQUIRE(zircon::tsv::detail::parse_float_generic(s, s + len, &generic) == s + len);
+        if (std::isnan(expect)) {
+            CHECK(std::isnan(got));
+            CHECK(std::isnan(generic));
+        } else {
+            CHECK_EQ(got, expect);
+            CHECK_EQ(generic, expect);
+        }
+    }
+    float v;
+    const char *bad = "abc";
+    CHECK(zircon::tsv::parse_float(bad, bad + 3, &v) == nullptr);
+    CHECK(zircon::tsv::detail::parse_float_generic(bad, bad + 3, &v) == nullptr);
+    // stop at the end of the range, not at the terminator
+    const char *cut = "12345";
+    CHECK(zircon::tsv::parse_float(cut, cut + 2, &v) == cut + 2);
+    CHECK_EQ(v, 12.0f);
+}
+
+TEST_CASE("tsv parse line") {
+    float out[3];
+    std::string line = " 1.5\t-2 \t3e2\r";
+    REQUIRE(zircon::tsv::parse_line(line.data(), line.data() + line.size(), 3, out).ok());
+    CHECK_EQ(out[0], 1.5f);
+    CHECK_EQ(out[1], -2.0f);
+    CHECK_EQ(out[2], 300.0f);
+    CHECK_FALSE(zircon::tsv::parse_line(line.data(), line.data() + line.size(), 2, out).ok());
+    std::string short_line = "1\t2";
+    CHECK_FALSE(zircon::tsv::parse_line(short_line.data(), short_line.data() + short_line.size(), 3, out).ok());
+    std::string glued = "1\t2x\t3";
+    CHECK_FALSE(zircon::tsv::parse_line(glued.data(), glued.data() + glued.size(), 3, out).ok());
+}
+
+TEST_CASE("tsv append line round trip") {
+    std::mt19937 rng(11);
+    std::normal_distribution<float> dist(0.0f, 100.0f);
+    std::vector<float> values(37);
+    for (auto &v: values) {
+        v = dist(rng);
+    }
+    values[0] = 0.0f;
+    values[1] = 1e-30f;
+    std::string out = "head\n";
+    zircon::tsv::append_line(values.data(), values.size(), &out);
+    REQUIRE(out.back() == '\n');
+    const char *line = out.data() + 5;
+    std::vector<float> back(values.size());
+    REQUIRE(zircon::tsv::parse_line(line, out.data() + out.size() - 1, back.size(), back.data()).ok());
+    CHECK(back == values);
+}
+
+TEST_CASE("tsv reader writer") {
+    auto path = (std::filesystem::temp_directory_path() / "zircon_tsv_codec_test.tsv").string();
+    constexpr std::size_t kDim = 5;
+    constexpr std::size_t kRows = 3000;
+    std::vector<float> data(kDim * kRows);
+    for (std::size_t i = 0; i < data.size(); ++i) {
+        data[i] = static_cast<float>(i) * 0.37f - 100.0f;
+    }
+    zircon::SerializeOption option;
+    option.dimension = kDim;
+    option.data_type = zircon::DataType::DT_FLOAT;
+    {
+        turbo::SequentialWriteFile file;
+        REQUIRE(file.open(path).ok());
+        zircon::TsvVectorSetWriter writer;
+        REQUIRE(writer.initialize(&file, option).ok());
+        auto bytes = reinterpret_cast<uint8_t *>(data.data());
+        REQUIRE(writer.write_vector(turbo::Span<uint8_t>{bytes, kDim * sizeof(float)}).ok());
+        REQUIRE(writer.write_batch(turbo::Span<uint8_t>{bytes + kDim * sizeof(float),
+                                                        (kRows - 1) * kDim * sizeof(float)}, kRows - 1).ok());
+        CHECK_EQ(writer.has_write(), kRows);
+        file.close();
+    }
+    turbo::SequentialReadFile file;
+    REQUIRE(file.open(path).ok());
+    zircon::TsvVectorSetReader reader;
+    REQUIRE(reader.initialize(&file, option).ok());
+    std::vector<float> back(kDim * (kRows + 10));
+    turbo::Span<uint8_t> span{reinterpret_cast<uint8_t *>(back.data()), back.size() * sizeof(float)};
+    auto rs = reader.read_batch(span, kRows + 10);
+    REQUIRE(rs.ok());
+    CHECK_EQ(rs.value(), kRows);
+    back.resize(data.size());
+    CHECK(back == data);
+    std::filesystem::remove(path);
+}
@@ -0,0 +1,243 @@
+// Copyright 2023 The Elastic-AI Authors.
+// part of Elastic AI Search
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#define DOCTEST_CONFIG_IMPLEMENT_WITH_MAIN
+#include "turbo/testing/test.h"
+#include "zircon/datasets/bin_vector_io.h"
+#include "zircon/datasets/fvec_vector_io.h"
+#include "zircon/datasets/vector_set_loader.h"
+#include "zircon/store/mem_vector_store.h"
+#include "turbo/files/sequential_write_file.h"
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace {
+    constexpr std::size_t kDim = 8;
+    constexpr std::size_t kRows = 2000;
+
+    float value(std::size_t row, std::size_t d) {
+        return static_cast<float>(row) + static_cast<float>(d) * 0.25f;
+    }
+
+    std::string temp_path(const char *name) {
+        return (std::filesystem::temp_directory_path() / name).string();
+    }
+
+    void write_fvecs(const std::string &path) {
+        std::ofstream out(path, std::ios::binary);
+        uint32_t dim = kDim;
+        for (std::size_t i = 0; i < kRows; ++i) {
+            out.write(reinterpret_cast<const char *>(&dim), sizeof(dim));
+            for (std::size_t d = 0; d < kDim; ++d) {
+                float v = value(i, d);
+                out.write(reinterpret_cast<const char *>(&v), sizeof(v));
+            }
+        }
+    }
+
+    void write_bin(const std::string &path, uint32_t nvec) {
+        std::ofstream out(path, std::ios::binary);
+        uint32_t header[2] = {nvec, static_cast<uint32_t>(kDim)};
+        out.write(reinterpret_cast<const char *>(header), sizeof(header));
+        for (std::size_t i = 0; i < kRows; ++i) {
+            for (std::size_t d = 0; d < kDim; ++d) {
+                float v = value(i, d);
+                out.write(reinterpret_cast<const char *>(&v), sizeof(v));
+            }
+        }
+    }
+
+    void write_tsv(const std::string &path) {
+        std::ofstream out(path);
+        for (std::size_t i = 0; i < kRows; ++i) {
+            for (std::size_t d = 0; d < kDim; ++d) {
+                out << value(i, d) << (d + 1 == kDim ? "" : "\t");
+            }
+            out << (i % 7 == 0 ? "\r\n\n" : "\n");
+        }
+    }
+
+    zircon::VectorStoreOption store_option() {
+        zircon::VectorStoreOption op;
+        op.batch_size = 128;
+        op.max_elements = kRows;
+        op.vector_byte_size = kDim * sizeof(float);
+        op.dimension = kDim;
+        return op;
+    }
+
+    void check_store(const zircon::MemVectorStore &store, zircon::label_type start_label) {
+        CHECK_EQ(store.size(), kRows);
+        for (std::size_t i = 0; i < kRows; ++i) {
+            auto loc = store.get_location(start_label + i);
+            REQUIRE(loc.ok());
+            const auto *v = reinterpret_cast<const float *>(store.get_vector(loc.value()).data());
+            for (std::size_t d = 0; d < kDim; ++d) {
+                CHECK_EQ(v[d], value(i, d));
+            }
+        }
+    }
+}  // namespace
+
+TEST_CASE("load fvecs") {
+    auto path = temp_path("zircon_loader_test.fvecs");
+    write_fvecs(path);
+    zircon::MemVectorStore store;
+    REQUIRE(store.initialize(store_option()).ok());
+    zircon::VectorLoadOption op;
+    op.format = zircon::VectorFileFormat::FORMAT_FVECS;
+    op.dimension = kDim;
+    op.nthreads = 4;
+    op.chunk_vectors = 100;
+    op.read_ahead = 2;
+    op.start_label = 10;
+    auto rs = zircon::load_vector_set(path, op, &store);
+    REQUIRE(rs.ok());
+    CHECK_EQ(rs.value(), kRows);
+    check_store(store, 10);
+
+    // a wrong dimension is reported
+    zircon::MemVectorStore other;
+    REQUIRE(other.initialize(store_option()).ok());
+    op.dimension = kDim + 1;
+    CHECK_FALSE(zircon::load_vector_set(path, op, &other).ok());
+    std::filesystem::remove(path);
+}
+
+TEST_CASE("load bin") {
+    auto path = temp_path("zircon_loader_test.bin");
+    write_bin(path, kRows);
+    zircon::MemVectorStore store;
+    REQUIRE(store.initialize(store_option()).ok());
+    zircon::VectorLoadOption op;
+    op.format = zircon::VectorFileFormat::FORMAT_BIN;
+    op.dimension = kDim;
+    op.nthreads = 3;
+    op.chunk_vectors = 333;
+    auto rs = zircon::load_vector_set(path, op, &store);
+    REQUIRE(rs.ok());
+    CHECK_EQ(rs.value(), kRows);
+    check_store(store, 0);
+
+    // the header claims more vectors than the file has
+    write_bin(path, kRows + 5);
+    zircon::MemVectorStore truncated;
+    auto sop = store_option();
+    sop.max_elements = kRows + 5;
+    REQUIRE(truncated.initialize(sop).ok());
+    CHECK_FALSE(zircon::load_vector_set(path, op, &truncated).ok());
+    std::filesystem::remove(path);
+}
+
+TEST_CASE("load tsv") {
+    auto path = temp_path("zircon_loader_test.tsv");
+    write_tsv(path);
+    zircon::MemVectorStore store;
+    REQUIRE(store.initialize(store_option()).ok());
+    zircon::VectorLoadOption op;
+    op.format = zircon::VectorFileFormat::FORMAT_TSV;
+    op.dimension = kDim;
+    op.nthreads = 4;
+    // small blocks so lines are cut between chunks
+    op.chunk_bytes = 4096;
+    auto rs = zircon::load_vector_set(path, op, &store);
+    REQUIRE(rs.ok());
+    CHECK_EQ(rs.value(), kRows);
+    check_store(store, 0);
+
+    {
+        std::ofstream out(path, std::ios::app);
+        out << "1\t2\tx\n";
+    }
+    zircon::MemVectorStore bad;
+    auto sop = store_option();
+    sop.max_elements = kRows + 1;
+    REQUIRE(bad.initialize(sop).ok());
+    CHECK_FALSE(zircon::load_vector_set(path, op, &bad).ok());
+    std::filesystem::remove(path);
+}
+
+TEST_CASE("buffered writers") {
+    std::vector<float> data(kRows * kDim);
+    for (std::size_t i = 0; i < kRows; ++i) {
+        for (std::size_t d = 0; d < kDim; ++d) {
+            data[i * kDim + d] = value(i, d);
+        }
+    }
+    auto bytes = reinterpret_cast<uint8_t *>(data.data());
+    auto read_file = [](const std::string &path) {
+        std::ifstream in(path, std::ios::binary);
+        return std::string(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>());
+    };
+    auto expect_fvecs = temp_path("zircon_writer_expect.fvecs");
+    auto expect_bin = temp_path("zircon_writer_expect.bin");
+    write_fvecs(expect_fvecs);
+    write_bin(expect_bin, kRows);
+    // no buffer, a buffer smaller than a record, and one not a multiple of it
+    for (std::size_t buffer : {std::size_t(0), std::size_t(7), std::size_t(1000), std::size_t(1) << 20}) {
+        CAPTURE(buffer);
+        zircon::SerializeOption so;
+        so.dimension = kDim;
+        so.n_vectors = kRows;
+        so.write_buffer_bytes = buffer;
+        auto path = temp_path("zircon_writer_test");
+        for (int format = 0; format < 2; ++format) {
+            turbo::SequentialWriteFile file;
+            REQUIRE(file.open(path).ok());
+            std::unique_ptr<zircon::VectorSetWriter> writer;
+            if (format == 0) {
+                writer = std::make_unique<zircon::FvecVectorSetWriter>();
+            } else {
+                writer = std::make_unique<zircon::BinaryVectorSetWriter>();
+            }
+            REQUIRE(writer->initialize(&file, so).ok());
+            // one by one records and a large batch mixed
+            const std::size_t vector_bytes = kDim * sizeof(float);
+            for (std::size_t i = 0; i < 10; ++i) {
+                REQUIRE(writer->write_vector(turbo::Span<uint8_t>{bytes + i * vector_bytes, vector_bytes}).ok());
+            }
+            REQUIRE(writer->write_batch(turbo::Span<uint8_t>{bytes + 10 * vector_bytes, (kRows - 10) * vector_bytes},
+                                        kRows - 10).ok());
+            CHECK_EQ(writer->has_write(), kRows);
+            REQUIRE(writer->flush().ok());
+            file.close();
+            CHECK(read_file(path) == read_file(format == 0 ? expect_fvecs : expect_bin));
+        }
+        std::filesystem::remove(path);
+    }
+    // unbuffered by default, the file is complete without a flush
+    {
+        zircon::SerializeOption so;
+        so.dimension = kDim;
+        so.n_vectors = kRows;
+        CHECK_EQ(so.write_buffer_bytes, 0);
+        auto path = temp_path("zircon_writer_test");
+        turbo::SequentialWriteFile file;
+        REQUIRE(file.open(path).ok());
+        zircon::BinaryVectorSetWriter writer;
+        REQUIRE(writer.initialize(&file, so).ok());
+        REQUIRE(writer.write_batch(turbo::Span<uint8_t>{bytes, kRows * kDim * sizeof(float)}, kRows).ok());
+        file.close();
+        CHECK(read_file(path) == read_file(expect_bin));
+        std::filesystem::remove(path);
+    }
+    std::filesystem::remove(expect_fvecs);
+    std::filesystem::remove(expect_bin);
+}
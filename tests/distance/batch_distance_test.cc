@@ -0,0 +1,117 @@
+// Copyright 2023 The Elastic-AI Authors.
+// part of Elastic AI Search
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#define DOCTEST_CONFIG_IMPLEMENT_WITH_MAIN
+#include "turbo/testing/test.h"
+#include "zircon/utility/batch_distance.h"
+#include "zircon/utility/primitive_distance.h"
+#include "zircon/utility/distance_dispatch.h"
+#include "turbo/random/random.h"
+#include <vector>
+
+class BatchDistanceTest {
+public:
+    BatchDistanceTest() {
+        query.resize(kDim);
+        for (size_t i = 0; i < kDim; ++i) {
+            query[i] = turbo::uniform(-1.0f, 1.0f);
+        }
+        auto r = batch.init(kDim * sizeof(float), 256);
+        REQUIRE(r.ok());
+        batch.resize(kSize);
+        std::vector<float> v(kDim);
+        for (size_t j = 0; j < kSize; ++j) {
+            for (size_t i = 0; i < kDim; ++i) {
+                v[i] = turbo::uniform(-1.0f, 1.0f);
+            }
+            batch.set_vector(j, turbo::Span<uint8_t>(reinterpret_cast<uint8_t *>(v.data()), kDim * sizeof(float)));
+        }
+    }
+
+    ~BatchDistanceTest() = default;
+
+    turbo::Span<float> vector_at(size_t i) const {
+        auto s = batch.at(i);
+        return turbo::Span<float>(reinterpret_cast<float *>(s.data()), kDim);
+    }
+
+    // not multiples of the simd width nor of the four rows block
+    static constexpr size_t kDim = 100;
+    static constexpr size_t kSize = 203;
+    std::vector<float, turbo::aligned_allocator<float, 64>> query;
+    zircon::VectorBatch batch;
+};
+
+TEST_CASE_FIXTURE(BatchDistanceTest, "batch distance") {
+    auto q = turbo::Span<float>(query.data(), query.size());
+    std::vector<float> l1(kSize);
+    std::vector<float> l2(kSize);
+    std::vector<float> ip(kSize);
+    zircon::distance::batch_l1(q, batch, l1.data());
+    zircon::distance::batch_l2(q, batch, l2.data());
+    zircon::distance::batch_ip(q, batch, ip.data());
+    for (size_t i = 0; i < kSize; ++i) {
+        CHECK(l1[i] == doctest::Approx(zircon::distance::simple_distance_l1(q, vector_at(i))));
+        CHECK(l2[i] == doctest::Approx(zircon::distance::simple_distance_l2(q, vector_at(i))));
+        CHECK(ip[i] == doctest::Approx(zircon::distance::simple_distance_ip(q, vector_at(i))));
+    }
+}
+
+TEST_CASE_FIXTURE(BatchDistanceTest, "every kernel table") {
+    auto base = reinterpret_cast<const float *>(batch.data());
+    std::vector<float> out(kSize);
+    for (auto *k: zircon::distance::available_distance_kernels()) {
+        CAPTURE(k->arch_name);
+        k->batch_l2(query.data(), base, kDim, kSize, out.data());
+        for (size_t i = 0; i < kSize; ++i) {
+            CHECK(out[i] == doctest::Approx(k->l2(query.data(), base + i * kDim, kDim)));
+        }
+    }
+}
+
+TEST_CASE("hyperbolic batch kernels") {
+    // points of the ball, the lorentz kernels take them as the space coordinates
+    constexpr size_t kDim = BatchDistanceTest::kDim;
+    constexpr size_t kSize = BatchDistanceTest::kSize;
+    std::vector<float, turbo::aligned_allocator<float, 64>> base(kDim * kSize);
+    std::vector<float, turbo::aligned_allocator<float, 64>> query(kDim);
+    auto fill = [](float *x) {
+        for (size_t i = 0; i < kDim; ++i) {
+            x[i] = turbo::uniform(-1.0f, 1.0f) / 11.0f;
+        }
+    };
+    fill(query.data());
+    for (size_t j = 0; j < kSize; ++j) {
+        fill(base.data() + j * kDim);
+    }
+    std::vector<float> out(kSize);
+    for (auto *k: zircon::distance::available_distance_kernels()) {
+        CAPTURE(k->arch_name);
+        k->batch_poincare(query.data(), base.data(), kDim, kSize, out.data());
+        for (size_t i = 0; i < kSize; ++i) {
+            CHECK(out[i] == doctest::Approx(k->poincare(query.data(), base.data() + i * kDim, kDim)));
+        }
+        k->batch_lorentz(query.data(), base.data(), kDim, kSize, out.data());
+        for (size_t i = 0; i < kSize; ++i) {
+            CHECK(out[i] == doctest::Approx(k->lorentz(query.data(), base.data() + i * kDim, kDim)));
+        }
+    }
+    auto q = turbo::Span<float>(query.data(), kDim);
+    zircon::distance::batch_poincare(q, base.data(), kSize, out.data());
+    for (size_t i = 0; i < kSize; ++i) {
+        CHECK(out[i] == doctest::Approx(zircon::distance::simple_distance_poincare(
+                q, turbo::Span<float>(base.data() + i * kDim, kDim))).epsilon(1e-4));
+    }
+}
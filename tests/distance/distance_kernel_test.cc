@@ -0,0 +1,211 @@
+// Copyright 2023 The Elastic-AI Authors.
+// part of Elastic AI Search
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#define DOCTEST_CONFIG_IMPLEMENT_WITH_MAIN
+#include "turbo/testing/test.h"
+#include "zircon/utility/distance.h"
+#include "zircon/utility/primitive_distance.h"
+#include "zircon/utility/distance_dispatch.h"
+#include "turbo/random/random.h"
+#include <cmath>
+#include <vector>
+
+class DistanceKernelTest {
+public:
+    DistanceKernelTest() {
+        a_vec.resize(kDim);
+        b_vec.resize(kDim);
+        a_bits.resize(kBytes);
+        b_bits.resize(kBytes);
+        for (size_t i = 0; i < kDim; ++i) {
+            a_vec[i] = turbo::uniform(-1.0f, 1.0f);
+            b_vec[i] = turbo::uniform(-1.0f, 1.0f);
+        }
+        for (size_t i = 0; i < kBytes; ++i) {
+            a_bits[i] = static_cast<uint8_t>(turbo::uniform(0, 256));
+            b_bits[i] = static_cast<uint8_t>(turbo::uniform(0, 256));
+        }
+    }
+
+    ~DistanceKernelTest() = default;
+
+    // not a multiple of any simd width, to cover the tail loops
+    static constexpr size_t kDim = 397;
+    static constexpr size_t kBytes = 61;
+    std::vector<float, turbo::aligned_allocator<float, 64>> a_vec;
+    std::vector<float, turbo::aligned_allocator<float, 64>> b_vec;
+    std::vector<uint8_t> a_bits;
+    std::vector<uint8_t> b_bits;
+};
+
+TEST_CASE_FIXTURE(DistanceKernelTest, "every kernel table") {
+    auto a = turbo::Span<float>(a_vec.data(), a_vec.size());
+    auto b = turbo::Span<float>(b_vec.data(), b_vec.size());
+    auto ab = turbo::Span<uint8_t>(a_bits.data(), a_bits.size());
+    auto bb = turbo::Span<uint8_t>(b_bits.data(), b_bits.size());
+    auto kernels = zircon::distance::available_distance_kernels();
+    REQUIRE(!kernels.empty());
+    for (auto *k: kernels) {
+        CAPTURE(k->arch_name);
+        CHECK(k->l1(a.data(), b.data(), kDim) == doctest::Approx(zircon::distance::simple_distance_l1(a, b)));
+        CHECK(k->l2(a.data(), b.data(), kDim) == doctest::Approx(zircon::distance::simple_distance_l2(a, b)));
+        CHECK(k->ip(a.data(), b.data(), kDim) == doctest::Approx(zircon::distance::simple_distance_ip(a, b)));
+        CHECK(k->cosine(a.data(), b.data(), kDim) == doctest::Approx(zircon::distance::simple_distance_cosine(a, b)));
+        CHECK(k->hamming(ab.data(), bb.data(), kBytes) == zircon::distance::simple_distance_hamming(ab, bb));
+        CHECK(k->jaccard(ab.data(), bb.data(), kBytes) ==
+              doctest::Approx(zircon::distance::simple_distance_jaccard(ab, bb)));
+    }
+}
+
+TEST_CASE("binary kernels") {
+    // every code size up to a few 64 bytes registers, with the tails of each
+    constexpr size_t kMaxBytes = 200;
+    constexpr size_t kCodes = 37;
+    std::vector<uint8_t> query(kMaxBytes);
+    std::vector<uint8_t> base(kMaxBytes * kCodes);
+    for (auto &v : query) {
+        v = static_cast<uint8_t>(turbo::uniform(0, 256));
+    }
+    for (auto &v : base) {
+        v = static_cast<uint8_t>(turbo::uniform(0, 256));
+    }
+    std::vector<float> out(kCodes);
+    for (auto *k: zircon::distance::available_distance_kernels()) {
+        CAPTURE(k->arch_name);
+        for (size_t nbytes = 1; nbytes <= kMaxBytes; ++nbytes) {
+            CAPTURE(nbytes);
+            auto q = turbo::Span<uint8_t>(query.data(), nbytes);
+            k->batch_hamming(query.data(), base.data(), nbytes, kCodes, out.data());
+            for (size_t j = 0; j < kCodes; ++j) {
+                auto x = turbo::Span<uint8_t>(base.data() + j * nbytes, nbytes);
+                auto expect = zircon::distance::simple_distance_hamming(q, x);
+                CHECK_EQ(out[j], expect);
+                CHECK_EQ(k->hamming(q.data(), x.data(), nbytes), expect);
+                CHECK(k->jaccard(q.data(), x.data(), nbytes) ==
+                      doctest::Approx(zircon::distance::simple_distance_jaccard(q, x)));
+            }
+        }
+        std::vector<uint8_t> zeros(64, 0);
+        CHECK_EQ(k->jaccard(zeros.data(), zeros.data(), zeros.size()), 0.0f);
+    }
+}
+
+TEST_CASE_FIXTURE(DistanceKernelTest, "vector distance") {
+    auto a = turbo::Span<float>(a_vec.data(), a_vec.size());
+    auto b = turbo::Span<float>(b_vec.data(), b_vec.size());
+    CHECK(zircon::VectorDistance<zircon::MetricType::METRIC_L2>().distance(a, b) ==
+          doctest::Approx(zircon::distance::simple_distance_l2(a, b)));
+    CHECK(zircon::VectorDistance<zircon::MetricType::METRIC_IP>().distance(a, b) ==
+          doctest::Approx(-zircon::distance::simple_distance_ip(a, b)));
+    CHECK(zircon::VectorDistance<zircon::MetricType::METRIC_COSINE>().distance(a, a) ==
+          doctest::Approx(0.0f).epsilon(1e-5));
+    // normalized for the normalized cosine keep the cosine
+    auto cosine = zircon::VectorDistance<zircon::MetricType::METRIC_COSINE>().distance(a, b);
+    zircon::VectorDistance<zircon::MetricType::METRIC_NORMALIZED_COSINE>().normalize(a);
+    zircon::VectorDistance<zircon::MetricType::METRIC_COSINE>().normalize(b);
+    CHECK(zircon::distance::norm_l2(a) == doctest::Approx(1.0f));
+    CHECK(zircon::distance::norm_l2(b) == doctest::Approx(1.0f));
+    CHECK(zircon::VectorDistance<zircon::MetricType::METRIC_NORMALIZED_COSINE>().distance(a, b) ==
+          doctest::Approx(cosine).epsilon(1e-5));
+    std::vector<float, turbo::aligned_allocator<float, 64>> zero(kDim, 0.0f);
+    CHECK_EQ(zircon::distance::normalize_l2(turbo::Span<float>(zero.data(), zero.size())), 0.0f);
+    CHECK_EQ(zero[0], 0.0f);
+    auto ab = turbo::Span<uint8_t>(a_bits.data(), a_bits.size());
+    CHECK(zircon::VectorDistance<zircon::MetricType::METRIC_HAMMING>().distance(ab, ab) == 0.0f);
+    CHECK(zircon::VectorDistance<zircon::MetricType::METRIC_JACCARD>().distance(ab, ab) == 0.0f);
+}
+
+namespace {
+    // a random point of the poincare ball at radius r
+    void ball_point(float *x, size_t dim, float r) {
+        for (size_t i = 0; i < dim; ++i) {
+            x[i] = turbo::uniform(-1.0f, 1.0f);
+        }
+        auto norm = zircon::distance::simple_distance_ip({x, dim}, {x, dim});
+        for (size_t i = 0; i < dim; ++i) {
+            x[i] *= r / std::sqrt(norm);
+        }
+    }
+
+    // lift the space coordinates x[1..dim) to the hyperboloid
+    void lift_lorentz(float *x, size_t dim) {
+        double space = 0.0;
+        for (size_t i = 1; i < dim; ++i) {
+            space += double(x[i]) * x[i];
+        }
+        x[0] = static_cast<float>(std::sqrt(1.0 + space));
+    }
+}  // namespace
+
+TEST_CASE("hyperbolic kernels") {
+    constexpr size_t kDim = DistanceKernelTest::kDim;
+    std::vector<float, turbo::aligned_allocator<float, 64>> a(kDim);
+    std::vector<float, turbo::aligned_allocator<float, 64>> b(kDim);
+    auto as = turbo::Span<float>(a.data(), kDim);
+    auto bs = turbo::Span<float>(b.data(), kDim);
+    for (auto *k: zircon::distance::available_distance_kernels()) {
+        CAPTURE(k->arch_name);
+        for (int round = 0; round < 20; ++round) {
+            ball_point(a.data(), kDim, turbo::uniform(0.0f, 0.95f));
+            ball_point(b.data(), kDim, turbo::uniform(0.0f, 0.95f));
+            CHECK(k->poincare(a.data(), b.data(), kDim) ==
+                  doctest::Approx(zircon::distance::simple_distance_poincare(as, bs)).epsilon(1e-4));
+            CHECK(k->poincare(a.data(), a.data(), kDim) == 0.0f);
+
+            for (size_t i = 1; i < kDim; ++i) {
+                a[i] = turbo::uniform(-0.1f, 0.1f);
+                b[i] = turbo::uniform(-0.1f, 0.1f);
+            }
+            lift_lorentz(a.data(), kDim);
+            lift_lorentz(b.data(), kDim);
+            CHECK(k->lorentz(a.data(), b.data(), kDim) ==
+                  doctest::Approx(zircon::distance::simple_distance_lorentz(as, bs)).epsilon(1e-4));
+            CHECK(k->lorentz(a.data(), a.data(), kDim) == 0.0f);
+        }
+
+        // near the boundary the distance is large but stays finite and accurate
+        ball_point(a.data(), kDim, 0.9999f);
+        ball_point(b.data(), kDim, 0.5f);
+        auto far = k->poincare(a.data(), b.data(), kDim);
+        CHECK(std::isfinite(far));
+        CHECK(far == doctest::Approx(zircon::distance::simple_distance_poincare(as, bs)).epsilon(1e-3));
+        // a point beyond it is clamped just inside
+        for (auto &v: a) {
+            v *= 2.0f;
+        }
+        CHECK(std::isfinite(k->poincare(a.data(), b.data(), kDim)));
+
+        // close points keep their small distance, acosh(z) would round it to 0 or noise
+        ball_point(a.data(), kDim, 0.3f);
+        for (size_t i = 0; i < kDim; ++i) {
+            b[i] = a[i] + 1e-5f;
+        }
+        auto close = k->poincare(a.data(), b.data(), kDim);
+        CHECK(close > 0.0f);
+        CHECK(close == doctest::Approx(zircon::distance::simple_distance_poincare(as, bs)).epsilon(1e-3));
+        for (size_t i = 1; i < kDim; ++i) {
+            a[i] = turbo::uniform(-0.1f, 0.1f);
+            b[i] = a[i] + 1e-3f;
+        }
+        lift_lorentz(a.data(), kDim);
+        lift_lorentz(b.data(), kDim);
+        CHECK(k->lorentz(a.data(), b.data(), kDim) ==
+              doctest::Approx(zircon::distance::simple_distance_lorentz(as, bs)).epsilon(1e-3));
+    }
+    ball_point(a.data(), kDim, 0.7f);
+    ball_point(b.data(), kDim, 0.2f);
+    CHECK(zircon::VectorDistance<zircon::MetricType::METRIC_POINCARE>().distance(as, bs) ==
+          doctest::Approx(zircon::distance::simple_distance_poincare(as, bs)).epsilon(1e-4));
+}
@@ -0,0 +1,112 @@
+// Copyright 2023 The Elastic-AI Authors.
+// part of Elastic AI Search
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#define DOCTEST_CONFIG_IMPLEMENT_WITH_MAIN
+#include "turbo/testing/test.h"
+#include "zircon/utility/distance_matrix.h"
+#include "zircon/utility/primitive_distance.h"
+#include "zircon/utility/distance_dispatch.h"
+#include "turbo/random/random.h"
+#include <vector>
+
+class DistanceMatrixTest {
+public:
+    DistanceMatrixTest() {
+        queries.resize(kQueries * kDim);
+        for (auto &v: queries) {
+            v = turbo::uniform(-1.0f, 1.0f);
+        }
+        zircon::VectorStoreOption option;
+        option.batch_size = 64;
+        option.max_elements = 1000;
+        option.vector_byte_size = kDim * sizeof(float);
+        auto r = store.initialize(option);
+        REQUIRE(r.ok());
+        std::vector<float> v(kDim);
+        for (size_t j = 0; j < kBase; ++j) {
+            for (size_t i = 0; i < kDim; ++i) {
+                v[i] = turbo::uniform(-1.0f, 1.0f);
+            }
+            auto rs = store.add_vector(j, turbo::Span<uint8_t>(reinterpret_cast<uint8_t *>(v.data()),
+                                                               kDim * sizeof(float)));
+            REQUIRE(rs.ok());
+        }
+    }
+
+    ~DistanceMatrixTest() = default;
+
+    turbo::Span<float> query_at(size_t i) {
+        return turbo::Span<float>(queries.data() + i * kDim, kDim);
+    }
+
+    turbo::Span<float> base_at(zircon::location_t i) const {
+        auto s = store.get_vector(i);
+        return turbo::Span<float>(reinterpret_cast<float *>(s.data()), kDim);
+    }
+
+    static constexpr size_t kDim = 36;
+    static constexpr size_t kQueries = 11;
+    static constexpr size_t kBase = 150;
+    std::vector<float, turbo::aligned_allocator<float, 64>> queries;
+    zircon::MemVectorStore store;
+};
+
+TEST_CASE_FIXTURE(DistanceMatrixTest, "store range cross batches") {
+    // begin and end in the middle of batches
+    const zircon::location_t begin = 30;
+    const zircon::location_t end = 141;
+    const size_t nb = end - begin;
+    std::vector<float> out(kQueries * nb);
+    auto q = turbo::Span<float>(queries.data(), queries.size());
+    auto r = zircon::distance::distance_matrix(q, kQueries, store, begin, end, zircon::MetricType::METRIC_L2,
+                                               out.data());
+    REQUIRE(r.ok());
+    for (size_t i = 0; i < kQueries; ++i) {
+        for (size_t j = 0; j < nb; ++j) {
+            CHECK(out[i * nb + j] ==
+                  doctest::Approx(zircon::distance::simple_distance_l2(query_at(i), base_at(begin + j))));
+        }
+    }
+    r = zircon::distance::distance_matrix(q, kQueries, store, begin, end, zircon::MetricType::METRIC_IP,
+                                          out.data());
+    REQUIRE(r.ok());
+    for (size_t i = 0; i < kQueries; ++i) {
+        for (size_t j = 0; j < nb; ++j) {
+            CHECK(out[i * nb + j] ==
+                  doctest::Approx(-zircon::distance::simple_distance_ip(query_at(i), base_at(begin + j))));
+        }
+    }
+    r = zircon::distance::distance_matrix(q, kQueries, store, begin, end, zircon::MetricType::METRIC_HAMMING,
+                                          out.data());
+    CHECK(!r.ok());
+}
+
+TEST_CASE_FIXTURE(DistanceMatrixTest, "every kernel table") {
+    std::vector<float> base(kBase * kDim);
+    for (zircon::location_t j = 0; j < kBase; ++j) {
+        std::copy(base_at(j).begin(), base_at(j).end(), base.begin() + j * kDim);
+    }
+    std::vector<float> out(kQueries * kBase);
+    for (auto *k: zircon::distance::available_distance_kernels()) {
+        CAPTURE(k->arch_name);
+        k->matrix_l1(queries.data(), kQueries, base.data(), kBase, kDim, out.data(), kBase);
+        for (size_t i = 0; i < kQueries; ++i) {
+            for (size_t j = 0; j < kBase; ++j) {
+                CHECK(out[i * kBase + j] ==
+                      doctest::Approx(zircon::distance::simple_distance_l1(query_at(i), base_at(j))));
+            }
+        }
+    }
+}
@@ -0,0 +1,154 @@
+// Copyright 2023 The Elastic-AI Authors.
+// part of Elastic AI Search
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#define DOCTEST_CONFIG_IMPLEMENT_WITH_MAIN
+#include "turbo/testing/test.h"
+#include "zircon/index/brute_force.h"
+#include "zircon/utility/id_filter.h"
+#include "turbo/random/random.h"
+#include <algorithm>
+#include <functional>
+#include <vector>
+
+class BruteForceTest {
+public:
+    BruteForceTest() {
+        data.resize(kSize * kDim);
+        for (auto &v : data) {
+            v = turbo::uniform(-1.0f, 1.0f);
+        }
+        query.resize(kDim);
+        for (auto &v : query) {
+            v = turbo::uniform(-1.0f, 1.0f);
+        }
+        zircon::VectorStoreOption op;
+        op.batch_size = 64;
+        op.max_elements = kSize;
+        op.vector_byte_size = kDim * sizeof(float);
+        REQUIRE(store.initialize(op).ok());
+        for (size_t i = 0; i < kSize; ++i) {
+            // labels are not the locations
+            auto r = store.add_vector(i * 10, turbo::Span<uint8_t>(reinterpret_cast<uint8_t *>(data.data() + i * kDim),
+                                                                   kDim * sizeof(float)));
+            REQUIRE(r.ok());
+        }
+        REQUIRE(distance.initialize(zircon::MetricType::METRIC_L2, kDim).ok());
+    }
+
+    // exact distances of the accepted labels, sorted
+    std::vector<float> expect(const std::function<bool(zircon::label_type)> &accept) {
+        std::vector<float> dis;
+        for (size_t i = 0; i < kSize; ++i) {
+            if (!store.is_deleted(i) && accept(i * 10)) {
+                dis.push_back(distance(query.data(), data.data() + i * kDim));
+            }
+        }
+        std::sort(dis.begin(), dis.end());
+        return dis;
+    }
+
+    static constexpr size_t kDim = 20;
+    static constexpr size_t kSize = 500;
+    std::vector<float> data;
+    std::vector<float> query;
+    zircon::MemVectorStore store;
+    zircon::MetricDistance distance;
+};
+
+TEST_CASE_FIXTURE(BruteForceTest, "brute force scan") {
+    for (size_t i = 0; i < kSize; i += 5) {
+        REQUIRE(store.remove_vector(i * 10).ok());
+    }
+    zircon::SearchOption so;
+    so.k = 15;
+    std::vector<zircon::QueryResult> result;
+    zircon::brute_force_search(store, distance, query.data(), so, result);
+    auto all = expect([](zircon::label_type) { return true; });
+    REQUIRE_EQ(result.size(), so.k);
+    for (size_t i = 0; i < so.k; ++i) {
+        CHECK_EQ(result[i].distance, doctest::Approx(all[i]).epsilon(1e-5));
+        CHECK_NE(result[i].label % 50, 0);
+    }
+
+    std::vector<zircon::label_type> labels;
+    for (size_t i = 0; i < kSize; i += 3) {
+        labels.push_back(i * 10);
+    }
+    zircon::IdFilterBitmap filter(labels);
+    so.filter = &filter;
+    zircon::brute_force_search(store, distance, query.data(), so, result);
+    auto filtered = expect([&](zircon::label_type l) { return filter.is_member(l); });
+    REQUIRE_EQ(result.size(), so.k);
+    for (size_t i = 0; i < so.k; ++i) {
+        CHECK_EQ(result[i].distance, doctest::Approx(filtered[i]).epsilon(1e-5));
+        CHECK(filter.is_member(result[i].label));
+    }
+
+    // the member version skips labels not in the store
+    labels.push_back(1);
+    zircon::brute_force_search(store, distance, query.data(), labels, so.k, result);
+    REQUIRE_EQ(result.size(), so.k);
+    for (size_t i = 0; i < so.k; ++i) {
+        CHECK_EQ(result[i].distance, doctest::Approx(filtered[i]).epsilon(1e-5));
+    }
+}
+
+TEST_CASE_FIXTURE(BruteForceTest, "rerank candidates") {
+    for (size_t i = 0; i < kSize; i += 7) {
+        REQUIRE(store.remove_vector(i * 10).ok());
+    }
+    // runs across the batch boundaries, single locations, duplicates, out of order
+    std::vector<zircon::location_t> candidates;
+    std::vector<zircon::label_type> labels;
+    for (zircon::location_t loc = 50; loc < 140; ++loc) {
+        candidates.push_back(loc);
+    }
+    for (zircon::location_t loc = 499; loc > 150; loc -= 13) {
+        candidates.push_back(loc);
+        candidates.push_back(loc);
+    }
+    candidates.push_back(static_cast<zircon::location_t>(kSize + 3));
+    candidates.push_back(zircon::constants::kUnknownLocation);
+    for (auto loc : candidates) {
+        if (loc < kSize && (labels.empty() || labels.back() != loc * 10)) {
+            labels.push_back(loc * 10);
+        }
+    }
+    zircon::QueryStats stats;
+    std::vector<zircon::QueryResult> result;
+    zircon::rerank_search(store, distance, query.data(), candidates, 20, result, &stats);
+    // duplicates and unknown locations are not scored
+    CHECK_EQ(stats.distance_computations, 90 + 27);
+    auto members = expect([&](zircon::label_type l) {
+        return std::find(labels.begin(), labels.end(), l) != labels.end();
+    });
+    REQUIRE_EQ(result.size(), 20);
+    for (size_t i = 0; i < result.size(); ++i) {
+        CHECK_EQ(result[i].distance, doctest::Approx(members[i]).epsilon(1e-5));
+        CHECK_NE(result[i].label % 70, 0);
+        CHECK_EQ(result[i].distance,
+                 doctest::Approx(distance(query.data(), data.data() + result[i].label / 10 * kDim)).epsilon(1e-5));
+    }
+    // the same as the exact search over the candidates
+    std::vector<zircon::QueryResult> exact;
+    zircon::brute_force_search(store, distance, query.data(), labels, 20, exact);
+    REQUIRE_EQ(exact.size(), result.size());
+    for (size_t i = 0; i < result.size(); ++i) {
+        CHECK_EQ(result[i].label, exact[i].label);
+    }
+
+    zircon::rerank_search(store, distance, query.data(), {}, 20, result);
+    CHECK(result.empty());
+}
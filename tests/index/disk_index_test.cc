@@ -0,0 +1,268 @@
+// Copyright 2023 The Elastic-AI Authors.
+// part of Elastic AI Search
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#define DOCTEST_CONFIG_IMPLEMENT_WITH_MAIN
+#include "turbo/testing/test.h"
+#include "zircon/datasets/bin_vector_io.h"
+#include "zircon/index/disk_index.h"
+#include "zircon/index/flat_index.h"
+#include "zircon/index/vamana_builder.h"
+#include "zircon/utility/id_filter.h"
+#include "turbo/random/random.h"
+#include <algorithm>
+#include <deque>
+#include <filesystem>
+#include <fstream>
+#include <functional>
+#include <string>
+#include <vector>
+
+namespace {
+    constexpr std::size_t kDim = 32;
+    constexpr std::size_t kSize = 3000;
+
+    zircon::IndexOption make_option() {
+        zircon::IndexOption op;
+        op.metric = zircon::MetricType::METRIC_L2;
+        op.dimension = kDim;
+        op.store_option.batch_size = 256;
+        op.store_option.max_elements = kSize;
+        return op;
+    }
+
+    zircon::VamanaOption make_vamana() {
+        zircon::VamanaOption vamana;
+        vamana.max_degree = 24;
+        vamana.build_list = 48;
+        vamana.pq_m = 8;
+        vamana.pq_samples = 1000;
+        vamana.nthreads = 2;
+        return vamana;
+    }
+
+    std::vector<float> make_data() {
+        std::vector<float> data(kSize * kDim);
+        for (auto &x : data) {
+            x = turbo::uniform(-1.0f, 1.0f);
+        }
+        return data;
+    }
+
+    // built once from a bin file through the VectorSetReader, shared by the cases
+    const std::string &index_path(const std::vector<float> &data) {
+        static std::string path;
+        if (!path.empty()) {
+            return path;
+        }
+        auto bin = (std::filesystem::temp_directory_path() / "zircon_disk_index_test.bin").string();
+        zircon::SerializeOption so;
+        so.dimension = kDim;
+        so.n_vectors = kSize;
+        {
+            turbo::SequentialWriteFile file;
+            REQUIRE(file.open(bin).ok());
+            zircon::BinaryVectorSetWriter writer;
+            REQUIRE(writer.initialize(&file, so).ok());
+            auto *bytes = reinterpret_cast<uint8_t *>(const_cast<float *>(data.data()));
+            REQUIRE(writer.write_batch(turbo::Span<uint8_t>{bytes, data.size() * sizeof(float)}, kSize).ok());
+            file.close();
+        }
+        zircon::VamanaBuilder builder;
+        REQUIRE(builder.initialize(make_option(), make_vamana()).ok());
+        {
+            turbo::SequentialReadFile file;
+            REQUIRE(file.open(bin).ok());
+            zircon::BinaryVectorSetReader reader;
+            REQUIRE(reader.initialize(&file, so).ok());
+            auto added = builder.add_vectors(reader, 0);
+            REQUIRE(added.ok());
+            REQUIRE_EQ(added.value(), kSize);
+        }
+        CHECK_FALSE(builder.save_index(bin + ".dann").ok());
+        REQUIRE(builder.build().ok());
+        // bounded degree, and every node reachable from the medoid
+        std::vector<bool> seen(kSize, false);
+        std::deque<uint32_t> queue{static_cast<uint32_t>(builder.medoid())};
+        seen[builder.medoid()] = true;
+        std::size_t reached = 1;
+        while (!queue.empty()) {
+            auto nbrs = builder.neighbors(queue.front());
+            queue.pop_front();
+            CHECK_LE(nbrs.size(), make_vamana().max_degree);
+            for (auto nb : nbrs) {
+                if (!seen[nb]) {
+                    seen[nb] = true;
+                    ++reached;
+                    queue.push_back(nb);
+                }
+            }
+        }
+        CHECK_EQ(reached, kSize);
+        path = bin + ".dann";
+        REQUIRE(builder.save_index(path).ok());
+        std::filesystem::remove(bin);
+        return path;
+    }
+
+    double recall(const zircon::Index &index, const zircon::FlatIndex &flat, const std::vector<float> &data,
+                  const zircon::SearchOption &so) {
+        std::size_t hit = 0;
+        std::size_t total = 0;
+        for (std::size_t q = 0; q < 30; ++q) {
+            std::vector<float> query(kDim);
+            for (std::size_t d = 0; d < kDim; ++d) {
+                query[d] = data[q * 89 * kDim + d] + turbo::uniform(-0.05f, 0.05f);
+            }
+            std::vector<zircon::QueryResult> truth;
+            std::vector<zircon::QueryResult> got;
+            REQUIRE(flat.search(turbo::Span<float>{query}, so, truth).ok());
+            REQUIRE(index.search(turbo::Span<float>{query}, so, got).ok());
+            REQUIRE(std::is_sorted(got.begin(), got.end(),
+                                   [](auto &a, auto &b) { return a.distance < b.distance; }));
+            for (auto &t : truth) {
+                hit += std::any_of(got.begin(), got.end(), [&t](auto &r) { return r.label == t.label; });
+            }
+            total += truth.size();
+        }
+        return static_cast<double>(hit) / static_cast<double>(total);
+    }
+}  // namespace
+
+TEST_CASE("disk index search") {
+    auto data = make_data();
+    const auto &path = index_path(data);
+    zircon::FlatIndex flat;
+    REQUIRE(flat.initialize(make_option()).ok());
+    for (zircon::label_type l = 0; l < kSize; ++l) {
+        REQUIRE(flat.add_vector(l, turbo::Span<float>{data.data() + l * kDim, kDim}).ok());
+    }
+    for (auto backend : {zircon::AsyncIoBackend::IO_THREAD_POOL, zircon::AsyncIoBackend::IO_AUTO}) {
+        zircon::DiskIndexOption option;
+        option.backend = backend;
+        option.direct_io = backend == zircon::AsyncIoBackend::IO_AUTO;
+        option.search_list = 64;
+        option.cache_nodes = backend == zircon::AsyncIoBackend::IO_AUTO ? 100 : 0;
+        zircon::DiskIndex index;
+        REQUIRE(index.initialize(option).ok());
+        REQUIRE(index.load_index(path).ok());
+        CHECK_EQ(index.size(), kSize);
+        CHECK_EQ(index.cached_nodes(), option.cache_nodes);
+        std::vector<float> v(kDim);
+        CHECK_FALSE(index.add_vector(kSize, turbo::Span<float>{v}).ok());
+
+        zircon::SearchOption so;
+        so.k = 10;
+        CHECK_GE(recall(index, flat, data, so), 0.9);
+
+        // removed labels are never returned, the graph still route through them
+        zircon::FlatIndex rest;
+        REQUIRE(rest.initialize(make_option()).ok());
+        for (zircon::label_type l = 0; l < kSize; ++l) {
+            if (l % 3 == 0) {
+                REQUIRE(index.remove_vector(l).ok());
+            } else {
+                REQUIRE(rest.add_vector(l, turbo::Span<float>{data.data() + l * kDim, kDim}).ok());
+            }
+        }
+        CHECK_FALSE(index.remove_vector(0).ok());
+        CHECK_EQ(index.size(), rest.size());
+        CHECK_GE(recall(index, rest, data, so), 0.85);
+
+        // a selective filter is read from its members
+        zircon::IdFilterRange few(100, 140);
+        so.filter = &few;
+        so.brute_force_ratio = 0.05f;
+        CHECK_GE(recall(index, rest, data, so), 0.999);
+    }
+}
+
+TEST_CASE("disk index bad file") {
+    auto data = make_data();
+    const auto &path = index_path(data);
+    auto cut = path + ".cut";
+    std::filesystem::copy_file(path, cut, std::filesystem::copy_options::overwrite_existing);
+    std::filesystem::resize_file(cut, std::filesystem::file_size(path) - zircon::kDiskSectorSize);
+    zircon::DiskIndex index;
+    REQUIRE(index.initialize().ok());
+    CHECK_FALSE(index.load_index(cut).ok());
+    CHECK_FALSE(index.load_index(cut + ".missing").ok());
+    std::filesystem::remove(cut);
+}
+
+TEST_CASE("disk index bad file header") {
+    auto data = make_data();
+    const auto &path = index_path(data);
+    zircon::DiskIndexHeader good{};
+    {
+        std::ifstream in(path, std::ios::binary);
+        REQUIRE(in.read(reinterpret_cast<char *>(&good), sizeof(good)));
+    }
+    auto bad = path + ".bad";
+    // a copy of the index with the header changed by fn
+    auto write_header = [&](const std::function<void(zircon::DiskIndexHeader &)> &fn) {
+        std::filesystem::copy_file(path, bad, std::filesystem::copy_options::overwrite_existing);
+        auto header = good;
+        fn(header);
+        std::fstream out(bad, std::ios::binary | std::ios::in | std::ios::out);
+        out.write(reinterpret_cast<const char *>(&header), sizeof(header));
+    };
+    std::vector<std::function<void(zircon::DiskIndexHeader &)>> corruptions = {
+            [](zircon::DiskIndexHeader &h) { h.medoid = h.nvectors; },
+            [](zircon::DiskIndexHeader &h) { h.max_degree += 1; },
+            [](zircon::DiskIndexHeader &h) { h.node_bytes += 4; },
+            [](zircon::DiskIndexHeader &h) { h.nodes_per_sector = 0; h.sectors_per_node = 0; },
+            [](zircon::DiskIndexHeader &h) { h.graph_offset = 0; },
+            [](zircon::DiskIndexHeader &h) { h.pq_offset = h.graph_offset; },
+            [](zircon::DiskIndexHeader &h) { h.codes_offset = h.pq_offset; },
+            [](zircon::DiskIndexHeader &h) { h.labels_offset = h.file_size; },
+            [](zircon::DiskIndexHeader &h) { h.pq_nbits = 5; },
+    };
+    for (std::size_t i = 0; i < corruptions.size(); ++i) {
+        CAPTURE(i);
+        write_header(corruptions[i]);
+        zircon::DiskIndex index;
+        REQUIRE(index.initialize().ok());
+        CHECK_FALSE(index.load_index(bad).ok());
+    }
+
+    // the medoid record with a degree above max_degree
+    write_header([](zircon::DiskIndexHeader &) {});
+    uint32_t degree = good.max_degree + 1;
+    {
+        std::fstream out(bad, std::ios::binary | std::ios::in | std::ios::out);
+        out.seekp(static_cast<std::streamoff>(good.node_read_offset(good.medoid) + good.node_read_skip(good.medoid) +
+                                              good.dimension * sizeof(float)));
+        out.write(reinterpret_cast<const char *>(&degree), sizeof(degree));
+    }
+    {
+        // read at load by the cache
+        zircon::DiskIndexOption op;
+        op.cache_nodes = 16;
+        zircon::DiskIndex index;
+        REQUIRE(index.initialize(op).ok());
+        CHECK_FALSE(index.load_index(bad).ok());
+    }
+    {
+        // read by the search
+        zircon::DiskIndex index;
+        REQUIRE(index.initialize().ok());
+        REQUIRE(index.load_index(bad).ok());
+        zircon::SearchOption so;
+        so.k = 10;
+        std::vector<zircon::QueryResult> result;
+        CHECK_FALSE(index.search(turbo::Span<float>{data.data(), kDim}, so, result).ok());
+    }
+    std::filesystem::remove(bad);
+}
@@ -0,0 +1,363 @@
+// Copyright 2023 The Elastic-AI Authors.
+// part of Elastic AI Search
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#define DOCTEST_CONFIG_IMPLEMENT_WITH_MAIN
+#include "turbo/testing/test.h"
+#include "zircon/index/brute_force.h"
+#include "zircon/index/flat_index.h"
+#include "zircon/utility/id_filter.h"
+#include "zircon/utility/metrics.h"
+#include "zircon/utility/primitive_distance.h"
+#include "turbo/random/random.h"
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+namespace {
+    constexpr std::size_t kDim = 24;
+    constexpr std::size_t kSize = 5000;
+
+    zircon::IndexOption make_option() {
+        zircon::IndexOption op;
+        op.metric = zircon::MetricType::METRIC_L2;
+        op.dimension = kDim;
+        op.store_option.batch_size = 64;
+        op.store_option.max_elements = kSize;
+        return op;
+    }
+
+    std::vector<float> random_vector() {
+        std::vector<float> v(kDim);
+        for (auto &x : v) {
+            x = turbo::uniform(-1.0f, 1.0f);
+        }
+        return v;
+    }
+}  // namespace
+
+TEST_CASE("flat index parallel matches serial") {
+    zircon::FlatOption parallel;
+    parallel.nthreads = 4;
+    parallel.batches_per_task = 3;
+    parallel.parallel_threshold = 0;
+    zircon::FlatOption serial;
+    serial.nthreads = 1;
+    zircon::FlatIndex a;
+    zircon::FlatIndex b;
+    REQUIRE(a.initialize(make_option(), parallel).ok());
+    REQUIRE(b.initialize(make_option(), serial).ok());
+    for (zircon::label_type l = 0; l < kSize; ++l) {
+        auto v = random_vector();
+        REQUIRE(a.add_vector(l, turbo::Span<float>{v}).ok());
+        REQUIRE(b.add_vector(l, turbo::Span<float>{v}).ok());
+    }
+    for (zircon::label_type l = 0; l < kSize; l += 3) {
+        REQUIRE(a.remove_vector(l).ok());
+        REQUIRE(b.remove_vector(l).ok());
+    }
+    CHECK_EQ(a.size(), b.size());
+    CHECK_FALSE(a.remove_vector(0).ok());
+
+    zircon::IdFilterRange range(1000, 3999);
+    for (int q = 0; q < 10; ++q) {
+        auto query = random_vector();
+        zircon::SearchOption so;
+        so.k = 25;
+        so.filter = q % 2 == 0 ? nullptr : &range;
+        std::vector<zircon::QueryResult> ra;
+        std::vector<zircon::QueryResult> rb;
+        REQUIRE(a.search(turbo::Span<float>{query}, so, ra).ok());
+        REQUIRE(b.search(turbo::Span<float>{query}, so, rb).ok());
+        REQUIRE_EQ(ra.size(), so.k);
+        REQUIRE_EQ(ra.size(), rb.size());
+        for (std::size_t i = 0; i < ra.size(); ++i) {
+            CHECK_EQ(ra[i].label, rb[i].label);
+            CHECK_EQ(ra[i].distance, rb[i].distance);
+            CHECK_NE(ra[i].label % 3, 0u);
+            if (so.filter != nullptr) {
+                CHECK(range.is_member(ra[i].label));
+            }
+        }
+        for (std::size_t i = 1; i < ra.size(); ++i) {
+            CHECK_LE(ra[i - 1].distance, ra[i].distance);
+        }
+    }
+}
+
+TEST_CASE("flat index small k and shared pool") {
+    zircon::FlatOption op;
+    op.parallel_threshold = 0;
+    zircon::FlatIndex index;
+    REQUIRE(index.initialize(make_option(), op).ok());
+    std::vector<std::vector<float>> data;
+    for (zircon::label_type l = 0; l < 300; ++l) {
+        data.push_back(random_vector());
+        REQUIRE(index.add_vector(l, turbo::Span<float>{data.back()}).ok());
+    }
+    // every vector is its own nearest
+    zircon::SearchOption so;
+    so.k = 1;
+    std::vector<zircon::QueryResult> result;
+    for (zircon::label_type l = 0; l < 300; l += 37) {
+        REQUIRE(index.search(turbo::Span<float>{data[l]}, so, result).ok());
+        REQUIRE_EQ(result.size(), 1u);
+        CHECK_EQ(result[0].label, l);
+    }
+    // more than the alive vectors
+    so.k = 1000;
+    REQUIRE(index.search(turbo::Span<float>{data[0]}, so, result).ok());
+    CHECK_EQ(result.size(), 300u);
+    std::vector<float> bad(kDim + 1);
+    CHECK_FALSE(index.search(turbo::Span<float>{bad}, so, result).ok());
+}
+
+TEST_CASE("flat index query stats") {
+    zircon::FlatOption op;
+    op.nthreads = 1;
+    zircon::FlatIndex index;
+    REQUIRE(index.initialize(make_option(), op).ok());
+    for (zircon::label_type l = 0; l < 1000; ++l) {
+        auto v = random_vector();
+        REQUIRE(index.add_vector(l, turbo::Span<float>{v}).ok());
+    }
+    auto &queries = zircon::MetricsRegistry::global().counter("zircon_flat_search_queries");
+    const auto before = queries.value();
+    auto query = random_vector();
+    zircon::QueryStats stats;
+    zircon::SearchOption so;
+    so.k = 10;
+    so.stats = &stats;
+    std::vector<zircon::QueryResult> result;
+    REQUIRE(index.search(turbo::Span<float>{query}, so, result).ok());
+    CHECK_EQ(stats.distance_computations, 1000u);
+    CHECK_EQ(stats.filter_rejected, 0u);
+    CHECK_GT(stats.latency_ns, 0u);
+    // a filter of 500 labels, too many for the brute force over members
+    zircon::IdFilterRange range(0, 499);
+    so.filter = &range;
+    so.brute_force_ratio = 0.0f;
+    stats = zircon::QueryStats();
+    REQUIRE(index.search(turbo::Span<float>{query}, so, result).ok());
+    CHECK_EQ(stats.distance_computations, 500u);
+    CHECK_EQ(stats.filter_rejected, 500u);
+    CHECK_EQ(queries.value() - before, 2u);
+}
+
+TEST_CASE("flat index cosine from the store norms") {
+    zircon::FlatOption op;
+    op.nthreads = 1;
+    for (auto metric : {zircon::MetricType::METRIC_COSINE, zircon::MetricType::METRIC_NORMALIZED_COSINE}) {
+        auto option = make_option();
+        option.metric = metric;
+        zircon::FlatIndex index;
+        REQUIRE(index.initialize(option, op).ok());
+        // vectors of any length and a zero one, the cosine does not depend on the norms
+        constexpr std::size_t n = 1000;
+        std::vector<std::vector<float>> data;
+        for (zircon::label_type l = 0; l < n; ++l) {
+            data.push_back(random_vector());
+            const float scale = l == 0 ? 0.0f : turbo::uniform(0.1f, 10.0f);
+            for (auto &x : data.back()) {
+                x *= scale;
+            }
+            REQUIRE(index.add_vector(l, turbo::Span<float>{data.back()}).ok());
+        }
+        // normalized cosine expect unit queries
+        auto query = random_vector();
+        zircon::distance::normalize_l2(turbo::Span<float>{query});
+        zircon::IdFilterRange range(0, 499);
+        for (int pass = 0; pass < 3; ++pass) {
+            CAPTURE(pass);
+            zircon::SearchOption so;
+            so.k = 10;
+            // the scan, the filtered scan and the brute force over the members
+            so.filter = pass == 0 ? nullptr : &range;
+            so.brute_force_ratio = pass == 1 ? 0.0f : 1.0f;
+            std::vector<std::pair<float, zircon::label_type>> truth;
+            for (zircon::label_type l = 0; l < (pass == 0 ? n : 500); ++l) {
+                truth.emplace_back(zircon::distance::simple_distance_cosine(turbo::Span<float>{query},
+                                                                            turbo::Span<float>{data[l]}), l);
+            }
+            std::sort(truth.begin(), truth.end());
+            std::vector<zircon::QueryResult> result;
+            REQUIRE(index.search(turbo::Span<float>{query}, so, result).ok());
+            REQUIRE_EQ(result.size(), so.k);
+            for (std::size_t i = 0; i < result.size(); ++i) {
+                CHECK_EQ(result[i].label, truth[i].second);
+                CHECK(result[i].distance == doctest::Approx(truth[i].first).epsilon(1e-4));
+            }
+        }
+    }
+}
+
+TEST_CASE("flat index hyperbolic metrics") {
+    zircon::FlatOption op;
+    op.nthreads = 1;
+    for (auto metric : {zircon::MetricType::METRIC_POINCARE, zircon::MetricType::METRIC_LORENTZ}) {
+        CAPTURE(static_cast<int>(metric));
+        auto option = make_option();
+        option.metric = metric;
+        zircon::FlatIndex index;
+        REQUIRE(index.initialize(option, op).ok());
+        // points of the ball, or the same lifted to the hyperboloid
+        auto point = [metric]() {
+            auto v = random_vector();
+            auto scale = turbo::uniform(0.0f, 0.99f) / zircon::distance::norm_l2(turbo::Span<float>{v});
+            for (auto &x : v) {
+                x *= scale;
+            }
+            if (metric == zircon::MetricType::METRIC_LORENTZ) {
+                v[0] = std::sqrt(1.0f + zircon::distance::simple_distance_ip(turbo::Span<float>{v.data() + 1, kDim - 1},
+                                                                            turbo::Span<float>{v.data() + 1, kDim - 1}));
+            }
+            return v;
+        };
+        auto reference = [metric](turbo::Span<float> a, turbo::Span<float> b) {
+            return metric == zircon::MetricType::METRIC_POINCARE ? zircon::distance::simple_distance_poincare(a, b)
+                                                                 : zircon::distance::simple_distance_lorentz(a, b);
+        };
+        constexpr std::size_t n = 1000;
+        std::vector<std::vector<float>> data;
+        for (zircon::label_type l = 0; l < n; ++l) {
+            data.push_back(point());
+            REQUIRE(index.add_vector(l, turbo::Span<float>{data.back()}).ok());
+        }
+        auto query = point();
+        std::vector<std::pair<float, zircon::label_type>> truth;
+        for (zircon::label_type l = 0; l < n; ++l) {
+            truth.emplace_back(reference(turbo::Span<float>{query}, turbo::Span<float>{data[l]}), l);
+        }
+        std::sort(truth.begin(), truth.end());
+        zircon::SearchOption so;
+        so.k = 10;
+        std::vector<zircon::QueryResult> result;
+        REQUIRE(index.search(turbo::Span<float>{query}, so, result).ok());
+        REQUIRE_EQ(result.size(), so.k);
+        for (std::size_t i = 0; i < result.size(); ++i) {
+            CHECK_EQ(result[i].label, truth[i].second);
+            CHECK(result[i].distance == doctest::Approx(truth[i].first).epsilon(1e-3));
+        }
+    }
+    // the time coordinate alone is no point of the hyperboloid
+    auto option = make_option();
+    option.metric = zircon::MetricType::METRIC_LORENTZ;
+    option.dimension = 1;
+    zircon::FlatIndex index;
+    CHECK_FALSE(index.initialize(option, op).ok());
+}
+
+TEST_CASE("binary first pass with float rerank") {
+    constexpr std::size_t kBinaryDim = 128;
+    constexpr std::size_t kBinarySize = 2000;
+    auto op = make_option();
+    op.dimension = kBinaryDim;
+    zircon::FlatIndex index;
+    REQUIRE(index.initialize(op).ok());
+    std::vector<float> data(kBinarySize * kBinaryDim);
+    for (auto &x : data) {
+        x = turbo::uniform(-1.0f, 1.0f);
+    }
+    for (zircon::label_type l = 0; l < kBinarySize; ++l) {
+        REQUIRE(index.add_vector(l, turbo::Span<float>{data.data() + l * kBinaryDim, kBinaryDim}).ok());
+    }
+    for (zircon::label_type l = 0; l < kBinarySize; l += 5) {
+        REQUIRE(index.remove_vector(l).ok());
+    }
+    zircon::ScalarQuantizer bq;
+    REQUIRE(bq.initialize(zircon::EncodingType::ENCODING_BINARY, kBinaryDim).ok());
+    REQUIRE(bq.train(turbo::Span<float>{data}).ok());
+    zircon::BinaryCodeStore codes;
+    REQUIRE(codes.initialize(&bq).ok());
+    REQUIRE(codes.add_from_store(index.store()).ok());
+    CHECK_EQ(codes.size(), kBinarySize);
+    zircon::MetricDistance distance;
+    REQUIRE(distance.initialize(zircon::MetricType::METRIC_L2, kBinaryDim).ok());
+
+    zircon::IdFilterRange range(0, 999);
+    std::size_t hits = 0;
+    std::size_t total = 0;
+    for (int q = 0; q < 20; ++q) {
+        std::vector<float> query(kBinaryDim);
+        for (auto &x : query) {
+            x = turbo::uniform(-1.0f, 1.0f);
+        }
+        zircon::SearchOption so;
+        so.k = 10;
+        so.filter = q % 2 == 0 ? nullptr : &range;
+        std::vector<zircon::QueryResult> exact;
+        std::vector<zircon::QueryResult> result;
+        zircon::brute_force_search(index.store(), distance, query.data(), so, exact);
+        zircon::QueryStats stats;
+        zircon::binary_rerank_search(index.store(), distance, codes, query.data(), so, 20, result, &stats);
+        REQUIRE_EQ(result.size(), so.k);
+        CHECK_EQ(stats.distance_computations, kBinarySize + so.k * 20);
+        for (std::size_t i = 0; i < result.size(); ++i) {
+            CHECK_NE(result[i].label % 5, 0u);
+            if (so.filter != nullptr) {
+                CHECK(range.is_member(result[i].label));
+            }
+            // the reranked distances are the exact ones, up to the batch kernel rounding
+            CHECK_EQ(result[i].distance,
+                     doctest::Approx(distance(query.data(), data.data() + result[i].label * kBinaryDim)).epsilon(1e-5));
+            for (auto &e : exact) {
+                hits += e.label == result[i].label;
+            }
+        }
+        total += so.k;
+    }
+    CHECK_GE(hits, total * 8 / 10);
+    // every candidate reranked is the exact search
+    zircon::SearchOption so;
+    so.k = 10;
+    std::vector<zircon::QueryResult> exact;
+    std::vector<zircon::QueryResult> result;
+    zircon::brute_force_search(index.store(), distance, data.data() + kBinaryDim, so, exact);
+    zircon::binary_rerank_search(index.store(), distance, codes, data.data() + kBinaryDim, so, kBinarySize, result);
+    REQUIRE_EQ(result.size(), exact.size());
+    for (std::size_t i = 0; i < result.size(); ++i) {
+        CHECK_EQ(result[i].label, exact[i].label);
+    }
+}
+
+TEST_CASE("flat index search batch") {
+    zircon::FlatOption op;
+    op.nthreads = 1;
+    zircon::FlatIndex index;
+    REQUIRE(index.initialize(make_option(), op).ok());
+    for (zircon::label_type l = 0; l < 500; ++l) {
+        auto v = random_vector();
+        REQUIRE(index.add_vector(l, turbo::Span<float>{v}).ok());
+    }
+    constexpr std::size_t kQueries = 5;
+    std::vector<float> queries;
+    for (std::size_t q = 0; q < kQueries; ++q) {
+        auto v = random_vector();
+        queries.insert(queries.end(), v.begin(), v.end());
+    }
+    zircon::SearchOption so;
+    so.k = 7;
+    std::vector<std::vector<zircon::QueryResult>> results;
+    REQUIRE(index.search_batch(turbo::Span<float>{queries}, kQueries, so, results).ok());
+    REQUIRE_EQ(results.size(), kQueries);
+    for (std::size_t q = 0; q < kQueries; ++q) {
+        std::vector<zircon::QueryResult> result;
+        REQUIRE(index.search(turbo::Span<float>{queries.data() + q * kDim, kDim}, so, result).ok());
+        REQUIRE_EQ(results[q].size(), result.size());
+        for (std::size_t i = 0; i < result.size(); ++i) {
+            CHECK_EQ(results[q][i].label, result[i].label);
+        }
+    }
+    CHECK_FALSE(index.search_batch(turbo::Span<float>{queries.data(), kDim * 2 + 1}, 2, so, results).ok());
+}
@@ -0,0 +1,273 @@
+// Copyright 2023 The Elastic-AI Authors.
+// part of Elastic AI Search
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#define DOCTEST_CONFIG_IMPLEMENT_WITH_MAIN
+#include "turbo/testing/test.h"
+#include "zircon/index/hnsw_index.h"
+#include "zircon/utility/id_filter.h"
+#include "zircon/utility/metric_distance.h"
+#include "turbo/random/random.h"
+#include <algorithm>
+#include <thread>
+#include <vector>
+
+class HnswIndexTest {
+public:
+    HnswIndexTest() {
+        data.resize(kSize * kDim);
+        for (auto &v : data) {
+            v = turbo::uniform(-1.0f, 1.0f);
+        }
+        queries.resize(kQueries * kDim);
+        for (auto &v : queries) {
+            v = turbo::uniform(-1.0f, 1.0f);
+        }
+        option.dimension = kDim;
+        option.store_option.max_elements = kSize;
+        option.store_option.batch_size = 256;
+    }
+
+    turbo::Span<float> vector(size_t i) {
+        return turbo::Span<float>(data.data() + i * kDim, kDim);
+    }
+
+    turbo::Span<float> query(size_t i) {
+        return turbo::Span<float>(queries.data() + i * kDim, kDim);
+    }
+
+    // exact k nearest labels, label i is the i-th vector
+    std::vector<zircon::label_type> brute_force(size_t qi, size_t k, const std::vector<bool> &removed) {
+        zircon::MetricDistance dist;
+        REQUIRE(dist.initialize(option.metric, kDim).ok());
+        std::vector<std::pair<float, zircon::label_type>> all;
+        for (size_t i = 0; i < kSize; ++i) {
+            if (!removed[i]) {
+                all.emplace_back(dist(query(qi).data(), vector(i).data()), i);
+            }
+        }
+        std::partial_sort(all.begin(), all.begin() + k, all.end());
+        std::vector<zircon::label_type> labels;
+        for (size_t i = 0; i < k; ++i) {
+            labels.push_back(all[i].second);
+        }
+        return labels;
+    }
+
+    double recall(const zircon::HnswIndex &index, const std::vector<bool> &removed) {
+        zircon::SearchOption so;
+        so.k = 10;
+        so.ef = 64;
+        size_t hit = 0;
+        for (size_t q = 0; q < kQueries; ++q) {
+            std::vector<zircon::QueryResult> result;
+            REQUIRE(index.search(query(q), so, result).ok());
+            REQUIRE_EQ(result.size(), so.k);
+            auto truth = brute_force(q, so.k, removed);
+            for (auto &r : result) {
+                CHECK_FALSE(removed[r.label]);
+                hit += std::count(truth.begin(), truth.end(), r.label);
+            }
+            for (size_t i = 1; i < result.size(); ++i) {
+                CHECK(result[i - 1].distance <= result[i].distance);
+            }
+        }
+        return static_cast<double>(hit) / static_cast<double>(kQueries * so.k);
+    }
+
+    static constexpr size_t kDim = 24;
+    static constexpr size_t kSize = 3000;
+    static constexpr size_t kQueries = 50;
+    std::vector<float> data;
+    std::vector<float> queries;
+    zircon::IndexOption option;
+};
+
+TEST_CASE_FIXTURE(HnswIndexTest, "hnsw build and search") {
+    zircon::HnswIndex index;
+    REQUIRE(index.initialize(option).ok());
+    for (size_t i = 0; i < kSize; ++i) {
+        auto r = index.add_vector(i, vector(i));
+        REQUIRE(r.ok());
+        CHECK_EQ(r.value(), i);
+    }
+    CHECK_EQ(index.size(), kSize);
+    CHECK(index.max_level() > 0);
+    CHECK_FALSE(index.add_vector(0, vector(0)).ok());
+    CHECK_FALSE(index.add_vector(kSize, turbo::Span<float>(data.data(), kDim - 1)).ok());
+    for (size_t i = 0; i < 100; ++i) {
+        auto links = index.neighbors(i, 0);
+        CHECK(!links.empty());
+        CHECK(links.size() <= 2 * index.hnsw_option().m);
+    }
+    std::vector<bool> removed(kSize, false);
+    CHECK(recall(index, removed) > 0.9);
+
+    for (size_t i = 0; i < kSize; i += 3) {
+        REQUIRE(index.remove_vector(i).ok());
+        removed[i] = true;
+    }
+    CHECK_FALSE(index.remove_vector(0).ok());
+    CHECK(recall(index, removed) > 0.9);
+}
+
+TEST_CASE_FIXTURE(HnswIndexTest, "hnsw cosine metrics") {
+    // vectors of random length, normalized cosine keeps the ranking of cosine
+    for (size_t i = 0; i < kSize; ++i) {
+        const float scale = turbo::uniform(0.1f, 10.0f);
+        for (size_t d = 0; d < kDim; ++d) {
+            data[i * kDim + d] *= scale;
+        }
+    }
+    for (auto metric : {zircon::MetricType::METRIC_COSINE, zircon::MetricType::METRIC_NORMALIZED_COSINE}) {
+        option.metric = metric;
+        zircon::HnswIndex index;
+        REQUIRE(index.initialize(option).ok());
+        for (size_t i = 0; i < kSize; ++i) {
+            REQUIRE(index.add_vector(i, vector(i)).ok());
+        }
+        CHECK_EQ(index.store().keeps_norms(), metric == zircon::MetricType::METRIC_COSINE);
+        CHECK_EQ(index.store().is_normalized(), metric == zircon::MetricType::METRIC_NORMALIZED_COSINE);
+        option.metric = zircon::MetricType::METRIC_COSINE;
+        std::vector<bool> removed(kSize, false);
+        CHECK(recall(index, removed) > 0.9);
+    }
+}
+
+TEST_CASE_FIXTURE(HnswIndexTest, "hnsw concurrent insert") {
+    option.metric = zircon::MetricType::METRIC_IP;
+    zircon::HnswIndex index;
+    REQUIRE(index.initialize(option).ok());
+    constexpr size_t kThreads = 4;
+    std::vector<std::thread> threads;
+    for (size_t t = 0; t < kThreads; ++t) {
+        threads.emplace_back([&, t]() {
+            for (size_t i = t; i < kSize; i += kThreads) {
+                CHECK(index.add_vector(i, vector(i)).ok());
+            }
+        });
+    }
+    for (auto &t : threads) {
+        t.join();
+    }
+    CHECK_EQ(index.size(), kSize);
+    std::vector<bool> removed(kSize, false);
+    CHECK(recall(index, removed) > 0.85);
+}
+
+TEST_CASE_FIXTURE(HnswIndexTest, "hnsw filtered search") {
+    zircon::HnswIndex index;
+    REQUIRE(index.initialize(option).ok());
+    for (size_t i = 0; i < kSize; ++i) {
+        REQUIRE(index.add_vector(i, vector(i)).ok());
+    }
+    // half of the labels are traversed in the graph
+    std::vector<zircon::label_type> even;
+    for (size_t i = 0; i < kSize; i += 2) {
+        even.push_back(i);
+    }
+    zircon::IdFilterBitmap half(even);
+    // a selective filter switch to brute force, the result is exact
+    zircon::IdFilterSet few{1, 7, 99, 500, 2999};
+    std::vector<bool> odd(kSize, false);
+    for (size_t i = 1; i < kSize; i += 2) {
+        odd[i] = true;
+    }
+    zircon::SearchOption so;
+    so.k = 10;
+    so.ef = 64;
+    size_t hit = 0;
+    for (size_t q = 0; q < kQueries; ++q) {
+        std::vector<zircon::QueryResult> result;
+        zircon::QueryStats stats;
+        so.filter = &half;
+        so.stats = &stats;
+        REQUIRE(index.search(query(q), so, result).ok());
+        so.stats = nullptr;
+        REQUIRE_EQ(result.size(), so.k);
+        // the odd neighbors are traversed and rejected
+        CHECK_GE(stats.nodes_visited, so.k);
+        CHECK_GT(stats.distance_computations, stats.nodes_visited);
+        CHECK_GT(stats.filter_rejected, 0u);
+        CHECK_LT(stats.filter_rejected, stats.distance_computations);
+        auto truth = brute_force(q, so.k, odd);
+        for (auto &r : result) {
+            CHECK_EQ(r.label % 2, 0);
+            hit += std::count(truth.begin(), truth.end(), r.label);
+        }
+
+        so.filter = &few;
+        REQUIRE(index.search(query(q), so, result).ok());
+        REQUIRE_EQ(result.size(), few.id_set.size());
+        for (size_t i = 1; i < result.size(); ++i) {
+            CHECK(result[i - 1].distance <= result[i].distance);
+        }
+        for (auto &r : result) {
+            CHECK(few.is_member(r.label));
+        }
+    }
+    CHECK(static_cast<double>(hit) / static_cast<double>(kQueries * so.k) > 0.9);
+}
+
+TEST_CASE_FIXTURE(HnswIndexTest, "hnsw search batch") {
+    zircon::HnswIndex index;
+    REQUIRE(index.initialize(option).ok());
+    for (size_t i = 0; i < kSize; ++i) {
+        REQUIRE(index.add_vector(i, vector(i)).ok());
+    }
+    for (size_t i = 0; i < kSize; i += 7) {
+        REQUIRE(index.remove_vector(i).ok());
+    }
+    std::vector<zircon::label_type> even;
+    for (size_t i = 0; i < kSize; i += 2) {
+        even.push_back(i);
+    }
+    zircon::IdFilterBitmap half(even);
+    zircon::IdFilterSet few{1, 8, 99, 500, 2999};
+    // more queries than kBatchWidth, the last group is partial
+    static_assert(kQueries > zircon::HnswIndex::kBatchWidth);
+    for (const zircon::IdFilter *filter : {static_cast<const zircon::IdFilter *>(nullptr),
+                                           static_cast<const zircon::IdFilter *>(&half),
+                                           static_cast<const zircon::IdFilter *>(&few)}) {
+        zircon::SearchOption so;
+        so.k = 10;
+        so.ef = 48;
+        so.filter = filter;
+        zircon::QueryStats batch_stats;
+        so.stats = &batch_stats;
+        std::vector<std::vector<zircon::QueryResult>> results;
+        REQUIRE(index.search_batch(turbo::Span<float>(queries), kQueries, so, results).ok());
+        REQUIRE_EQ(results.size(), kQueries);
+        zircon::QueryStats stats;
+        so.stats = &stats;
+        for (size_t q = 0; q < kQueries; ++q) {
+            std::vector<zircon::QueryResult> result;
+            REQUIRE(index.search(query(q), so, result).ok());
+            // the same traversal, only interleaved
+            REQUIRE_EQ(results[q].size(), result.size());
+            for (size_t i = 0; i < result.size(); ++i) {
+                CHECK_EQ(results[q][i].label, result[i].label);
+                CHECK_EQ(results[q][i].distance, result[i].distance);
+            }
+        }
+        CHECK_EQ(batch_stats.distance_computations, stats.distance_computations);
+        CHECK_EQ(batch_stats.nodes_visited, stats.nodes_visited);
+        CHECK_EQ(batch_stats.filter_rejected, stats.filter_rejected);
+    }
+    std::vector<std::vector<zircon::QueryResult>> results;
+    zircon::SearchOption so;
+    CHECK_FALSE(index.search_batch(turbo::Span<float>(queries.data(), kDim + 1), 1, so, results).ok());
+    REQUIRE(index.search_batch(turbo::Span<float>(queries.data(), 0), 0, so, results).ok());
+    CHECK(results.empty());
+}
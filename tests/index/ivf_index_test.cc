@@ -0,0 +1,197 @@
+// Copyright 2023 The Elastic-AI Authors.
+// part of Elastic AI Search
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#define DOCTEST_CONFIG_IMPLEMENT_WITH_MAIN
+#include "turbo/testing/test.h"
+#include "zircon/index/flat_index.h"
+#include "zircon/index/ivf_index.h"
+#include "zircon/utility/id_filter.h"
+#include "turbo/random/random.h"
+#include <algorithm>
+#include <vector>
+
+namespace {
+    constexpr std::size_t kDim = 16;
+    constexpr std::size_t kSize = 4000;
+    constexpr std::size_t kClusters = 32;
+
+    zircon::IndexOption make_option(zircon::MetricType metric = zircon::MetricType::METRIC_L2) {
+        zircon::IndexOption op;
+        op.metric = metric;
+        op.dimension = kDim;
+        op.store_option.batch_size = 64;
+        op.store_option.max_elements = kSize;
+        return op;
+    }
+
+    zircon::IvfOption make_ivf(zircon::IvfCode code) {
+        zircon::IvfOption ivf;
+        ivf.nlist = 16;
+        ivf.nprobe = 4;
+        ivf.code = code;
+        ivf.pq_m = 8;
+        ivf.kmeans_iter = 20;
+        ivf.kmeans_batch = 1024;
+        ivf.nthreads = 2;
+        ivf.list_block = 32;
+        return ivf;
+    }
+
+    // clustered data, so a few probes find most neighbors
+    std::vector<float> make_data() {
+        std::vector<float> centers(kClusters * kDim);
+        for (auto &x : centers) {
+            x = turbo::uniform(-1.0f, 1.0f);
+        }
+        std::vector<float> data(kSize * kDim);
+        for (std::size_t i = 0; i < kSize; ++i) {
+            const std::size_t c = turbo::uniform<std::size_t>(0, kClusters);
+            for (std::size_t d = 0; d < kDim; ++d) {
+                data[i * kDim + d] = centers[c * kDim + d] + turbo::uniform(-0.1f, 0.1f);
+            }
+        }
+        return data;
+    }
+
+    double recall(const std::vector<zircon::QueryResult> &truth, const std::vector<zircon::QueryResult> &got) {
+        std::size_t hit = 0;
+        for (auto &t : truth) {
+            hit += std::any_of(got.begin(), got.end(), [&t](auto &r) { return r.label == t.label; });
+        }
+        return truth.empty() ? 1.0 : static_cast<double>(hit) / static_cast<double>(truth.size());
+    }
+
+    void build(zircon::IvfIndex &ivf, zircon::FlatIndex &flat, std::vector<float> &data) {
+        REQUIRE(ivf.train(turbo::Span<float>{data}).ok());
+        for (zircon::label_type l = 0; l < kSize; ++l) {
+            turbo::Span<float> v{data.data() + l * kDim, kDim};
+            REQUIRE(ivf.add_vector(l, v).ok());
+            REQUIRE(flat.add_vector(l, v).ok());
+        }
+    }
+
+    double mean_recall(const zircon::IvfIndex &ivf, const zircon::FlatIndex &flat, const std::vector<float> &data,
+                       const zircon::SearchOption &so) {
+        double sum = 0.0;
+        constexpr int kQueries = 20;
+        for (int q = 0; q < kQueries; ++q) {
+            std::vector<float> query(data.begin() + q * 97 * kDim, data.begin() + (q * 97 + 1) * kDim);
+            std::vector<zircon::QueryResult> truth;
+            std::vector<zircon::QueryResult> got;
+            REQUIRE(flat.search(turbo::Span<float>{query}, so, truth).ok());
+            REQUIRE(ivf.search(turbo::Span<float>{query}, so, got).ok());
+            REQUIRE(std::is_sorted(got.begin(), got.end(),
+                                   [](auto &a, auto &b) { return a.distance < b.distance; }));
+            sum += recall(truth, got);
+        }
+        return sum / kQueries;
+    }
+}  // namespace
+
+TEST_CASE("ivf flat recall and remove") {
+    auto data = make_data();
+    zircon::IvfIndex ivf;
+    zircon::FlatIndex flat;
+    REQUIRE(ivf.initialize(make_option(), make_ivf(zircon::IvfCode::IVF_FLAT)).ok());
+    REQUIRE(flat.initialize(make_option()).ok());
+    std::vector<float> v(kDim);
+    CHECK_FALSE(ivf.add_vector(0, turbo::Span<float>{v}).ok());
+    build(ivf, flat, data);
+    CHECK_EQ(ivf.size(), kSize);
+    CHECK_FALSE(ivf.add_vector(0, turbo::Span<float>{data.data(), kDim}).ok());
+    std::size_t total = 0;
+    for (std::size_t i = 0; i < ivf.nlist(); ++i) {
+        total += ivf.list_size(i);
+    }
+    CHECK_EQ(total, kSize);
+
+    zircon::SearchOption so;
+    so.k = 10;
+    CHECK_GE(mean_recall(ivf, flat, data, so), 0.9);
+    // all the lists probed is exact
+    so.nprobe = ivf.nlist();
+    CHECK_GE(mean_recall(ivf, flat, data, so), 0.999);
+
+    for (zircon::label_type l = 0; l < kSize; l += 2) {
+        REQUIRE(ivf.remove_vector(l).ok());
+        REQUIRE(flat.remove_vector(l).ok());
+    }
+    CHECK_FALSE(ivf.remove_vector(0).ok());
+    CHECK_EQ(ivf.size(), kSize / 2);
+    CHECK_GE(mean_recall(ivf, flat, data, so), 0.999);
+
+    // a removed label comes back in the list of its new vector
+    REQUIRE(ivf.add_vector(0, turbo::Span<float>{data.data() + kDim, kDim}).ok());
+    std::vector<zircon::QueryResult> got;
+    std::vector<float> query(data.begin() + kDim, data.begin() + 2 * kDim);
+    REQUIRE(ivf.search(turbo::Span<float>{query}, so, got).ok());
+    CHECK(std::any_of(got.begin(), got.end(), [](auto &r) { return r.label == 0; }));
+}
+
+TEST_CASE("ivf filter") {
+    auto data = make_data();
+    zircon::IvfIndex ivf;
+    zircon::FlatIndex flat;
+    REQUIRE(ivf.initialize(make_option(), make_ivf(zircon::IvfCode::IVF_FLAT)).ok());
+    REQUIRE(flat.initialize(make_option()).ok());
+    build(ivf, flat, data);
+    zircon::IdFilterRange range(1000, 2999);
+    zircon::IdFilterRange few(100, 119);
+    for (auto *filter : {&range, &few}) {
+        zircon::SearchOption so;
+        so.k = 10;
+        so.nprobe = ivf.nlist();
+        so.filter = filter;
+        for (int q = 0; q < 5; ++q) {
+            std::vector<float> query(data.begin() + q * kDim, data.begin() + (q + 1) * kDim);
+            std::vector<zircon::QueryResult> truth;
+            std::vector<zircon::QueryResult> got;
+            REQUIRE(flat.search(turbo::Span<float>{query}, so, truth).ok());
+            REQUIRE(ivf.search(turbo::Span<float>{query}, so, got).ok());
+            REQUIRE_EQ(got.size(), truth.size());
+            for (std::size_t i = 0; i < got.size(); ++i) {
+                CHECK(filter->is_member(got[i].label));
+                CHECK_EQ(got[i].label, truth[i].label);
+            }
+        }
+    }
+}
+
+TEST_CASE("ivf quantized codes") {
+    auto data = make_data();
+    for (auto metric : {zircon::MetricType::METRIC_L2, zircon::MetricType::METRIC_IP}) {
+        zircon::FlatIndex flat;
+        REQUIRE(flat.initialize(make_option(metric)).ok());
+        for (zircon::label_type l = 0; l < kSize; ++l) {
+            REQUIRE(flat.add_vector(l, turbo::Span<float>{data.data() + l * kDim, kDim}).ok());
+        }
+        for (auto code : {zircon::IvfCode::IVF_SQ8, zircon::IvfCode::IVF_FP16, zircon::IvfCode::IVF_PQ}) {
+            zircon::IvfIndex ivf;
+            REQUIRE(ivf.initialize(make_option(metric), make_ivf(code)).ok());
+            REQUIRE(ivf.train(turbo::Span<float>{data}).ok());
+            for (zircon::label_type l = 0; l < kSize; ++l) {
+                REQUIRE(ivf.add_vector(l, turbo::Span<float>{data.data() + l * kDim, kDim}).ok());
+            }
+            zircon::SearchOption so;
+            so.k = 10;
+            so.nprobe = ivf.nlist();
+            // pq of 8 bytes is lossy, the others are close to exact
+            CHECK_GE(mean_recall(ivf, flat, data, so), code == zircon::IvfCode::IVF_PQ ? 0.5 : 0.8);
+        }
+    }
+    zircon::IvfIndex bad;
+    CHECK_FALSE(bad.initialize(make_option(zircon::MetricType::METRIC_L1),
+                               make_ivf(zircon::IvfCode::IVF_PQ)).ok());
+}
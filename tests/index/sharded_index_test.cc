@@ -0,0 +1,204 @@
+// Copyright 2023 The Elastic-AI Authors.
+// part of Elastic AI Search
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#define DOCTEST_CONFIG_IMPLEMENT_WITH_MAIN
+#include "turbo/testing/test.h"
+#include "zircon/index/flat_index.h"
+#include "zircon/index/sharded_index.h"
+#include "zircon/utility/id_filter.h"
+#include "turbo/random/random.h"
+#include <atomic>
+#include <thread>
+#include <vector>
+
+namespace {
+    constexpr std::size_t kDim = 16;
+    constexpr std::size_t kSize = 4000;
+
+    zircon::IndexOption make_option() {
+        zircon::IndexOption op;
+        op.metric = zircon::MetricType::METRIC_L2;
+        op.dimension = kDim;
+        op.store_option.batch_size = 64;
+        op.store_option.max_elements = kSize;
+        return op;
+    }
+
+    std::vector<float> make_vectors(std::size_t n) {
+        std::vector<float> v(n * kDim);
+        for (auto &x : v) {
+            x = turbo::uniform(-1.0f, 1.0f);
+        }
+        return v;
+    }
+}  // namespace
+
+TEST_CASE("sharded index hash shards match the flat index") {
+    zircon::FlatOption flat;
+    flat.nthreads = 1;
+    zircon::ShardOption so;
+    so.nshards = 5;
+    zircon::ShardedIndex index;
+    REQUIRE(index.initialize(make_option(), so, flat).ok());
+    CHECK_FALSE(index.initialize(make_option(), so, flat).ok());
+    zircon::FlatIndex single;
+    REQUIRE(single.initialize(make_option(), flat).ok());
+    auto data = make_vectors(kSize);
+    for (zircon::label_type l = 0; l < kSize; ++l) {
+        auto v = turbo::Span<float>{data.data() + l * kDim, kDim};
+        REQUIRE(index.add_vector(l, v).ok());
+        REQUIRE(single.add_vector(l, v).ok());
+    }
+    CHECK_FALSE(index.add_vector(7, turbo::Span<float>{data.data(), kDim}).ok());
+    for (zircon::label_type l = 0; l < kSize; l += 3) {
+        REQUIRE(index.remove_vector(l).ok());
+        REQUIRE(single.remove_vector(l).ok());
+    }
+    CHECK_FALSE(index.remove_vector(0).ok());
+    CHECK_EQ(index.size(), single.size());
+    // every shard got a fair share
+    for (std::size_t i = 0; i < index.nshards(); ++i) {
+        CHECK_GT(index.shard(i).size(), single.size() / so.nshards / 2);
+    }
+
+    zircon::IdFilterRange range(100, 1999);
+    for (int q = 0; q < 10; ++q) {
+        auto query = make_vectors(1);
+        zircon::SearchOption sop;
+        sop.k = 20;
+        sop.filter = q % 2 == 0 ? nullptr : &range;
+        zircon::QueryStats stats;
+        sop.stats = &stats;
+        std::vector<zircon::QueryResult> result;
+        std::vector<zircon::QueryResult> expect;
+        REQUIRE(index.search(turbo::Span<float>{query}, sop, result).ok());
+        sop.stats = nullptr;
+        REQUIRE(single.search(turbo::Span<float>{query}, sop, expect).ok());
+        REQUIRE_EQ(result.size(), expect.size());
+        for (std::size_t i = 0; i < result.size(); ++i) {
+            CHECK_EQ(result[i].label, expect[i].label);
+            CHECK_EQ(result[i].distance, expect[i].distance);
+        }
+        CHECK_GE(stats.distance_computations, sop.k);
+    }
+}
+
+TEST_CASE("sharded index range shards") {
+    zircon::FlatOption flat;
+    flat.nthreads = 1;
+    zircon::ShardOption so;
+    so.policy = zircon::ShardPolicy::SHARD_RANGE;
+    so.ranges = {{0, 999}, {1000, 1999}, {3000, 3999}};
+    so.nthreads = 3;
+    zircon::ShardedIndex index;
+    REQUIRE(index.initialize(make_option(), so, flat).ok());
+    CHECK_EQ(index.nshards(), 3u);
+    CHECK_EQ(index.shard_of(0), 0u);
+    CHECK_EQ(index.shard_of(1999), 1u);
+    CHECK_EQ(index.shard_of(2500), 3u);
+    CHECK_EQ(index.shard_of(3999), 2u);
+    CHECK_EQ(index.shard_of(4000), 3u);
+
+    auto data = make_vectors(kSize);
+    for (zircon::label_type l = 0; l < kSize; ++l) {
+        auto rs = index.add_vector(l, turbo::Span<float>{data.data() + l * kDim, kDim});
+        CHECK_EQ(rs.ok(), l < 2000 || l >= 3000);
+    }
+    CHECK_EQ(index.size(), 3000u);
+    CHECK_EQ(index.shard(1).size(), 1000u);
+
+    // a range filter searches the shards it overlaps only
+    zircon::IdFilterRange range(1200, 1300);
+    zircon::SearchOption sop;
+    sop.k = 10;
+    sop.filter = &range;
+    sop.brute_force_ratio = 0.0f;
+    zircon::QueryStats stats;
+    sop.stats = &stats;
+    auto query = make_vectors(1);
+    std::vector<zircon::QueryResult> result;
+    REQUIRE(index.search(turbo::Span<float>{query}, sop, result).ok());
+    REQUIRE_EQ(result.size(), sop.k);
+    for (auto &r : result) {
+        CHECK(range.is_member(r.label));
+    }
+    CHECK_EQ(stats.distance_computations + stats.filter_rejected, 1000u);
+
+    zircon::ShardOption bad;
+    bad.policy = zircon::ShardPolicy::SHARD_RANGE;
+    bad.ranges = {{0, 999}, {999, 1999}};
+    zircon::ShardedIndex overlapping;
+    CHECK_FALSE(overlapping.initialize(make_option(), bad, flat).ok());
+    bad.ranges.clear();
+    zircon::ShardedIndex empty;
+    CHECK_FALSE(empty.initialize(make_option(), bad, flat).ok());
+}
+
+TEST_CASE("sharded index hnsw shards built from threads") {
+    zircon::ShardOption so;
+    so.nshards = 4;
+    zircon::HnswOption hnsw;
+    hnsw.ef = 100;
+    zircon::ShardedIndex index;
+    REQUIRE(index.initialize(make_option(), so, hnsw).ok());
+    auto data = make_vectors(kSize);
+    constexpr std::size_t kThreads = 4;
+    std::atomic<int> failures{0};
+    std::vector<std::thread> threads;
+    for (std::size_t t = 0; t < kThreads; ++t) {
+        threads.emplace_back([&, t] {
+            for (zircon::label_type l = t; l < kSize; l += kThreads) {
+                if (!index.add_vector(l, turbo::Span<float>{data.data() + l * kDim, kDim}).ok()) {
+                    failures.fetch_add(1);
+                }
+            }
+        });
+    }
+    for (auto &th : threads) {
+        th.join();
+    }
+    REQUIRE_EQ(failures.load(), 0);
+    CHECK_EQ(index.size(), kSize);
+
+    zircon::FlatIndex exact;
+    zircon::FlatOption flat;
+    flat.nthreads = 1;
+    REQUIRE(exact.initialize(make_option(), flat).ok());
+    for (zircon::label_type l = 0; l < kSize; ++l) {
+        REQUIRE(exact.add_vector(l, turbo::Span<float>{data.data() + l * kDim, kDim}).ok());
+    }
+    std::size_t hits = 0;
+    std::size_t total = 0;
+    for (int q = 0; q < 20; ++q) {
+        auto query = make_vectors(1);
+        zircon::SearchOption sop;
+        sop.k = 10;
+        std::vector<zircon::QueryResult> result;
+        std::vector<zircon::QueryResult> expect;
+        REQUIRE(index.search(turbo::Span<float>{query}, sop, result).ok());
+        REQUIRE(exact.search(turbo::Span<float>{query}, sop, expect).ok());
+        REQUIRE_EQ(result.size(), sop.k);
+        for (std::size_t i = 0; i < result.size(); ++i) {
+            if (i > 0) {
+                CHECK_LE(result[i - 1].distance, result[i].distance);
+            }
+            for (auto &e : expect) {
+                hits += e.label == result[i].label;
+            }
+        }
+        total += sop.k;
+    }
+    CHECK_GE(hits, total * 9 / 10);
+}
@@ -0,0 +1,200 @@
+// Copyright 2023 The Elastic-AI Authors.
+// part of Elastic AI Search
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#define DOCTEST_CONFIG_IMPLEMENT_WITH_MAIN
+#include "turbo/testing/test.h"
+#include "zircon/quantizer/kmeans.h"
+#include "zircon/quantizer/product_quantizer.h"
+#include "zircon/quantizer/pq_code_store.h"
+#include "zircon/store/mem_vector_store.h"
+#include "zircon/utility/distance_dispatch.h"
+#include "zircon/utility/primitive_distance.h"
+#include "zircon/utility/thread_pool.h"
+#include "turbo/random/random.h"
+#include <vector>
+
+class ProductQuantizerTest {
+public:
+    ProductQuantizerTest() {
+        data.resize(kSize * kDim);
+        for (auto &v : data) {
+            v = turbo::uniform(-1.0f, 1.0f);
+        }
+        query.resize(kDim);
+        for (auto &v : query) {
+            v = turbo::uniform(-1.0f, 1.0f);
+        }
+    }
+
+    [[nodiscard]] const float *vector(size_t i) const {
+        return data.data() + i * kDim;
+    }
+
+    static constexpr size_t kDim = 48;
+    static constexpr size_t kSize = 1000;
+    std::vector<float> data;
+    std::vector<float> query;
+};
+
+TEST_CASE("kmeans separated clusters") {
+    constexpr size_t kDim = 8;
+    constexpr size_t k = 4;
+    constexpr size_t n = 400;
+    std::vector<float> data(n * kDim);
+    for (size_t i = 0; i < n; ++i) {
+        for (size_t d = 0; d < kDim; ++d) {
+            data[i * kDim + d] = static_cast<float>((i % k) * 10) + turbo::uniform(-0.5f, 0.5f);
+        }
+    }
+    std::vector<float> centroids(k * kDim);
+    REQUIRE(zircon::kmeans_train(data.data(), n, kDim, k, zircon::KMeansOption(), centroids.data()).ok());
+    std::vector<uint32_t> assign(n);
+    zircon::kmeans_assign(data.data(), n, kDim, centroids.data(), k, assign.data());
+    // every point of a generated cluster lands in the same centroid
+    for (size_t i = k; i < n; ++i) {
+        CHECK_EQ(assign[i], assign[i % k]);
+    }
+    CHECK_FALSE(zircon::kmeans_train(data.data(), 3, kDim, k, zircon::KMeansOption(), centroids.data()).ok());
+}
+
+TEST_CASE("mini batch kmeans") {
+    constexpr size_t kDim = 8;
+    constexpr size_t k = 4;
+    constexpr size_t n = 4000;
+    std::vector<float> data(n * kDim);
+    for (size_t i = 0; i < n; ++i) {
+        for (size_t d = 0; d < kDim; ++d) {
+            data[i * kDim + d] = static_cast<float>((i % k) * 10) + turbo::uniform(-0.5f, 0.5f);
+        }
+    }
+    zircon::MiniBatchKMeansOption option;
+    option.niter = 20;
+    option.batch_size = 256;
+    std::vector<float> serial(k * kDim);
+    std::vector<float> parallel(k * kDim);
+    REQUIRE(zircon::minibatch_kmeans_train(data.data(), n, kDim, k, option, serial.data()).ok());
+    zircon::ThreadPool pool(4);
+    REQUIRE(zircon::minibatch_kmeans_train(data.data(), n, kDim, k, option, parallel.data(), &pool).ok());
+    // the threads only split the work
+    CHECK_EQ(serial, parallel);
+    std::vector<uint32_t> assign(n);
+    zircon::parallel_kmeans_assign(pool, data.data(), n, kDim, serial.data(), k, assign.data());
+    for (size_t i = k; i < n; ++i) {
+        CHECK_EQ(assign[i], assign[i % k]);
+    }
+    CHECK_FALSE(zircon::minibatch_kmeans_train(data.data(), 3, kDim, k, option, serial.data()).ok());
+}
+
+TEST_CASE("pq4 scan kernels") {
+    for (size_t m : {1, 2, 3, 4, 5, 8, 13}) {
+        const size_t nblocks = 3;
+        std::vector<uint8_t> codes(nblocks * m * 16);
+        std::vector<uint8_t> lut(m * 16);
+        for (auto &c : codes) {
+            c = static_cast<uint8_t>(turbo::uniform(0, 256));
+        }
+        for (auto &t : lut) {
+            t = static_cast<uint8_t>(turbo::uniform(0, 256));
+        }
+        std::vector<uint16_t> expect(nblocks * 32, 0);
+        for (size_t b = 0; b < nblocks; ++b) {
+            for (size_t q = 0; q < m; ++q) {
+                for (size_t j = 0; j < 16; ++j) {
+                    uint8_t c = codes[b * m * 16 + q * 16 + j];
+                    expect[b * 32 + j] += lut[q * 16 + (c & 0x0f)];
+                    expect[b * 32 + j + 16] += lut[q * 16 + (c >> 4)];
+                }
+            }
+        }
+        for (auto *k : zircon::distance::available_distance_kernels()) {
+            std::vector<uint16_t> out(nblocks * 32, 0);
+            k->pq4_scan(codes.data(), nblocks, m, lut.data(), out.data());
+            CHECK(out == expect);
+        }
+    }
+}
+
+TEST_CASE_FIXTURE(ProductQuantizerTest, "pq encode and adc") {
+    zircon::ProductQuantizer pq;
+    CHECK_FALSE(pq.initialize(kDim, 5).ok());
+    CHECK_FALSE(pq.initialize(kDim, 8, 6).ok());
+    REQUIRE(pq.initialize(kDim, 8).ok());
+    REQUIRE(pq.train(turbo::Span<float>(data.data(), data.size())).ok());
+    CHECK_EQ(pq.code_size(), 8);
+    std::vector<float> lut(pq.m() * pq.ksub());
+    REQUIRE(pq.compute_lut(zircon::MetricType::METRIC_L2, query.data(), lut.data()).ok());
+    std::vector<float> lut_ip(pq.m() * pq.ksub());
+    REQUIRE(pq.compute_lut(zircon::MetricType::METRIC_IP, query.data(), lut_ip.data()).ok());
+    CHECK_FALSE(pq.compute_lut(zircon::MetricType::METRIC_L1, query.data(), lut.data()).ok());
+    std::vector<uint8_t> code(pq.code_size());
+    std::vector<float> decoded(kDim);
+    double err = 0.0;
+    double norm = 0.0;
+    for (size_t i = 0; i < 100; ++i) {
+        pq.encode(vector(i), code.data());
+        pq.decode(code.data(), decoded.data());
+        auto v = turbo::Span<float>(const_cast<float *>(vector(i)), kDim);
+        err += zircon::distance::simple_distance_l2(v, turbo::Span<float>(decoded));
+        norm += zircon::distance::simple_distance_ip(v, v);
+        // adc is exactly the distance to the reconstruction
+        auto l2 = zircon::distance::simple_distance_l2(turbo::Span<float>(query), turbo::Span<float>(decoded));
+        auto ip = zircon::distance::simple_distance_ip(turbo::Span<float>(query), turbo::Span<float>(decoded));
+        CHECK_EQ(pq.adc_distance(lut.data(), code.data()), doctest::Approx(l2).epsilon(1e-4));
+        CHECK_EQ(pq.adc_distance(lut_ip.data(), code.data()), doctest::Approx(-ip).epsilon(1e-4));
+    }
+    // the reconstruction is much better than nothing
+    CHECK(err < norm * 0.5);
+}
+
+TEST_CASE_FIXTURE(ProductQuantizerTest, "pq code store") {
+    zircon::MemVectorStore store;
+    zircon::VectorStoreOption op;
+    op.batch_size = 128;
+    op.max_elements = kSize;
+    op.vector_byte_size = kDim * sizeof(float);
+    REQUIRE(store.initialize(op).ok());
+    for (size_t i = 0; i < kSize; ++i) {
+        auto r = store.add_vector(i, turbo::Span<uint8_t>(reinterpret_cast<uint8_t *>(data.data() + i * kDim),
+                                                          kDim * sizeof(float)));
+        REQUIRE(r.ok());
+    }
+    for (size_t nbits : {4, 8}) {
+        zircon::ProductQuantizer pq;
+        REQUIRE(pq.initialize(kDim, 12, nbits).ok());
+        REQUIRE(pq.train(store, 500).ok());
+        zircon::PqCodeStore codes;
+        REQUIRE(codes.initialize(&pq).ok());
+        REQUIRE(codes.add_from_store(store).ok());
+        CHECK_EQ(codes.size(), kSize);
+
+        std::vector<float> lut(pq.m() * pq.ksub());
+        REQUIRE(pq.compute_lut(zircon::MetricType::METRIC_L2, query.data(), lut.data()).ok());
+        std::vector<float> dis(kSize);
+        REQUIRE(codes.scan(zircon::MetricType::METRIC_L2, query.data(), dis.data()).ok());
+        float max_lut = *std::max_element(lut.begin(), lut.end());
+        for (size_t i = 0; i < kSize; ++i) {
+            // the fast scan quantize the lut, half a step error per sub quantizer
+            float tolerance = nbits == 4 ? max_lut / 255.0f * pq.m() : 1e-4f;
+            CHECK(std::abs(dis[i] - pq.adc_distance(lut.data(), codes.code(i))) <= tolerance);
+        }
+        std::vector<std::pair<float, zircon::location_t>> result;
+        REQUIRE(codes.search(zircon::MetricType::METRIC_L2, query.data(), 10, result).ok());
+        REQUIRE_EQ(result.size(), 10);
+        for (size_t i = 1; i < result.size(); ++i) {
+            CHECK(result[i - 1].first <= result[i].first);
+        }
+        CHECK_EQ(result[0].first, *std::min_element(dis.begin(), dis.end()));
+    }
+}
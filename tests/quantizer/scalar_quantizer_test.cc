@@ -0,0 +1,209 @@
+// Copyright 2023 The Elastic-AI Authors.
+// part of Elastic AI Search
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#define DOCTEST_CONFIG_IMPLEMENT_WITH_MAIN
+#include "turbo/testing/test.h"
+#include "zircon/quantizer/scalar_quantizer.h"
+#include "zircon/store/mem_vector_store.h"
+#include "zircon/utility/distance_dispatch.h"
+#include "zircon/utility/primitive_distance.h"
+#include "zircon/utility/float16.h"
+#include "turbo/random/random.h"
+#include <cmath>
+#include <vector>
+
+class ScalarQuantizerTest {
+public:
+    ScalarQuantizerTest() {
+        data.resize(kSize * kDim);
+        for (auto &v : data) {
+            v = turbo::uniform(-1.0f, 1.0f);
+        }
+        query.resize(kDim);
+        for (auto &v : query) {
+            v = turbo::uniform(-1.0f, 1.0f);
+        }
+    }
+
+    [[nodiscard]] const float *vector(size_t i) const {
+        return data.data() + i * kDim;
+    }
+
+    static constexpr size_t kDim = 37;
+    static constexpr size_t kSize = 200;
+    std::vector<float> data;
+    std::vector<float> query;
+};
+
+TEST_CASE("half float round trip") {
+    CHECK_EQ(zircon::half_to_float(zircon::float_to_half(1.0f)), 1.0f);
+    CHECK_EQ(zircon::half_to_float(zircon::float_to_half(-0.5f)), -0.5f);
+    CHECK_EQ(zircon::half_to_float(zircon::float_to_half(65504.0f)), 65504.0f);
+    CHECK(std::isinf(zircon::half_to_float(zircon::float_to_half(1e6f))));
+    // 2^-24 is the smallest subnormal
+    CHECK_EQ(zircon::half_to_float(zircon::float_to_half(5.9604645e-8f)), 5.9604645e-8f);
+}
+
+TEST_CASE_FIXTURE(ScalarQuantizerTest, "sq8 encode decode") {
+    zircon::ScalarQuantizer sq;
+    REQUIRE(sq.initialize(zircon::EncodingType::ENCODING_SQ8, kDim).ok());
+    CHECK_FALSE(sq.is_trained());
+    CHECK_FALSE(sq.train(turbo::Span<float>(data.data(), kDim + 1)).ok());
+    REQUIRE(sq.train(turbo::Span<float>(data.data(), data.size())).ok());
+    CHECK_EQ(sq.code_size(), kDim);
+    std::vector<uint8_t> code(sq.code_size());
+    std::vector<float> decoded(kDim);
+    for (size_t j = 0; j < kSize; ++j) {
+        sq.encode(vector(j), code.data());
+        sq.decode(code.data(), decoded.data());
+        for (size_t i = 0; i < kDim; ++i) {
+            CHECK(std::fabs(decoded[i] - vector(j)[i]) <= sq.scale()[i] * 0.5f + 1e-6f);
+        }
+    }
+}
+
+TEST_CASE_FIXTURE(ScalarQuantizerTest, "sq8 distance") {
+    zircon::ScalarQuantizer sq;
+    REQUIRE(sq.initialize(zircon::EncodingType::ENCODING_SQ8, kDim).ok());
+    REQUIRE(sq.train(turbo::Span<float>(data.data(), data.size())).ok());
+    std::vector<uint8_t> code(sq.code_size());
+    std::vector<float> decoded(kDim);
+    for (size_t j = 0; j < kSize; ++j) {
+        sq.encode(vector(j), code.data());
+        sq.decode(code.data(), decoded.data());
+        // the kernels against the code equal the float kernels against the decoded vector
+        for (auto *k : zircon::distance::available_distance_kernels()) {
+            auto l2 = zircon::distance::simple_distance_l2(turbo::Span<float>(query), turbo::Span<float>(decoded));
+            auto ip = zircon::distance::simple_distance_ip(turbo::Span<float>(query), turbo::Span<float>(decoded));
+            CHECK_EQ(k->sq8_l2(query.data(), code.data(), sq.vmin().data(), sq.scale().data(), kDim),
+                     doctest::Approx(l2).epsilon(1e-4));
+            CHECK_EQ(k->sq8_ip(query.data(), code.data(), sq.vmin().data(), sq.scale().data(), kDim),
+                     doctest::Approx(ip).epsilon(1e-4));
+        }
+    }
+}
+
+TEST_CASE_FIXTURE(ScalarQuantizerTest, "fp16 distance") {
+    zircon::ScalarQuantizer sq;
+    REQUIRE(sq.initialize(zircon::EncodingType::ENCODING_FP16, kDim).ok());
+    CHECK(sq.is_trained());
+    CHECK_EQ(sq.code_size(), kDim * 2);
+    std::vector<uint8_t> code(sq.code_size());
+    std::vector<float> decoded(kDim);
+    for (size_t j = 0; j < kSize; ++j) {
+        sq.encode(vector(j), code.data());
+        sq.decode(code.data(), decoded.data());
+        auto *h = reinterpret_cast<const uint16_t *>(code.data());
+        for (auto *k : zircon::distance::available_distance_kernels()) {
+            auto l2 = zircon::distance::simple_distance_l2(turbo::Span<float>(query), turbo::Span<float>(decoded));
+            auto ip = zircon::distance::simple_distance_ip(turbo::Span<float>(query), turbo::Span<float>(decoded));
+            CHECK_EQ(k->fp16_l2(query.data(), h, kDim), doctest::Approx(l2).epsilon(1e-4));
+            CHECK_EQ(k->fp16_ip(query.data(), h, kDim), doctest::Approx(ip).epsilon(1e-4));
+        }
+    }
+}
+
+TEST_CASE_FIXTURE(ScalarQuantizerTest, "encoded store") {
+    zircon::MemVectorStore store;
+    zircon::VectorStoreOption op;
+    op.batch_size = 64;
+    op.max_elements = kSize;
+    op.encoding = zircon::EncodingType::ENCODING_SQ8;
+    op.dimension = kDim;
+    REQUIRE(store.initialize(op).ok());
+    auto as_bytes = [](const float *v) {
+        return turbo::Span<uint8_t>(reinterpret_cast<uint8_t *>(const_cast<float *>(v)), kDim * sizeof(float));
+    };
+    CHECK_FALSE(store.add_vector(0, as_bytes(vector(0))).ok());
+    REQUIRE(store.train_quantizer(turbo::Span<float>(data.data(), data.size())).ok());
+    for (size_t j = 0; j < kSize; ++j) {
+        auto r = store.add_vector(j, as_bytes(vector(j)));
+        REQUIRE(r.ok());
+        CHECK_EQ(r.value(), j);
+    }
+    CHECK_EQ(store.get_vector(0).size() % turbo::simd::default_arch::alignment(), 0);
+    std::vector<float> decoded(kDim);
+    for (size_t j = 0; j < kSize; ++j) {
+        store.decode_vector(j, turbo::Span<float>(decoded.data(), kDim));
+        auto l2 = zircon::distance::simple_distance_l2(turbo::Span<float>(query), turbo::Span<float>(decoded));
+        CHECK_EQ(store.quantizer().distance(zircon::MetricType::METRIC_L2, query.data(), store.get_vector(j).data()),
+                 doctest::Approx(l2).epsilon(1e-4));
+    }
+}
+
+TEST_CASE_FIXTURE(ScalarQuantizerTest, "binary encode decode") {
+    zircon::ScalarQuantizer bq;
+    REQUIRE(bq.initialize(zircon::EncodingType::ENCODING_BINARY, kDim).ok());
+    CHECK(bq.is_trained());
+    CHECK_EQ(bq.code_size(), (kDim + 7) / 8);
+    // sign bits until trained
+    std::vector<uint8_t> code(bq.code_size());
+    std::vector<float> decoded(kDim);
+    bq.encode(query.data(), code.data());
+    bq.decode(code.data(), decoded.data());
+    for (size_t i = 0; i < kDim; ++i) {
+        CHECK_EQ(decoded[i], query[i] > 0.0f ? 1.0f : -1.0f);
+    }
+    CHECK_EQ(bq.distance(zircon::MetricType::METRIC_L2, query.data(), code.data()),
+             doctest::Approx(zircon::distance::simple_distance_l2(turbo::Span<float>(query),
+                                                                  turbo::Span<float>(decoded))));
+    CHECK_EQ(bq.hamming(code.data(), code.data()), 0.0f);
+
+    // shifted data, the thresholds follow the means
+    std::vector<float> shifted(data);
+    for (auto &v : shifted) {
+        v += 3.0f;
+    }
+    REQUIRE(bq.train(turbo::Span<float>(shifted.data(), shifted.size())).ok());
+    size_t ones = 0;
+    for (size_t j = 0; j < kSize; ++j) {
+        bq.encode(shifted.data() + j * kDim, code.data());
+        for (size_t i = 0; i < kDim; ++i) {
+            ones += (code[i / 8] >> (i % 8)) & 1u;
+        }
+        // the padding bits of the last byte are never set
+        CHECK_EQ(code.back() >> (kDim % 8), 0);
+    }
+    CHECK(ones > kSize * kDim / 4);
+    CHECK(ones < kSize * kDim * 3 / 4);
+    for (size_t i = 0; i < kDim; ++i) {
+        CHECK_EQ(bq.vmin()[i], doctest::Approx(3.0f).epsilon(0.1));
+        CHECK_EQ(bq.scale()[i], doctest::Approx(0.5f).epsilon(0.25));
+    }
+}
+
+TEST_CASE_FIXTURE(ScalarQuantizerTest, "binary store") {
+    zircon::MemVectorStore store;
+    zircon::VectorStoreOption op;
+    op.batch_size = 64;
+    op.max_elements = kSize;
+    op.encoding = zircon::EncodingType::ENCODING_BINARY;
+    op.dimension = kDim;
+    REQUIRE(store.initialize(op).ok());
+    REQUIRE(store.train_quantizer(turbo::Span<float>(data.data(), data.size())).ok());
+    for (size_t j = 0; j < kSize; ++j) {
+        auto r = store.add_vector(j, turbo::Span<uint8_t>(reinterpret_cast<uint8_t *>(data.data() + j * kDim),
+                                                          kDim * sizeof(float)));
+        REQUIRE(r.ok());
+    }
+    zircon::ScalarQuantizer bq;
+    REQUIRE(bq.initialize(zircon::EncodingType::ENCODING_BINARY, kDim).ok());
+    REQUIRE(bq.set_range(store.quantizer().vmin(), store.quantizer().scale()).ok());
+    std::vector<uint8_t> code(bq.code_size());
+    for (size_t j = 0; j < kSize; ++j) {
+        bq.encode(vector(j), code.data());
+        CHECK_EQ(bq.hamming(code.data(), store.get_vector(j).data()), 0.0f);
+    }
+}
@@ -0,0 +1,646 @@
+// Copyright 2023 The Elastic-AI Authors.
+// part of Elastic AI Search
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#define DOCTEST_CONFIG_IMPLEMENT_WITH_MAIN
+#include "turbo/testing/test.h"
+#include "zircon/store/mem_vector_store.h"
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <thread>
+#include <vector>
+
+namespace {
+    constexpr std::size_t kDim = 16;
+
+    zircon::VectorStoreOption make_option(uint32_t max_elements) {
+        zircon::VectorStoreOption op;
+        op.batch_size = 64;
+        op.max_elements = max_elements;
+        op.vector_byte_size = kDim * sizeof(float);
+        op.dimension = kDim;
+        op.enable_replace_vacant = true;
+        return op;
+    }
+
+    turbo::Span<uint8_t> as_bytes(std::vector<float> &v) {
+        return turbo::Span<uint8_t>{reinterpret_cast<uint8_t *>(v.data()), v.size() * sizeof(float)};
+    }
+}  // namespace
+
+TEST_CASE("mem vector store remove and vacant") {
+    zircon::MemVectorStore store;
+    REQUIRE(store.initialize(make_option(256)).ok());
+    std::vector<float> v(kDim);
+    for (zircon::label_type l = 0; l < 100; ++l) {
+        v[0] = static_cast<float>(l);
+        REQUIRE(store.add_vector(l, as_bytes(v)).ok());
+    }
+    auto rs = store.remove_vector(10);
+    REQUIRE(rs.ok());
+    auto loc = rs.value();
+    CHECK(store.is_deleted(loc));
+    CHECK_EQ(store.get_label(loc).value(), zircon::constants::kUnknownLabel);
+    CHECK_FALSE(store.is_deleted(loc + 1));
+    CHECK_EQ(store.size(), 99u);
+
+    // the removed location is reused
+    v[0] = 1000.0f;
+    auto add = store.add_vector(1000, as_bytes(v));
+    REQUIRE(add.ok());
+    CHECK_EQ(add.value(), loc);
+    CHECK_FALSE(store.is_deleted(loc));
+    CHECK_EQ(store.get_label(loc).value(), 1000u);
+    auto span = store.get_vector(loc);
+    CHECK_EQ(reinterpret_cast<const float *>(span.data())[0], 1000.0f);
+}
+
+TEST_CASE("mem vector store grow keeps state") {
+    zircon::MemVectorStore store;
+    REQUIRE(store.initialize(make_option(100)).ok());
+    std::vector<float> v(kDim);
+    for (zircon::label_type l = 0; l < 100; ++l) {
+        v[0] = static_cast<float>(l);
+        REQUIRE(store.add_vector(l, as_bytes(v)).ok());
+    }
+    CHECK_FALSE(store.add_vector(100, as_bytes(v)).ok());
+    REQUIRE(store.remove_vector(7).ok());
+    store.disable_vacant();
+    store.reset_max_elements(1000);
+    for (zircon::label_type l = 100; l < 1000; ++l) {
+        v[0] = static_cast<float>(l);
+        REQUIRE(store.add_vector(l, as_bytes(v)).ok());
+    }
+    CHECK(store.is_deleted(7));
+    for (zircon::location_t i = 0; i < 1000; ++i) {
+        auto span = store.get_vector(i);
+        CHECK_EQ(reinterpret_cast<const float *>(span.data())[0], static_cast<float>(i == 7 ? 7 : i));
+        if (i != 7) {
+            CHECK_EQ(store.get_label(i).value(), i);
+        }
+    }
+}
+
+TEST_CASE("mem vector store concurrent read while writing") {
+    zircon::MemVectorStore store;
+    REQUIRE(store.initialize(make_option(256)).ok());
+    std::vector<float> v(kDim);
+    for (zircon::label_type l = 0; l < 256; ++l) {
+        v[0] = static_cast<float>(l);
+        REQUIRE(store.add_vector(l, as_bytes(v)).ok());
+    }
+    store.disable_vacant();
+    std::atomic<bool> stop{false};
+    std::atomic<std::size_t> bad{0};
+    std::vector<std::thread> readers;
+    for (int t = 0; t < 4; ++t) {
+        readers.emplace_back([&]() {
+            while (!stop.load()) {
+                auto n = store.current_index();
+                for (zircon::location_t i = 0; i < n; ++i) {
+                    auto label = store.get_label(i).value();
+                    if (store.is_deleted(i) || label == zircon::constants::kUnknownLabel) {
+                        continue;
+                    }
+                    // vectors of the first generation never change
+                    if (i < 256) {
+                        auto span = store.get_vector(i);
+                        if (reinterpret_cast<const float *>(span.data())[0] != static_cast<float>(i)) {
+                            ++bad;
+                        }
+                    }
+                }
+            }
+        });
+    }
+    uint32_t max_elements = 256;
+    zircon::label_type next = 256;
+    for (int round = 0; round < 8; ++round) {
+        max_elements *= 2;
+        store.reset_max_elements(max_elements);
+        while (next < max_elements) {
+            v[0] = static_cast<float>(next);
+            CHECK(store.add_vector(next, as_bytes(v)).ok());
+            ++next;
+        }
+        for (zircon::label_type l = round; l < 256; l += 16) {
+            CHECK(store.remove_vector(l).ok());
+        }
+    }
+    stop = true;
+    for (auto &t : readers) {
+        t.join();
+    }
+    CHECK_EQ(bad.load(), 0u);
+    CHECK_EQ(store.current_index(), max_elements);
+}
+
+TEST_CASE("mem vector store bulk add") {
+    zircon::MemVectorStore store;
+    REQUIRE(store.initialize(make_option(1000)).ok());
+    std::vector<float> single(kDim);
+    single[0] = -1.0f;
+    REQUIRE(store.add_vector(5000, as_bytes(single)).ok());
+
+    // crosses several batches and starts in the middle of the first one
+    constexpr std::size_t n = 300;
+    std::vector<zircon::label_type> labels(n);
+    std::vector<float> data(n * kDim);
+    for (std::size_t i = 0; i < n; ++i) {
+        labels[i] = i;
+        data[i * kDim] = static_cast<float>(i);
+        data[i * kDim + kDim - 1] = static_cast<float>(i) * 2.0f;
+    }
+    auto rs = store.add_vectors(turbo::Span<zircon::label_type>{labels}, as_bytes(data));
+    REQUIRE(rs.ok());
+    CHECK_EQ(rs.value(), 1u);
+    CHECK_EQ(store.size(), n + 1);
+    for (std::size_t i = 0; i < n; ++i) {
+        auto loc = store.get_location(i);
+        REQUIRE(loc.ok());
+        CHECK_EQ(loc.value(), i + 1);
+        CHECK_EQ(store.get_label(i + 1).value(), i);
+        auto v = reinterpret_cast<const float *>(store.get_vector(i + 1).data());
+        CHECK_EQ(v[0], static_cast<float>(i));
+        CHECK_EQ(v[kDim - 1], static_cast<float>(i) * 2.0f);
+    }
+
+    // a repeated label fails the whole call and leaves the store untouched
+    std::vector<zircon::label_type> dup = {1000, 1001, 5000};
+    std::vector<float> dup_data(dup.size() * kDim);
+    CHECK_FALSE(store.add_vectors(turbo::Span<zircon::label_type>{dup}, as_bytes(dup_data)).ok());
+    CHECK_FALSE(store.exists_label(1000));
+    CHECK_EQ(store.current_index(), n + 1);
+
+    // wrong buffer size and no space
+    CHECK_FALSE(store.add_vectors(turbo::Span<zircon::label_type>{labels}, as_bytes(single)).ok());
+    std::vector<zircon::label_type> many(800);
+    std::vector<float> many_data(many.size() * kDim);
+    for (std::size_t i = 0; i < many.size(); ++i) {
+        many[i] = 10000 + i;
+    }
+    CHECK_FALSE(store.add_vectors(turbo::Span<zircon::label_type>{many}, as_bytes(many_data)).ok());
+    CHECK_FALSE(store.exists_label(10000));
+}
+
+TEST_CASE("mem vector store snapshot") {
+    auto path = (std::filesystem::temp_directory_path() / "zircon_store_snapshot_test.snap").string();
+    std::vector<float> data(300 * kDim);
+    std::vector<zircon::label_type> labels(300);
+    for (std::size_t i = 0; i < labels.size(); ++i) {
+        labels[i] = 100 + i;
+        for (std::size_t d = 0; d < kDim; ++d) {
+            data[i * kDim + d] = static_cast<float>(i) + static_cast<float>(d) * 0.01f;
+        }
+    }
+    {
+        zircon::MemVectorStore store;
+        REQUIRE(store.initialize(make_option(1000)).ok());
+        REQUIRE(store.add_vectors(turbo::Span<zircon::label_type>{labels}, as_bytes(data)).ok());
+        REQUIRE(store.remove_vector(105).ok());
+        REQUIRE(store.remove_vector(300).ok());
+        REQUIRE(store.save_snapshot(path).ok());
+    }
+    for (bool zero_copy : {true, false}) {
+        zircon::MemVectorStore store;
+        REQUIRE(store.load_snapshot(path, zero_copy).ok());
+        CHECK_EQ(store.current_index(), 300u);
+        CHECK_EQ(store.size(), 298u);
+        CHECK(store.is_deleted(5));
+        CHECK(store.is_deleted(200));
+        CHECK_FALSE(store.exists_label(105));
+        for (std::size_t i = 0; i < labels.size(); ++i) {
+            if (i == 5 || i == 200) {
+                continue;
+            }
+            CHECK_EQ(store.get_location(labels[i]).value(), i);
+            const auto *v = reinterpret_cast<const float *>(store.get_vector(i).data());
+            CHECK_EQ(v[kDim - 1], data[i * kDim + kDim - 1]);
+        }
+        // the store keeps working, the vacant and the tail of the last mapped batch are reused
+        std::vector<float> v(kDim, 7.0f);
+        CHECK_EQ(store.add_vector(5000, as_bytes(v)).value(), 5u);
+        CHECK_EQ(store.add_vector(5001, as_bytes(v)).value(), 200u);
+        CHECK_EQ(store.add_vector(5002, as_bytes(v)).value(), 300u);
+        CHECK_EQ(reinterpret_cast<const float *>(store.get_vector(300).data())[0], 7.0f);
+    }
+    {
+        // the file is not changed by the writes to the mapped store
+        zircon::MemVectorStore store;
+        REQUIRE(store.load_snapshot(path).ok());
+        CHECK_EQ(store.current_index(), 300u);
+        CHECK_EQ(reinterpret_cast<const float *>(store.get_vector(300 - 1).data())[0], 299.0f);
+    }
+    std::filesystem::resize_file(path, 100);
+    zircon::MemVectorStore broken;
+    CHECK_FALSE(broken.load_snapshot(path).ok());
+    std::filesystem::remove(path);
+}
+
+TEST_CASE("mem vector store version 1 snapshot") {
+    // the version 1 header, no norms_offset and flags, padded to 128 bytes
+    struct HeaderV1 {
+        uint64_t magic;
+        uint32_t version;
+        uint32_t encoding;
+        uint32_t dimension;
+        uint32_t vector_byte_size;
+        uint32_t batch_size;
+        uint32_t enable_replace_vacant;
+        uint64_t max_elements;
+        uint64_t current_index;
+        uint64_t deleted_size;
+        uint64_t nbatches;
+        uint64_t batch_stride;
+        uint64_t quantizer_offset;
+        uint64_t labels_offset;
+        uint64_t tombstones_offset;
+        uint64_t batches_offset;
+        uint64_t file_size;
+    };
+    constexpr std::size_t kHeaderSize = 128;
+    static_assert(sizeof(HeaderV1) <= kHeaderSize);
+    auto path = (std::filesystem::temp_directory_path() / "zircon_store_v1_snapshot_test.snap").string();
+    auto write_v1 = [&](std::size_t n) {
+        const std::size_t batch_size = 64;
+        const std::size_t stride = batch_size * kDim * sizeof(float);
+        HeaderV1 header{};
+        header.magic = 0x50414e534e43525aULL;
+        header.version = 1;
+        header.encoding = static_cast<uint32_t>(zircon::EncodingType::ENCODING_NONE);
+        header.dimension = kDim;
+        header.vector_byte_size = kDim * sizeof(float);
+        header.batch_size = batch_size;
+        header.enable_replace_vacant = 1;
+        header.max_elements = 1000;
+        header.current_index = n;
+        header.nbatches = (n + batch_size - 1) / batch_size;
+        header.batch_stride = stride;
+        // the labels, then the tombstone words, then the batches, each padded to 64 bytes
+        header.labels_offset = kHeaderSize;
+        header.tombstones_offset = header.labels_offset + (n * sizeof(uint64_t) + 63) / 64 * 64;
+        header.batches_offset = header.tombstones_offset + ((n + 63) / 64 * sizeof(uint64_t) + 63) / 64 * 64;
+        header.file_size = header.batches_offset + header.nbatches * stride;
+        std::vector<char> file(header.file_size, 0);
+        // the padding of the header is not read by a version 1 reader, where a version 2 header has its flags
+        std::memset(file.data(), 0xff, kHeaderSize);
+        std::memcpy(file.data(), &header, sizeof(header));
+        for (std::size_t i = 0; i < n; ++i) {
+            // the first label is odd, the first section must not be read as flags either
+            const uint64_t label = 3 + i;
+            std::memcpy(file.data() + header.labels_offset + i * sizeof(uint64_t), &label, sizeof(label));
+            for (std::size_t d = 0; d < kDim; ++d) {
+                const float x = 2.0f + static_cast<float>(i);
+                std::memcpy(file.data() + header.batches_offset + (i * kDim + d) * sizeof(float), &x, sizeof(x));
+            }
+        }
+        std::FILE *f = std::fopen(path.c_str(), "wb");
+        REQUIRE(f != nullptr);
+        REQUIRE_EQ(std::fwrite(file.data(), 1, file.size(), f), file.size());
+        std::fclose(f);
+    };
+    write_v1(10);
+    {
+        zircon::MemVectorStore store;
+        REQUIRE(store.load_snapshot(path).ok());
+        CHECK_EQ(store.current_index(), 10u);
+        CHECK_FALSE(store.keeps_norms());
+        CHECK_FALSE(store.is_normalized());
+        CHECK_EQ(store.get_location(3).value(), 0u);
+        CHECK_EQ(reinterpret_cast<const float *>(store.get_vector(9).data())[kDim - 1], 11.0f);
+        // the writes are not rescaled
+        std::vector<float> v(kDim, 2.0f);
+        auto loc = store.add_vector(100, as_bytes(v));
+        REQUIRE(loc.ok());
+        CHECK_EQ(reinterpret_cast<const float *>(store.get_vector(loc.value()).data())[0], 2.0f);
+    }
+    // an empty store is the header only, smaller than a version 2 header
+    write_v1(0);
+    {
+        zircon::MemVectorStore store;
+        REQUIRE(store.load_snapshot(path).ok());
+        CHECK_EQ(store.size(), 0u);
+    }
+    std::filesystem::remove(path);
+}
+
+TEST_CASE("mem vector store sq8 snapshot") {
+    auto path = (std::filesystem::temp_directory_path() / "zircon_store_sq8_snapshot_test.snap").string();
+    auto op = make_option(128);
+    op.encoding = zircon::EncodingType::ENCODING_SQ8;
+    std::vector<float> data(100 * kDim);
+    for (std::size_t i = 0; i < data.size(); ++i) {
+        data[i] = static_cast<float>(i % 97) / 97.0f;
+    }
+    std::vector<float> expect(kDim);
+    {
+        zircon::MemVectorStore store;
+        REQUIRE(store.initialize(op).ok());
+        REQUIRE(store.train_quantizer(turbo::Span<float>{data}).ok());
+        std::vector<zircon::label_type> labels(100);
+        for (std::size_t i = 0; i < labels.size(); ++i) {
+            labels[i] = i;
+        }
+        REQUIRE(store.add_vectors(turbo::Span<zircon::label_type>{labels}, as_bytes(data)).ok());
+        store.decode_vector(42, turbo::Span<float>{expect});
+        REQUIRE(store.save_snapshot(path).ok());
+    }
+    zircon::MemVectorStore store;
+    REQUIRE(store.load_snapshot(path).ok());
+    CHECK(store.is_encoded());
+    CHECK(store.quantizer().is_trained());
+    std::vector<float> got(kDim);
+    store.decode_vector(42, turbo::Span<float>{got});
+    CHECK(got == expect);
+    std::filesystem::remove(path);
+}
+
+TEST_CASE("mem vector store keep norms") {
+    auto path = (std::filesystem::temp_directory_path() / "zircon_store_norms_test.snap").string();
+    auto op = make_option(1000);
+    op.keep_norms = true;
+    zircon::MemVectorStore store;
+    REQUIRE(store.initialize(op).ok());
+    CHECK(store.keeps_norms());
+    // the norm of vector i is i + 1, a bulk add crossing batches then single adds
+    std::vector<zircon::label_type> labels(150);
+    std::vector<float> data(labels.size() * kDim);
+    for (std::size_t i = 0; i < labels.size(); ++i) {
+        labels[i] = i;
+        data[i * kDim + i % kDim] = static_cast<float>(i + 1);
+    }
+    REQUIRE(store.add_vectors(turbo::Span<zircon::label_type>{labels}, as_bytes(data)).ok());
+    std::vector<float> v(kDim, 0.0f);
+    v[0] = 3.0f;
+    v[1] = 4.0f;
+    REQUIRE(store.add_vector(500, as_bytes(v)).ok());
+    for (std::size_t i = 0; i < labels.size(); ++i) {
+        CHECK(store.get_norm(i) == doctest::Approx(static_cast<float>(i + 1)));
+    }
+    CHECK(store.get_norm(150) == doctest::Approx(5.0f));
+    CHECK(store.batch_norms(1)[0] == doctest::Approx(65.0f));
+    v[1] = 0.0f;
+    store.set_vector(150, as_bytes(v));
+    CHECK(store.get_norm(150) == doctest::Approx(3.0f));
+
+    // the norms follow the vectors moved by a compaction and are saved in the snapshot
+    for (zircon::label_type l = 0; l < 100; ++l) {
+        REQUIRE(store.remove_vector(l).ok());
+    }
+    REQUIRE(store.compact().ok());
+    for (zircon::location_t i = 0; i < store.current_index(); ++i) {
+        auto label = store.get_label(i).value();
+        CHECK(store.get_norm(i) == doctest::Approx(label == 500 ? 3.0f : static_cast<float>(label + 1)));
+    }
+    REQUIRE(store.save_snapshot(path).ok());
+    for (bool zero_copy : {true, false}) {
+        zircon::MemVectorStore loaded;
+        REQUIRE(loaded.load_snapshot(path, zero_copy).ok());
+        CHECK(loaded.keeps_norms());
+        CHECK_EQ(loaded.current_index(), store.current_index());
+        for (zircon::location_t i = 0; i < loaded.current_index(); ++i) {
+            CHECK_EQ(loaded.get_norm(i), store.get_norm(i));
+        }
+    }
+    std::filesystem::remove(path);
+
+    // norms need the floats of a dimension
+    auto bad = make_option(100);
+    bad.keep_norms = true;
+    bad.dimension = 0;
+    zircon::MemVectorStore no_dim;
+    CHECK_FALSE(no_dim.initialize(bad).ok());
+    bad = make_option(100);
+    bad.normalize = true;
+    bad.encoding = zircon::EncodingType::ENCODING_SQ8;
+    zircon::MemVectorStore encoded;
+    CHECK_FALSE(encoded.initialize(bad).ok());
+}
+
+TEST_CASE("mem vector store normalize") {
+    auto op = make_option(200);
+    op.normalize = true;
+    op.keep_norms = true;
+    zircon::MemVectorStore store;
+    REQUIRE(store.initialize(op).ok());
+    std::vector<float> v(kDim, 2.0f);
+    REQUIRE(store.add_vector(1, as_bytes(v)).ok());
+    std::vector<float> zero(kDim, 0.0f);
+    REQUIRE(store.add_vector(2, as_bytes(zero)).ok());
+    std::vector<zircon::label_type> labels = {3, 4};
+    std::vector<float> data(2 * kDim, -0.5f);
+    REQUIRE(store.add_vectors(turbo::Span<zircon::label_type>{labels}, as_bytes(data)).ok());
+    // the input is not changed, the stored vectors are unit length
+    CHECK_EQ(v[0], 2.0f);
+    CHECK_EQ(data[0], -0.5f);
+    const float unit = 1.0f / std::sqrt(static_cast<float>(kDim));
+    for (zircon::location_t i : {0u, 2u, 3u}) {
+        const auto *x = reinterpret_cast<const float *>(store.get_vector(i).data());
+        CHECK(std::abs(x[kDim - 1]) == doctest::Approx(unit));
+        CHECK(store.get_norm(i) == doctest::Approx(1.0f));
+    }
+    // a zero vector is kept as is
+    CHECK_EQ(reinterpret_cast<const float *>(store.get_vector(1).data())[0], 0.0f);
+    CHECK_EQ(store.get_norm(1), 0.0f);
+}
+
+TEST_CASE("mem vector store batches keep their address") {
+    zircon::MemVectorStore store;
+    REQUIRE(store.initialize(make_option(64)).ok());
+    std::vector<float> v(kDim);
+    v[0] = 1.0f;
+    REQUIRE(store.add_vector(0, as_bytes(v)).ok());
+    const auto *first = store.get_vector(0).data();
+    for (uint32_t max_elements = 128; max_elements <= 8192; max_elements *= 2) {
+        store.reset_max_elements(max_elements);
+        for (auto l = static_cast<zircon::label_type>(store.current_index()); l < max_elements; ++l) {
+            REQUIRE(store.add_vector(l, as_bytes(v)).ok());
+        }
+    }
+    CHECK_EQ(store.get_vector(0).data(), first);
+    CHECK_EQ(&store.vector_batch()[0], &store.vector_batch()[0]);
+    CHECK_EQ(store.vector_batch().size(), 8192u / 64);
+    CHECK_EQ(store.current_index(), 8192u);
+}
+
+TEST_CASE("mem vector store compact") {
+    zircon::MemVectorStore store;
+    REQUIRE(store.initialize(make_option(1000)).ok());
+    std::vector<float> v(kDim);
+    for (zircon::label_type l = 0; l < 600; ++l) {
+        v[0] = static_cast<float>(l);
+        REQUIRE(store.add_vector(l, as_bytes(v)).ok());
+    }
+    // every other vector and a whole tail
+    for (zircon::label_type l = 0; l < 600; ++l) {
+        if (l % 2 == 0 || l >= 550) {
+            REQUIRE(store.remove_vector(l).ok());
+        }
+    }
+    std::vector<std::pair<zircon::location_t, zircon::location_t>> remap;
+    std::size_t moves = 0;
+    zircon::CompactOption op;
+    op.moves_per_step = 7;
+    op.on_move = [&](zircon::location_t from, zircon::location_t to) {
+        CHECK_GT(from, to);
+        ++moves;
+    };
+    auto rs = store.compact(op, &remap);
+    REQUIRE(rs.ok());
+    CHECK(rs.value().complete);
+    CHECK_EQ(rs.value().moved, remap.size());
+    CHECK_EQ(moves, remap.size());
+    CHECK_EQ(store.size(), 275u);
+    CHECK_EQ(store.current_index(), 275u);
+    CHECK_EQ(store.deleted_size(), 0u);
+    // 5 of the 16 batches are left
+    CHECK_EQ(rs.value().released_batches, 11u);
+    CHECK_EQ(store.capacity(), 320u);
+    for (zircon::location_t i = 0; i < store.current_index(); ++i) {
+        CHECK_FALSE(store.is_deleted(i));
+        auto label = store.get_label(i).value();
+        CHECK_EQ(label % 2, 1u);
+        CHECK_EQ(store.get_location(label).value(), i);
+        CHECK_EQ(reinterpret_cast<const float *>(store.get_vector(i).data())[0], static_cast<float>(label));
+    }
+    CHECK_FALSE(store.exists_label(0));
+
+    // the released batches are given memory again, the retired locations are reused
+    for (zircon::label_type l = 1000; l < 1400; ++l) {
+        v[0] = static_cast<float>(l);
+        auto add = store.add_vector(l, as_bytes(v));
+        REQUIRE(add.ok());
+        CHECK_FALSE(store.is_deleted(add.value()));
+    }
+    CHECK_EQ(store.size(), 675u);
+    CHECK_EQ(reinterpret_cast<const float *>(store.get_vector(store.get_location(1399).value()).data())[0], 1399.0f);
+}
+
+TEST_CASE("mem vector store background compaction") {
+    zircon::MemVectorStore store;
+    REQUIRE(store.initialize(make_option(4096)).ok());
+    std::vector<float> v(kDim);
+    for (zircon::label_type l = 0; l < 2048; ++l) {
+        v[0] = static_cast<float>(l);
+        REQUIRE(store.add_vector(l, as_bytes(v)).ok());
+    }
+    for (zircon::label_type l = 5000; l < 5500; ++l) {
+        v[0] = static_cast<float>(l);
+        REQUIRE(store.add_vector(l, as_bytes(v)).ok());
+    }
+    store.disable_vacant();
+    zircon::CompactOption op;
+    op.moves_per_step = 16;
+    op.interval_ms = 1;
+    op.min_deleted_ratio = 0.01;
+    REQUIRE(store.start_compaction(op).ok());
+    CHECK_FALSE(store.start_compaction(op).ok());
+    std::atomic<bool> stop{false};
+    std::atomic<std::size_t> bad{0};
+    std::thread reader([&]() {
+        while (!stop.load()) {
+            zircon::UpdateSharedLockGuard guard(&store);
+            auto n = store.current_index();
+            for (zircon::location_t i = 0; i < n; ++i) {
+                auto label = store.get_label(i).value();
+                if (label == zircon::constants::kUnknownLabel) {
+                    continue;
+                }
+                auto value = reinterpret_cast<const float *>(store.get_vector(i).data())[0];
+                if (value != static_cast<float>(label)) {
+                    ++bad;
+                }
+            }
+        }
+    });
+    // the retired locations are not reused while the reader runs, a reused
+    // location may be seen with the label of its previous vector.
+    for (zircon::label_type l = 0; l < 2048; l += 3) {
+        CHECK(store.remove_vector(l).ok());
+    }
+    for (int i = 0; i < 1000 && store.deleted_size() != 0; ++i) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(2));
+    }
+    store.stop_compaction();
+    stop = true;
+    reader.join();
+    CHECK_EQ(bad.load(), 0u);
+    CHECK_EQ(store.deleted_size(), 0u);
+    CHECK_EQ(store.current_index(), store.size());
+    for (zircon::label_type l = 5000; l < 5500; ++l) {
+        auto loc = store.get_location(l);
+        REQUIRE(loc.ok());
+        CHECK_EQ(reinterpret_cast<const float *>(store.get_vector(loc.value()).data())[0], static_cast<float>(l));
+    }
+}
+
+TEST_CASE("mem vector store batched label lookup") {
+    zircon::MemVectorStore store;
+    REQUIRE(store.initialize(make_option(1000)).ok());
+    std::vector<float> v(kDim);
+    for (zircon::label_type l = 0; l < 500; ++l) {
+        REQUIRE(store.add_vector(l * 7, as_bytes(v)).ok());
+    }
+    REQUIRE(store.remove_vector(14).ok());
+    std::vector<zircon::label_type> labels = {0, 7, 14, 15, 3493, 700, 100000};
+    std::vector<zircon::location_t> out(labels.size());
+    auto found = store.get_locations(turbo::Span<const zircon::label_type>{labels.data(), labels.size()},
+                                     turbo::Span<zircon::location_t>{out});
+    CHECK_EQ(found, 4u);
+    CHECK_EQ(out[0], 0u);
+    CHECK_EQ(out[1], 1u);
+    CHECK_EQ(out[2], zircon::constants::kUnknownLocation);
+    CHECK_EQ(out[3], zircon::constants::kUnknownLocation);
+    CHECK_EQ(out[4], 499u);
+    CHECK_EQ(out[5], 100u);
+    CHECK_EQ(out[6], zircon::constants::kUnknownLocation);
+}
+
+TEST_CASE("mem vector store concurrent upserts") {
+    zircon::MemVectorStore store;
+    REQUIRE(store.initialize(make_option(20000)).ok());
+    constexpr int kThreads = 4;
+    constexpr zircon::label_type kPerThread = 2000;
+    std::vector<std::thread> writers;
+    for (int t = 0; t < kThreads; ++t) {
+        writers.emplace_back([&store, t]() {
+            std::vector<float> v(kDim);
+            const zircon::label_type base = t * kPerThread;
+            for (zircon::label_type l = base; l < base + kPerThread; ++l) {
+                v[0] = static_cast<float>(l);
+                CHECK(store.add_vector(l, as_bytes(v)).ok());
+                if (l % 4 == 0) {
+                    // remove and put it back, like an update
+                    CHECK(store.remove_vector(l).ok());
+                    CHECK(store.add_vector(l, as_bytes(v)).ok());
+                }
+                CHECK(store.exists_label(l));
+            }
+        });
+    }
+    for (auto &w : writers) {
+        w.join();
+    }
+    CHECK_EQ(store.size(), kThreads * kPerThread);
+    for (zircon::label_type l = 0; l < kThreads * kPerThread; ++l) {
+        auto loc = store.get_location(l);
+        REQUIRE(loc.ok());
+        CHECK_EQ(store.get_label(loc.value()).value(), l);
+        CHECK_EQ(reinterpret_cast<const float *>(store.get_vector(loc.value()).data())[0], static_cast<float>(l));
+    }
+}
@@ -0,0 +1,119 @@
+// Copyright 2023 The Elastic-AI Authors.
+// part of Elastic AI Search
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#define DOCTEST_CONFIG_IMPLEMENT_WITH_MAIN
+#include "turbo/testing/test.h"
+#include "zircon/core/allocator.h"
+#include "zircon/core/slab_arena.h"
+#include "zircon/store/mem_vector_store.h"
+#include <cstring>
+#include <vector>
+
+namespace {
+    constexpr std::size_t kDim = 16;
+
+    turbo::Span<uint8_t> as_bytes(std::vector<float> &v) {
+        return turbo::Span<uint8_t>{reinterpret_cast<uint8_t *>(v.data()), v.size() * sizeof(float)};
+    }
+}  // namespace
+
+TEST_CASE("slab arena reuse freed blocks") {
+    zircon::SlabArena arena;
+    zircon::ArenaOption op;
+    op.region_bytes = 2u << 20;
+    op.huge_page = zircon::HugePageMode::HUGE_PAGE_NONE;
+    arena.set_option(op);
+
+    auto *a = arena.allocate(100);
+    auto *b = arena.allocate(10000, 0);
+    REQUIRE(a != nullptr);
+    REQUIRE(b != nullptr);
+    CHECK_EQ(reinterpret_cast<uintptr_t>(a) % 64, 0u);
+    CHECK_EQ(reinterpret_cast<uintptr_t>(b) % 4096, 0u);
+    std::memset(a, 1, 100);
+    std::memset(b, 2, 10000);
+    CHECK(arena.owns(a));
+    CHECK(arena.owns(b + 9999));
+    int x = 0;
+    CHECK_FALSE(arena.owns(reinterpret_cast<uint8_t *>(&x)));
+
+    auto st = arena.stats();
+    CHECK_EQ(st.regions, 1u);
+    CHECK_EQ(st.used_bytes, 128u + 12288u);
+
+    arena.deallocate(b, 10000);
+    CHECK_EQ(arena.stats().used_bytes, 128u);
+    // same block size, same node
+    CHECK_EQ(arena.allocate(12000, 0), b);
+
+    // larger than a region get a dedicated one
+    auto *c = arena.allocate(3u << 20, 0);
+    REQUIRE(c != nullptr);
+    std::memset(c, 3, 3u << 20);
+    st = arena.stats();
+    CHECK_EQ(st.regions, 2u);
+    CHECK_EQ(st.reserved_bytes, (2u << 20) + (4u << 20));
+    arena.deallocate(a, 100);
+    arena.deallocate(b, 12000);
+    arena.deallocate(c, 3u << 20);
+    CHECK_EQ(arena.stats().used_bytes, 0u);
+}
+
+TEST_CASE("slab arena huge pages fall back") {
+    // no huge page may be reserved, the arena fall back to thp
+    zircon::SlabArena arena;
+    zircon::ArenaOption op;
+    op.region_bytes = 4u << 20;
+    op.huge_page = zircon::HugePageMode::HUGE_PAGE_HUGETLB;
+    arena.set_option(op);
+    auto *p = arena.allocate(1u << 20);
+    REQUIRE(p != nullptr);
+    std::memset(p, 0, 1u << 20);
+    auto st = arena.stats();
+    CHECK_EQ(st.regions, 1u);
+    CHECK_LE(st.huge_tlb_regions, 1u);
+    CHECK(zircon::SlabArena::num_nodes() >= 1);
+    CHECK(zircon::SlabArena::current_node() >= 0);
+    arena.deallocate(p, 1u << 20);
+}
+
+TEST_CASE("mem vector store on the arena") {
+    auto &alloc = zircon::Allocator::get_instance();
+    zircon::ArenaOption aop;
+    aop.region_bytes = 2u << 20;
+    alloc.enable_arena(aop);
+    {
+        zircon::MemVectorStore store;
+        zircon::VectorStoreOption op;
+        op.batch_size = 64;
+        op.max_elements = 1000;
+        op.vector_byte_size = kDim * sizeof(float);
+        op.dimension = kDim;
+        op.numa_node = 0;
+        REQUIRE(store.initialize(op).ok());
+        std::vector<float> v(kDim);
+        for (zircon::label_type l = 0; l < 500; ++l) {
+            v[0] = static_cast<float>(l);
+            REQUIRE(store.add_vector(l, as_bytes(v)).ok());
+        }
+        CHECK(alloc.arena().owns(store.get_vector(0).data()));
+        CHECK(alloc.arena().owns(store.get_vector(499).data()));
+        CHECK_EQ(reinterpret_cast<const float *>(store.get_vector(321).data())[0], 321.0f);
+        CHECK_GT(alloc.arena().stats().used_bytes, 0u);
+    }
+    CHECK_EQ(alloc.arena().stats().used_bytes, 0u);
+    alloc.disable_arena();
+    CHECK_FALSE(alloc.is_arena_enabled());
+}
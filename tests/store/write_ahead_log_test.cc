@@ -0,0 +1,340 @@
+// Copyright 2023 The Elastic-AI Authors.
+// part of Elastic AI Search
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#define DOCTEST_CONFIG_IMPLEMENT_WITH_MAIN
+#include "turbo/testing/test.h"
+#include "zircon/store/durable_vector_store.h"
+#include "zircon/store/write_ahead_log.h"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <filesystem>
+#include <thread>
+#include <vector>
+
+namespace {
+    constexpr std::size_t kDim = 8;
+
+    std::string fresh_dir(const char *name) {
+        auto dir = std::filesystem::temp_directory_path() / name;
+        std::filesystem::remove_all(dir);
+        return dir.string();
+    }
+
+    std::vector<float> make_vector(float x) {
+        std::vector<float> v(kDim, x);
+        v[kDim - 1] = -x;
+        return v;
+    }
+
+    turbo::Span<uint8_t> as_bytes(std::vector<float> &v) {
+        return turbo::Span<uint8_t>{reinterpret_cast<uint8_t *>(v.data()), v.size() * sizeof(float)};
+    }
+
+    turbo::Span<const uint8_t> as_const_bytes(const std::vector<float> &v) {
+        return turbo::Span<const uint8_t>{reinterpret_cast<const uint8_t *>(v.data()), v.size() * sizeof(float)};
+    }
+
+    std::vector<zircon::WalRecord> replay_all(const zircon::WriteAheadLog &log, uint64_t after,
+                                              std::vector<float> &first_values) {
+        std::vector<zircon::WalRecord> records;
+        first_values.clear();
+        auto rs = log.replay(after, [&](const zircon::WalRecord &r) {
+            records.push_back(r);
+            first_values.push_back(r.payload.empty() ? 0.0f : reinterpret_cast<const float *>(r.payload.data())[0]);
+            return turbo::ok_status();
+        });
+        REQUIRE(rs.ok());
+        return records;
+    }
+
+    zircon::VectorStoreOption store_option() {
+        zircon::VectorStoreOption op;
+        op.batch_size = 32;
+        op.max_elements = 1000;
+        op.vector_byte_size = kDim * sizeof(float);
+        op.dimension = kDim;
+        return op;
+    }
+}  // namespace
+
+TEST_CASE("write ahead log append replay and reopen") {
+    auto dir = fresh_dir("zircon_wal_reopen_test");
+    {
+        zircon::WriteAheadLog log;
+        REQUIRE(log.open(dir).ok());
+        for (std::size_t i = 0; i < 100; ++i) {
+            auto v = make_vector(static_cast<float>(i));
+            auto op = i % 10 == 9 ? zircon::WalOp::WAL_REMOVE : zircon::WalOp::WAL_ADD;
+            auto r = log.append(op, i, op == zircon::WalOp::WAL_REMOVE ? turbo::Span<const uint8_t>()
+                                                                       : as_const_bytes(v));
+            REQUIRE(r.ok());
+            CHECK_EQ(r.value(), i + 1);
+        }
+        CHECK_EQ(log.durable_lsn(), 0u);
+        REQUIRE(log.sync(50).ok());
+        CHECK_EQ(log.durable_lsn(), 100u);
+    }
+    zircon::WriteAheadLog log;
+    REQUIRE(log.open(dir).ok());
+    CHECK_EQ(log.last_lsn(), 100u);
+    std::vector<float> values;
+    auto records = replay_all(log, 0, values);
+    REQUIRE_EQ(records.size(), 100u);
+    for (std::size_t i = 0; i < records.size(); ++i) {
+        CHECK_EQ(records[i].lsn, i + 1);
+        CHECK_EQ(records[i].label, i);
+        if (i % 10 == 9) {
+            CHECK_EQ(records[i].op, zircon::WalOp::WAL_REMOVE);
+            CHECK(records[i].payload.empty());
+        } else {
+            CHECK_EQ(records[i].op, zircon::WalOp::WAL_ADD);
+            CHECK_EQ(records[i].payload.size(), kDim * sizeof(float));
+            CHECK_EQ(values[i], static_cast<float>(i));
+        }
+    }
+    CHECK_EQ(replay_all(log, 60, values).size(), 40u);
+    // the records go on after the last one
+    auto v = make_vector(7.0f);
+    CHECK_EQ(log.append(zircon::WalOp::WAL_SET, 7, as_const_bytes(v)).value(), 101u);
+    REQUIRE(log.close().ok());
+    std::filesystem::remove_all(dir);
+}
+
+TEST_CASE("write ahead log torn tail") {
+    auto dir = fresh_dir("zircon_wal_torn_test");
+    std::string segment;
+    {
+        zircon::WriteAheadLog log;
+        REQUIRE(log.open(dir).ok());
+        for (std::size_t i = 0; i < 10; ++i) {
+            auto v = make_vector(static_cast<float>(i));
+            REQUIRE(log.append(zircon::WalOp::WAL_ADD, i, as_const_bytes(v)).ok());
+        }
+        REQUIRE(log.close().ok());
+        segment = log.segments().back().second;
+    }
+    // half of the last record reached the disk
+    auto size = std::filesystem::file_size(segment);
+    std::filesystem::resize_file(segment, size - 10);
+    {
+        zircon::WriteAheadLog log;
+        REQUIRE(log.open(dir).ok());
+        CHECK_EQ(log.last_lsn(), 9u);
+        std::vector<float> values;
+        CHECK_EQ(replay_all(log, 0, values).size(), 9u);
+        auto v = make_vector(100.0f);
+        CHECK_EQ(log.append(zircon::WalOp::WAL_ADD, 100, as_const_bytes(v)).value(), 10u);
+        REQUIRE(log.close().ok());
+    }
+    zircon::WriteAheadLog log;
+    REQUIRE(log.open(dir).ok());
+    std::vector<float> values;
+    auto records = replay_all(log, 0, values);
+    REQUIRE_EQ(records.size(), 10u);
+    CHECK_EQ(records.back().label, 100u);
+    CHECK_EQ(values.back(), 100.0f);
+    std::filesystem::remove_all(dir);
+}
+
+TEST_CASE("write ahead log segments and purge") {
+    auto dir = fresh_dir("zircon_wal_segments_test");
+    zircon::WalOption op;
+    op.segment_bytes = 1024;
+    op.fsync = false;
+    {
+        zircon::WriteAheadLog log;
+        REQUIRE(log.open(dir, op).ok());
+        for (std::size_t i = 0; i < 200; ++i) {
+            auto v = make_vector(static_cast<float>(i));
+            auto r = log.append(zircon::WalOp::WAL_ADD, i, as_const_bytes(v));
+            REQUIRE(r.ok());
+            REQUIRE(log.sync(r.value()).ok());
+        }
+        auto segments = log.segments();
+        REQUIRE(segments.size() > 5);
+        for (std::size_t i = 1; i < segments.size(); ++i) {
+            CHECK_GT(segments[i].first, segments[i - 1].first);
+        }
+        // a checkpoint up to 100 makes the segments before it useless
+        REQUIRE(log.purge(100).ok());
+        auto kept = log.segments();
+        CHECK_LT(kept.size(), segments.size());
+        CHECK_LE(kept.front().first, 101u);
+        std::vector<float> values;
+        auto records = replay_all(log, 100, values);
+        REQUIRE_EQ(records.size(), 100u);
+        CHECK_EQ(records.front().lsn, 101u);
+        REQUIRE(log.close().ok());
+    }
+    zircon::WriteAheadLog log;
+    REQUIRE(log.open(dir, op).ok());
+    CHECK_EQ(log.last_lsn(), 200u);
+    std::vector<float> values;
+    CHECK_EQ(replay_all(log, 150, values).size(), 50u);
+    REQUIRE(log.close().ok());
+    // a snapshot newer than every record, the log continue from it
+    zircon::WriteAheadLog newer;
+    REQUIRE(newer.open(dir, op, 500).ok());
+    CHECK_EQ(newer.last_lsn(), 500u);
+    CHECK_EQ(newer.segments().size(), 1u);
+    std::filesystem::remove_all(dir);
+}
+
+TEST_CASE("write ahead log group commit") {
+    auto dir = fresh_dir("zircon_wal_group_test");
+    zircon::WriteAheadLog log;
+    REQUIRE(log.open(dir).ok());
+    constexpr std::size_t kThreads = 8;
+    constexpr std::size_t kPerThread = 100;
+    std::atomic<std::size_t> failed{0};
+    std::vector<std::thread> threads;
+    for (std::size_t t = 0; t < kThreads; ++t) {
+        threads.emplace_back([&, t]() {
+            for (std::size_t i = 0; i < kPerThread; ++i) {
+                auto v = make_vector(static_cast<float>(t));
+                auto r = log.append(zircon::WalOp::WAL_ADD, t * kPerThread + i, as_const_bytes(v));
+                if (!r.ok() || !log.sync(r.value()).ok() || log.durable_lsn() < r.value()) {
+                    ++failed;
+                }
+            }
+        });
+    }
+    for (auto &t: threads) {
+        t.join();
+    }
+    CHECK_EQ(failed.load(), 0u);
+    CHECK_EQ(log.durable_lsn(), kThreads * kPerThread);
+    std::vector<float> values;
+    auto records = replay_all(log, 0, values);
+    REQUIRE_EQ(records.size(), kThreads * kPerThread);
+    std::vector<bool> seen(kThreads * kPerThread, false);
+    for (auto &r: records) {
+        CHECK_EQ(values[&r - records.data()], static_cast<float>(r.label / kPerThread));
+        seen[r.label] = true;
+    }
+    CHECK(std::all_of(seen.begin(), seen.end(), [](bool b) { return b; }));
+    std::filesystem::remove_all(dir);
+}
+
+TEST_CASE("durable vector store recovery") {
+    auto dir = fresh_dir("zircon_durable_store_test");
+    zircon::DurableOption op;
+    op.checkpoint_bytes = 0;
+    auto check_state = [](const zircon::MemVectorStore &store) {
+        // labels 0..199, every third removed, the even ones set to -label
+        CHECK_EQ(store.size(), 200u - 67u);
+        for (zircon::label_type l = 0; l < 200; ++l) {
+            auto loc = store.get_location(l);
+            REQUIRE_EQ(loc.ok(), l % 3 != 0);
+            if (!loc.ok()) {
+                continue;
+            }
+            auto x = reinterpret_cast<const float *>(store.get_vector(loc.value()).data())[0];
+            CHECK_EQ(x, l % 2 == 0 ? -static_cast<float>(l) : static_cast<float>(l));
+        }
+    };
+    {
+        zircon::DurableVectorStore store;
+        REQUIRE(store.open(dir, store_option(), op).ok());
+        for (zircon::label_type l = 0; l < 100; ++l) {
+            auto v = make_vector(static_cast<float>(l));
+            REQUIRE(store.add_vector(l, as_bytes(v)).ok());
+        }
+        // the first half goes into a snapshot, the rest only in the log
+        auto cp = store.checkpoint();
+        REQUIRE(cp.ok());
+        CHECK_EQ(cp.value(), 100u);
+        CHECK_EQ(store.checkpoint_lsn(), 100u);
+        for (zircon::label_type l = 100; l < 200; ++l) {
+            auto v = make_vector(static_cast<float>(l));
+            REQUIRE(store.add_vector(l, as_bytes(v)).ok());
+        }
+        for (zircon::label_type l = 0; l < 200; ++l) {
+            if (l % 3 == 0) {
+                REQUIRE(store.remove_vector(l).ok());
+            } else if (l % 2 == 0) {
+                auto v = make_vector(-static_cast<float>(l));
+                REQUIRE(store.set_vector(l, as_bytes(v)).ok());
+            }
+        }
+        // failed mutations are not logged
+        auto v = make_vector(1.0f);
+        CHECK_FALSE(store.add_vector(1, as_bytes(v)).ok());
+        CHECK_FALSE(store.remove_vector(0).ok());
+        CHECK_FALSE(store.set_vector(3, as_bytes(v)).ok());
+        std::vector<float> bad(kDim + 1);
+        CHECK_FALSE(store.add_vector(1000, as_bytes(bad)).ok());
+        check_state(store.store());
+        // no close, the acknowledged mutations are in the log already
+    }
+    {
+        zircon::DurableVectorStore store;
+        REQUIRE(store.open(dir, store_option(), op).ok());
+        CHECK_EQ(store.checkpoint_lsn(), 100u);
+        check_state(store.store());
+        // a second checkpoint replaces the snapshot, the replayed records are not applied twice
+        REQUIRE(store.checkpoint().ok());
+        CHECK_EQ(store.checkpoint().value(), store.checkpoint_lsn());
+        REQUIRE(store.close().ok());
+    }
+    std::size_t snapshots = 0;
+    for (auto &entry: std::filesystem::directory_iterator(dir)) {
+        snapshots += entry.path().extension() == ".snap";
+    }
+    CHECK_EQ(snapshots, 1u);
+    zircon::DurableVectorStore store;
+    REQUIRE(store.open(dir, store_option(), op).ok());
+    check_state(store.store());
+    std::filesystem::remove_all(dir);
+}
+
+TEST_CASE("durable vector store background checkpoint") {
+    auto dir = fresh_dir("zircon_durable_background_test");
+    zircon::DurableOption op;
+    op.checkpoint_bytes = 4096;
+    op.checkpoint_interval_ms = 5;
+    op.wal.fsync = false;
+    zircon::DurableVectorStore store;
+    REQUIRE(store.open(dir, store_option(), op).ok());
+    std::atomic<std::size_t> failed{0};
+    // the writer keeps going while the snapshots are taken
+    std::thread writer([&]() {
+        for (zircon::label_type l = 0; l < 600; ++l) {
+            auto v = make_vector(static_cast<float>(l));
+            failed += store.add_vector(l, as_bytes(v)).ok() ? 0 : 1;
+        }
+    });
+    auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(10);
+    while (store.checkpoint_lsn() == 0 && std::chrono::steady_clock::now() < deadline) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    writer.join();
+    CHECK_EQ(failed.load(), 0u);
+    CHECK_GT(store.checkpoint_lsn(), 0u);
+    CHECK(store.checkpoint_status().ok());
+    const auto size = store.store().size();
+    REQUIRE(store.close().ok());
+    zircon::DurableVectorStore reopened;
+    REQUIRE(reopened.open(dir, store_option(), op).ok());
+    CHECK_EQ(reopened.store().size(), size);
+    for (zircon::label_type l = 0; l < size; ++l) {
+        auto loc = reopened.store().get_location(l);
+        REQUIRE(loc.ok());
+        CHECK_EQ(reinterpret_cast<const float *>(reopened.store().get_vector(loc.value()).data())[0],
+                 static_cast<float>(l));
+    }
+    std::filesystem::remove_all(dir);
+}
@@ -0,0 +1,134 @@
+// Copyright 2023 The Elastic-AI Authors.
+// part of Elastic AI Search
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#define DOCTEST_CONFIG_IMPLEMENT_WITH_MAIN
+#include "turbo/testing/test.h"
+#include "zircon/utility/id_filter.h"
+#include "zircon/utility/distance_dispatch.h"
+#include "turbo/random/random.h"
+#include <algorithm>
+#include <vector>
+
+namespace {
+    // the block evaluation of a filter must agree with is_member
+    void check_block(const zircon::IdFilter &filter, const std::vector<zircon::label_type> &labels) {
+        std::vector<uint64_t> mask((labels.size() + 63) / 64, ~uint64_t(0));
+        filter.filter_block(labels.data(), labels.size(), mask.data());
+        for (size_t i = 0; i < labels.size(); ++i) {
+            bool bit = (mask[i / 64] >> (i % 64)) & 1;
+            CHECK_EQ(bit, filter.is_member(labels[i]));
+        }
+    }
+}  // namespace
+
+TEST_CASE("range mask kernels") {
+    std::vector<uint64_t> values(301);
+    for (auto &v : values) {
+        v = static_cast<uint64_t>(turbo::uniform(0, 1000));
+    }
+    values[0] = 0;
+    values[1] = ~uint64_t(0);
+    for (auto *k : zircon::distance::available_distance_kernels()) {
+        for (auto [lo, hi] : {std::pair<uint64_t, uint64_t>{100, 400}, {0, 0}, {0, ~uint64_t(0)}, {999, 999}}) {
+            std::vector<uint64_t> mask((values.size() + 63) / 64, ~uint64_t(0));
+            k->range_mask(values.data(), values.size(), lo, hi, mask.data());
+            for (size_t i = 0; i < values.size(); ++i) {
+                bool bit = (mask[i / 64] >> (i % 64)) & 1;
+                CHECK_EQ(bit, values[i] >= lo && values[i] <= hi);
+            }
+        }
+    }
+}
+
+TEST_CASE("filter block") {
+    std::vector<zircon::label_type> labels(700);
+    for (auto &l : labels) {
+        l = static_cast<zircon::label_type>(turbo::uniform(0, 2000));
+    }
+    zircon::IdFilterRange range(300, 1200);
+    zircon::IdFilterRange empty(10, 5);
+    std::vector<zircon::label_type> some;
+    for (size_t i = 0; i < 2000; i += 3) {
+        some.push_back(i);
+    }
+    zircon::IdFilterBitmap bitmap(some);
+    zircon::IdFilterSet set(std::vector<zircon::label_type>(some.begin(), some.begin() + 300));
+    check_block(range, labels);
+    check_block(empty, labels);
+    check_block(bitmap, labels);
+    check_block(set, labels);
+
+    // range now composes with the others
+    zircon::IdFilterAnd both(&range, &bitmap);
+    zircon::IdFilterOr any(&range, &set);
+    zircon::IdFilterXor one(&both, &set);
+    check_block(both, labels);
+    check_block(any, labels);
+    check_block(one, labels);
+
+    // the compile time form, nested expressions hold the inner nodes by value
+    auto composed = zircon::id_filter_xor(zircon::id_filter_and(range, bitmap), set);
+    check_block(composed, labels);
+    for (auto l : labels) {
+        CHECK_EQ(composed.is_member(l), one.is_member(l));
+    }
+    const zircon::IdFilter &root = composed;
+    CHECK_EQ(root.is_member(labels[0]), one.is_member(labels[0]));
+
+    auto folded = bitmap & zircon::IdFilterBitmap(std::vector<zircon::label_type>{0, 1, 2, 3, 6});
+    CHECK(folded.is_member(0));
+    CHECK(folded.is_member(3));
+    CHECK(folded.is_member(6));
+    CHECK_FALSE(folded.is_member(1));
+    auto merged = folded | zircon::IdFilterBitmap(std::vector<zircon::label_type>{1});
+    CHECK(merged.is_member(1));
+}
+
+TEST_CASE("id filter collect members") {
+    zircon::IdFilterSet a{1, 2, 3, 4};
+    zircon::IdFilterBitmap b{3, 4, 5};
+    std::vector<zircon::label_type> members;
+    CHECK(a.collect_members(4, members));
+    CHECK_EQ(members.size(), 4);
+    CHECK_FALSE(a.collect_members(3, members));
+
+    zircon::IdFilterAnd both(&a, &b);
+    REQUIRE(both.collect_members(10, members));
+    std::sort(members.begin(), members.end());
+    CHECK(members == std::vector<zircon::label_type>{3, 4});
+
+    zircon::IdFilterOr any(&a, &b);
+    REQUIRE(any.collect_members(10, members));
+    CHECK(members == std::vector<zircon::label_type>{1, 2, 3, 4, 5});
+    CHECK_FALSE(any.collect_members(4, members));
+
+    zircon::IdFilterXor one(&a, &b);
+    REQUIRE(one.collect_members(10, members));
+    CHECK(members == std::vector<zircon::label_type>{1, 2, 5});
+}
+
+TEST_CASE("range collect members") {
+    std::vector<zircon::label_type> members;
+    zircon::IdFilterRange range(10, 19);
+    REQUIRE(range.collect_members(10, members));
+    CHECK_EQ(members.size(), 10);
+    CHECK_EQ(members.front(), 10);
+    CHECK_EQ(members.back(), 19);
+    CHECK_FALSE(range.collect_members(9, members));
+    zircon::IdFilterSet set{12, 30};
+    auto composed = zircon::id_filter_and(range, set);
+    REQUIRE(composed.collect_members(100, members));
+    CHECK(members == std::vector<zircon::label_type>{12});
+}
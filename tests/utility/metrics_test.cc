@@ -0,0 +1,142 @@
+// Copyright 2023 The Elastic-AI Authors.
+// part of Elastic AI Search
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#define DOCTEST_CONFIG_IMPLEMENT_WITH_MAIN
+#include "turbo/testing/test.h"
+#include "zircon/utility/metrics.h"
+#include "zircon/store/mem_vector_store.h"
+#include <shared_mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+TEST_CASE("metric counter over threads") {
+    zircon::MetricCounter counter;
+    std::vector<std::thread> threads;
+    for (int t = 0; t < 8; ++t) {
+        threads.emplace_back([&]() {
+            for (int i = 0; i < 10000; ++i) {
+                counter.add();
+            }
+            counter.add(5);
+        });
+    }
+    for (auto &t : threads) {
+        t.join();
+    }
+    CHECK_EQ(counter.value(), 8u * 10005u);
+    counter.reset();
+    CHECK_EQ(counter.value(), 0u);
+}
+
+TEST_CASE("latency histogram buckets") {
+    using zircon::LatencyHistogram;
+    // every value falls in the bucket whose range holds it, the ranges are contiguous
+    uint64_t lower = 0;
+    for (std::size_t b = 0; b < LatencyHistogram::kBuckets; ++b) {
+        auto upper = LatencyHistogram::bucket_upper(b);
+        CHECK_GE(upper, lower);
+        CHECK_EQ(LatencyHistogram::bucket_of(lower), b);
+        CHECK_EQ(LatencyHistogram::bucket_of(upper), b);
+        if (upper == ~uint64_t(0)) {
+            CHECK_EQ(b, LatencyHistogram::kBuckets - 1);
+            break;
+        }
+        lower = upper + 1;
+    }
+
+    LatencyHistogram h;
+    for (uint64_t v = 1; v <= 1000; ++v) {
+        h.record(v * 1000);
+    }
+    auto s = h.snapshot();
+    CHECK_EQ(s.count, 1000u);
+    CHECK_EQ(s.sum, 500500u * 1000u);
+    // within the bucket width, a quarter of the value
+    auto p50 = s.percentile(0.5);
+    CHECK_GE(p50, 500000u);
+    CHECK_LE(p50, 500000u + 500000u / 4);
+    auto p99 = s.percentile(0.99);
+    CHECK_GE(p99, 990000u);
+    CHECK_LE(p99, 990000u + 990000u / 4);
+    CHECK_EQ(zircon::HistogramSnapshot().percentile(0.5), 0u);
+}
+
+TEST_CASE("metrics registry scrape") {
+    zircon::MetricsRegistry registry;
+    auto &c = registry.counter("test_events", "events seen");
+    CHECK_EQ(&c, &registry.counter("test_events"));
+    c.add(3);
+    auto &h = registry.histogram("test_latency_ns");
+    h.record(10);
+    h.record(1000);
+    auto text = registry.scrape();
+    CHECK_NE(text.find("# HELP test_events events seen\n"), std::string::npos);
+    CHECK_NE(text.find("# TYPE test_events counter\ntest_events 3\n"), std::string::npos);
+    CHECK_NE(text.find("# TYPE test_latency_ns histogram\n"), std::string::npos);
+    CHECK_NE(text.find("test_latency_ns_bucket{le=\"+Inf\"} 2\n"), std::string::npos);
+    CHECK_NE(text.find("test_latency_ns_sum 1010\n"), std::string::npos);
+    CHECK_NE(text.find("test_latency_ns_count 2\n"), std::string::npos);
+    auto counters = registry.counters();
+    REQUIRE_EQ(counters.size(), 1u);
+    CHECK_EQ(counters[0].second, 3u);
+    registry.reset();
+    CHECK_EQ(c.value(), 0u);
+    CHECK_EQ(registry.histograms()[0].second.count, 0u);
+}
+
+TEST_CASE("lock wait recorded when contended") {
+    zircon::LatencyHistogram wait;
+    std::shared_mutex mutex;
+    {
+        std::unique_lock<std::shared_mutex> lock(mutex, std::defer_lock);
+        zircon::lock_timed(lock, wait);
+        CHECK(lock.owns_lock());
+    }
+    CHECK_EQ(wait.snapshot().count, 0u);
+    std::unique_lock<std::shared_mutex> held(mutex);
+    std::thread t([&]() {
+        std::shared_lock<std::shared_mutex> lock(mutex, std::defer_lock);
+        zircon::lock_timed(lock, wait);
+    });
+    std::this_thread::sleep_for(std::chrono::milliseconds(20));
+    held.unlock();
+    t.join();
+    auto s = wait.snapshot();
+    CHECK_EQ(s.count, 1u);
+    CHECK_GE(s.sum, 10000000u);
+}
+
+TEST_CASE("store reports its batch allocations") {
+    auto &allocations = zircon::MetricsRegistry::global().counter("zircon_store_batch_allocations");
+    const auto before = allocations.value();
+    zircon::VectorStoreOption op;
+    op.batch_size = 64;
+    op.max_elements = 1000;
+    op.vector_byte_size = 4 * sizeof(float);
+    op.dimension = 4;
+    zircon::MemVectorStore store;
+    REQUIRE(store.initialize(op).ok());
+    std::vector<float> v(4);
+    for (zircon::label_type l = 0; l < 200; ++l) {
+        REQUIRE(store.add_vector(l, turbo::Span<uint8_t>{reinterpret_cast<uint8_t *>(v.data()),
+                                                          v.size() * sizeof(float)}).ok());
+    }
+    // 200 vectors take 4 batches of 64
+    CHECK_GE(allocations.value() - before, 4u);
+    auto text = zircon::MetricsRegistry::global().scrape();
+    CHECK_NE(text.find("zircon_store_batch_allocations"), std::string::npos);
+    CHECK_NE(text.find("zircon_store_meta_lock_wait_ns"), std::string::npos);
+}
@@ -0,0 +1,82 @@
+// Copyright 2023 The Elastic-AI Authors.
+// part of Elastic AI Search
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#define DOCTEST_CONFIG_IMPLEMENT_WITH_MAIN
+#include "turbo/testing/test.h"
+#include "zircon/utility/thread_pool.h"
+#include <atomic>
+#include <chrono>
+#include <thread>
+#include <vector>
+
+TEST_CASE("thread pool runs every task once") {
+    zircon::ThreadPool pool(4);
+    CHECK_EQ(pool.concurrency(), 4u);
+    constexpr std::size_t n = 1000;
+    std::vector<std::atomic<int>> hits(n);
+    std::vector<std::atomic<int>> busy(pool.concurrency());
+    std::atomic<int> overlap{0};
+    pool.parallel_for(n, [&](std::size_t task, std::size_t slot) {
+        CHECK_LT(slot, pool.concurrency());
+        if (busy[slot].fetch_add(1) != 0) {
+            ++overlap;
+        }
+        ++hits[task];
+        busy[slot].fetch_sub(1);
+    });
+    CHECK_EQ(overlap.load(), 0);
+    for (auto &h : hits) {
+        CHECK_EQ(h.load(), 1);
+    }
+}
+
+TEST_CASE("thread pool balances uneven tasks") {
+    zircon::ThreadPool pool(3);
+    std::atomic<std::size_t> sum{0};
+    // the first share is much slower, the others steal from it
+    pool.parallel_for(60, [&](std::size_t task, std::size_t) {
+        if (task < 20) {
+            std::this_thread::sleep_for(std::chrono::microseconds(200));
+        }
+        sum += task;
+    });
+    CHECK_EQ(sum.load(), 60u * 59 / 2);
+}
+
+TEST_CASE("thread pool nested and concurrent callers") {
+    zircon::ThreadPool pool(4);
+    std::atomic<std::size_t> total{0};
+    std::vector<std::thread> callers;
+    for (int t = 0; t < 3; ++t) {
+        callers.emplace_back([&]() {
+            pool.parallel_for(8, [&](std::size_t, std::size_t) {
+                pool.parallel_for(16, [&](std::size_t, std::size_t) { ++total; });
+            });
+        });
+    }
+    for (auto &c : callers) {
+        c.join();
+    }
+    CHECK_EQ(total.load(), 3u * 8 * 16);
+
+    // a single thread pool runs on the caller
+    zircon::ThreadPool serial(1);
+    std::size_t count = 0;
+    serial.parallel_for(10, [&](std::size_t, std::size_t slot) {
+        CHECK_EQ(slot, 0u);
+        ++count;
+    });
+    CHECK_EQ(count, 10u);
+}
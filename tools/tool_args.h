@@ -0,0 +1,88 @@
+// Copyright 2023 The Elastic-AI Authors.
+// part of Elastic AI Search
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#ifndef TOOLS_TOOL_ARGS_H_
+#define TOOLS_TOOL_ARGS_H_
+
+#include <cstdio>
+#include <cstdlib>
+#include <map>
+#include <string>
+#include "turbo/base/status.h"
+
+namespace zircon::tools {
+
+    /**
+     * @brief the key=value arguments of the command line tools and benchmarks.
+     *        every read takes its key, so the keys left once all the options
+     *        are read are unknown arguments.
+     */
+    class ToolArgs {
+    public:
+        // false if an argument is not key=value
+        bool parse(int argc, char **argv) {
+            for (int i = 1; i < argc; ++i) {
+                std::string arg = argv[i];
+                auto eq = arg.find('=');
+                if (eq == std::string::npos) {
+                    return false;
+                }
+                _args[arg.substr(0, eq)] = arg.substr(eq + 1);
+            }
+            return true;
+        }
+
+        // the value of key, out is not changed and false returned if it is not given
+        bool take(const char *key, std::string &out) {
+            auto it = _args.find(key);
+            if (it == _args.end()) {
+                return false;
+            }
+            out = it->second;
+            _args.erase(it);
+            return true;
+        }
+
+        template<typename T>
+        bool number(const char *key, T &out) {
+            std::string value;
+            if (!take(key, value)) {
+                return false;
+            }
+            out = static_cast<T>(std::strtoull(value.c_str(), nullptr, 10));
+            return true;
+        }
+
+        // true if every argument was read, else the first unknown is printed
+        [[nodiscard]] bool all_read() const {
+            if (_args.empty()) {
+                return true;
+            }
+            std::fprintf(stderr, "unknown argument %s\n", _args.begin()->first.c_str());
+            return false;
+        }
+
+    private:
+        std::map<std::string, std::string> _args;
+    };
+
+    inline void report(const turbo::Status &status) {
+        auto msg = status.message();
+        std::fprintf(stderr, "%.*s\n", static_cast<int>(msg.size()), msg.data());
+    }
+
+}  // namespace zircon::tools
+
+#endif  // TOOLS_TOOL_ARGS_H_
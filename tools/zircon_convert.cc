@@ -0,0 +1,490 @@
+// Copyright 2023 The Elastic-AI Authors.
+// part of Elastic AI Search
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+// stream a vector set from one format to another. the formats are fvecs, bin,
+// tsv and snap, the snapshot of a MemVectorStore.
+//
+//   zircon_convert input=base.fvecs output=base.bin
+//   zircon_convert input=base.tsv dim=128 output=base.snap threads=16
+//
+// the format of a file is the one of its extension unless from= or to= is
+// given. fvecs and bin inputs are read with several chunk reads in flight, the
+// outputs go through the write buffer of the writers, so the file is written
+// by large aligned writes. a snap output is built by the parallel loader, the
+// row i of the input gets the label i. a snap input gives its alive vectors in
+// location order, decoded if the store is encoded. a tsv input needs dim=, and
+// is read twice for a bin or snap output, the row count goes first.
+// the vectors are floats.
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <limits>
+#include <memory>
+#include <string>
+#include <vector>
+#include "turbo/files/sequential_read_file.h"
+#include "turbo/files/sequential_write_file.h"
+#include "zircon/datasets/async_vector_reader.h"
+#include "zircon/datasets/bin_vector_io.h"
+#include "zircon/datasets/fvec_vector_io.h"
+#include "zircon/datasets/tsv_vector_io.h"
+#include "zircon/datasets/vector_set_loader.h"
+#include "zircon/store/mem_vector_store.h"
+#include "tools/tool_args.h"
+
+namespace {
+
+    using Clock = std::chrono::steady_clock;
+
+    enum class Format {
+        FVECS,
+        BIN,
+        TSV,
+        SNAP,
+    };
+
+    struct ConvertOption {
+        std::string input;
+        std::string output;
+        std::string from;
+        std::string to;
+        // dimension of a tsv input, read from the file for the others
+        std::size_t dim{0};
+        // vectors per read of the streaming conversions
+        std::size_t chunk{4096};
+        // parse threads of a snap output, 0 for one per core
+        std::size_t threads{0};
+        // write buffer of the writers
+        std::size_t buffer{4 << 20};
+        // chunk reads in flight of fvecs and bin inputs
+        std::size_t queue_depth{4};
+    };
+
+    void usage() {
+        std::fprintf(stderr,
+                     "usage: zircon_convert input=<file> output=<file> [from=fvecs|bin|tsv|snap]\n"
+                     "       [to=fvecs|bin|tsv|snap] [dim=0] [chunk=4096] [threads=0] [buffer=4194304]\n"
+                     "       [queue_depth=4]\n");
+    }
+
+    bool parse_args(int argc, char **argv, ConvertOption &option) {
+        zircon::tools::ToolArgs args;
+        if (!args.parse(argc, argv)) {
+            return false;
+        }
+        args.take("input", option.input);
+        args.take("output", option.output);
+        args.take("from", option.from);
+        args.take("to", option.to);
+        args.number("dim", option.dim);
+        args.number("chunk", option.chunk);
+        args.number("threads", option.threads);
+        args.number("buffer", option.buffer);
+        args.number("queue_depth", option.queue_depth);
+        if (!args.all_read()) {
+            return false;
+        }
+        return !option.input.empty() && !option.output.empty() && option.chunk > 0;
+    }
+
+    // the given name, or the extension of path
+    turbo::ResultStatus<Format> parse_format(const std::string &name, const std::string &path) {
+        auto f = name;
+        if (f.empty()) {
+            f = std::filesystem::path(path).extension().string();
+            if (!f.empty()) {
+                f = f.substr(1);
+            }
+        }
+        if (f == "fvecs" || f == "fvec") {
+            return Format::FVECS;
+        }
+        if (f == "bin" || f == "fbin") {
+            return Format::BIN;
+        }
+        if (f == "tsv" || f == "txt") {
+            return Format::TSV;
+        }
+        if (f == "snap") {
+            return Format::SNAP;
+        }
+        return turbo::invalid_argument_error("unknown format of {}, give from= or to=", path);
+    }
+
+    zircon::VectorFileFormat file_format(Format f) {
+        switch (f) {
+            case Format::FVECS:
+                return zircon::VectorFileFormat::FORMAT_FVECS;
+            case Format::BIN:
+                return zircon::VectorFileFormat::FORMAT_BIN;
+            default:
+                return zircon::VectorFileFormat::FORMAT_TSV;
+        }
+    }
+
+    // the first 8 bytes, the dimension of a fvecs, the count and the dimension of a bin
+    turbo::ResultStatus<std::pair<uint32_t, uint32_t>> read_header(const std::string &path) {
+        turbo::SequentialReadFile file;
+        auto rs = file.open(path);
+        if (!rs.ok()) {
+            return rs;
+        }
+        uint32_t header[2] = {0, 0};
+        auto r = file.read(header, sizeof(header));
+        if (!r.ok()) {
+            return r.status();
+        }
+        if (r.value() < sizeof(uint32_t)) {
+            return turbo::data_loss_error("{} has no header", path);
+        }
+        return std::make_pair(header[0], header[1]);
+    }
+
+    // the rows of a tsv, the file is read once
+    turbo::ResultStatus<std::size_t> count_tsv(const std::string &path, std::size_t dim, std::size_t chunk) {
+        turbo::SequentialReadFile file;
+        auto rs = file.open(path);
+        if (!rs.ok()) {
+            return rs;
+        }
+        zircon::SerializeOption so;
+        so.dimension = dim;
+        zircon::TsvVectorSetReader reader;
+        rs = reader.initialize(&file, so);
+        if (!rs.ok()) {
+            return rs;
+        }
+        std::vector<uint8_t> buf(chunk * dim * sizeof(float));
+        while (true) {
+            turbo::Span<uint8_t> span{buf.data(), buf.size()};
+            auto n = reader.read_batch(span, chunk);
+            if (!n.ok()) {
+                return n.status();
+            }
+            if (n.value() < chunk) {
+                break;
+            }
+        }
+        return reader.has_read();
+    }
+
+    struct Source {
+        Format format;
+        std::size_t dim{0};
+        // vectors, kUnknownSize for a tsv not counted
+        std::size_t n{zircon::constants::kUnknownSize};
+    };
+
+    turbo::ResultStatus<Source> probe(const ConvertOption &option, Format in, Format out) {
+        Source src{in};
+        if (in == Format::SNAP) {
+            // loaded by the conversion itself
+            return src;
+        }
+        if (in == Format::TSV) {
+            if (option.dim == 0) {
+                return turbo::invalid_argument_error("a tsv input needs dim=");
+            }
+            src.dim = option.dim;
+            if (out == Format::BIN || out == Format::SNAP) {
+                auto n = count_tsv(option.input, src.dim, option.chunk);
+                if (!n.ok()) {
+                    return n.status();
+                }
+                src.n = n.value();
+            }
+            return src;
+        }
+        auto header = read_header(option.input);
+        if (!header.ok()) {
+            return header.status();
+        }
+        std::error_code ec;
+        auto bytes = std::filesystem::file_size(option.input, ec);
+        if (ec) {
+            return turbo::not_found_error("can not stat {}: {}", option.input, ec.message());
+        }
+        if (in == Format::FVECS) {
+            src.dim = header.value().first;
+            auto record = sizeof(uint32_t) + src.dim * sizeof(float);
+            if (src.dim == 0 || bytes % record != 0) {
+                return turbo::data_loss_error("{} is not a fvecs file", option.input);
+            }
+            src.n = bytes / record;
+        } else {
+            src.n = header.value().first;
+            src.dim = header.value().second;
+            if (src.dim == 0) {
+                return turbo::data_loss_error("{} is not a bin file", option.input);
+            }
+        }
+        return src;
+    }
+
+    // the writer of a streaming conversion, finish flushes the buffered records and closes the file
+    class Sink {
+    public:
+        turbo::Status open(const ConvertOption &option, Format out, std::size_t dim, std::size_t n) {
+            if (out == Format::BIN) {
+                if (n == zircon::constants::kUnknownSize) {
+                    return turbo::invalid_argument_error("a bin output needs the vector count");
+                }
+                _writer = std::make_unique<zircon::BinaryVectorSetWriter>();
+            } else if (out == Format::FVECS) {
+                _writer = std::make_unique<zircon::FvecVectorSetWriter>();
+            } else {
+                _writer = std::make_unique<zircon::TsvVectorSetWriter>();
+            }
+            auto rs = _file.open(option.output);
+            if (!rs.ok()) {
+                return rs;
+            }
+            _vector_bytes = dim * sizeof(float);
+            zircon::SerializeOption so;
+            so.dimension = dim;
+            so.n_vectors = n;
+            so.write_buffer_bytes = option.buffer;
+            return _writer->initialize(&_file, so);
+        }
+
+        // n vectors one after another
+        turbo::Status write(const uint8_t *data, std::size_t n) {
+            return _writer->write_batch(turbo::Span<uint8_t>{const_cast<uint8_t *>(data), n * _vector_bytes}, n);
+        }
+
+        turbo::Status finish() {
+            auto rs = _writer->flush();
+            if (!rs.ok()) {
+                return rs;
+            }
+            rs = _file.flush();
+            _file.close();
+            return rs;
+        }
+
+        [[nodiscard]] std::size_t written() const {
+            return _writer->has_write();
+        }
+
+    private:
+        turbo::SequentialWriteFile _file;
+        std::unique_ptr<zircon::VectorSetWriter> _writer;
+        std::size_t _vector_bytes{0};
+    };
+
+    // fvecs or bin, several chunk reads in flight while the previous chunk is written
+    turbo::Status stream_records(const ConvertOption &option, const Source &src, Sink &sink) {
+        zircon::SerializeOption so;
+        so.dimension = src.dim;
+        zircon::AsyncReadOption aop;
+        aop.format = file_format(src.format);
+        aop.batch_size = option.chunk;
+        aop.queue_depth = option.queue_depth;
+        zircon::AsyncVectorSetReader reader;
+        auto rs = reader.open(option.input, so, aop);
+        if (!rs.ok()) {
+            return rs;
+        }
+        zircon::VectorBatch batch;
+        while (true) {
+            rs = reader.next_batch(&batch);
+            if (turbo::is_reach_file_end(rs)) {
+                return turbo::ok_status();
+            }
+            if (!rs.ok()) {
+                return rs;
+            }
+            rs = sink.write(batch.data(), batch.size());
+            if (!rs.ok()) {
+                return rs;
+            }
+        }
+    }
+
+    turbo::Status stream_tsv(const ConvertOption &option, const Source &src, Sink &sink) {
+        turbo::SequentialReadFile file;
+        auto rs = file.open(option.input);
+        if (!rs.ok()) {
+            return rs;
+        }
+        zircon::SerializeOption so;
+        so.dimension = src.dim;
+        zircon::TsvVectorSetReader reader;
+        rs = reader.initialize(&file, so);
+        if (!rs.ok()) {
+            return rs;
+        }
+        std::vector<uint8_t> buf(option.chunk * src.dim * sizeof(float));
+        while (true) {
+            turbo::Span<uint8_t> span{buf.data(), buf.size()};
+            auto n = reader.read_batch(span, option.chunk);
+            if (!n.ok()) {
+                return n.status();
+            }
+            if (n.value() > 0) {
+                rs = sink.write(buf.data(), n.value());
+                if (!rs.ok()) {
+                    return rs;
+                }
+            }
+            if (n.value() < option.chunk) {
+                return turbo::ok_status();
+            }
+        }
+    }
+
+    // the alive vectors of the store in location order, chunk by chunk
+    turbo::Status stream_store(const ConvertOption &option, const zircon::MemVectorStore &store, std::size_t dim,
+                               Sink &sink) {
+        const std::size_t vector_bytes = dim * sizeof(float);
+        std::vector<uint8_t> buf(option.chunk * vector_bytes);
+        std::size_t n = 0;
+        for (std::size_t loc = 0; loc < store.current_index(); ++loc) {
+            auto l = static_cast<zircon::location_t>(loc);
+            if (store.is_deleted(l)) {
+                continue;
+            }
+            auto *dst = buf.data() + n * vector_bytes;
+            if (store.is_encoded()) {
+                store.decode_vector(l, turbo::Span<float>{reinterpret_cast<float *>(dst), dim});
+            } else {
+                std::memcpy(dst, store.get_vector(l).data(), vector_bytes);
+            }
+            if (++n == option.chunk) {
+                auto rs = sink.write(buf.data(), n);
+                if (!rs.ok()) {
+                    return rs;
+                }
+                n = 0;
+            }
+        }
+        return n > 0 ? sink.write(buf.data(), n) : turbo::ok_status();
+    }
+
+    // the input loaded by the parallel loader, then saved as a snapshot
+    turbo::ResultStatus<std::size_t> build_snapshot(const ConvertOption &option, const Source &src) {
+        if (src.n > std::numeric_limits<uint32_t>::max()) {
+            return turbo::invalid_argument_error("{} vectors do not fit a store", src.n);
+        }
+        zircon::VectorStoreOption sop;
+        sop.max_elements = static_cast<uint32_t>(std::max<std::size_t>(src.n, 1));
+        sop.vector_byte_size = static_cast<uint32_t>(src.dim * sizeof(float));
+        sop.dimension = static_cast<uint32_t>(src.dim);
+        zircon::MemVectorStore store;
+        auto rs = store.initialize(sop);
+        if (!rs.ok()) {
+            return rs;
+        }
+        zircon::VectorLoadOption lop;
+        lop.format = file_format(src.format);
+        lop.dimension = src.dim;
+        lop.nthreads = option.threads;
+        lop.chunk_vectors = option.chunk;
+        auto loaded = zircon::load_vector_set(option.input, lop, &store);
+        if (!loaded.ok()) {
+            return loaded.status();
+        }
+        rs = store.save_snapshot(option.output);
+        if (!rs.ok()) {
+            return rs;
+        }
+        return loaded.value();
+    }
+
+    turbo::ResultStatus<std::size_t> convert(const ConvertOption &option, std::size_t &dim) {
+        auto in = parse_format(option.from, option.input);
+        if (!in.ok()) {
+            return in.status();
+        }
+        auto out = parse_format(option.to, option.output);
+        if (!out.ok()) {
+            return out.status();
+        }
+        if (in.value() == Format::SNAP) {
+            zircon::MemVectorStore store;
+            auto rs = store.load_snapshot(option.input, true);
+            if (!rs.ok()) {
+                return rs;
+            }
+            dim = store.input_byte_size() / sizeof(float);
+            if (out.value() == Format::SNAP) {
+                rs = store.save_snapshot(option.output);
+                if (!rs.ok()) {
+                    return rs;
+                }
+                return store.size();
+            }
+            Sink sink;
+            rs = sink.open(option, out.value(), dim, store.size());
+            if (rs.ok()) {
+                rs = stream_store(option, store, dim, sink);
+            }
+            if (rs.ok()) {
+                rs = sink.finish();
+            }
+            if (!rs.ok()) {
+                return rs;
+            }
+            return sink.written();
+        }
+        auto src = probe(option, in.value(), out.value());
+        if (!src.ok()) {
+            return src.status();
+        }
+        dim = src.value().dim;
+        if (out.value() == Format::SNAP) {
+            return build_snapshot(option, src.value());
+        }
+        Sink sink;
+        auto rs = sink.open(option, out.value(), dim, src.value().n);
+        if (rs.ok()) {
+            rs = in.value() == Format::TSV ? stream_tsv(option, src.value(), sink)
+                                           : stream_records(option, src.value(), sink);
+        }
+        if (rs.ok()) {
+            rs = sink.finish();
+        }
+        if (!rs.ok()) {
+            return rs;
+        }
+        return sink.written();
+    }
+
+}  // namespace
+
+int main(int argc, char **argv) {
+    ConvertOption option;
+    if (!parse_args(argc, argv, option)) {
+        usage();
+        return 1;
+    }
+    auto start = Clock::now();
+    std::size_t dim = 0;
+    auto n = convert(option, dim);
+    if (!n.ok()) {
+        zircon::tools::report(n.status());
+        return 1;
+    }
+    double seconds = std::chrono::duration<double>(Clock::now() - start).count();
+    std::error_code ec;
+    auto bytes = std::filesystem::file_size(option.output, ec);
+    std::printf("%zu vectors of dimension %zu in %.3f s, %.1f MB/s written\n", n.value(), dim, seconds,
+                ec ? 0.0 : static_cast<double>(bytes) / 1e6 / std::max(seconds, 1e-9));
+    return 0;
+}
@@ -16,8 +16,10 @@
 #ifndef ZIRCON_CORE_ALLOCATOR_H_
 #define ZIRCON_CORE_ALLOCATOR_H_
 
+#include <atomic>
 #include "turbo/memory/aligned_allocator.h"
 #include "turbo/simd/simd.h"
+#include "zircon/core/slab_arena.h"
 
 namespace zircon {
 
@@ -41,8 +43,67 @@ namespace zircon {
             _allocator.deallocate(p, n);
         }
 
+        // for direct io, the buffer, offset and length must all be block aligned
+        static constexpr size_t page_alignment = 4096;
+
+        uint8_t *allocate_pages(size_t n) {
+            return _page_allocator.allocate(n);
+        }
+
+        void deallocate_pages(uint8_t *p, size_t n) {
+            _page_allocator.deallocate(p, n);
+        }
+
+        /**
+         * @brief take the vector batches from the slab arena from now on. batches
+         *        allocated before keep their heap memory, the option apply to the
+         *        regions mapped after the call.
+         */
+        void enable_arena(const ArenaOption &option) {
+            _arena.set_option(option);
+            _arena_used.store(true, std::memory_order_release);
+            _arena_enabled.store(true, std::memory_order_release);
+        }
+
+        // new batches from the heap again, blocks of the arena are still returned to it.
+        void disable_arena() {
+            _arena_enabled.store(false, std::memory_order_release);
+        }
+
+        [[nodiscard]] bool is_arena_enabled() const {
+            return _arena_enabled.load(std::memory_order_acquire);
+        }
+
+        [[nodiscard]] const SlabArena &arena() const {
+            return _arena;
+        }
+
+        // memory of a vector batch, placed on node if the arena is enabled, -1 for the calling cpu.
+        uint8_t *allocate_batch(size_t n, int node = -1) {
+            if (is_arena_enabled()) {
+                auto *p = _arena.allocate(n, node);
+                if (p != nullptr) {
+                    return p;
+                }
+            }
+            return _allocator.allocate(n);
+        }
+
+        void deallocate_batch(uint8_t *p, size_t n) {
+            if (_arena_used.load(std::memory_order_acquire) && _arena.owns(p)) {
+                _arena.deallocate(p, n);
+                return;
+            }
+            _allocator.deallocate(p, n);
+        }
+
     private:
         turbo::aligned_allocator<uint8_t, Allocator::alignment> _allocator;
+        turbo::aligned_allocator<uint8_t, Allocator::page_alignment> _page_allocator;
+        SlabArena _arena;
+        std::atomic<bool> _arena_enabled{false};
+        // set once enabled, the arena may own blocks after disable_arena
+        std::atomic<bool> _arena_used{false};
         Allocator() = default;
     };
 }
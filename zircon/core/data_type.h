@@ -0,0 +1,48 @@
+// Copyright 2023 The Elastic-AI Authors.
+// part of Elastic AI Search
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#ifndef ZIRCON_CORE_DATA_TYPE_H_
+#define ZIRCON_CORE_DATA_TYPE_H_
+
+#include <cstddef>
+#include <cstdint>
+
+namespace zircon {
+
+    // element type of the vectors in a dataset file
+    enum class DataType {
+        DT_NONE = 0,
+        DT_UINT8,
+        DT_FLOAT16,
+        DT_FLOAT,
+    };
+
+    // bytes of one element, 0 for DT_NONE
+    inline constexpr std::size_t data_type_size(DataType type) {
+        switch (type) {
+            case DataType::DT_UINT8:
+                return sizeof(uint8_t);
+            case DataType::DT_FLOAT16:
+                return sizeof(uint16_t);
+            case DataType::DT_FLOAT:
+                return sizeof(float);
+            default:
+                return 0;
+        }
+    }
+
+}  // namespace zircon
+
+#endif  // ZIRCON_CORE_DATA_TYPE_H_
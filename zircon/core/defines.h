@@ -20,6 +20,9 @@
 #include <cstdint>
 #include <limits>
 #include <cstddef>
+#include "zircon/core/data_type.h"
+#include "zircon/core/encoding_type.h"
+#include "zircon/core/metric_type.h"
 
 namespace zircon {
 
@@ -50,12 +53,139 @@ namespace zircon {
         uint32_t max_elements{constants::kMaxElements};
         uint32_t vector_byte_size{0};
         bool     enable_replace_vacant{true};
+        // with an encoding other than ENCODING_NONE, the store take float
+        // vectors of dimension, and vector_byte_size is set by the store.
+        EncodingType encoding{EncodingType::ENCODING_NONE};
+        uint32_t dimension{0};
+        // numa node of the batches when the allocator use the slab arena,
+        // -1 for the node of the thread that grows the store.
+        int32_t numa_node{-1};
+        // keep the l2 norm of every vector next to its slot, see MemVectorStore::get_norm.
+        // float stores only, dimension must be set.
+        bool keep_norms{false};
+        // scale every vector written to unit l2 norm, float stores only, dimension must be set.
+        bool normalize{false};
+    };
+
+    struct IndexOption {
+        MetricType metric{MetricType::METRIC_L2};
+        uint32_t dimension{0};
+        // vector_byte_size is set by the index from the dimension
+        VectorStoreOption store_option;
+    };
+
+    struct HnswOption {
+        // max neighbors of a node on the upper levels, 2 * m on level 0
+        uint32_t m{constants::kHnswM};
+        uint32_t ef_construction{constants::kHnswEfConstruction};
+        // default ef of search, take the max of it and k
+        uint32_t ef{constants::kHnswEf};
+        uint64_t random_seed{constants::kHnswRandomSeed};
+    };
+
+    struct FlatOption {
+        // threads of a search, the caller included. 0 use the shared pool of
+        // one thread per core, 1 search on the calling thread only.
+        uint32_t nthreads{0};
+        // consecutive batches scored by one task
+        uint32_t batches_per_task{4};
+        // stores with fewer locations are searched on the calling thread
+        uint64_t parallel_threshold{16384};
+    };
+
+    // how an ivf index keeps the vectors of its posting lists
+    enum class IvfCode {
+        // the float vectors
+        IVF_FLAT = 0,
+        // ScalarQuantizer codes of the vectors
+        IVF_SQ8,
+        IVF_FP16,
+        // ProductQuantizer codes of the residuals to the list centroid
+        IVF_PQ,
+    };
+
+    struct IvfOption {
+        // coarse centroids, one posting list each
+        uint32_t nlist{1024};
+        // lists searched when SearchOption::nprobe is 0
+        uint32_t nprobe{16};
+        IvfCode code{IvfCode::IVF_FLAT};
+        // sub quantizers and bits of IVF_PQ
+        uint32_t pq_m{8};
+        uint32_t pq_nbits{8};
+        // mini batch k-means of the coarse centroids
+        uint32_t kmeans_iter{50};
+        uint32_t kmeans_batch{8192};
+        uint64_t seed{1234};
+        // threads of the training, the caller included. 0 use the shared pool.
+        uint32_t nthreads{0};
+        // codes per block of a posting list
+        uint32_t list_block{256};
+    };
+
+    struct VamanaOption {
+        // out degree bound of the graph, the node record hold that many ids
+        uint32_t max_degree{64};
+        // candidate list of the searches done while building
+        uint32_t build_list{100};
+        // pruning factor of the second pass, the first pass use 1
+        float alpha{1.2f};
+        // sub quantizers of the in memory codes, must divide the dimension
+        uint32_t pq_m{16};
+        uint32_t pq_nbits{8};
+        // vectors the codebooks are trained on
+        uint32_t pq_samples{100000};
+        // threads of the build, the caller included. 0 use the shared pool.
+        uint32_t nthreads{0};
+        uint64_t seed{1234};
+    };
+
+    struct IdFilter;
+
+    // where the time of a search went, see SearchOption::stats
+    struct QueryStats {
+        // distances to full vectors or to codes
+        uint64_t distance_computations{0};
+        // graph nodes whose neighbors were expanded
+        uint64_t nodes_visited{0};
+        // posting lists scanned by ivf indexes
+        uint64_t lists_probed{0};
+        // candidates dropped by the filter or removed
+        uint64_t filter_rejected{0};
+        // node reads of disk indexes
+        uint64_t io_reads{0};
+        uint64_t latency_ns{0};
+    };
+
+    struct SearchOption {
+        std::size_t k{10};
+        // ef of graph indexes, 0 use the index default
+        std::size_t ef{0};
+        // posting lists probed by ivf indexes, 0 use the index default
+        std::size_t nprobe{0};
+        // only the labels of the filter are returned, the filter is applied
+        // while scanning or traversing, not owned.
+        const IdFilter *filter{nullptr};
+        // a filter listing not more than this ratio of the index size is
+        // searched by brute force over its members.
+        float brute_force_ratio{0.01f};
+        // if not null, the counts of the search are added to it, not owned.
+        QueryStats *stats{nullptr};
+    };
+
+    struct QueryResult {
+        label_type label{constants::kUnknownLabel};
+        distance_type distance{0};
     };
 
     struct SerializeOption {
-        //DataType data_type;
+        DataType data_type{DataType::DT_FLOAT};
         std::size_t n_vectors{constants::kUnknownSize};
-        std::size_t dimension;
+        std::size_t dimension{0};
+        // the writers gather the records in a buffer of that many bytes and
+        // write it to the file once full, the writer must then be flushed
+        // before the file is closed. 0 writes every record on its own.
+        std::size_t write_buffer_bytes{0};
     };
 
 }  // namespace zircon
@@ -0,0 +1,35 @@
+// Copyright 2023 The Elastic-AI Authors.
+// part of Elastic AI Search
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+
+#ifndef ZIRCON_CORE_ENCODING_TYPE_H_
+#define ZIRCON_CORE_ENCODING_TYPE_H_
+
+namespace zircon {
+
+    // how the store keeps the vectors in memory.
+    enum class EncodingType {
+        // vector_byte_size raw bytes, as given by the user
+        ENCODING_NONE = 0,
+        // one byte per dimension, per dimension min/max trained from samples
+        ENCODING_SQ8,
+        // ieee half precision float per dimension
+        ENCODING_FP16,
+        // one bit per dimension packed in bytes, set if the value is above a
+        // per dimension threshold, zero or the mean trained from samples
+        ENCODING_BINARY,
+    };
+}  // namespace zircon
+#endif  // ZIRCON_CORE_ENCODING_TYPE_H_
@@ -17,4 +17,32 @@
 
 namespace zircon {
 
+    turbo::Status Index::search_batch(turbo::Span<float> queries, std::size_t nq, const SearchOption &option,
+                                      std::vector<std::vector<QueryResult>> &results) const {
+        results.clear();
+        if (nq == 0) {
+            return turbo::ok_status();
+        }
+        if (queries.size() % nq != 0) {
+            return turbo::invalid_argument_error("queries size {} is not a multiple of nq {}", queries.size(), nq);
+        }
+        const std::size_t dim = queries.size() / nq;
+        results.resize(nq);
+        for (std::size_t i = 0; i < nq; ++i) {
+            auto rs = search(turbo::Span<float>(queries.data() + i * dim, dim), option, results[i]);
+            if (!rs.ok()) {
+                return rs;
+            }
+        }
+        return turbo::ok_status();
+    }
+
+    turbo::Status Index::load_index(const std::string &path) {
+        return turbo::unimplemented_error("index not support load from {}", path);
+    }
+
+    turbo::Status Index::save_index(const std::string &path) const {
+        return turbo::unimplemented_error("index not support save to {}", path);
+    }
+
 }  // namespace zircon
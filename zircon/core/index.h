@@ -16,17 +16,55 @@
 #ifndef ZIRCON_CORE_INDEX_H_
 #define ZIRCON_CORE_INDEX_H_
 
+#include <string>
+#include <vector>
 #include "turbo/base/status.h"
+#include "turbo/meta/span.h"
+#include "zircon/core/defines.h"
 
 namespace zircon {
 
+    /**
+     * @brief interface of the vector indexes, vectors are float of the index
+     *        dimension and identified by the user label.
+     */
     class Index {
     public:
-        Index();
-        ~Index();
+        Index() = default;
 
-        turbo::Status load_index();
-        turbo::Status save_index();
+        virtual ~Index() = default;
+
+        /**
+         * @return the location of the vector in the index store, already exists
+         *         if the label is in the index, resource exhausted if full.
+         */
+        virtual turbo::ResultStatus<location_t> add_vector(label_type label, turbo::Span<float> vector) = 0;
+
+        virtual turbo::Status remove_vector(label_type label) = 0;
+
+        /**
+         * @brief the nearest option.k vectors, nearest first. deleted vectors are
+         *        never returned.
+         */
+        virtual turbo::Status
+        search(turbo::Span<float> query, const SearchOption &option, std::vector<QueryResult> &result) const = 0;
+
+        /**
+         * @brief search nq queries stored one after another in queries, results[i]
+         *        is the result of search for the i-th query. the default run search
+         *        once per query, the graph indexes interleave the traversals of the
+         *        queries so the vectors of one are prefetched while another is
+         *        scored. option.stats, if set, get the sum of the queries.
+         */
+        virtual turbo::Status search_batch(turbo::Span<float> queries, std::size_t nq, const SearchOption &option,
+                                           std::vector<std::vector<QueryResult>> &results) const;
+
+        // alive vectors in the index
+        [[nodiscard]] virtual std::size_t size() const = 0;
+
+        virtual turbo::Status load_index(const std::string &path);
+
+        virtual turbo::Status save_index(const std::string &path) const;
     };
 }  // namespace zircon
 
@@ -0,0 +1,328 @@
+// Copyright 2023 The Elastic-AI Authors.
+// part of Elastic AI Search
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+#include "zircon/core/io_engine.h"
+#include "turbo/log/logging.h"
+#include <algorithm>
+#include <cerrno>
+#include <condition_variable>
+#include <cstring>
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <unistd.h>
+#include <vector>
+
+#if defined(__linux__) && defined(__has_include)
+#if __has_include(<linux/io_uring.h>)
+#define ZIRCON_HAS_IO_URING 1
+#include <linux/io_uring.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#endif
+#endif
+
+namespace zircon {
+
+    namespace {
+
+        class ThreadPoolEngine : public IoEngine {
+        public:
+            explicit ThreadPoolEngine(std::size_t nthreads) {
+                for (std::size_t i = 0; i < std::max<std::size_t>(nthreads, 1); ++i) {
+                    _threads.emplace_back([this] { run(); });
+                }
+            }
+
+            ~ThreadPoolEngine() override {
+                {
+                    std::unique_lock<std::mutex> lock(_mutex);
+                    _stop = true;
+                }
+                _pending_cv.notify_all();
+                for (auto &t: _threads) {
+                    t.join();
+                }
+            }
+
+            turbo::Status submit(IoRequest *req) override {
+                {
+                    std::unique_lock<std::mutex> lock(_mutex);
+                    _pending.push_back(req);
+                }
+                _pending_cv.notify_one();
+                return turbo::ok_status();
+            }
+
+            [[nodiscard]] AsyncIoBackend backend() const override {
+                return AsyncIoBackend::IO_THREAD_POOL;
+            }
+
+            turbo::ResultStatus<IoRequest *> wait() override {
+                std::unique_lock<std::mutex> lock(_mutex);
+                _done_cv.wait(lock, [this] { return !_done.empty(); });
+                auto *req = _done.front();
+                _done.pop_front();
+                return req;
+            }
+
+        private:
+            void run() {
+                while (true) {
+                    IoRequest *req = nullptr;
+                    {
+                        std::unique_lock<std::mutex> lock(_mutex);
+                        _pending_cv.wait(lock, [this] { return _stop || !_pending.empty(); });
+                        if (_pending.empty()) {
+                            return;
+                        }
+                        req = _pending.front();
+                        _pending.pop_front();
+                    }
+                    while (req->done < req->len) {
+                        auto r = ::pread(req->fd, req->buf + req->done, req->len - req->done,
+                                         static_cast<off_t>(req->offset + req->done));
+                        if (r < 0) {
+                            if (errno == EINTR) {
+                                continue;
+                            }
+                            req->error = errno;
+                            break;
+                        }
+                        if (r == 0) {
+                            break;
+                        }
+                        req->done += static_cast<std::size_t>(r);
+                    }
+                    {
+                        std::unique_lock<std::mutex> lock(_mutex);
+                        _done.push_back(req);
+                    }
+                    _done_cv.notify_one();
+                }
+            }
+
+        private:
+            std::vector<std::thread> _threads;
+            std::mutex _mutex;
+            std::condition_variable _pending_cv;
+            std::condition_variable _done_cv;
+            std::deque<IoRequest *> _pending;
+            std::deque<IoRequest *> _done;
+            bool _stop{false};
+        };
+
+#if defined(ZIRCON_HAS_IO_URING)
+
+        // io_uring through the raw system calls, one submitter and one reaper thread.
+        class IoUringEngine : public IoEngine {
+        public:
+            IoUringEngine() = default;
+
+            ~IoUringEngine() override {
+                // closing the ring does not wait for its reads, they would land in freed buffers
+                drain();
+                if (_sqes != nullptr) {
+                    ::munmap(_sqes, _sqes_size);
+                }
+                if (_cq_ptr != nullptr && _cq_ptr != _sq_ptr) {
+                    ::munmap(_cq_ptr, _cq_size);
+                }
+                if (_sq_ptr != nullptr) {
+                    ::munmap(_sq_ptr, _sq_size);
+                }
+                if (_ring_fd >= 0) {
+                    ::close(_ring_fd);
+                }
+            }
+
+            turbo::Status init(unsigned entries) {
+                struct io_uring_params p;
+                std::memset(&p, 0, sizeof(p));
+                _ring_fd = static_cast<int>(::syscall(__NR_io_uring_setup, entries, &p));
+                if (_ring_fd < 0) {
+                    return turbo::errno_to_status(errno, "io_uring_setup");
+                }
+                _sq_entries = p.sq_entries;
+                _sq_size = p.sq_off.array + p.sq_entries * sizeof(uint32_t);
+                _cq_size = p.cq_off.cqes + p.cq_entries * sizeof(struct io_uring_cqe);
+                bool single_mmap = false;
+#if defined(IORING_FEAT_SINGLE_MMAP)
+                single_mmap = (p.features & IORING_FEAT_SINGLE_MMAP) != 0;
+#endif
+                if (single_mmap) {
+                    _sq_size = _cq_size = std::max(_sq_size, _cq_size);
+                }
+                _sq_ptr = map(_sq_size, IORING_OFF_SQ_RING);
+                if (_sq_ptr == nullptr) {
+                    return turbo::errno_to_status(errno, "mmap io_uring sq");
+                }
+                _cq_ptr = single_mmap ? _sq_ptr : map(_cq_size, IORING_OFF_CQ_RING);
+                if (_cq_ptr == nullptr) {
+                    return turbo::errno_to_status(errno, "mmap io_uring cq");
+                }
+                _sqes_size = p.sq_entries * sizeof(struct io_uring_sqe);
+                _sqes = static_cast<struct io_uring_sqe *>(map(_sqes_size, IORING_OFF_SQES));
+                if (_sqes == nullptr) {
+                    return turbo::errno_to_status(errno, "mmap io_uring sqes");
+                }
+                auto *sq = static_cast<uint8_t *>(_sq_ptr);
+                _sq_head = reinterpret_cast<unsigned *>(sq + p.sq_off.head);
+                _sq_tail = reinterpret_cast<unsigned *>(sq + p.sq_off.tail);
+                _sq_mask = *reinterpret_cast<unsigned *>(sq + p.sq_off.ring_mask);
+                _sq_array = reinterpret_cast<unsigned *>(sq + p.sq_off.array);
+                auto *cq = static_cast<uint8_t *>(_cq_ptr);
+                _cq_head = reinterpret_cast<unsigned *>(cq + p.cq_off.head);
+                _cq_tail = reinterpret_cast<unsigned *>(cq + p.cq_off.tail);
+                _cq_mask = *reinterpret_cast<unsigned *>(cq + p.cq_off.ring_mask);
+                _cqes = reinterpret_cast<struct io_uring_cqe *>(cq + p.cq_off.cqes);
+                return turbo::ok_status();
+            }
+
+            turbo::Status submit(IoRequest *req) override {
+                unsigned tail = *_sq_tail;
+                unsigned head = __atomic_load_n(_sq_head, __ATOMIC_ACQUIRE);
+                if (tail - head >= _sq_entries) {
+                    return turbo::resource_exhausted_error("io_uring submit queue full");
+                }
+                unsigned idx = tail & _sq_mask;
+                auto *sqe = &_sqes[idx];
+                std::memset(sqe, 0, sizeof(*sqe));
+                req->iov.iov_base = req->buf + req->done;
+                req->iov.iov_len = req->len - req->done;
+                sqe->opcode = IORING_OP_READV;
+                sqe->fd = req->fd;
+                sqe->addr = reinterpret_cast<uint64_t>(&req->iov);
+                sqe->len = 1;
+                sqe->off = req->offset + req->done;
+                sqe->user_data = reinterpret_cast<uint64_t>(req);
+                _sq_array[idx] = idx;
+                __atomic_store_n(_sq_tail, tail + 1, __ATOMIC_RELEASE);
+                // the entry stay in the ring if enter fails, the next enter submit it
+                ++_inflight;
+                return enter(1, 0, 0);
+            }
+
+            [[nodiscard]] AsyncIoBackend backend() const override {
+                return AsyncIoBackend::IO_URING;
+            }
+
+            turbo::ResultStatus<IoRequest *> wait() override {
+                while (true) {
+                    unsigned head = *_cq_head;
+                    unsigned tail = __atomic_load_n(_cq_tail, __ATOMIC_ACQUIRE);
+                    if (head == tail) {
+                        auto rs = enter(0, 1, IORING_ENTER_GETEVENTS);
+                        if (!rs.ok()) {
+                            return rs;
+                        }
+                        continue;
+                    }
+                    auto *cqe = &_cqes[head & _cq_mask];
+                    auto *req = reinterpret_cast<IoRequest *>(cqe->user_data);
+                    int res = cqe->res;
+                    __atomic_store_n(_cq_head, head + 1, __ATOMIC_RELEASE);
+                    --_inflight;
+                    if (res < 0) {
+                        req->error = -res;
+                        return req;
+                    }
+                    req->done += static_cast<std::size_t>(res);
+                    if (res == 0 || req->done == req->len) {
+                        return req;
+                    }
+                    // short read before the end of the file, read the rest
+                    auto rs = submit(req);
+                    if (!rs.ok()) {
+                        return rs;
+                    }
+                }
+            }
+
+        private:
+            // reap every read submitted and not returned by wait, their requests are not touched
+            void drain() {
+                while (_inflight > 0) {
+                    const unsigned queued = *_sq_tail - __atomic_load_n(_sq_head, __ATOMIC_ACQUIRE);
+                    auto rs = enter(queued, 1, IORING_ENTER_GETEVENTS);
+                    TLOG_CHECK(rs.ok(), "io_uring reads in flight can not be reaped: {}", rs.message());
+                    const unsigned tail = __atomic_load_n(_cq_tail, __ATOMIC_ACQUIRE);
+                    _inflight -= tail - *_cq_head;
+                    __atomic_store_n(_cq_head, tail, __ATOMIC_RELEASE);
+                }
+            }
+
+            void *map(std::size_t size, off_t offset) {
+                void *p = ::mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, _ring_fd, offset);
+                return p == MAP_FAILED ? nullptr : p;
+            }
+
+            turbo::Status enter(unsigned to_submit, unsigned min_complete, unsigned flags) {
+                while (true) {
+                    auto r = ::syscall(__NR_io_uring_enter, _ring_fd, to_submit, min_complete, flags, nullptr, 0);
+                    if (r >= 0) {
+                        return turbo::ok_status();
+                    }
+                    if (errno != EINTR) {
+                        return turbo::errno_to_status(errno, "io_uring_enter");
+                    }
+                }
+            }
+
+        private:
+            int _ring_fd{-1};
+            unsigned _sq_entries{0};
+            void *_sq_ptr{nullptr};
+            void *_cq_ptr{nullptr};
+            std::size_t _sq_size{0};
+            std::size_t _cq_size{0};
+            std::size_t _sqes_size{0};
+            struct io_uring_sqe *_sqes{nullptr};
+            unsigned *_sq_head{nullptr};
+            unsigned *_sq_tail{nullptr};
+            unsigned *_sq_array{nullptr};
+            unsigned _sq_mask{0};
+            unsigned *_cq_head{nullptr};
+            unsigned *_cq_tail{nullptr};
+            unsigned _cq_mask{0};
+            struct io_uring_cqe *_cqes{nullptr};
+            // entries put in the submit queue and not reaped yet
+            std::size_t _inflight{0};
+        };
+
+#endif  // ZIRCON_HAS_IO_URING
+
+    }  // namespace
+
+    turbo::ResultStatus<std::unique_ptr<IoEngine>>
+    make_io_engine(AsyncIoBackend backend, std::size_t entries, std::size_t io_threads) {
+#if defined(ZIRCON_HAS_IO_URING)
+        if (backend != AsyncIoBackend::IO_THREAD_POOL) {
+            auto engine = std::make_unique<IoUringEngine>();
+            auto rs = engine->init(static_cast<unsigned>(std::max<std::size_t>(entries, 1)));
+            if (rs.ok()) {
+                return std::unique_ptr<IoEngine>(std::move(engine));
+            }
+            if (backend == AsyncIoBackend::IO_URING) {
+                return rs;
+            }
+        }
+#endif
+        if (backend == AsyncIoBackend::IO_URING) {
+            return turbo::unavailable_error("io_uring not built in");
+        }
+        return std::unique_ptr<IoEngine>(std::make_unique<ThreadPoolEngine>(io_threads));
+    }
+
+}  // namespace zircon
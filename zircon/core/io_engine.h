@@ -0,0 +1,77 @@
+// Copyright 2023 The Elastic-AI Authors.
+// part of Elastic AI Search
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#ifndef ZIRCON_CORE_IO_ENGINE_H_
+#define ZIRCON_CORE_IO_ENGINE_H_
+
+#include <cstdint>
+#include <memory>
+#include <sys/uio.h>
+#include "turbo/base/status.h"
+
+namespace zircon {
+
+    enum class AsyncIoBackend {
+        // io_uring if the kernel allow it, the thread pool otherwise
+        IO_AUTO = 0,
+        IO_URING,
+        IO_THREAD_POOL,
+    };
+
+    struct IoRequest {
+        int fd{-1};
+        uint8_t *buf{nullptr};
+        std::size_t len{0};
+        uint64_t offset{0};
+        // bytes read so far, less than len only at the end of the file
+        std::size_t done{0};
+        // errno of a failed read
+        int error{0};
+        void *owner{nullptr};
+        struct iovec iov{};
+    };
+
+    /**
+     * @brief positioned reads in flight, completed in any order. with direct
+     *        io the buffers, offsets and lengths must be page aligned. one
+     *        thread drive an engine, the requests must outlive their read.
+     *        destroying an engine waits for the reads still in flight.
+     */
+    class IoEngine {
+    public:
+        virtual ~IoEngine() = default;
+
+        // the request is filled completely unless the file ends or a read fails
+        virtual turbo::Status submit(IoRequest *req) = 0;
+
+        // block until a submitted request completes
+        virtual turbo::ResultStatus<IoRequest *> wait() = 0;
+
+        // never IO_AUTO
+        [[nodiscard]] virtual AsyncIoBackend backend() const = 0;
+    };
+
+    /**
+     * @brief the engine of backend, IO_AUTO try io_uring first and fall back
+     *        to io_threads threads doing pread.
+     * @param entries the most requests in flight.
+     * @return unavailable or the error of the ring setup if IO_URING can not be used.
+     */
+    turbo::ResultStatus<std::unique_ptr<IoEngine>>
+    make_io_engine(AsyncIoBackend backend, std::size_t entries, std::size_t io_threads);
+
+}  // namespace zircon
+
+#endif  // ZIRCON_CORE_IO_ENGINE_H_
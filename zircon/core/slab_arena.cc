@@ -0,0 +1,251 @@
+// Copyright 2023 The Elastic-AI Authors.
+// part of Elastic AI Search
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#include "zircon/core/slab_arena.h"
+#include <algorithm>
+#include <fstream>
+#include <string>
+#include "turbo/log/logging.h"
+#if defined(__linux__)
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+namespace zircon {
+
+    namespace {
+        constexpr std::size_t kPage = 4096;
+        constexpr std::size_t kHugePage = 2u << 20;
+        constexpr std::size_t kCacheLine = 64;
+        // from linux/mempolicy.h
+        constexpr int kMpolPreferred = 1;
+        constexpr int kMpolBind = 2;
+
+        constexpr std::size_t round_up(std::size_t n, std::size_t align) {
+            return (n + align - 1) / align * align;
+        }
+    }  // namespace
+
+    SlabArena::~SlabArena() {
+#if defined(__linux__)
+        for (auto &pool: _pools) {
+            if (pool == nullptr) {
+                continue;
+            }
+            for (auto &r: pool->regions) {
+                ::munmap(r.base, r.size);
+            }
+        }
+#endif
+    }
+
+    void SlabArena::set_option(const ArenaOption &option) {
+        std::unique_lock<std::shared_mutex> lock(_mutex);
+        _option = option;
+    }
+
+    ArenaOption SlabArena::option() const {
+        std::shared_lock<std::shared_mutex> lock(_mutex);
+        return _option;
+    }
+
+    std::size_t SlabArena::block_size(std::size_t n) {
+        n = std::max<std::size_t>(n, 1);
+        return n >= kPage ? round_up(n, kPage) : round_up(n, kCacheLine);
+    }
+
+    SlabArena::Pool &SlabArena::get_pool(int node) {
+        {
+            std::shared_lock<std::shared_mutex> lock(_mutex);
+            if (_pools[node] != nullptr) {
+                return *_pools[node];
+            }
+        }
+        std::unique_lock<std::shared_mutex> lock(_mutex);
+        if (_pools[node] == nullptr) {
+            _pools[node] = std::make_unique<Pool>();
+            _pools[node]->node = node;
+        }
+        return *_pools[node];
+    }
+
+    uint8_t *SlabArena::allocate(std::size_t n, int node) {
+#if defined(__linux__)
+        if (node < 0) {
+            node = current_node();
+        }
+        node = std::min(node, kMaxNodes - 1);
+        auto &pool = get_pool(node);
+        const auto bs = block_size(n);
+        std::unique_lock<std::mutex> lock(pool.mutex);
+        auto &freed = pool.free_blocks[bs];
+        if (!freed.empty()) {
+            auto *p = freed.back();
+            freed.pop_back();
+            _used += bs;
+            return p;
+        }
+        const auto align = bs >= kPage ? kPage : kCacheLine;
+        if (!pool.regions.empty()) {
+            auto &r = pool.regions.back();
+            auto offset = round_up(r.used, align);
+            if (offset + bs <= r.size) {
+                r.used = offset + bs;
+                _used += bs;
+                return r.base + offset;
+            }
+        }
+        if (!map_region(pool, bs).ok()) {
+            return nullptr;
+        }
+        auto &r = pool.regions.back();
+        r.used = bs;
+        _used += bs;
+        return r.base;
+#else
+        (void) n;
+        (void) node;
+        return nullptr;
+#endif
+    }
+
+    turbo::Status SlabArena::map_region(Pool &pool, std::size_t min_size) {
+#if defined(__linux__)
+        auto op = option();
+        const auto size = round_up(std::max(op.region_bytes, min_size), kHugePage);
+        Region region;
+        region.size = size;
+        if (op.huge_page == HugePageMode::HUGE_PAGE_HUGETLB) {
+            void *p = ::mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+            if (p != MAP_FAILED) {
+                region.base = static_cast<uint8_t *>(p);
+                region.huge_tlb = true;
+            }
+        }
+        if (region.base == nullptr) {
+            // over map to get a huge page aligned start, thp need it
+            void *p = ::mmap(nullptr, size + kHugePage, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+            if (p == MAP_FAILED) {
+                return turbo::resource_exhausted_error("map a region of {} bytes", size);
+            }
+            auto *raw = static_cast<uint8_t *>(p);
+            auto *base = reinterpret_cast<uint8_t *>(round_up(reinterpret_cast<uintptr_t>(raw), kHugePage));
+            if (base != raw) {
+                ::munmap(raw, static_cast<std::size_t>(base - raw));
+            }
+            auto tail = static_cast<std::size_t>(raw + size + kHugePage - (base + size));
+            if (tail > 0) {
+                ::munmap(base + size, tail);
+            }
+            region.base = base;
+            if (op.huge_page != HugePageMode::HUGE_PAGE_NONE) {
+                // a hint, the kernel may have thp disabled
+                ::madvise(region.base, size, MADV_HUGEPAGE);
+            }
+        }
+        if (num_nodes() > 1) {
+            unsigned long mask[(kMaxNodes + 8 * sizeof(unsigned long) - 1) / (8 * sizeof(unsigned long))] = {};
+            mask[pool.node / (8 * sizeof(unsigned long))] |= 1UL << (pool.node % (8 * sizeof(unsigned long)));
+            // before the first touch, the pages are then allocated on the node
+            ::syscall(SYS_mbind, region.base, size, op.pin_to_node ? kMpolBind : kMpolPreferred, mask,
+                      static_cast<unsigned long>(kMaxNodes + 1), 0);
+        }
+        if (op.lock_memory) {
+            // may be over RLIMIT_MEMLOCK, the region is usable anyway
+            ::mlock(region.base, size);
+        }
+        pool.regions.push_back(region);
+        std::unique_lock<std::shared_mutex> lock(_mutex);
+        _ranges[region.base] = {region.base + size, pool.node};
+        return turbo::ok_status();
+#else
+        (void) pool;
+        (void) min_size;
+        return turbo::unimplemented_error("slab arena need linux");
+#endif
+    }
+
+    void SlabArena::deallocate(uint8_t *p, std::size_t n) {
+        int node;
+        {
+            std::shared_lock<std::shared_mutex> lock(_mutex);
+            auto it = _ranges.upper_bound(p);
+            TLOG_CHECK(it != _ranges.begin(), "block not from the arena");
+            --it;
+            TLOG_CHECK(p < it->second.first, "block not from the arena");
+            node = it->second.second;
+        }
+        auto &pool = *_pools[node];
+        const auto bs = block_size(n);
+        std::unique_lock<std::mutex> lock(pool.mutex);
+        pool.free_blocks[bs].push_back(p);
+        _used -= bs;
+    }
+
+    bool SlabArena::owns(const uint8_t *p) const {
+        std::shared_lock<std::shared_mutex> lock(_mutex);
+        auto it = _ranges.upper_bound(p);
+        if (it == _ranges.begin()) {
+            return false;
+        }
+        --it;
+        return p < it->second.first;
+    }
+
+    ArenaStats SlabArena::stats() const {
+        ArenaStats st;
+        for (auto &pool: _pools) {
+            if (pool == nullptr) {
+                continue;
+            }
+            std::unique_lock<std::mutex> lock(pool->mutex);
+            for (auto &r: pool->regions) {
+                ++st.regions;
+                st.huge_tlb_regions += r.huge_tlb ? 1 : 0;
+                st.reserved_bytes += r.size;
+            }
+        }
+        st.used_bytes = _used.load();
+        return st;
+    }
+
+    int SlabArena::current_node() {
+#if defined(__linux__) && defined(SYS_getcpu)
+        unsigned cpu = 0;
+        unsigned node = 0;
+        if (::syscall(SYS_getcpu, &cpu, &node, nullptr) == 0) {
+            return static_cast<int>(node);
+        }
+#endif
+        return 0;
+    }
+
+    int SlabArena::num_nodes() {
+        static const int nodes = [] {
+            // "0" or "0-1"
+            std::ifstream in("/sys/devices/system/node/possible");
+            std::string range;
+            if (!(in >> range)) {
+                return 1;
+            }
+            auto pos = range.find_last_of("-,");
+            auto last = std::atoi(range.c_str() + (pos == std::string::npos ? 0 : pos + 1));
+            return std::max(1, last + 1);
+        }();
+        return nodes;
+    }
+
+}  // namespace zircon
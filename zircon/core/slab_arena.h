@@ -0,0 +1,130 @@
+// Copyright 2023 The Elastic-AI Authors.
+// part of Elastic AI Search
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#ifndef ZIRCON_CORE_SLAB_ARENA_H_
+#define ZIRCON_CORE_SLAB_ARENA_H_
+
+#include <cstddef>
+#include <atomic>
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <shared_mutex>
+#include <vector>
+#include "turbo/base/status.h"
+
+namespace zircon {
+
+    enum class HugePageMode {
+        HUGE_PAGE_NONE = 0,
+        // transparent huge pages, madvise the regions
+        HUGE_PAGE_THP,
+        // MAP_HUGETLB from the reserved pool, THP if none is reserved
+        HUGE_PAGE_HUGETLB,
+    };
+
+    struct ArenaOption {
+        // bytes of one region, rounded up to 2MB
+        std::size_t region_bytes{64u << 20};
+        HugePageMode huge_page{HugePageMode::HUGE_PAGE_THP};
+        // bind the pages of a node pool to the node, preferred only if false
+        bool pin_to_node{false};
+        // mlock the regions so they are never swapped out
+        bool lock_memory{false};
+    };
+
+    struct ArenaStats {
+        std::size_t regions{0};
+        std::size_t huge_tlb_regions{0};
+        std::size_t reserved_bytes{0};
+        std::size_t used_bytes{0};
+    };
+
+    /**
+     * @brief slab arena for the vector batches. blocks are carved from large
+     *        anonymous regions, one pool of regions per numa node, freed blocks
+     *        go to a free list of their size and are reused by the next batch of
+     *        that size. regions are only returned to the system with the arena.
+     *        blocks are aligned to 64 bytes, blocks of a page or more to a page.
+     */
+    class SlabArena {
+    public:
+        // nodes above are folded into the last pool
+        static constexpr int kMaxNodes = 64;
+
+        SlabArena() = default;
+
+        ~SlabArena();
+
+        void set_option(const ArenaOption &option);
+
+        [[nodiscard]] ArenaOption option() const;
+
+        /**
+         * @brief a block of n bytes placed on node, -1 for the node of the calling cpu.
+         * @return nullptr if the system is out of memory.
+         */
+        uint8_t *allocate(std::size_t n, int node = -1);
+
+        void deallocate(uint8_t *p, std::size_t n);
+
+        // true if p is in a region of the arena
+        [[nodiscard]] bool owns(const uint8_t *p) const;
+
+        [[nodiscard]] ArenaStats stats() const;
+
+        // the numa node of the calling cpu, 0 if unknown
+        static int current_node();
+
+        // number of numa nodes of the host, 1 if unknown
+        static int num_nodes();
+
+    private:
+        struct Region {
+            uint8_t *base{nullptr};
+            std::size_t size{0};
+            std::size_t used{0};
+            bool huge_tlb{false};
+        };
+
+        struct Pool {
+            std::mutex mutex;
+            int node{0};
+            std::vector<Region> regions;
+            // block size to the freed blocks of that size
+            std::map<std::size_t, std::vector<uint8_t *>> free_blocks;
+        };
+
+        static std::size_t block_size(std::size_t n);
+
+        Pool &get_pool(int node);
+
+        // guard by the mutex of the pool
+        turbo::Status map_region(Pool &pool, std::size_t min_size);
+
+    private:
+        // guard the option, the pools and the ranges, the pools have their own for blocks
+        mutable std::shared_mutex _mutex;
+        ArenaOption _option;
+        std::unique_ptr<Pool> _pools[kMaxNodes];
+        // base of every region to its end and node, for owns and deallocate
+        std::map<const uint8_t *, std::pair<const uint8_t *, int>> _ranges;
+        std::atomic<std::size_t> _used{0};
+    };
+
+}  // namespace zircon
+
+#endif  // ZIRCON_CORE_SLAB_ARENA_H_
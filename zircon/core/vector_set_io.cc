@@ -12,9 +12,11 @@
 // limitations under the License.
 //
 
-#include "tann/core/vector_set_io.h"
+#include "zircon/core/vector_set_io.h"
+#include <algorithm>
+#include <cstring>
 
-namespace tann {
+namespace zircon {
 
     turbo::Status VectorSetReader::initialize(turbo::SequentialReadFile *file, const SerializeOption &option) {
         _file = file;
@@ -29,6 +31,56 @@ namespace tann {
         _option = option;
         _element_size = data_type_size(_option.data_type);
         _vector_bytes = _option.dimension * _element_size;
+        _buffered = 0;
+        _buffer.reset();
+        if (_option.write_buffer_bytes > 0) {
+            _buffer = std::make_unique<char[]>(_option.write_buffer_bytes);
+        }
         return init();
     }
-}  // namespace tann
+
+    turbo::Status VectorSetWriter::append(const void *data, std::size_t size) {
+        auto *p = static_cast<const char *>(data);
+        const std::size_t cap = _option.write_buffer_bytes;
+        if (cap == 0) {
+            return _file->write(p, size);
+        }
+        while (size > 0) {
+            if (_buffered == 0 && size >= cap) {
+                // the buffer is empty, so the file is at a buffer boundary
+                auto whole = size - size % cap;
+                auto rs = _file->write(p, whole);
+                if (!rs.ok()) {
+                    return rs;
+                }
+                p += whole;
+                size -= whole;
+                continue;
+            }
+            auto n = std::min(size, cap - _buffered);
+            std::memcpy(_buffer.get() + _buffered, p, n);
+            _buffered += n;
+            p += n;
+            size -= n;
+            if (_buffered == cap) {
+                auto rs = flush();
+                if (!rs.ok()) {
+                    return rs;
+                }
+            }
+        }
+        return turbo::ok_status();
+    }
+
+    turbo::Status VectorSetWriter::flush() {
+        if (_buffered == 0) {
+            return turbo::ok_status();
+        }
+        auto rs = _file->write(_buffer.get(), _buffered);
+        if (!rs.ok()) {
+            return rs;
+        }
+        _buffered = 0;
+        return turbo::ok_status();
+    }
+}  // namespace zircon
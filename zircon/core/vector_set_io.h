@@ -15,6 +15,7 @@
 #ifndef ZIRCON_CORE_VECTOR_SET_IO_H_
 #define ZIRCON_CORE_VECTOR_SET_IO_H_
 
+#include <memory>
 #include "turbo/files/sequential_write_file.h"
 #include "turbo/files/sequential_read_file.h"
 #include "zircon/core/defines.h"
@@ -66,6 +67,14 @@ namespace zircon {
 
         virtual turbo::Status write_batch(turbo::Span<uint8_t> vector, std::size_t batch_size) = 0;
 
+        /**
+         * @brief write the buffered records to the file, see
+         *        SerializeOption::write_buffer_bytes. with a buffer, must be
+         *        called once the last record is written and before the file is
+         *        closed, nothing to do without.
+         */
+        turbo::Status flush();
+
         [[nodiscard]] std::size_t has_write() const {
             return _has_write;
         }
@@ -73,12 +82,24 @@ namespace zircon {
     protected:
         virtual turbo::Status init() = 0;
 
+        /**
+         * @brief copy bytes to the write buffer. the buffer goes to the file
+         *        once full, so the file is written by whole buffers at offsets
+         *        multiple of the buffer size, and the whole buffers of a large
+         *        write go from data directly.
+         */
+        turbo::Status append(const void *data, std::size_t size);
+
     protected:
         turbo::SequentialWriteFile *_file{nullptr};
         SerializeOption _option;
         size_t _element_size{0};
         size_t _vector_bytes{0};
         size_t _has_write{0};
+
+    private:
+        std::unique_ptr<char[]> _buffer;
+        size_t _buffered{0};
     };
 
 }  // namespace zircon
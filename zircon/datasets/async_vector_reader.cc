@@ -0,0 +1,374 @@
+// Copyright 2023 The Elastic-AI Authors.
+// part of Elastic AI Search
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#include "zircon/datasets/async_vector_reader.h"
+#include <cerrno>
+#include <cstring>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include "turbo/log/logging.h"
+#include "zircon/core/allocator.h"
+
+namespace zircon {
+
+    namespace {
+        constexpr std::size_t kIoAlign = Allocator::page_alignment;
+
+        constexpr std::size_t align_down(std::size_t n) {
+            return n / kIoAlign * kIoAlign;
+        }
+
+        constexpr std::size_t align_up(std::size_t n) {
+            return (n + kIoAlign - 1) / kIoAlign * kIoAlign;
+        }
+    }  // namespace
+
+    struct AsyncVectorSetReader::Slot {
+        explicit Slot(std::size_t n) : capacity(n) {
+            buf = Allocator::get_instance().allocate_pages(capacity);
+        }
+
+        ~Slot() {
+            Allocator::get_instance().deallocate_pages(buf, capacity);
+        }
+
+        IoRequest req;
+        uint8_t *buf{nullptr};
+        std::size_t capacity{0};
+        // bytes from the aligned start of the read to the first record
+        std::size_t skip{0};
+        std::size_t first{0};
+        std::size_t count{0};
+        // where a gathered vector goes
+        std::size_t tag{0};
+        bool busy{false};
+        bool ready{false};
+    };
+
+    AsyncVectorSetReader::AsyncVectorSetReader() = default;
+
+    AsyncVectorSetReader::~AsyncVectorSetReader() {
+        close();
+    }
+
+    turbo::Status
+    AsyncVectorSetReader::open(const std::string &path, const SerializeOption &option, const AsyncReadOption &aop) {
+        close();
+        if (aop.format != VectorFileFormat::FORMAT_FVECS && aop.format != VectorFileFormat::FORMAT_BIN) {
+            return turbo::invalid_argument_error("only fvecs and bin have fixed size records");
+        }
+        auto element_size = data_type_size(option.data_type);
+        if (element_size == 0 || option.dimension == 0 || aop.batch_size == 0) {
+            return turbo::invalid_argument_error("data type, dimension and batch size should be set");
+        }
+        _option = option;
+        _aop = aop;
+        _aop.queue_depth = std::max<std::size_t>(_aop.queue_depth, 1);
+        _vector_bytes = option.dimension * element_size;
+        _record_bytes = _aop.format == VectorFileFormat::FORMAT_FVECS ? _vector_bytes + sizeof(uint32_t)
+                                                                       : _vector_bytes;
+        _header_bytes = _aop.format == VectorFileFormat::FORMAT_BIN ? 2 * sizeof(uint32_t) : 0;
+
+        Slot probe(kIoAlign);
+        ssize_t nprobe = -1;
+#if defined(O_DIRECT)
+        if (_aop.direct_io) {
+            _fd = ::open(path.c_str(), O_RDONLY | O_DIRECT);
+            if (_fd >= 0) {
+                nprobe = ::pread(_fd, probe.buf, kIoAlign, 0);
+                if (nprobe < 0) {
+                    // the file system take the flag but not the reads
+                    ::close(_fd);
+                    _fd = -1;
+                }
+            }
+        }
+#endif
+        _direct_io = _fd >= 0;
+        if (_fd < 0) {
+            _fd = ::open(path.c_str(), O_RDONLY);
+            if (_fd < 0) {
+                return turbo::errno_to_status(errno, "open " + path);
+            }
+            nprobe = ::pread(_fd, probe.buf, kIoAlign, 0);
+        }
+        struct stat st;
+        if (nprobe < 0 || ::fstat(_fd, &st) != 0) {
+            auto rs = turbo::errno_to_status(errno, "read " + path);
+            close();
+            return rs;
+        }
+        _file_size = static_cast<std::size_t>(st.st_size);
+        auto probed = static_cast<std::size_t>(nprobe);
+        if (_aop.format == VectorFileFormat::FORMAT_BIN) {
+            uint32_t header[2];
+            if (probed < sizeof(header)) {
+                close();
+                return turbo::data_loss_error("bad format, {} has no header", path);
+            }
+            std::memcpy(header, probe.buf, sizeof(header));
+            if (header[1] != option.dimension) {
+                close();
+                return turbo::data_loss_error("bad format, dimension read from file {} but option {}", header[1],
+                                              option.dimension);
+            }
+            _nvecs = header[0];
+            if (_header_bytes + _nvecs * _record_bytes > _file_size) {
+                close();
+                return turbo::data_loss_error("file truncated, header claim {} vectors", _nvecs);
+            }
+        } else {
+            if (_file_size % _record_bytes != 0) {
+                close();
+                return turbo::data_loss_error("file truncated in the middle of a record");
+            }
+            _nvecs = _file_size / _record_bytes;
+        }
+
+        const auto depth = _aop.queue_depth;
+        // room for the chunk reads and the gather reads
+        auto engine = make_io_engine(_aop.backend, 2 * depth, _aop.io_threads);
+        if (!engine.ok()) {
+            close();
+            return engine.status();
+        }
+        _engine = std::move(engine.value());
+        _backend = _engine->backend();
+
+        // the chunk slots, a read may start up to one block before the first record
+        const std::size_t chunk_capacity = align_up(_aop.batch_size * _record_bytes) + 2 * kIoAlign;
+        for (std::size_t i = 0; i < depth; ++i) {
+            _slots.push_back(std::make_unique<Slot>(chunk_capacity));
+        }
+        const std::size_t gather_capacity = align_up(_record_bytes) + 2 * kIoAlign;
+        for (std::size_t i = 0; i < depth; ++i) {
+            _slots.push_back(std::make_unique<Slot>(gather_capacity));
+        }
+        _nchunks = (_nvecs + _aop.batch_size - 1) / _aop.batch_size;
+        for (std::size_t c = 0; c < std::min(depth, _nchunks); ++c) {
+            auto first = c * _aop.batch_size;
+            auto rs = submit(*_slots[c], first, std::min(_aop.batch_size, _nvecs - first));
+            if (!rs.ok()) {
+                close();
+                return rs;
+            }
+        }
+        return turbo::ok_status();
+    }
+
+    turbo::Status AsyncVectorSetReader::submit(Slot &slot, std::size_t first, std::size_t count) {
+        auto begin = _header_bytes + first * _record_bytes;
+        auto end = begin + count * _record_bytes;
+        auto abegin = align_down(begin);
+        auto len = align_up(end) - abegin;
+        TLOG_CHECK(len <= slot.capacity, "read of {} bytes overflow the slot", len);
+        slot.skip = begin - abegin;
+        slot.first = first;
+        slot.count = count;
+        slot.busy = true;
+        slot.ready = false;
+        slot.req = IoRequest{};
+        slot.req.fd = _fd;
+        slot.req.buf = slot.buf;
+        slot.req.len = len;
+        slot.req.offset = abegin;
+        slot.req.owner = &slot;
+        auto rs = _engine->submit(&slot.req);
+        if (!rs.ok()) {
+            slot.busy = false;
+            return rs;
+        }
+        ++_inflight;
+        return turbo::ok_status();
+    }
+
+    turbo::Status AsyncVectorSetReader::wait_one() {
+        if (_inflight == 0) {
+            // the engine would block forever
+            return turbo::failed_precondition_error("no read in flight");
+        }
+        auto rs = _engine->wait();
+        if (!rs.ok()) {
+            return rs.status();
+        }
+        auto *slot = static_cast<Slot *>(rs.value()->owner);
+        slot->ready = true;
+        --_inflight;
+        return turbo::ok_status();
+    }
+
+    turbo::Status AsyncVectorSetReader::unpack(const Slot &slot, uint8_t *dst) const {
+        if (slot.req.error != 0) {
+            return turbo::errno_to_status(slot.req.error, "read vectors");
+        }
+        if (slot.req.done < slot.skip + slot.count * _record_bytes) {
+            return turbo::data_loss_error("file truncated at vector {}", slot.first);
+        }
+        const uint8_t *src = slot.buf + slot.skip;
+        if (_aop.format == VectorFileFormat::FORMAT_BIN) {
+            std::memcpy(dst, src, slot.count * _vector_bytes);
+            return turbo::ok_status();
+        }
+        for (std::size_t i = 0; i < slot.count; ++i) {
+            uint32_t dim;
+            std::memcpy(&dim, src + i * _record_bytes, sizeof(dim));
+            if (dim != _option.dimension) {
+                return turbo::data_loss_error("bad format, dimension {} at vector {} but option {}", dim,
+                                              slot.first + i, _option.dimension);
+            }
+            std::memcpy(dst + i * _vector_bytes, src + i * _record_bytes + sizeof(uint32_t), _vector_bytes);
+        }
+        return turbo::ok_status();
+    }
+
+    turbo::Status AsyncVectorSetReader::next_batch(VectorBatch *batch) {
+        if (_fd < 0) {
+            return turbo::failed_precondition_error("reader not opened");
+        }
+        if (!_status.ok()) {
+            return _status;
+        }
+        if (_next_chunk >= _nchunks) {
+            return turbo::reach_file_end_error("file reach eof");
+        }
+        if (batch->capacity() == 0) {
+            auto rs = batch->init(_vector_bytes, _aop.batch_size);
+            if (!rs.ok()) {
+                return rs;
+            }
+        } else if (batch->capacity() < _aop.batch_size || batch->vector_byte_size() != _vector_bytes) {
+            return turbo::invalid_argument_error("batch do not fit the chunks");
+        }
+        auto &slot = *_slots[_next_chunk % _aop.queue_depth];
+        while (!slot.ready) {
+            auto rs = wait_one();
+            if (!rs.ok()) {
+                _status = rs;
+                return rs;
+            }
+        }
+        auto rs = unpack(slot, batch->data());
+        slot.ready = false;
+        slot.busy = false;
+        if (!rs.ok()) {
+            // the chunk is not read again, the next ones would be out of order
+            _status = rs;
+            return rs;
+        }
+        batch->resize(slot.count);
+        _has_read += slot.count;
+        // keep the pipeline full
+        auto c = _next_chunk + _aop.queue_depth;
+        if (c < _nchunks) {
+            auto first = c * _aop.batch_size;
+            rs = submit(slot, first, std::min(_aop.batch_size, _nvecs - first));
+            if (!rs.ok()) {
+                _status = rs;
+                return rs;
+            }
+        }
+        ++_next_chunk;
+        return turbo::ok_status();
+    }
+
+    turbo::Status AsyncVectorSetReader::gather(turbo::Span<const std::size_t> ids, turbo::Span<uint8_t> out) {
+        if (_fd < 0) {
+            return turbo::failed_precondition_error("reader not opened");
+        }
+        if (!_status.ok()) {
+            return _status;
+        }
+        TLOG_CHECK(out.size() >= ids.size() * _vector_bytes, "not enough space to read vectors");
+        for (auto id: ids) {
+            if (id >= _nvecs) {
+                return turbo::out_of_range_error("vector {} out of {}", id, _nvecs);
+            }
+        }
+        const auto depth = _aop.queue_depth;
+        turbo::Status status;
+        std::size_t next = 0;
+        std::size_t completed = 0;
+        std::size_t busy = 0;
+        while (completed < ids.size()) {
+            for (std::size_t i = depth; i < 2 * depth && next < ids.size() && status.ok(); ++i) {
+                auto &slot = *_slots[i];
+                if (slot.busy) {
+                    continue;
+                }
+                auto rs = submit(slot, ids[next], 1);
+                if (!rs.ok()) {
+                    status = rs;
+                    break;
+                }
+                slot.tag = next++;
+                ++busy;
+            }
+            if (busy == 0) {
+                // nothing in flight, a submit failed
+                return status;
+            }
+            auto rs = wait_one();
+            if (!rs.ok()) {
+                // the reads in flight are lost, the chunks with them
+                _status = rs;
+                return rs;
+            }
+            for (std::size_t i = depth; i < 2 * depth; ++i) {
+                auto &slot = *_slots[i];
+                if (!slot.ready) {
+                    continue;
+                }
+                rs = unpack(slot, out.data() + slot.tag * _vector_bytes);
+                if (!rs.ok() && status.ok()) {
+                    status = rs;
+                }
+                slot.ready = false;
+                slot.busy = false;
+                --busy;
+                ++completed;
+            }
+            if (!status.ok()) {
+                // stop submitting, drain what is in flight
+                next = ids.size();
+                completed = ids.size() - busy;
+            }
+        }
+        return status;
+    }
+
+    void AsyncVectorSetReader::close() {
+        while (_inflight > 0 && _engine != nullptr) {
+            if (!wait_one().ok()) {
+                break;
+            }
+        }
+        _engine.reset();
+        _slots.clear();
+        if (_fd >= 0) {
+            ::close(_fd);
+        }
+        _fd = -1;
+        _inflight = 0;
+        _status = turbo::ok_status();
+        _nvecs = 0;
+        _nchunks = 0;
+        _next_chunk = 0;
+        _has_read = 0;
+        _direct_io = false;
+        _backend = AsyncIoBackend::IO_AUTO;
+    }
+
+}  // namespace zircon
@@ -0,0 +1,133 @@
+// Copyright 2023 The Elastic-AI Authors.
+// part of Elastic AI Search
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#ifndef ZIRCON_DATASETS_ASYNC_VECTOR_READER_H_
+#define ZIRCON_DATASETS_ASYNC_VECTOR_READER_H_
+
+#include <memory>
+#include <string>
+#include <vector>
+#include "turbo/base/status.h"
+#include "turbo/meta/span.h"
+#include "zircon/core/defines.h"
+#include "zircon/core/io_engine.h"
+#include "zircon/datasets/vector_set_loader.h"
+#include "zircon/store/vector_batch.h"
+
+namespace zircon {
+
+    struct AsyncReadOption {
+        // FORMAT_FVECS or FORMAT_BIN, the records are fixed size
+        VectorFileFormat format{VectorFileFormat::FORMAT_BIN};
+        // vectors per chunk returned by next_batch
+        std::size_t batch_size{constants::kBatchSize};
+        // chunk reads in flight
+        std::size_t queue_depth{4};
+        // bypass the page cache, fall back to buffered reads if the file system refuse it
+        bool direct_io{true};
+        AsyncIoBackend backend{AsyncIoBackend::IO_AUTO};
+        // threads of the thread pool backend
+        std::size_t io_threads{4};
+    };
+
+    /**
+     * @brief read a fvecs or bin file with several chunk reads in flight.
+     *        the reads go to page aligned buffers of zircon::Allocator, with
+     *        direct io they do not go through the page cache. next_batch
+     *        return the chunks in file order, the records are unpacked into
+     *        a VectorBatch. gather read scattered vectors with all the reads
+     *        submitted at once, eg. for a rerank from disk.
+     *        not thread safe, one thread drive a reader.
+     */
+    class AsyncVectorSetReader {
+    public:
+        AsyncVectorSetReader();
+
+        ~AsyncVectorSetReader();
+
+        turbo::Status open(const std::string &path, const SerializeOption &option, const AsyncReadOption &aop);
+
+        /**
+         * @brief the next chunk of the file, at most batch_size vectors.
+         * @param batch initialized with batch_size vectors if empty, else must
+         *        have the capacity and the vector size of the chunks.
+         * @return reach file end after the last chunk. once a chunk fails, eg.
+         *         a bad fvecs record, every later call return that error.
+         */
+        turbo::Status next_batch(VectorBatch *batch);
+
+        /**
+         * @brief read the vectors ids, out[i] get the vector ids[i]. can be
+         *        mixed with next_batch. fails with the error of the chunks if
+         *        next_batch failed.
+         */
+        turbo::Status gather(turbo::Span<const std::size_t> ids, turbo::Span<uint8_t> out);
+
+        // wait for the reads in flight and close the file
+        void close();
+
+        [[nodiscard]] std::size_t num_vectors() const {
+            return _nvecs;
+        }
+
+        [[nodiscard]] std::size_t has_read() const {
+            return _has_read;
+        }
+
+        [[nodiscard]] bool is_direct_io() const {
+            return _direct_io;
+        }
+
+        // the backend in use, never IO_AUTO once opened
+        [[nodiscard]] AsyncIoBackend backend() const {
+            return _backend;
+        }
+
+    private:
+        struct Slot;
+
+        turbo::Status submit(Slot &slot, std::size_t first, std::size_t count);
+
+        // wait for any read in flight
+        turbo::Status wait_one();
+
+        // copy the records of a completed slot to dst, vector_bytes each
+        turbo::Status unpack(const Slot &slot, uint8_t *dst) const;
+
+    private:
+        int _fd{-1};
+        SerializeOption _option;
+        AsyncReadOption _aop;
+        bool _direct_io{false};
+        AsyncIoBackend _backend{AsyncIoBackend::IO_AUTO};
+        std::unique_ptr<IoEngine> _engine;
+        std::size_t _file_size{0};
+        std::size_t _header_bytes{0};
+        std::size_t _vector_bytes{0};
+        std::size_t _record_bytes{0};
+        std::size_t _nvecs{0};
+        std::size_t _has_read{0};
+        std::size_t _next_chunk{0};
+        std::size_t _nchunks{0};
+        std::size_t _inflight{0};
+        // the first error of the chunk pipeline, the pipeline stopped
+        turbo::Status _status;
+        // the chunk slots, then the gather slots
+        std::vector<std::unique_ptr<Slot>> _slots;
+    };
+
+}  // namespace zircon
+
+#endif  // ZIRCON_DATASETS_ASYNC_VECTOR_READER_H_
@@ -13,6 +13,7 @@
 //
 
 #include "zircon/datasets/bin_vector_io.h"
+#include "turbo/log/logging.h"
 
 namespace zircon {
 
@@ -30,8 +31,8 @@ namespace zircon {
         _nvecs = nvec;
         _ndims = dim;
         if (_ndims != _option.dimension) {
-            return turbo::UnavailableError("bad format, option dimension: {} dimension read form file {}, not the same",
-                                           _option.dimension, _ndims);
+            return turbo::unavailable_error("bad format, option dimension: {} dimension read form file {}, not the same",
+                                            _option.dimension, _ndims);
         }
         return turbo::ok_status();
     }
@@ -63,12 +64,12 @@ namespace zircon {
     turbo::Status BinaryVectorSetWriter::init() {
         uint32_t nvec = _option.n_vectors;
         uint32_t dim = _option.dimension;
-        auto r = _file->write(reinterpret_cast<const char *>(&nvec), sizeof(nvec));
+        auto r = append(&nvec, sizeof(nvec));
         if (!r.ok()) {
             return r;
         }
 
-        r = _file->write(reinterpret_cast<const char *>(&dim), sizeof(dim));
+        r = append(&dim, sizeof(dim));
         if (!r.ok()) {
             return r;
         }
@@ -77,10 +78,10 @@ namespace zircon {
 
     turbo::Status BinaryVectorSetWriter::write_vector(turbo::Span<uint8_t> vector) {
         if(_has_write >= _option.n_vectors) {
-            return turbo::OutOfRangeError("read the max vector size");
+            return turbo::out_of_range_error("read the max vector size");
         }
         TLOG_CHECK(_vector_bytes <= vector.size(), "not enough space to read vector");
-        auto r = _file->write(reinterpret_cast<const char *>(vector.data()), _vector_bytes);
+        auto r = append(vector.data(), _vector_bytes);
         if (!r.ok()) {
             return r;
         }
@@ -90,14 +91,14 @@ namespace zircon {
 
     turbo::Status BinaryVectorSetWriter::write_batch(turbo::Span<uint8_t> vector, std::size_t batch_size) {
         if(_has_write + batch_size > _option.n_vectors) {
-            return turbo::OutOfRangeError("read the max vector size");
+            return turbo::out_of_range_error("read the max vector size");
         }
         TLOG_CHECK(_vector_bytes * batch_size <= vector.size(), "not enough space to read vector");
-        auto r = _file->write(reinterpret_cast<const char *>(vector.data()), _vector_bytes * batch_size);
+        auto r = append(vector.data(), _vector_bytes * batch_size);
         if (!r.ok()) {
             return r;
         }
         _has_write += batch_size;
         return turbo::ok_status();
     }
-}  // namespace tann
+}  // namespace zircon
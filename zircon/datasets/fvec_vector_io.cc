@@ -13,6 +13,7 @@
 //
 
 #include "zircon/datasets/fvec_vector_io.h"
+#include "turbo/log/logging.h"
 
 namespace zircon {
 
@@ -71,11 +72,12 @@ namespace zircon {
     turbo::Status FvecVectorSetWriter::write_vector(turbo::Span<uint8_t> vector) {
         TLOG_CHECK(_vector_bytes <= vector.size(), "not enough space to read vector");
         uint32_t ndims = _option.dimension;
-        auto r = _file->write(reinterpret_cast<const char *>(&ndims), sizeof(ndims));
+        // the header and the body of the record land in the same buffer
+        auto r = append(&ndims, sizeof(ndims));
         if (!r.ok()) {
             return r;
         }
-        r = _file->write(reinterpret_cast<const char *>(vector.data()), _vector_bytes);
+        r = append(vector.data(), _vector_bytes);
         if (!r.ok()) {
             return r;
         }
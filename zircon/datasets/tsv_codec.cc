@@ -0,0 +1,246 @@
+// Copyright 2023 The Elastic-AI Authors.
+// part of Elastic AI Search
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#include "zircon/datasets/tsv_codec.h"
+#include <charconv>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#if defined(__SSE2__) || defined(__AVX2__)
+#include <immintrin.h>
+#elif defined(__aarch64__)
+#include <arm_neon.h>
+#endif
+
+namespace zircon::tsv {
+
+    namespace {
+        // enough for any float, "-1.17549435e-38" with room to spare
+        constexpr std::size_t kMaxFloatChars = 24;
+
+        constexpr float kPow10[] = {1e0f, 1e1f, 1e2f, 1e3f, 1e4f, 1e5f, 1e6f, 1e7f, 1e8f, 1e9f, 1e10f};
+
+        inline bool is_blank(char c) {
+            return c == ' ' || c == '\t' || c == '\r';
+        }
+
+        inline bool is_digit(char c) {
+            return static_cast<unsigned char>(c - '0') < 10;
+        }
+
+        // strtof over a terminated copy of [p, s), the slow but exact path
+        const char *parse_float_slow(const char *p, const char *s, float *out) {
+            char buf[64];
+            auto len = static_cast<std::size_t>(s - p);
+            if (len == 0 || len >= sizeof(buf)) {
+                return nullptr;
+            }
+            std::memcpy(buf, p, len);
+            buf[len] = '\0';
+            char *stop = nullptr;
+            *out = std::strtof(buf, &stop);
+            if (stop != buf + len) {
+                return nullptr;
+            }
+            return s;
+        }
+    }  // namespace
+
+    const char *find_line_end(const char *p, const char *end) {
+#if defined(__AVX2__)
+        const __m256i nl32 = _mm256_set1_epi8('\n');
+        while (end - p >= 32) {
+            auto v = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(p));
+            auto m = static_cast<uint32_t>(_mm256_movemask_epi8(_mm256_cmpeq_epi8(v, nl32)));
+            if (m != 0) {
+                return p + __builtin_ctz(m);
+            }
+            p += 32;
+        }
+#endif
+#if defined(__SSE2__)
+        const __m128i nl = _mm_set1_epi8('\n');
+        while (end - p >= 16) {
+            auto v = _mm_loadu_si128(reinterpret_cast<const __m128i *>(p));
+            auto m = static_cast<uint32_t>(_mm_movemask_epi8(_mm_cmpeq_epi8(v, nl)));
+            if (m != 0) {
+                return p + __builtin_ctz(m);
+            }
+            p += 16;
+        }
+#elif defined(__aarch64__)
+        const uint8x16_t nl = vdupq_n_u8('\n');
+        while (end - p >= 16) {
+            auto eq = vceqq_u8(vld1q_u8(reinterpret_cast<const uint8_t *>(p)), nl);
+            // 4 bits per byte
+            auto m = vget_lane_u64(vreinterpret_u64_u8(vshrn_n_u16(vreinterpretq_u16_u8(eq), 4)), 0);
+            if (m != 0) {
+                return p + (__builtin_ctzll(m) >> 2);
+            }
+            p += 16;
+        }
+#endif
+        while (p < end && *p != '\n') {
+            ++p;
+        }
+        return p;
+    }
+
+    bool is_blank_line(const char *p, const char *eol) {
+        while (p < eol && is_blank(*p)) {
+            ++p;
+        }
+        return p == eol;
+    }
+
+    const char *parse_float(const char *p, const char *end, float *out) {
+        while (p < end && is_blank(*p)) {
+            ++p;
+        }
+        if (p == end) {
+            return nullptr;
+        }
+#if defined(__cpp_lib_to_chars)
+        const char *s = p;
+        // from_chars take no leading '+'
+        if (*s == '+' && s + 1 < end && (is_digit(s[1]) || s[1] == '.')) {
+            ++s;
+        }
+        auto r = std::from_chars(s, end, *out);
+        if (r.ec == std::errc()) {
+            return r.ptr;
+        }
+        if (r.ec == std::errc::result_out_of_range) {
+            // inf or denormal zero like strtof
+            return detail::parse_float_generic(p, end, out);
+        }
+        return nullptr;
+#else
+        return detail::parse_float_generic(p, end, out);
+#endif
+    }
+
+    namespace detail {
+        const char *parse_float_generic(const char *p, const char *end, float *out) {
+            while (p < end && is_blank(*p)) {
+                ++p;
+            }
+            const char *s = p;
+            bool neg = false;
+            if (s < end && (*s == '-' || *s == '+')) {
+                neg = *s == '-';
+                ++s;
+            }
+            uint64_t m = 0;
+            int digits = 0;
+            int exp10 = 0;
+            bool any = false;
+            bool truncated = false;
+            for (; s < end && is_digit(*s); ++s) {
+                any = true;
+                if (digits < 19) {
+                    m = m * 10 + static_cast<uint64_t>(*s - '0');
+                    digits += m != 0;
+                } else {
+                    truncated = true;
+                    ++exp10;
+                }
+            }
+            if (s < end && *s == '.') {
+                for (++s; s < end && is_digit(*s); ++s) {
+                    any = true;
+                    if (digits < 19) {
+                        m = m * 10 + static_cast<uint64_t>(*s - '0');
+                        digits += m != 0;
+                        --exp10;
+                    } else {
+                        truncated = true;
+                    }
+                }
+            }
+            if (!any) {
+                // inf, nan or garbage, let strtof decide on the whole token
+                while (s < end && !is_blank(*s) && *s != '\n') {
+                    ++s;
+                }
+                return parse_float_slow(p, s, out);
+            }
+            if (s < end && (*s == 'e' || *s == 'E')) {
+                const char *e = s + 1;
+                bool eneg = false;
+                if (e < end && (*e == '-' || *e == '+')) {
+                    eneg = *e == '-';
+                    ++e;
+                }
+                if (e < end && is_digit(*e)) {
+                    int ev = 0;
+                    for (; e < end && is_digit(*e); ++e) {
+                        if (ev < 100000) {
+                            ev = ev * 10 + (*e - '0');
+                        }
+                    }
+                    exp10 += eneg ? -ev : ev;
+                    s = e;
+                }
+            }
+            // m and 10^exp10 are exact floats, one rounding gives the right float
+            if (!truncated && m <= (uint64_t{1} << 24) && exp10 >= -10 && exp10 <= 10) {
+                auto f = static_cast<float>(m);
+                f = exp10 < 0 ? f / kPow10[-exp10] : f * kPow10[exp10];
+                *out = neg ? -f : f;
+                return s;
+            }
+            return parse_float_slow(p, s, out);
+        }
+    }  // namespace detail
+
+    turbo::Status parse_line(const char *p, const char *eol, std::size_t dim, float *out) {
+        for (std::size_t i = 0; i < dim; ++i) {
+            auto *next = parse_float(p, eol, out + i);
+            if (next == nullptr) {
+                return turbo::data_loss_error("bad format, field {} is not a float or missing", i);
+            }
+            if (next < eol && !is_blank(*next)) {
+                return turbo::data_loss_error("bad format, field {} is not a float", i);
+            }
+            p = next;
+        }
+        if (!is_blank_line(p, eol)) {
+            return turbo::data_loss_error("bad format, more than {} fields", dim);
+        }
+        return turbo::ok_status();
+    }
+
+    void append_line(const float *values, std::size_t dim, std::string *out) {
+        auto base = out->size();
+        out->resize(base + dim * (kMaxFloatChars + 1) + 1);
+        char *p = out->data() + base;
+        char *stop = out->data() + out->size();
+        for (std::size_t i = 0; i < dim; ++i) {
+            if (i != 0) {
+                *p++ = '\t';
+            }
+#if defined(__cpp_lib_to_chars)
+            p = std::to_chars(p, stop, values[i]).ptr;
+#else
+            p += std::snprintf(p, kMaxFloatChars, "%.9g", static_cast<double>(values[i]));
+#endif
+        }
+        *p++ = '\n';
+        out->resize(static_cast<std::size_t>(p - out->data()));
+    }
+
+}  // namespace zircon::tsv
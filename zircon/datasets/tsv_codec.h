@@ -0,0 +1,62 @@
+// Copyright 2023 The Elastic-AI Authors.
+// part of Elastic AI Search
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#ifndef ZIRCON_DATASETS_TSV_CODEC_H_
+#define ZIRCON_DATASETS_TSV_CODEC_H_
+
+#include <cstddef>
+#include <string>
+#include "turbo/base/status.h"
+
+namespace zircon::tsv {
+
+    /**
+     * @brief the first '\n' in [p, end), end if none. 16 or 32 bytes are
+     *        compared at a time with the simd of the build target.
+     */
+    const char *find_line_end(const char *p, const char *end);
+
+    // true if [p, eol) is only spaces, tabs and '\r'
+    bool is_blank_line(const char *p, const char *eol);
+
+    /**
+     * @brief decode the float at p, leading blanks are skipped. never read
+     *        at or past end, the buffer need not be terminated.
+     * @return the first char after the float, nullptr if there is none.
+     */
+    const char *parse_float(const char *p, const char *end, float *out);
+
+    /**
+     * @brief decode the line [p, eol) of exactly dim values straight into out,
+     *        fields are separated by tabs or spaces, '\r' before eol is allowed.
+     */
+    turbo::Status parse_line(const char *p, const char *eol, std::size_t dim, float *out);
+
+    /**
+     * @brief append dim values tab separated and a '\n' to out, every value is
+     *        written with the shortest digits that read back to the same float,
+     *        9 significant digits if the standard library has no float to_chars.
+     *        out is only grown, reuse it to write without allocation.
+     */
+    void append_line(const float *values, std::size_t dim, std::string *out);
+
+    namespace detail {
+        // the portable decoder, used when the standard library has no float from_chars
+        const char *parse_float_generic(const char *p, const char *end, float *out);
+    }  // namespace detail
+
+}  // namespace zircon::tsv
+
+#endif  // ZIRCON_DATASETS_TSV_CODEC_H_
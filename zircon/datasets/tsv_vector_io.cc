@@ -12,120 +12,109 @@
 // limitations under the License.
 //
 #include "zircon/datasets/tsv_vector_io.h"
-#include "turbo/strings/str_split.h"
-#include "turbo/strings/str_trim.h"
-#include "turbo/strings/numbers.h"
-#include "zircon/core/allocator.h"
-#include "turbo/meta/reflect.h"
+#include <cstring>
+#include "zircon/datasets/tsv_codec.h"
+#include "zircon/utility/float16.h"
+#include "turbo/log/logging.h"
 
 namespace zircon {
 
-    namespace detail {
+    namespace {
+        constexpr std::size_t kBlockSize = 1 << 20;
+    }  // namespace
 
-        template <typename T>
-        turbo::Status convert_to_vector(const std::string&line, std::size_t ndim, turbo::Span<uint8_t> &vector) {
-            auto span = to_span<T>(vector);
-            auto sv = turbo::TrimRight(line);
-            std::vector<std::string_view> elems = turbo::StrSplit(sv, '\t', turbo::SkipEmpty());
-            if(elems.size() != ndim) {
-                return turbo::DataLossError("bad format");
-            }
-            constexpr bool is_inttype = std::is_integral_v<T>;
-            for(size_t i = 0; i < ndim; ++i) {
-                if constexpr (is_inttype) {
-                    turbo::ResultStatus<int64_t> rs = turbo::Atoi<int64_t>(elems[i]);
-                    if(!rs.ok()) {
-                        return rs.status();
-                    }
-                    span[i] = static_cast<T>(rs.value());
-                } else {
-                    turbo::ResultStatus<float> rs = turbo::Atof(elems[i]);
-                    if(!rs.ok()) {
-                        return rs.status();
-                    }
-                    span[i] = static_cast<T>(rs.value());
-                }
-            }
-            return turbo::ok_status();
-        }
-        template  turbo::Status convert_to_vector<uint8_t>(const std::string&line, std::size_t ndim, turbo::Span<uint8_t> &vector);
-        template  turbo::Status convert_to_vector<float16>(const std::string&line, std::size_t ndim, turbo::Span<uint8_t> &vector);
-        template  turbo::Status convert_to_vector<float>(const std::string&line, std::size_t ndim, turbo::Span<uint8_t> &vector);
-
-        template <typename T>
-       turbo::Status convert_to_string(std::size_t ndim, turbo::Span<uint8_t> vector, std::string *result) {
-            auto span = to_span<T>(vector);
-            if(span.size() != ndim) {
-                return turbo::DataLossError("bad format");
-            }
-            *result = turbo::FormatRange("{}", span.begin(), span.end(), "\t");
-            return turbo::ok_status();
-        }
-
-        template turbo::Status convert_to_string<uint8_t>(std::size_t ndim, turbo::Span<uint8_t> vector, std::string *result);
-        template turbo::Status convert_to_string<float16>(std::size_t ndim, turbo::Span<uint8_t> vector, std::string *result);
-        template turbo::Status convert_to_string<float>(std::size_t ndim, turbo::Span<uint8_t> vector, std::string *result);
-    }  // namespace detail
     turbo::Status TsvVectorSetReader::init() {
+        if (data_type_size(_option.data_type) == 0) {
+            return turbo::invalid_argument_error("data type parameter error {}", static_cast<int>(_option.data_type));
+        }
         return turbo::ok_status();
     }
 
-    turbo::Status TsvVectorSetReader::read_vector(turbo::Span<uint8_t> &vector) {
-        static constexpr size_t KTmpSize = 4096;
-        std::string line;
-        line.reserve(KTmpSize);
-        bool find_eol = false;
-        bool feof = false;
-        while (!find_eol) {
-            if(_cache_buf.empty()) {
-                if(_file->is_eof()) {
-                    feof = true;
-                    break;
+    turbo::Status TsvVectorSetReader::next_line(const char **line, const char **eol) {
+        while (true) {
+            const char *begin = _buf.data() + _pos;
+            const char *end = _buf.data() + _buf.size();
+            const char *nl = tsv::find_line_end(begin, end);
+            if (nl != end || _eof) {
+                if (begin == end) {
+                    return turbo::reach_file_end_error("file reach eof");
                 }
-                std::string temp;
-                auto r = _file->read(&temp, KTmpSize);
-                if (!r.ok()) {
-                    if(turbo::IsReachFileEnd(r.status())) {
-                        feof = true;
-                    } else {
-                        return r.status();
-                    }
+                _pos = nl == end ? _buf.size() : static_cast<std::size_t>(nl - _buf.data()) + 1;
+                if (tsv::is_blank_line(begin, nl)) {
+                    continue;
                 }
-                _cache_buf.append(temp);
+                *line = begin;
+                *eol = nl;
+                return turbo::ok_status();
             }
-            auto it = _cache_buf.char_begin();
-            size_t n = 0;
-            while(it != _cache_buf.char_end() && !find_eol) {
-                if ((*it =='\n') && !line.empty()) {
-                    find_eol = true;
-                } else {
-                    line.append(1, *it);
+            // keep the partial line and read the next block after it
+            _buf.erase(0, _pos);
+            _pos = 0;
+            auto base = _buf.size();
+            _buf.resize(base + kBlockSize);
+            auto r = _file->read(_buf.data() + base, kBlockSize);
+            if (!r.ok()) {
+                if (!turbo::is_reach_file_end(r.status())) {
+                    _buf.resize(base);
+                    return r.status();
                 }
-                ++n;
-                ++it;
+                _buf.resize(base);
+                _eof = true;
+                continue;
             }
-            _cache_buf.remove_prefix(n);
+            _buf.resize(base + r.value());
+            _eof = r.value() < kBlockSize || _file->is_eof();
         }
-        if(line.empty() && feof) {
-            return turbo::ReachFileEnd("file reach eof");
+    }
+
+    turbo::Status TsvVectorSetReader::read_vector(turbo::Span<uint8_t> &vector) {
+        TLOG_CHECK(_vector_bytes <= vector.size(), "not enough space to read vector");
+        const char *line = nullptr;
+        const char *eol = nullptr;
+        auto rs = next_line(&line, &eol);
+        if (!rs.ok()) {
+            return rs;
         }
         ++_has_read;
-        if(_option.data_type == DataType::DT_UINT8) {
-            return detail::convert_to_vector<uint8_t>(line, _option.dimension, vector);
-        } else if(_option.data_type == DataType::DT_FLOAT16) {
-            return detail::convert_to_vector<float16>(line, _option.dimension, vector);
-        } else if(_option.data_type == DataType::DT_FLOAT) {
-            return detail::convert_to_vector<float>(line, _option.dimension, vector);
+        if (_option.data_type == DataType::DT_FLOAT) {
+            // straight into the destination
+            return tsv::parse_line(line, eol, _option.dimension, reinterpret_cast<float *>(vector.data()));
         }
-        return turbo::InvalidArgumentError("data type parameter error {}", turbo::nameof_enum(_option.data_type));
+        _row.resize(_option.dimension);
+        rs = tsv::parse_line(line, eol, _option.dimension, _row.data());
+        if (!rs.ok()) {
+            return rs;
+        }
+        return convert_row(vector);
+    }
+
+    turbo::Status TsvVectorSetReader::convert_row(turbo::Span<uint8_t> &vector) {
+        if (_option.data_type == DataType::DT_UINT8) {
+            for (std::size_t i = 0; i < _option.dimension; ++i) {
+                vector[i] = static_cast<uint8_t>(static_cast<int64_t>(_row[i]));
+            }
+            return turbo::ok_status();
+        }
+        if (_option.data_type == DataType::DT_FLOAT16) {
+            for (std::size_t i = 0; i < _option.dimension; ++i) {
+                auto h = float_to_half(_row[i]);
+                std::memcpy(vector.data() + i * sizeof(h), &h, sizeof(h));
+            }
+            return turbo::ok_status();
+        }
+        return turbo::invalid_argument_error("data type parameter error {}", static_cast<int>(_option.data_type));
     }
 
     turbo::ResultStatus<std::size_t> TsvVectorSetReader::read_batch(turbo::Span<uint8_t> &vector, std::size_t batch_size) {
+        TLOG_CHECK(_vector_bytes * batch_size <= vector.size(), "not enough space to read vector");
         std::size_t i = 0;
-        for(; i < batch_size; i++) {
+        for (; i < batch_size; i++) {
             turbo::Span<uint8_t> v = turbo::Span<uint8_t>(vector.data() + i * _vector_bytes, _vector_bytes);
             auto r = read_vector(v);
-            if(!r.ok()) {
+            if (!r.ok()) {
+                if (turbo::is_reach_file_end(r)) {
+                    break;
+                }
                 return r;
             }
         }
@@ -133,40 +122,67 @@ namespace zircon {
     }
 
 
-    turbo::Status TsvVectorSetWriter::init(){
+    turbo::Status TsvVectorSetWriter::init() {
+        if (data_type_size(_option.data_type) == 0) {
+            return turbo::invalid_argument_error("data type parameter error {}", static_cast<int>(_option.data_type));
+        }
         return turbo::ok_status();
     }
 
-    turbo::Status TsvVectorSetWriter::write_vector(turbo::Span<uint8_t> vector) {
-        turbo::Status r;
-        std::string line;
-        if(_option.data_type == DataType::DT_UINT8) {
-            r = detail::convert_to_string<uint8_t>(_option.dimension, vector, &line);
-        } else if(_option.data_type == DataType::DT_FLOAT16) {
-            r = detail::convert_to_string<float16>(_option.dimension, vector, &line);
-        } else if(_option.data_type == DataType::DT_FLOAT) {
-            r = detail::convert_to_string<float>(_option.dimension, vector, &line);
+    turbo::Status TsvVectorSetWriter::append_vector(turbo::Span<uint8_t> vector) {
+        TLOG_CHECK(_vector_bytes <= vector.size(), "not enough space to write vector");
+        const float *values = nullptr;
+        if (_option.data_type == DataType::DT_FLOAT) {
+            values = reinterpret_cast<const float *>(vector.data());
         } else {
-            return turbo::InvalidArgumentError("data type parameter error {}", turbo::nameof_enum(_option.data_type));
+            _row.resize(_option.dimension);
+            if (_option.data_type == DataType::DT_UINT8) {
+                for (std::size_t i = 0; i < _option.dimension; ++i) {
+                    _row[i] = static_cast<float>(vector[i]);
+                }
+            } else {
+                for (std::size_t i = 0; i < _option.dimension; ++i) {
+                    uint16_t h;
+                    std::memcpy(&h, vector.data() + i * sizeof(h), sizeof(h));
+                    _row[i] = half_to_float(h);
+                }
+            }
+            values = _row.data();
+        }
+        tsv::append_line(values, _option.dimension, &_line);
+        return turbo::ok_status();
+    }
+
+    turbo::Status TsvVectorSetWriter::write_vector(turbo::Span<uint8_t> vector) {
+        _line.clear();
+        auto r = append_vector(vector);
+        if (!r.ok()) {
+            return r;
         }
-        if(!r.ok()) {
+        r = append(_line.data(), _line.size());
+        if (!r.ok()) {
             return r;
         }
-        line += "\n";
-        r = _file->write(line);
-        ++ _has_write;
-        return r;
+        ++_has_write;
+        return turbo::ok_status();
     }
 
     turbo::Status TsvVectorSetWriter::write_batch(turbo::Span<uint8_t> vector, std::size_t batch_size) {
-        for(std::size_t i = 0; i < batch_size; i++) {
+        // the whole batch is formatted before it is appended
+        _line.clear();
+        for (std::size_t i = 0; i < batch_size; i++) {
             turbo::Span<uint8_t> v = turbo::Span<uint8_t>(vector.data() + i * _vector_bytes, _vector_bytes);
-            auto r = write_vector(v);
-            if(!r.ok()) {
+            auto r = append_vector(v);
+            if (!r.ok()) {
                 return r;
             }
         }
+        auto r = append(_line.data(), _line.size());
+        if (!r.ok()) {
+            return r;
+        }
+        _has_write += batch_size;
         return turbo::ok_status();
     }
 
-}  // namespace tann
+}  // namespace zircon
@@ -15,6 +15,8 @@
 #ifndef ZIRCON_DATASETS_TSV_VECTOR_IO_H_
 #define ZIRCON_DATASETS_TSV_VECTOR_IO_H_
 
+#include <string>
+#include <vector>
 #include "zircon/core/vector_set_io.h"
 
 namespace zircon {
@@ -30,8 +32,19 @@ namespace zircon {
         turbo::ResultStatus<std::size_t> read_batch(turbo::Span<uint8_t> &vector, std::size_t batch_size) override;
     private:
         turbo::Status init() override;
+
+        // the next non blank line [*line, *eol), valid until the next call
+        turbo::Status next_line(const char **line, const char **eol);
+
+        // decode the floats of a row to the data type of the option
+        turbo::Status convert_row(turbo::Span<uint8_t> &vector);
     private:
-        turbo::Cord _cache_buf;
+        // lines are parsed in place, _buf holds the unread part of the file
+        std::string _buf;
+        std::size_t _pos{0};
+        bool _eof{false};
+        // a row of a non float data type
+        std::vector<float> _row;
     };
 
     class TsvVectorSetWriter : public VectorSetWriter {
@@ -46,6 +59,13 @@ namespace zircon {
 
     private:
         turbo::Status init() override;
+
+        turbo::Status append_vector(turbo::Span<uint8_t> vector);
+
+    private:
+        // reused so writing does not allocate
+        std::string _line;
+        std::vector<float> _row;
     };
 }  // namespace zircon
 
@@ -0,0 +1,353 @@
+// Copyright 2023 The Elastic-AI Authors.
+// part of Elastic AI Search
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#include "zircon/datasets/vector_set_loader.h"
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstring>
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include "turbo/files/sequential_read_file.h"
+#include "turbo/log/logging.h"
+#include "zircon/datasets/tsv_codec.h"
+#include "zircon/store/mem_vector_store.h"
+
+namespace zircon {
+
+    namespace {
+
+        struct Chunk {
+            std::size_t seq{0};
+            // whole records or whole lines
+            std::string bytes;
+        };
+
+        // bounded multi consumer queue between the read thread and the parse threads.
+        class ChunkQueue {
+        public:
+            explicit ChunkQueue(std::size_t capacity) : _capacity(capacity) {}
+
+            // false if closed
+            bool push(Chunk &&chunk) {
+                std::unique_lock<std::mutex> lock(_mutex);
+                _not_full.wait(lock, [this] { return _closed || _queue.size() < _capacity; });
+                if (_closed) {
+                    return false;
+                }
+                _queue.push_back(std::move(chunk));
+                _not_empty.notify_one();
+                return true;
+            }
+
+            // false if closed and drained
+            bool pop(Chunk &chunk) {
+                std::unique_lock<std::mutex> lock(_mutex);
+                _not_empty.wait(lock, [this] { return _closed || !_queue.empty(); });
+                if (_queue.empty()) {
+                    return false;
+                }
+                chunk = std::move(_queue.front());
+                _queue.pop_front();
+                _not_full.notify_one();
+                return true;
+            }
+
+            void close() {
+                std::unique_lock<std::mutex> lock(_mutex);
+                _closed = true;
+                _not_full.notify_all();
+                _not_empty.notify_all();
+            }
+
+            // drop the chunks not parsed yet, on error
+            void abort() {
+                std::unique_lock<std::mutex> lock(_mutex);
+                _closed = true;
+                _queue.clear();
+                _not_full.notify_all();
+                _not_empty.notify_all();
+            }
+
+        private:
+            std::size_t _capacity;
+            bool _closed{false};
+            std::deque<Chunk> _queue;
+            std::mutex _mutex;
+            std::condition_variable _not_full;
+            std::condition_variable _not_empty;
+        };
+
+        // parse the lines of [p, end) in place, blank lines are skipped.
+        turbo::Status parse_tsv(const char *p, const char *end, std::size_t dim, std::vector<float> &out,
+                                std::size_t &nrows) {
+            nrows = 0;
+            out.clear();
+            while (p < end) {
+                const char *eol = tsv::find_line_end(p, end);
+                if (!tsv::is_blank_line(p, eol)) {
+                    out.resize((nrows + 1) * dim);
+                    auto rs = tsv::parse_line(p, eol, dim, out.data() + nrows * dim);
+                    if (!rs.ok()) {
+                        return rs;
+                    }
+                    ++nrows;
+                }
+                p = eol + 1;
+            }
+            return turbo::ok_status();
+        }
+
+        class LoadPipeline {
+        public:
+            LoadPipeline(const VectorLoadOption &option, MemVectorStore *store)
+                    : _option(option), _store(store), _queue(std::max<std::size_t>(option.read_ahead, 1)) {
+                _vector_bytes = _option.dimension * sizeof(float);
+                _record_bytes = _option.format == VectorFileFormat::FORMAT_FVECS ? _vector_bytes + sizeof(uint32_t)
+                                                                                   : _vector_bytes;
+            }
+
+            turbo::ResultStatus<std::size_t> run(const std::string &path) {
+                auto rs = _file.open(path);
+                if (!rs.ok()) {
+                    return rs;
+                }
+                std::size_t total = constants::kUnknownSize;
+                if (_option.format == VectorFileFormat::FORMAT_BIN) {
+                    uint32_t header[2];
+                    auto r = _file.read(header, sizeof(header));
+                    if (!r.ok()) {
+                        return r.status();
+                    }
+                    if (r.value() != sizeof(header) || header[1] != _option.dimension) {
+                        return turbo::data_loss_error("bad format, dimension read from file {} but option {}",
+                                                      header[1], _option.dimension);
+                    }
+                    total = header[0];
+                }
+                auto nthreads = _option.nthreads;
+                if (nthreads == 0) {
+                    nthreads = std::max(1u, std::thread::hardware_concurrency());
+                }
+                std::vector<std::thread> workers;
+                workers.reserve(nthreads);
+                for (std::size_t i = 0; i < nthreads; ++i) {
+                    workers.emplace_back([this] { parse_loop(); });
+                }
+                rs = _option.format == VectorFileFormat::FORMAT_TSV ? read_lines() : read_records(total);
+                if (!rs.ok()) {
+                    fail(rs);
+                }
+                _queue.close();
+                for (auto &w: workers) {
+                    w.join();
+                }
+                _file.close();
+                if (!_status.ok()) {
+                    return _status;
+                }
+                if (total != constants::kUnknownSize && _rows != total) {
+                    return turbo::data_loss_error("file truncated, {} vectors of {} read", _rows, total);
+                }
+                return _rows;
+            }
+
+        private:
+            turbo::Status read_records(std::size_t total) {
+                const std::size_t chunk_vectors = std::max<std::size_t>(_option.chunk_vectors, 1);
+                std::size_t remain = total;
+                while (remain > 0 && !failed()) {
+                    auto nvec = std::min(chunk_vectors, remain);
+                    Chunk chunk;
+                    chunk.seq = _nchunks;
+                    chunk.bytes.resize(nvec * _record_bytes);
+                    auto r = _file.read(chunk.bytes.data(), chunk.bytes.size());
+                    if (!r.ok()) {
+                        return r.status();
+                    }
+                    if (r.value() % _record_bytes != 0) {
+                        return turbo::data_loss_error("file truncated in the middle of a record");
+                    }
+                    if (r.value() == 0) {
+                        break;
+                    }
+                    chunk.bytes.resize(r.value());
+                    if (total != constants::kUnknownSize) {
+                        remain -= r.value() / _record_bytes;
+                    }
+                    ++_nchunks;
+                    if (!_queue.push(std::move(chunk))) {
+                        break;
+                    }
+                    if (r.value() < nvec * _record_bytes) {
+                        break;
+                    }
+                }
+                return turbo::ok_status();
+            }
+
+            turbo::Status read_lines() {
+                const std::size_t block = std::max<std::size_t>(_option.chunk_bytes, 4096);
+                std::string carry;
+                bool eof = false;
+                while (!eof && !failed()) {
+                    Chunk chunk;
+                    chunk.seq = _nchunks;
+                    chunk.bytes = std::move(carry);
+                    carry.clear();
+                    auto base = chunk.bytes.size();
+                    chunk.bytes.resize(base + block);
+                    auto r = _file.read(chunk.bytes.data() + base, block);
+                    if (!r.ok()) {
+                        return r.status();
+                    }
+                    chunk.bytes.resize(base + r.value());
+                    eof = r.value() < block;
+                    if (!eof) {
+                        // the partial last line goes to the next chunk
+                        auto pos = chunk.bytes.rfind('\n');
+                        if (pos == std::string::npos) {
+                            carry = std::move(chunk.bytes);
+                            continue;
+                        }
+                        carry.assign(chunk.bytes, pos + 1, std::string::npos);
+                        chunk.bytes.resize(pos + 1);
+                    }
+                    if (chunk.bytes.empty()) {
+                        continue;
+                    }
+                    ++_nchunks;
+                    if (!_queue.push(std::move(chunk))) {
+                        break;
+                    }
+                }
+                return turbo::ok_status();
+            }
+
+            void parse_loop() {
+                std::vector<float> floats;
+                std::vector<label_type> labels;
+                Chunk chunk;
+                while (_queue.pop(chunk)) {
+                    std::size_t nrows = 0;
+                    turbo::Status rs;
+                    turbo::Span<uint8_t> vectors;
+                    if (_option.format == VectorFileFormat::FORMAT_TSV) {
+                        rs = parse_tsv(chunk.bytes.data(), chunk.bytes.data() + chunk.bytes.size(),
+                                       _option.dimension, floats, nrows);
+                        vectors = turbo::Span<uint8_t>{reinterpret_cast<uint8_t *>(floats.data()),
+                                                       nrows * _vector_bytes};
+                    } else if (_option.format == VectorFileFormat::FORMAT_FVECS) {
+                        // drop the dimension of every record, compact in place
+                        nrows = chunk.bytes.size() / _record_bytes;
+                        auto *data = reinterpret_cast<uint8_t *>(chunk.bytes.data());
+                        for (std::size_t i = 0; i < nrows && rs.ok(); ++i) {
+                            uint32_t dim;
+                            std::memcpy(&dim, data + i * _record_bytes, sizeof(dim));
+                            if (dim != _option.dimension) {
+                                rs = turbo::data_loss_error("bad format, dimension {} in a record but option {}",
+                                                            dim, _option.dimension);
+                                break;
+                            }
+                            std::memmove(data + i * _vector_bytes, data + i * _record_bytes + sizeof(uint32_t),
+                                         _vector_bytes);
+                        }
+                        vectors = turbo::Span<uint8_t>{data, nrows * _vector_bytes};
+                    } else {
+                        nrows = chunk.bytes.size() / _record_bytes;
+                        vectors = turbo::Span<uint8_t>{reinterpret_cast<uint8_t *>(chunk.bytes.data()),
+                                                       chunk.bytes.size()};
+                    }
+                    // the rows of the chunks are counted in file order
+                    std::size_t first_row = 0;
+                    {
+                        std::unique_lock<std::mutex> lock(_order_mutex);
+                        _order_cv.wait(lock, [&] { return _next_seq == chunk.seq || failed(); });
+                        if (failed()) {
+                            break;
+                        }
+                        if (!rs.ok()) {
+                            lock.unlock();
+                            fail(rs);
+                            break;
+                        }
+                        first_row = _rows;
+                        _rows += nrows;
+                        ++_next_seq;
+                        _order_cv.notify_all();
+                    }
+                    if (nrows == 0) {
+                        continue;
+                    }
+                    labels.resize(nrows);
+                    for (std::size_t i = 0; i < nrows; ++i) {
+                        labels[i] = _option.start_label + first_row + i;
+                    }
+                    auto r = _store->add_vectors(turbo::Span<label_type>{labels}, vectors);
+                    if (!r.ok()) {
+                        fail(r.status());
+                        break;
+                    }
+                }
+            }
+
+            [[nodiscard]] bool failed() const {
+                return _failed.load(std::memory_order_acquire);
+            }
+
+            void fail(const turbo::Status &rs) {
+                {
+                    std::unique_lock<std::mutex> lock(_order_mutex);
+                    if (!failed()) {
+                        _status = rs;
+                        _failed.store(true, std::memory_order_release);
+                    }
+                    _order_cv.notify_all();
+                }
+                _queue.abort();
+            }
+
+        private:
+            VectorLoadOption _option;
+            MemVectorStore *_store{nullptr};
+            turbo::SequentialReadFile _file;
+            ChunkQueue _queue;
+            std::size_t _vector_bytes{0};
+            std::size_t _record_bytes{0};
+            // touched by the read thread only
+            std::size_t _nchunks{0};
+            std::mutex _order_mutex;
+            std::condition_variable _order_cv;
+            // guard by _order_mutex
+            std::size_t _next_seq{0};
+            std::size_t _rows{0};
+            turbo::Status _status;
+            std::atomic<bool> _failed{false};
+        };
+    }  // namespace
+
+    turbo::ResultStatus<std::size_t>
+    load_vector_set(const std::string &path, const VectorLoadOption &option, MemVectorStore *store) {
+        TLOG_CHECK(store != nullptr);
+        if (option.dimension == 0) {
+            return turbo::invalid_argument_error("dimension not set");
+        }
+        LoadPipeline pipeline(option, store);
+        return pipeline.run(path);
+    }
+
+}  // namespace zircon
@@ -0,0 +1,66 @@
+// Copyright 2023 The Elastic-AI Authors.
+// part of Elastic AI Search
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#ifndef ZIRCON_DATASETS_VECTOR_SET_LOADER_H_
+#define ZIRCON_DATASETS_VECTOR_SET_LOADER_H_
+
+#include <string>
+#include "turbo/base/status.h"
+#include "zircon/core/defines.h"
+
+namespace zircon {
+
+    class MemVectorStore;
+
+    enum class VectorFileFormat {
+        // per record, uint32 dimension then dimension floats
+        FORMAT_FVECS = 0,
+        // uint32 number of vectors, uint32 dimension, then the floats
+        FORMAT_BIN,
+        // one vector per line, floats separated by tabs
+        FORMAT_TSV,
+    };
+
+    struct VectorLoadOption {
+        VectorFileFormat format{VectorFileFormat::FORMAT_FVECS};
+        std::size_t dimension{0};
+        // parse threads, 0 for the hardware concurrency
+        std::size_t nthreads{0};
+        // vectors per chunk of fvecs/bin, the unit of work of a parse thread
+        std::size_t chunk_vectors{4096};
+        // bytes per chunk of tsv
+        std::size_t chunk_bytes{4 << 20};
+        // chunks read ahead of the parse threads, bound the memory in use
+        std::size_t read_ahead{8};
+        // the vector of row i gets the label start_label + i
+        label_type start_label{0};
+    };
+
+    /**
+     * @brief load a vector file into the store with a pipeline. one thread read
+     *        the file ahead in chunks, fvecs and bin are cut on record boundaries
+     *        without looking at the content, tsv on the last line end of a block.
+     *        the parse threads decode the chunks and hand them to
+     *        MemVectorStore::add_vectors. labels follow the row order of the file,
+     *        the locations are in the order the chunks are added.
+     * @return the number of vectors loaded. on error the vectors of the chunks
+     *         added before it stay in the store.
+     */
+    turbo::ResultStatus<std::size_t>
+    load_vector_set(const std::string &path, const VectorLoadOption &option, MemVectorStore *store);
+
+}  // namespace zircon
+
+#endif  // ZIRCON_DATASETS_VECTOR_SET_LOADER_H_
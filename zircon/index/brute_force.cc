@@ -0,0 +1,383 @@
+// Copyright 2023 The Elastic-AI Authors.
+// part of Elastic AI Search
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#include "zircon/index/brute_force.h"
+#include "zircon/utility/id_filter.h"
+#include "turbo/memory/prefetch.h"
+#include <algorithm>
+#include <memory>
+#include <queue>
+#include <utility>
+
+namespace zircon {
+
+    namespace {
+
+        using Entry = std::pair<float, label_type>;
+
+        // max heap of the k nearest
+        class TopK {
+        public:
+            explicit TopK(std::size_t k) : _k(k) {}
+
+            void push(float d, label_type label) {
+                if (_heap.size() < _k) {
+                    _heap.emplace(d, label);
+                } else if (d < _heap.top().first) {
+                    _heap.pop();
+                    _heap.emplace(d, label);
+                }
+            }
+
+            // move the entries of other into this heap, other is left empty
+            void merge(TopK &other) {
+                while (!other._heap.empty()) {
+                    push(other._heap.top().first, other._heap.top().second);
+                    other._heap.pop();
+                }
+            }
+
+            void finish(std::vector<QueryResult> &result) {
+                result.resize(_heap.size());
+                for (auto i = result.size(); i > 0; --i) {
+                    result[i - 1] = {_heap.top().second, _heap.top().first};
+                    _heap.pop();
+                }
+            }
+
+        private:
+            std::size_t _k;
+            std::priority_queue<Entry> _heap;
+        };
+
+        // distance of query to the vector at loc, from the norms the store keep if the metric use them
+        float location_distance(const MemVectorStore &store, const MetricDistance &distance, const float *query,
+                                float query_norm, location_t loc) {
+            const auto *v = reinterpret_cast<const float *>(store.get_vector(loc).data());
+            if (query_norm < 0.0f) {
+                return distance(query, v);
+            }
+            return distance(query, query_norm, v, store.get_norm(loc));
+        }
+
+        // the l2 norm of query for location_distance, -1 if the norms are not used
+        float location_query_norm(const MemVectorStore &store, const MetricDistance &distance, const float *query) {
+            return store.keeps_norms() && distance.use_norms() ? distance.norm(query) : -1.0f;
+        }
+
+        // candidates rerank_search prefetches ahead of the one scored
+        static constexpr std::size_t kRerankPrefetch = 8;
+
+        // every cache line of the vector at loc
+        void prefetch_location(const MemVectorStore &store, location_t loc) {
+            auto v = store.get_vector(loc);
+            for (std::size_t off = 0; off < v.size(); off += 64) {
+                turbo::prefetch_to_local_cache(v.data() + off);
+            }
+        }
+
+        // scores the batches of a store into a heap, holds the scratch of one thread
+        class BatchScanner {
+        public:
+            BatchScanner(const MemVectorStore &store, const MetricDistance &distance, const float *query,
+                         const IdFilter *filter)
+                    : _store(store), _distance(distance), _query(query), _filter(filter),
+                      _use_norms(store.keeps_norms() && distance.use_norms()),
+                      _query_norm(_use_norms ? distance.norm(query) : 0.0f),
+                      _batch_size(store.get_batch_size()), _dis(_batch_size), _labels(_batch_size),
+                      _mask((_batch_size + 63) / 64) {}
+
+            // batches [first, last) of the n first locations
+            void scan(std::size_t first, std::size_t last, std::size_t n, TopK &top) {
+                auto &batches = _store.vector_batch();
+                for (std::size_t bi = first; bi < last; ++bi) {
+                    const location_t base = static_cast<location_t>(bi * _batch_size);
+                    const std::size_t count = std::min(_batch_size, n - base);
+                    const auto *vectors = reinterpret_cast<const float *>(batches[bi].data());
+                    const std::size_t stride = batches[bi].vector_byte_size() / sizeof(float);
+                    const float *norms = _use_norms ? _store.batch_norms(bi) : nullptr;
+                    // deleted locations have no label
+                    for (std::size_t i = 0; i < count; ++i) {
+                        _labels[i] = _store.get_label(base + i).value();
+                    }
+                    if (_filter == nullptr) {
+                        _distances += count;
+                        if (norms != nullptr) {
+                            // the stride of a store keeping norms is the dimension
+                            _distance.batch(_query, _query_norm, vectors, norms, count, _dis.data());
+                        } else if (stride == _distance.dimension()) {
+                            _distance.batch(_query, vectors, count, _dis.data());
+                        } else {
+                            for (std::size_t i = 0; i < count; ++i) {
+                                _dis[i] = _distance(_query, vectors + i * stride);
+                            }
+                        }
+                        for (std::size_t i = 0; i < count; ++i) {
+                            if (_labels[i] != constants::kUnknownLabel) {
+                                top.push(_dis[i], _labels[i]);
+                            }
+                        }
+                        continue;
+                    }
+                    // one filter call for the batch, then only the members are scored
+                    _filter->filter_block(_labels.data(), count, _mask.data());
+                    std::size_t scored = 0;
+                    for (std::size_t w = 0; w * 64 < count; ++w) {
+                        for (uint64_t bits = _mask[w]; bits != 0; bits &= bits - 1) {
+                            const std::size_t i = w * 64 + __builtin_ctzll(bits);
+                            if (_labels[i] != constants::kUnknownLabel) {
+                                const float d = norms != nullptr
+                                                ? _distance(_query, _query_norm, vectors + i * stride, norms[i])
+                                                : _distance(_query, vectors + i * stride);
+                                top.push(d, _labels[i]);
+                                ++scored;
+                            }
+                        }
+                    }
+                    _distances += scored;
+                    _rejected += count - scored;
+                }
+            }
+
+            // the counts of the batches scanned so far added to stats
+            void add_stats(QueryStats &stats) const {
+                stats.distance_computations += _distances;
+                stats.filter_rejected += _rejected;
+            }
+
+        private:
+            const MemVectorStore &_store;
+            const MetricDistance &_distance;
+            const float *_query;
+            const IdFilter *_filter;
+            const bool _use_norms;
+            const float _query_norm;
+            const std::size_t _batch_size;
+            std::vector<float> _dis;
+            std::vector<label_type> _labels;
+            std::vector<uint64_t> _mask;
+            uint64_t _distances{0};
+            uint64_t _rejected{0};
+        };
+    }  // namespace
+
+    void brute_force_search(const MemVectorStore &store, const MetricDistance &distance, const float *query,
+                            const SearchOption &option, std::vector<QueryResult> &result, QueryStats *stats) {
+        result.clear();
+        if (option.k == 0) {
+            return;
+        }
+        TopK top(option.k);
+        const std::size_t n = store.current_index();
+        const std::size_t batch_size = store.get_batch_size();
+        BatchScanner scanner(store, distance, query, option.filter);
+        scanner.scan(0, (n + batch_size - 1) / batch_size, n, top);
+        top.finish(result);
+        if (stats != nullptr) {
+            scanner.add_stats(*stats);
+        }
+    }
+
+    void parallel_brute_force_search(const MemVectorStore &store, const MetricDistance &distance,
+                                     const float *query, const SearchOption &option, ThreadPool &pool,
+                                     std::size_t batches_per_task, std::vector<QueryResult> &result,
+                                     QueryStats *stats) {
+        result.clear();
+        if (option.k == 0) {
+            return;
+        }
+        batches_per_task = std::max<std::size_t>(batches_per_task, 1);
+        const std::size_t n = store.current_index();
+        const std::size_t batch_size = store.get_batch_size();
+        const std::size_t nbatches = (n + batch_size - 1) / batch_size;
+        const std::size_t ntasks = (nbatches + batches_per_task - 1) / batches_per_task;
+        // a heap and a scanner for every slot of the pool, merged at the end
+        std::vector<TopK> tops(pool.concurrency(), TopK(option.k));
+        std::vector<std::unique_ptr<BatchScanner>> scanners(pool.concurrency());
+        pool.parallel_for(ntasks, [&](std::size_t task, std::size_t slot) {
+            if (scanners[slot] == nullptr) {
+                scanners[slot] = std::make_unique<BatchScanner>(store, distance, query, option.filter);
+            }
+            const auto first = task * batches_per_task;
+            scanners[slot]->scan(first, std::min(first + batches_per_task, nbatches), n, tops[slot]);
+        });
+        for (std::size_t i = 1; i < tops.size(); ++i) {
+            tops[0].merge(tops[i]);
+        }
+        tops[0].finish(result);
+        if (stats != nullptr) {
+            for (auto &scanner: scanners) {
+                if (scanner != nullptr) {
+                    scanner->add_stats(*stats);
+                }
+            }
+        }
+    }
+
+    void brute_force_search(const MemVectorStore &store, const MetricDistance &distance, const float *query,
+                            const std::vector<label_type> &labels, std::size_t k, std::vector<QueryResult> &result,
+                            QueryStats *stats) {
+        result.clear();
+        if (k == 0) {
+            return;
+        }
+        TopK top(k);
+        // one lock of every label shard for the whole set
+        std::vector<location_t> locations(labels.size());
+        store.get_locations(turbo::Span<const label_type>{labels.data(), labels.size()},
+                            turbo::Span<location_t>{locations});
+        std::vector<label_type> found;
+        found.reserve(labels.size());
+        std::size_t nfound = 0;
+        for (std::size_t i = 0; i < labels.size(); ++i) {
+            if (locations[i] != constants::kUnknownLocation) {
+                locations[nfound++] = locations[i];
+                found.push_back(labels[i]);
+            }
+        }
+        locations.resize(nfound);
+        const float query_norm = location_query_norm(store, distance, query);
+        for (std::size_t i = 0; i < locations.size(); ++i) {
+            if (i + 1 < locations.size()) {
+                turbo::prefetch_to_local_cache(store.get_vector(locations[i + 1]).data());
+            }
+            top.push(location_distance(store, distance, query, query_norm, locations[i]), found[i]);
+        }
+        top.finish(result);
+        if (stats != nullptr) {
+            stats->distance_computations += locations.size();
+            stats->filter_rejected += labels.size() - locations.size();
+        }
+    }
+
+    void rerank_search(const MemVectorStore &store, const MetricDistance &distance, const float *query,
+                       const std::vector<location_t> &candidates, std::size_t k, std::vector<QueryResult> &result,
+                       QueryStats *stats) {
+        result.clear();
+        if (k == 0) {
+            return;
+        }
+        // in memory order, so the batches are read once and one after another
+        std::vector<location_t> locations(candidates);
+        std::sort(locations.begin(), locations.end());
+        locations.erase(std::unique(locations.begin(), locations.end()), locations.end());
+        locations.erase(std::lower_bound(locations.begin(), locations.end(),
+                                         static_cast<location_t>(store.current_index())), locations.end());
+        const std::size_t n = locations.size();
+        const bool use_norms = store.keeps_norms() && distance.use_norms();
+        const float query_norm = use_norms ? distance.norm(query) : 0.0f;
+        const std::size_t batch_size = store.get_batch_size();
+        auto &batches = store.vector_batch();
+        std::vector<float> dis(batch_size);
+        TopK top(k);
+        std::size_t prefetched = 0;
+        for (std::size_t i = 0; i < n;) {
+            const std::size_t bi = locations[i] / batch_size;
+            const location_t base = static_cast<location_t>(bi * batch_size);
+            // the run of consecutive locations in the batch of locations[i]
+            std::size_t last = i + 1;
+            while (last < n && locations[last] == locations[last - 1] + 1 && locations[last] / batch_size == bi) {
+                ++last;
+            }
+            for (; prefetched < std::min(last + kRerankPrefetch, n); ++prefetched) {
+                if (prefetched >= last) {
+                    prefetch_location(store, locations[prefetched]);
+                }
+            }
+            const std::size_t count = last - i;
+            const std::size_t stride = batches[bi].vector_byte_size() / sizeof(float);
+            const auto *vectors = reinterpret_cast<const float *>(batches[bi].data()) + (locations[i] - base) * stride;
+            if (use_norms) {
+                // the stride of a store keeping norms is the dimension
+                const float *norms = store.batch_norms(bi) + (locations[i] - base);
+                distance.batch(query, query_norm, vectors, norms, count, dis.data());
+            } else if (count > 1 && stride == distance.dimension()) {
+                distance.batch(query, vectors, count, dis.data());
+            } else {
+                for (std::size_t j = 0; j < count; ++j) {
+                    dis[j] = distance(query, vectors + j * stride);
+                }
+            }
+            // deleted locations have no label
+            for (std::size_t j = 0; j < count; ++j) {
+                auto label = store.get_label(locations[i + j]).value();
+                if (label != constants::kUnknownLabel) {
+                    top.push(dis[j], label);
+                }
+            }
+            i = last;
+        }
+        top.finish(result);
+        if (stats != nullptr) {
+            stats->distance_computations += n;
+        }
+    }
+
+    void binary_rerank_search(const MemVectorStore &store, const MetricDistance &distance,
+                              const BinaryCodeStore &codes, const float *query, const SearchOption &option,
+                              std::size_t rerank, std::vector<QueryResult> &result, QueryStats *stats) {
+        result.clear();
+        if (option.k == 0) {
+            return;
+        }
+        std::vector<uint8_t> query_code(codes.code_size());
+        codes.quantizer()->encode(query, query_code.data());
+        // first pass, the candidates are kept by location
+        TopK candidates(option.k * std::max<std::size_t>(rerank, 1));
+        const std::size_t n = std::min(codes.size(), store.current_index());
+        const std::size_t chunk = store.get_batch_size();
+        std::vector<float> dis(chunk);
+        std::vector<label_type> labels(chunk);
+        std::vector<uint64_t> mask((chunk + 63) / 64);
+        std::size_t rejected = 0;
+        for (std::size_t first = 0; first < n; first += chunk) {
+            const std::size_t count = std::min(chunk, n - first);
+            codes.scan(query_code.data(), first, count, dis.data());
+            // deleted locations have no label
+            for (std::size_t i = 0; i < count; ++i) {
+                labels[i] = store.get_label(static_cast<location_t>(first + i)).value();
+            }
+            if (option.filter == nullptr) {
+                for (std::size_t i = 0; i < count; ++i) {
+                    if (labels[i] != constants::kUnknownLabel) {
+                        candidates.push(dis[i], first + i);
+                    }
+                }
+                continue;
+            }
+            option.filter->filter_block(labels.data(), count, mask.data());
+            for (std::size_t i = 0; i < count; ++i) {
+                if (labels[i] != constants::kUnknownLabel && (mask[i / 64] >> (i % 64)) & 1u) {
+                    candidates.push(dis[i], first + i);
+                } else {
+                    ++rejected;
+                }
+            }
+        }
+        std::vector<QueryResult> coarse;
+        candidates.finish(coarse);
+        // second pass with the float vectors
+        std::vector<location_t> locations(coarse.size());
+        for (std::size_t i = 0; i < coarse.size(); ++i) {
+            locations[i] = static_cast<location_t>(coarse[i].label);
+        }
+        rerank_search(store, distance, query, locations, option.k, result, stats);
+        if (stats != nullptr) {
+            stats->distance_computations += n;
+            stats->filter_rejected += rejected;
+        }
+    }
+
+}  // namespace zircon
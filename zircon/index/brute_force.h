@@ -0,0 +1,92 @@
+// Copyright 2023 The Elastic-AI Authors.
+// part of Elastic AI Search
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#ifndef ZIRCON_INDEX_BRUTE_FORCE_H_
+#define ZIRCON_INDEX_BRUTE_FORCE_H_
+
+#include <vector>
+#include "turbo/base/status.h"
+#include "zircon/core/defines.h"
+#include "zircon/quantizer/binary_code_store.h"
+#include "zircon/store/mem_vector_store.h"
+#include "zircon/utility/metric_distance.h"
+#include "zircon/utility/thread_pool.h"
+
+namespace zircon {
+
+    /**
+     * @brief exact search over all alive vectors of a float store. without a
+     *        filter the vectors are scored batch by batch with the one to many
+     *        kernels, with a filter a location is scored only if its label is a
+     *        member, the filter is checked before the distance.
+     * @param result the nearest option.k, nearest first.
+     * @param stats if not null, the distances and the rejected locations are added to it.
+     */
+    void brute_force_search(const MemVectorStore &store, const MetricDistance &distance, const float *query,
+                            const SearchOption &option, std::vector<QueryResult> &result,
+                            QueryStats *stats = nullptr);
+
+    /**
+     * @brief brute_force_search split over the threads of pool, batches_per_task
+     *        consecutive batches per task. every slot of the pool keep its own
+     *        bounded heap, the heaps are merged once all the batches are scored,
+     *        the result is the one of brute_force_search.
+     */
+    void parallel_brute_force_search(const MemVectorStore &store, const MetricDistance &distance,
+                                     const float *query, const SearchOption &option, ThreadPool &pool,
+                                     std::size_t batches_per_task, std::vector<QueryResult> &result,
+                                     QueryStats *stats = nullptr);
+
+    /**
+     * @brief exact search over the given labels only, labels not in the store
+     *        are skipped. used for selective filters, see IdFilter::collect_members.
+     */
+    void brute_force_search(const MemVectorStore &store, const MetricDistance &distance, const float *query,
+                            const std::vector<label_type> &labels, std::size_t k, std::vector<QueryResult> &result,
+                            QueryStats *stats = nullptr);
+
+    /**
+     * @brief exact second stage of a compressed search. the candidates are store
+     *        locations from any approximate first pass, eg. PqCodeStore::search
+     *        or the hamming scan of a BinaryCodeStore, oversampled so the true
+     *        neighbors are likely among them. they are sorted by location so the
+     *        float vectors are read batch by batch in memory order, the vectors
+     *        of the next candidates are prefetched, and every run of consecutive
+     *        locations is scored with the one to many kernel. duplicated, deleted
+     *        and unknown locations are skipped.
+     * @param result the nearest k of the candidates by exact distance, nearest first.
+     * @param stats if not null, the float distances are added to it.
+     */
+    void rerank_search(const MemVectorStore &store, const MetricDistance &distance, const float *query,
+                       const std::vector<location_t> &candidates, std::size_t k, std::vector<QueryResult> &result,
+                       QueryStats *stats = nullptr);
+
+    /**
+     * @brief two pass search of a float store. the encoded query is compared by
+     *        hamming with the binary codes of codes, built from the store so the
+     *        i-th code is location i, and the option.k * rerank nearest alive
+     *        members are scored again with the float vectors, see rerank_search.
+     *        locations above codes.size() are not searched.
+     * @param rerank candidates of the first pass per result, at least 1.
+     * @param stats if not null, the hamming and the float distances and the
+     *        rejected locations are added to it.
+     */
+    void binary_rerank_search(const MemVectorStore &store, const MetricDistance &distance,
+                              const BinaryCodeStore &codes, const float *query, const SearchOption &option,
+                              std::size_t rerank, std::vector<QueryResult> &result, QueryStats *stats = nullptr);
+
+}  // namespace zircon
+
+#endif  // ZIRCON_INDEX_BRUTE_FORCE_H_
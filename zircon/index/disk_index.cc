@@ -0,0 +1,590 @@
+// Copyright 2023 The Elastic-AI Authors.
+// part of Elastic AI Search
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#include "zircon/index/disk_index.h"
+#include "zircon/core/allocator.h"
+#include "zircon/utility/id_filter.h"
+#include "zircon/utility/metrics.h"
+#include "turbo/container/flat_hash_set.h"
+#include "turbo/log/logging.h"
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <deque>
+#include <limits>
+#include <queue>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace zircon {
+
+    namespace {
+        SearchMetrics &search_metrics() {
+            static SearchMetrics metrics("disk");
+            return metrics;
+        }
+
+        struct Candidate {
+            float distance;
+            uint32_t id;
+            bool expanded;
+        };
+
+        // exact distances of the nodes read, max heap of the k nearest
+        void push_result(std::priority_queue<std::pair<float, label_type>> &heap, std::size_t k, float d,
+                         label_type label) {
+            if (heap.size() < k) {
+                heap.emplace(d, label);
+            } else if (d < heap.top().first) {
+                heap.pop();
+                heap.emplace(d, label);
+            }
+        }
+
+        // the fields of a header that does not need the pq, consistent with each other
+        bool check_layout(const DiskIndexHeader &h) {
+            if (h.dimension == 0 || h.nvectors > std::numeric_limits<uint32_t>::max() ||
+                (h.nvectors != 0 && h.medoid >= h.nvectors)) {
+                return false;
+            }
+            // the record written by VamanaBuilder, vector, degree and max_degree ids
+            const uint64_t record =
+                    uint64_t{h.dimension} * sizeof(float) + (uint64_t{h.max_degree} + 1) * sizeof(uint32_t);
+            if (h.node_bytes != record) {
+                return false;
+            }
+            if (h.nodes_per_sector != 0) {
+                if (h.sectors_per_node != 1 || uint64_t{h.nodes_per_sector} * h.node_bytes > kDiskSectorSize) {
+                    return false;
+                }
+            } else if (h.sectors_per_node == 0 || uint64_t{h.sectors_per_node} * kDiskSectorSize < h.node_bytes) {
+                return false;
+            }
+            return h.graph_offset >= kDiskSectorSize && h.graph_offset % kDiskSectorSize == 0 &&
+                   h.graph_offset + h.graph_sectors() * kDiskSectorSize <= h.pq_offset;
+        }
+
+        void finish(std::priority_queue<std::pair<float, label_type>> &heap, std::vector<QueryResult> &result) {
+            result.resize(heap.size());
+            for (auto i = result.size(); i > 0; --i) {
+                result[i - 1] = {heap.top().second, heap.top().first};
+                heap.pop();
+            }
+        }
+    }  // namespace
+
+    struct DiskIndex::SearchContext {
+        SearchContext(std::size_t nslots, std::size_t slot_bytes)
+                : bytes(nslots * slot_bytes), reqs(nslots), ids(nslots) {
+            buf = Allocator::get_instance().allocate_pages(bytes);
+        }
+
+        ~SearchContext() {
+            // the engine reaps the reads in flight, none may land in the buffer once it is freed
+            engine.reset();
+            Allocator::get_instance().deallocate_pages(buf, bytes);
+        }
+
+        std::unique_ptr<IoEngine> engine;
+        uint8_t *buf{nullptr};
+        std::size_t bytes{0};
+        std::vector<IoRequest> reqs;
+        // node read by every slot
+        std::vector<uint32_t> ids;
+        std::vector<std::size_t> free_slots;
+        std::vector<float> lut;
+    };
+
+    DiskIndex::DiskIndex() = default;
+
+    DiskIndex::~DiskIndex() {
+        close();
+    }
+
+    void DiskIndex::close() {
+        {
+            std::unique_lock<std::mutex> lock(_context_lock);
+            _contexts.clear();
+        }
+        if (_fd >= 0) {
+            ::close(_fd);
+        }
+        _fd = -1;
+    }
+
+    turbo::Status DiskIndex::initialize(const DiskIndexOption &option) {
+        if (_is_available) {
+            return turbo::failed_precondition_error("index already initialized");
+        }
+        if (option.beam_width == 0 || option.search_list == 0) {
+            return turbo::invalid_argument_error("beam_width and search_list must be positive");
+        }
+        _option = option;
+        _is_available = true;
+        return turbo::ok_status();
+    }
+
+    turbo::Status DiskIndex::read_section(uint64_t offset, std::size_t bytes, uint8_t *dst) const {
+        // through a bounded page aligned buffer, direct io need aligned reads
+        constexpr std::size_t kChunk = 1 << 20;
+        const uint64_t begin = offset / kDiskSectorSize * kDiskSectorSize;
+        std::size_t skip = offset - begin;
+        const std::size_t total = align_to_sector(skip + bytes);
+        const std::size_t cap = std::min(kChunk, total);
+        auto *buf = Allocator::get_instance().allocate_pages(cap);
+        turbo::Status status;
+        std::size_t copied = 0;
+        for (std::size_t pos = 0; pos < total && status.ok(); pos += cap) {
+            const std::size_t len = std::min(cap, total - pos);
+            std::size_t done = 0;
+            while (done < len) {
+                auto r = ::pread(_fd, buf + done, len - done, static_cast<off_t>(begin + pos + done));
+                if (r < 0 && errno == EINTR) {
+                    continue;
+                }
+                if (r < 0) {
+                    status = turbo::errno_to_status(errno, "read disk index");
+                    break;
+                }
+                if (r == 0) {
+                    status = turbo::data_loss_error("disk index truncated at {}", begin + pos + done);
+                    break;
+                }
+                done += static_cast<std::size_t>(r);
+            }
+            if (status.ok()) {
+                const std::size_t n = std::min(len - skip, bytes - copied);
+                std::memcpy(dst + copied, buf + skip, n);
+                copied += n;
+                skip = 0;
+            }
+        }
+        Allocator::get_instance().deallocate_pages(buf, cap);
+        return status;
+    }
+
+    turbo::Status DiskIndex::load_index(const std::string &path) {
+        TLOG_CHECK(_is_available, "should init be using");
+        if (_is_loaded) {
+            return turbo::failed_precondition_error("index already loaded");
+        }
+        auto *probe = Allocator::get_instance().allocate_pages(kDiskSectorSize);
+        ssize_t nprobe = -1;
+#if defined(O_DIRECT)
+        if (_option.direct_io) {
+            _fd = ::open(path.c_str(), O_RDONLY | O_DIRECT);
+            if (_fd >= 0) {
+                nprobe = ::pread(_fd, probe, kDiskSectorSize, 0);
+                if (nprobe < 0) {
+                    // the file system take the flag but not the reads
+                    ::close(_fd);
+                    _fd = -1;
+                }
+            }
+        }
+#endif
+        _direct_io = _fd >= 0;
+        if (_fd < 0) {
+            _fd = ::open(path.c_str(), O_RDONLY);
+            if (_fd >= 0) {
+                nprobe = ::pread(_fd, probe, kDiskSectorSize, 0);
+            }
+        }
+        turbo::Status rs;
+        struct stat st;
+        if (_fd < 0 || nprobe < 0 || ::fstat(_fd, &st) != 0) {
+            rs = turbo::errno_to_status(errno, "open " + path);
+        } else if (static_cast<std::size_t>(nprobe) < sizeof(DiskIndexHeader)) {
+            rs = turbo::data_loss_error("disk index {} too small", path);
+        } else {
+            std::memcpy(&_header, probe, sizeof(_header));
+            if (_header.magic != kDiskIndexMagic) {
+                rs = turbo::data_loss_error("{} is not a disk index", path);
+            } else if (_header.version != kDiskIndexVersion) {
+                rs = turbo::unimplemented_error("disk index version {} not supported", _header.version);
+            } else if (_header.file_size > static_cast<uint64_t>(st.st_size)) {
+                rs = turbo::data_loss_error("disk index {} truncated, {} of {} bytes", path, st.st_size,
+                                            _header.file_size);
+            } else if (!check_layout(_header)) {
+                rs = turbo::data_loss_error("disk index {} is corrupted", path);
+            }
+        }
+        Allocator::get_instance().deallocate_pages(probe, kDiskSectorSize);
+        if (!rs.ok()) {
+            close();
+            return rs;
+        }
+        const std::size_t n = _header.nvectors;
+        auto metric = static_cast<MetricType>(_header.metric);
+        rs = _distance.initialize(metric, _header.dimension);
+        if (rs.ok() && !_pq.initialize(_header.dimension, _header.pq_m, _header.pq_nbits).ok()) {
+            rs = turbo::data_loss_error("disk index {} is corrupted", path);
+        }
+        // the sections in order, inside the file
+        const std::size_t pq_bytes = _pq.m() * _pq.ksub() * _pq.dsub() * sizeof(float);
+        if (rs.ok() && (_header.pq_offset + pq_bytes > _header.codes_offset ||
+                        _header.codes_offset + n * _pq.code_size() > _header.labels_offset ||
+                        _header.labels_offset + n * sizeof(label_type) > _header.file_size)) {
+            rs = turbo::data_loss_error("disk index {} is corrupted", path);
+        }
+        if (rs.ok()) {
+            std::vector<float> centroids(_pq.m() * _pq.ksub() * _pq.dsub());
+            rs = read_section(_header.pq_offset, centroids.size() * sizeof(float),
+                              reinterpret_cast<uint8_t *>(centroids.data()));
+            if (rs.ok()) {
+                rs = _pq.set_centroids(centroids);
+            }
+        }
+        if (rs.ok()) {
+            _codes.resize(n * _pq.code_size());
+            rs = read_section(_header.codes_offset, _codes.size(), _codes.data());
+        }
+        if (rs.ok()) {
+            _labels.resize(n);
+            rs = read_section(_header.labels_offset, n * sizeof(label_type),
+                              reinterpret_cast<uint8_t *>(_labels.data()));
+        }
+        if (!rs.ok()) {
+            close();
+            return rs;
+        }
+        _label_map.reserve(n);
+        for (std::size_t i = 0; i < n; ++i) {
+            _label_map[_labels[i]] = static_cast<uint32_t>(i);
+        }
+        const std::size_t nwords = (n + 63) / 64;
+        _deleted = std::make_unique<std::atomic<uint64_t>[]>(nwords);
+        for (std::size_t w = 0; w < nwords; ++w) {
+            _deleted[w].store(0, std::memory_order_relaxed);
+        }
+        rs = load_cache();
+        if (!rs.ok()) {
+            close();
+            return rs;
+        }
+        _is_loaded = true;
+        return turbo::ok_status();
+    }
+
+    turbo::Status DiskIndex::load_cache() {
+        const std::size_t n = std::min<std::size_t>(_option.cache_nodes, _header.nvectors);
+        if (n == 0) {
+            return turbo::ok_status();
+        }
+        _cache_data.resize(n * _header.node_bytes);
+        std::vector<uint8_t> read(_header.node_read_bytes());
+        // breadth first from the medoid, the nodes every search goes through first
+        std::deque<uint32_t> queue{static_cast<uint32_t>(_header.medoid)};
+        turbo::flat_hash_set<uint32_t> seen{static_cast<uint32_t>(_header.medoid)};
+        while (!queue.empty() && _cache_index.size() < n) {
+            const uint32_t id = queue.front();
+            queue.pop_front();
+            auto rs = read_section(_header.node_read_offset(id) + _header.node_read_skip(id), _header.node_bytes,
+                                   read.data());
+            if (!rs.ok()) {
+                return rs;
+            }
+            const auto slot = static_cast<uint32_t>(_cache_index.size());
+            std::memcpy(_cache_data.data() + slot * _header.node_bytes, read.data(), _header.node_bytes);
+            _cache_index[id] = slot;
+            uint32_t degree;
+            const uint32_t *nbrs;
+            if (!read_links(read.data(), degree, nbrs)) {
+                return turbo::data_loss_error("disk index node {} is corrupted", id);
+            }
+            for (uint32_t i = 0; i < degree; ++i) {
+                if (nbrs[i] >= _header.nvectors) {
+                    return turbo::data_loss_error("disk index node {} is corrupted", id);
+                }
+                if (seen.insert(nbrs[i]).second) {
+                    queue.push_back(nbrs[i]);
+                }
+            }
+        }
+        _cache_data.resize(_cache_index.size() * _header.node_bytes);
+        return turbo::ok_status();
+    }
+
+    bool DiskIndex::read_links(const uint8_t *rec, uint32_t &degree, const uint32_t *&nbrs) const {
+        const std::size_t vector_bytes = _header.dimension * sizeof(float);
+        std::memcpy(&degree, rec + vector_bytes, sizeof(degree));
+        nbrs = reinterpret_cast<const uint32_t *>(rec + vector_bytes + sizeof(uint32_t));
+        return degree <= _header.max_degree;
+    }
+
+    turbo::ResultStatus<std::unique_ptr<DiskIndex::SearchContext>> DiskIndex::get_context() const {
+        {
+            std::unique_lock<std::mutex> lock(_context_lock);
+            if (!_contexts.empty()) {
+                auto context = std::move(_contexts.back());
+                _contexts.pop_back();
+                return context;
+            }
+        }
+        auto context = std::make_unique<SearchContext>(_option.beam_width, _header.node_read_bytes());
+        auto engine = make_io_engine(_option.backend, _option.beam_width, _option.io_threads);
+        if (!engine.ok()) {
+            return engine.status();
+        }
+        context->engine = std::move(engine.value());
+        context->lut.resize(_pq.m() * _pq.ksub());
+        return context;
+    }
+
+    void DiskIndex::release_context(std::unique_ptr<SearchContext> context) const {
+        std::unique_lock<std::mutex> lock(_context_lock);
+        _contexts.push_back(std::move(context));
+    }
+
+    template<typename F>
+    turbo::Status
+    DiskIndex::read_nodes(SearchContext &context, const uint32_t *ids, std::size_t n, QueryStats &stats,
+                          F &&fn) const {
+        const std::size_t slot_bytes = _header.node_read_bytes();
+        context.free_slots.clear();
+        for (std::size_t s = context.reqs.size(); s > 0; --s) {
+            context.free_slots.push_back(s - 1);
+        }
+        turbo::Status status;
+        std::size_t next = 0;
+        std::size_t inflight = 0;
+        while (true) {
+            while (next < n && status.ok()) {
+                const uint32_t id = ids[next];
+                if (auto it = _cache_index.find(id); it != _cache_index.end()) {
+                    fn(id, _cache_data.data() + static_cast<std::size_t>(it->second) * _header.node_bytes);
+                    ++next;
+                    continue;
+                }
+                if (context.free_slots.empty()) {
+                    break;
+                }
+                const std::size_t slot = context.free_slots.back();
+                auto &req = context.reqs[slot];
+                req = IoRequest{};
+                req.fd = _fd;
+                req.buf = context.buf + slot * slot_bytes;
+                req.len = slot_bytes;
+                req.offset = _header.node_read_offset(id);
+                req.owner = &context;
+                auto rs = context.engine->submit(&req);
+                if (!rs.ok()) {
+                    status = rs;
+                    break;
+                }
+                context.free_slots.pop_back();
+                context.ids[slot] = id;
+                ++stats.io_reads;
+                ++inflight;
+                ++next;
+            }
+            if (inflight == 0) {
+                return status;
+            }
+            auto r = context.engine->wait();
+            if (!r.ok()) {
+                return r.status();
+            }
+            auto *req = r.value();
+            const auto slot = static_cast<std::size_t>(req - context.reqs.data());
+            --inflight;
+            context.free_slots.push_back(slot);
+            if (req->error != 0) {
+                status = turbo::errno_to_status(req->error, "read disk index node");
+            } else if (req->done < req->len) {
+                status = turbo::data_loss_error("disk index truncated at node {}", context.ids[slot]);
+            } else if (status.ok()) {
+                fn(context.ids[slot], req->buf + _header.node_read_skip(context.ids[slot]));
+            }
+            if (!status.ok()) {
+                // stop submitting, drain what is in flight
+                next = n;
+            }
+        }
+    }
+
+    turbo::ResultStatus<location_t> DiskIndex::add_vector(label_type label, turbo::Span<float> vector) {
+        return turbo::unimplemented_error("disk index is read only, build it with VamanaBuilder");
+    }
+
+    turbo::Status DiskIndex::remove_vector(label_type label) {
+        TLOG_CHECK(_is_loaded, "should load be using");
+        std::unique_lock<std::shared_mutex> lock(_label_lock);
+        auto it = _label_map.find(label);
+        if (it == _label_map.end()) {
+            return turbo::not_found_error("delete label not found");
+        }
+        const uint32_t id = it->second;
+        _label_map.erase(it);
+        _deleted[id / 64].fetch_or(uint64_t{1} << (id % 64), std::memory_order_release);
+        ++_deleted_size;
+        return turbo::ok_status();
+    }
+
+    std::size_t DiskIndex::size() const {
+        return _is_loaded ? _header.nvectors - _deleted_size : 0;
+    }
+
+    turbo::Status
+    DiskIndex::search(turbo::Span<float> query, const SearchOption &option, std::vector<QueryResult> &result) const {
+        TLOG_CHECK(_is_loaded, "should load be using");
+        if (query.size() != _header.dimension) {
+            return turbo::invalid_argument_error("query dimension {} not match the index {}", query.size(),
+                                                 _header.dimension);
+        }
+        result.clear();
+        if (option.k == 0 || _header.nvectors == 0) {
+            return turbo::ok_status();
+        }
+        SearchRecorder recorder(search_metrics(), option.stats);
+        auto &stats = recorder.stats;
+        if (option.filter != nullptr) {
+            // few members, read them directly instead of walking the graph
+            auto limit = std::max(static_cast<std::size_t>(option.brute_force_ratio * size()), option.k);
+            std::vector<label_type> members;
+            if (option.filter->collect_members(limit, members)) {
+                return search_members(query.data(), members, option.k, result, stats);
+            }
+        }
+        auto ctx = get_context();
+        if (!ctx.ok()) {
+            return ctx.status();
+        }
+        auto context = std::move(ctx.value());
+        auto rs = _pq.compute_lut(_distance.metric(), query.data(), context->lut.data());
+        if (!rs.ok()) {
+            release_context(std::move(context));
+            return rs;
+        }
+        const std::size_t code_size = _pq.code_size();
+        const std::size_t limit = std::max<std::size_t>(option.ef != 0 ? option.ef : _option.search_list,
+                                                        option.k);
+        const float *lut = context->lut.data();
+        std::vector<Candidate> list;
+        list.reserve(limit + 1);
+        turbo::flat_hash_set<uint32_t> visited;
+        const auto medoid = static_cast<uint32_t>(_header.medoid);
+        visited.insert(medoid);
+        list.push_back({_pq.adc_distance(lut, _codes.data() + medoid * code_size), medoid, false});
+        std::priority_queue<std::pair<float, label_type>> heap;
+        std::vector<uint32_t> beam;
+        // the first node read with a bad degree or neighbor, its links are not followed
+        uint32_t corrupted = constants::kUnknownLocation;
+        ++stats.distance_computations;
+        auto expand = [&](uint32_t id, const uint8_t *rec) {
+            ++stats.nodes_visited;
+            if (!is_deleted(id) && (option.filter == nullptr || option.filter->is_member(_labels[id]))) {
+                push_result(heap, option.k, _distance(query.data(), reinterpret_cast<const float *>(rec)),
+                            _labels[id]);
+                ++stats.distance_computations;
+            } else {
+                ++stats.filter_rejected;
+            }
+            uint32_t degree;
+            const uint32_t *nbrs;
+            if (!read_links(rec, degree, nbrs)) {
+                corrupted = std::min(corrupted, id);
+                return;
+            }
+            for (uint32_t i = 0; i < degree; ++i) {
+                const uint32_t nb = nbrs[i];
+                if (nb >= _header.nvectors) {
+                    corrupted = std::min(corrupted, id);
+                    continue;
+                }
+                if (!visited.insert(nb).second) {
+                    continue;
+                }
+                const float d = _pq.adc_distance(lut, _codes.data() + static_cast<std::size_t>(nb) * code_size);
+                ++stats.distance_computations;
+                if (list.size() >= limit && d >= list.back().distance) {
+                    continue;
+                }
+                auto pos = std::upper_bound(list.begin(), list.end(), d,
+                                            [](float v, const Candidate &c) { return v < c.distance; });
+                list.insert(pos, {d, nb, false});
+                if (list.size() > limit) {
+                    list.pop_back();
+                }
+            }
+        };
+        while (true) {
+            beam.clear();
+            for (auto &c : list) {
+                if (!c.expanded) {
+                    c.expanded = true;
+                    beam.push_back(c.id);
+                    if (beam.size() == _option.beam_width) {
+                        break;
+                    }
+                }
+            }
+            if (beam.empty()) {
+                break;
+            }
+            rs = read_nodes(*context, beam.data(), beam.size(), stats, expand);
+            if (!rs.ok()) {
+                // the context may have reads in flight, it is dropped and its engine reaps them
+                return rs;
+            }
+        }
+        release_context(std::move(context));
+        if (corrupted != constants::kUnknownLocation) {
+            return turbo::data_loss_error("disk index node {} is corrupted", corrupted);
+        }
+        finish(heap, result);
+        return turbo::ok_status();
+    }
+
+    turbo::Status DiskIndex::search_members(const float *query, const std::vector<label_type> &members,
+                                            std::size_t k, std::vector<QueryResult> &result,
+                                            QueryStats &stats) const {
+        std::vector<uint32_t> ids;
+        ids.reserve(members.size());
+        {
+            std::shared_lock<std::shared_mutex> lock(_label_lock);
+            for (auto label : members) {
+                if (auto it = _label_map.find(label); it != _label_map.end()) {
+                    ids.push_back(it->second);
+                }
+            }
+        }
+        // in file order, neighbors in a sector are read together by the page cache
+        std::sort(ids.begin(), ids.end());
+        auto ctx = get_context();
+        if (!ctx.ok()) {
+            return ctx.status();
+        }
+        auto context = std::move(ctx.value());
+        std::priority_queue<std::pair<float, label_type>> heap;
+        stats.filter_rejected += members.size() - ids.size();
+        auto rs = read_nodes(*context, ids.data(), ids.size(), stats, [&](uint32_t id, const uint8_t *rec) {
+            if (!is_deleted(id)) {
+                push_result(heap, k, _distance(query, reinterpret_cast<const float *>(rec)), _labels[id]);
+                ++stats.distance_computations;
+            } else {
+                ++stats.filter_rejected;
+            }
+        });
+        if (!rs.ok()) {
+            return rs;
+        }
+        release_context(std::move(context));
+        finish(heap, result);
+        return turbo::ok_status();
+    }
+
+}  // namespace zircon
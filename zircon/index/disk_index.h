@@ -0,0 +1,147 @@
+// Copyright 2023 The Elastic-AI Authors.
+// part of Elastic AI Search
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#ifndef ZIRCON_INDEX_DISK_INDEX_H_
+#define ZIRCON_INDEX_DISK_INDEX_H_
+
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <shared_mutex>
+#include <string>
+#include <vector>
+#include "turbo/container/flat_hash_map.h"
+#include "zircon/core/index.h"
+#include "zircon/core/io_engine.h"
+#include "zircon/index/disk_layout.h"
+#include "zircon/quantizer/product_quantizer.h"
+#include "zircon/utility/metric_distance.h"
+
+namespace zircon {
+
+    struct DiskIndexOption {
+        // node reads in flight of a search
+        uint32_t beam_width{4};
+        // candidate list of a search when SearchOption::ef is 0, at least k
+        uint32_t search_list{100};
+        // nodes nearest in hops to the medoid held in memory, their reads are skipped
+        uint32_t cache_nodes{0};
+        // bypass the page cache, fall back to buffered reads if the file system refuse it
+        bool direct_io{true};
+        AsyncIoBackend backend{AsyncIoBackend::IO_AUTO};
+        // threads of the thread pool backend, for every search context
+        uint32_t io_threads{2};
+    };
+
+    /**
+     * @brief search a vamana graph written by VamanaBuilder without loading
+     *        it. the node records, vector and neighbors, stay on disk in
+     *        aligned sectors, only the pq codes and the labels are in memory.
+     *        a search is a beam search, the unexpanded candidates nearest by
+     *        pq distance are read beam_width at a time through an IoEngine,
+     *        the neighbors of a read node are ranked by their pq codes and
+     *        the node itself by its full vector, so the result is reranked
+     *        exactly with no extra read. concurrent searches take their own
+     *        search context, an io engine and the sector buffers, from a pool.
+     *        the index is read only, add_vector is unimplemented, removed
+     *        labels are hidden from the results and still routed through.
+     */
+    class DiskIndex : public Index {
+    public:
+        DiskIndex();
+
+        ~DiskIndex() override;
+
+        turbo::Status initialize(const DiskIndexOption &option = DiskIndexOption());
+
+        // open the index file, data loss if it is not a complete disk index
+        turbo::Status load_index(const std::string &path) override;
+
+        turbo::ResultStatus<location_t> add_vector(label_type label, turbo::Span<float> vector) override;
+
+        turbo::Status remove_vector(label_type label) override;
+
+        turbo::Status
+        search(turbo::Span<float> query, const SearchOption &option, std::vector<QueryResult> &result) const override;
+
+        [[nodiscard]] std::size_t size() const override;
+
+        [[nodiscard]] const DiskIndexHeader &header() const {
+            return _header;
+        }
+
+        [[nodiscard]] bool is_direct_io() const {
+            return _direct_io;
+        }
+
+        [[nodiscard]] std::size_t cached_nodes() const {
+            return _cache_index.size();
+        }
+
+    private:
+        struct SearchContext;
+
+        turbo::ResultStatus<std::unique_ptr<SearchContext>> get_context() const;
+
+        void release_context(std::unique_ptr<SearchContext> context) const;
+
+        // bytes at offset of the file into dst, through aligned reads
+        turbo::Status read_section(uint64_t offset, std::size_t bytes, uint8_t *dst) const;
+
+        turbo::Status load_cache();
+
+        // degree and neighbor ids of a node record, false if the degree is above max_degree
+        bool read_links(const uint8_t *rec, uint32_t &degree, const uint32_t *&nbrs) const;
+
+        [[nodiscard]] bool is_deleted(uint32_t id) const {
+            return (_deleted[id / 64].load(std::memory_order_acquire) >> (id % 64)) & 1u;
+        }
+
+        // read the records of ids, call fn(id, record) for each as the reads complete
+        template<typename F>
+        turbo::Status read_nodes(SearchContext &context, const uint32_t *ids, std::size_t n, QueryStats &stats,
+                                 F &&fn) const;
+
+        turbo::Status search_members(const float *query, const std::vector<label_type> &members, std::size_t k,
+                                     std::vector<QueryResult> &result, QueryStats &stats) const;
+
+        void close();
+
+    private:
+        bool _is_available{false};
+        bool _is_loaded{false};
+        DiskIndexOption _option;
+        DiskIndexHeader _header{};
+        int _fd{-1};
+        bool _direct_io{false};
+        MetricDistance _distance;
+        ProductQuantizer _pq;
+        std::vector<uint8_t> _codes;
+        std::vector<label_type> _labels;
+        mutable std::shared_mutex _label_lock;
+        // guard by _label_lock
+        turbo::flat_hash_map<label_type, uint32_t> _label_map;
+        std::unique_ptr<std::atomic<uint64_t>[]> _deleted;
+        std::atomic<std::size_t> _deleted_size{0};
+        // node id to its record in _cache_data
+        turbo::flat_hash_map<uint32_t, uint32_t> _cache_index;
+        std::vector<uint8_t> _cache_data;
+        mutable std::mutex _context_lock;
+        mutable std::vector<std::unique_ptr<SearchContext>> _contexts;
+    };
+
+}  // namespace zircon
+
+#endif  // ZIRCON_INDEX_DISK_INDEX_H_
@@ -0,0 +1,98 @@
+// Copyright 2023 The Elastic-AI Authors.
+// part of Elastic AI Search
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#ifndef ZIRCON_INDEX_DISK_LAYOUT_H_
+#define ZIRCON_INDEX_DISK_LAYOUT_H_
+
+#include <cstddef>
+#include <cstdint>
+#include "zircon/core/allocator.h"
+
+namespace zircon {
+
+    // "ZRCNDANN"
+    constexpr uint64_t kDiskIndexMagic = 0x4e4e41444e43525aULL;
+    constexpr uint32_t kDiskIndexVersion = 1;
+    // unit of the node reads, every section start on a sector
+    constexpr std::size_t kDiskSectorSize = Allocator::page_alignment;
+
+    constexpr std::size_t align_to_sector(std::size_t n) {
+        return (n + kDiskSectorSize - 1) / kDiskSectorSize * kDiskSectorSize;
+    }
+
+    /**
+     * @brief first sector of a disk index file, written by VamanaBuilder and
+     *        read by DiskIndex. a node record is the dimension floats of the
+     *        vector, the uint32 degree, then max_degree uint32 neighbor ids.
+     *        small records are packed nodes_per_sector to a sector and never
+     *        straddle two, large ones take sectors_per_node whole sectors, so
+     *        a node is always one aligned read. the pq codebooks, the codes
+     *        and the labels follow the graph, they are loaded in memory.
+     *        the layout is the one of the host, no byte order conversion is done.
+     */
+    struct DiskIndexHeader {
+        uint64_t magic;
+        uint32_t version;
+        uint32_t metric;
+        uint32_t dimension;
+        uint32_t max_degree;
+        uint64_t nvectors;
+        uint64_t medoid;
+        uint32_t node_bytes;
+        // 0 if a record is larger than a sector
+        uint32_t nodes_per_sector;
+        uint32_t sectors_per_node;
+        uint32_t pq_m;
+        uint32_t pq_nbits;
+        uint32_t reserved;
+        uint64_t graph_offset;
+        // pq_m * ksub * dsub floats
+        uint64_t pq_offset;
+        // nvectors codes of the pq code size
+        uint64_t codes_offset;
+        // nvectors uint64 labels
+        uint64_t labels_offset;
+        uint64_t file_size;
+
+        // file offset of the read holding node i
+        [[nodiscard]] uint64_t node_read_offset(uint64_t i) const {
+            if (nodes_per_sector != 0) {
+                return graph_offset + i / nodes_per_sector * kDiskSectorSize;
+            }
+            return graph_offset + i * sectors_per_node * kDiskSectorSize;
+        }
+
+        // where the record of node i is in that read
+        [[nodiscard]] std::size_t node_read_skip(uint64_t i) const {
+            return nodes_per_sector != 0 ? i % nodes_per_sector * node_bytes : 0;
+        }
+
+        [[nodiscard]] std::size_t node_read_bytes() const {
+            return sectors_per_node * kDiskSectorSize;
+        }
+
+        [[nodiscard]] uint64_t graph_sectors() const {
+            if (nodes_per_sector != 0) {
+                return (nvectors + nodes_per_sector - 1) / nodes_per_sector;
+            }
+            return nvectors * sectors_per_node;
+        }
+    };
+
+    static_assert(sizeof(DiskIndexHeader) <= kDiskSectorSize, "disk index header must fit a sector");
+
+}  // namespace zircon
+
+#endif  // ZIRCON_INDEX_DISK_LAYOUT_H_
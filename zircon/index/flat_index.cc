@@ -0,0 +1,122 @@
+// Copyright 2023 The Elastic-AI Authors.
+// part of Elastic AI Search
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#include "zircon/index/flat_index.h"
+#include "zircon/index/brute_force.h"
+#include "zircon/utility/id_filter.h"
+#include "zircon/utility/metrics.h"
+#include "turbo/log/logging.h"
+#include <algorithm>
+
+namespace zircon {
+
+    namespace {
+        SearchMetrics &search_metrics() {
+            static SearchMetrics metrics("flat");
+            return metrics;
+        }
+    }  // namespace
+
+    turbo::Status FlatIndex::initialize(const IndexOption &option, const FlatOption &flat) {
+        if (_is_available) {
+            return turbo::failed_precondition_error("index already initialized");
+        }
+        auto rs = _distance.initialize(option.metric, option.dimension);
+        if (!rs.ok()) {
+            return rs;
+        }
+        if (option.store_option.encoding != EncodingType::ENCODING_NONE) {
+            return turbo::invalid_argument_error("flat index need a float store");
+        }
+        _option = option;
+        _flat = flat;
+        auto &store_option = _option.store_option;
+        store_option.vector_byte_size = static_cast<uint32_t>(option.dimension * sizeof(float));
+        // cosine read the norms kept by the store, normalized cosine has the vectors normalized when added
+        store_option.dimension = option.dimension;
+        if (option.metric == MetricType::METRIC_COSINE) {
+            store_option.keep_norms = true;
+        } else if (option.metric == MetricType::METRIC_NORMALIZED_COSINE) {
+            store_option.normalize = true;
+        }
+        rs = _store.initialize(store_option);
+        if (!rs.ok()) {
+            return rs;
+        }
+        if (_flat.nthreads > 1) {
+            _pool = std::make_unique<ThreadPool>(_flat.nthreads);
+        }
+        _is_available = true;
+        return turbo::ok_status();
+    }
+
+    ThreadPool *FlatIndex::pool() const {
+        if (_flat.nthreads == 1) {
+            return nullptr;
+        }
+        return _pool != nullptr ? _pool.get() : &ThreadPool::default_pool();
+    }
+
+    turbo::ResultStatus<location_t> FlatIndex::add_vector(label_type label, turbo::Span<float> vector) {
+        TLOG_CHECK(_is_available, "should init be using");
+        if (vector.size() != _option.dimension) {
+            return turbo::invalid_argument_error("vector dimension {} not match the index {}", vector.size(),
+                                                 _option.dimension);
+        }
+        return _store.add_vector(label, turbo::Span<uint8_t>(reinterpret_cast<uint8_t *>(vector.data()),
+                                                             vector.size() * sizeof(float)));
+    }
+
+    turbo::Status FlatIndex::remove_vector(label_type label) {
+        TLOG_CHECK(_is_available, "should init be using");
+        auto r = _store.remove_vector(label);
+        if (!r.ok()) {
+            return r.status();
+        }
+        return turbo::ok_status();
+    }
+
+    turbo::Status
+    FlatIndex::search(turbo::Span<float> query, const SearchOption &option, std::vector<QueryResult> &result) const {
+        TLOG_CHECK(_is_available, "should init be using");
+        if (query.size() != _option.dimension) {
+            return turbo::invalid_argument_error("query dimension {} not match the index {}", query.size(),
+                                                 _option.dimension);
+        }
+        result.clear();
+        if (option.k == 0) {
+            return turbo::ok_status();
+        }
+        SearchRecorder recorder(search_metrics(), option.stats);
+        if (option.filter != nullptr) {
+            // few members, scoring them directly is cheaper than a scan
+            auto limit = std::max(static_cast<std::size_t>(option.brute_force_ratio * _store.size()), option.k);
+            std::vector<label_type> members;
+            if (option.filter->collect_members(limit, members)) {
+                brute_force_search(_store, _distance, query.data(), members, option.k, result, &recorder.stats);
+                return turbo::ok_status();
+            }
+        }
+        auto *p = pool();
+        if (p == nullptr || _store.current_index() < _flat.parallel_threshold) {
+            brute_force_search(_store, _distance, query.data(), option, result, &recorder.stats);
+            return turbo::ok_status();
+        }
+        parallel_brute_force_search(_store, _distance, query.data(), option, *p, _flat.batches_per_task, result,
+                                    &recorder.stats);
+        return turbo::ok_status();
+    }
+
+}  // namespace zircon
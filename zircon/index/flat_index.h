@@ -0,0 +1,86 @@
+// Copyright 2023 The Elastic-AI Authors.
+// part of Elastic AI Search
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#ifndef ZIRCON_INDEX_FLAT_INDEX_H_
+#define ZIRCON_INDEX_FLAT_INDEX_H_
+
+#include <memory>
+#include <vector>
+#include "zircon/core/index.h"
+#include "zircon/store/mem_vector_store.h"
+#include "zircon/utility/metric_distance.h"
+#include "zircon/utility/thread_pool.h"
+
+namespace zircon {
+
+    /**
+     * @brief exact index, every search scores all alive vectors of the store.
+     *        the batches are split over a work stealing pool, every thread
+     *        keeps a bounded heap of its batches and the heaps are merged at
+     *        the end. it is the ground truth of the recall checks and the
+     *        fallback of small or heavily filtered shards. removed locations
+     *        are reused by the next adds. METRIC_COSINE scores with the norms
+     *        kept by the store, METRIC_NORMALIZED_COSINE normalizes the vectors
+     *        when added, the queries are expected unit length. METRIC_POINCARE
+     *        and METRIC_LORENTZ take the points of the ball or the hyperboloid
+     *        as they are.
+     */
+    class FlatIndex : public Index {
+    public:
+        FlatIndex() = default;
+
+        ~FlatIndex() override = default;
+
+        turbo::Status initialize(const IndexOption &option, const FlatOption &flat = FlatOption());
+
+        turbo::ResultStatus<location_t> add_vector(label_type label, turbo::Span<float> vector) override;
+
+        turbo::Status remove_vector(label_type label) override;
+
+        turbo::Status
+        search(turbo::Span<float> query, const SearchOption &option, std::vector<QueryResult> &result) const override;
+
+        [[nodiscard]] std::size_t size() const override {
+            return _store.size();
+        }
+
+        [[nodiscard]] const MemVectorStore &store() const {
+            return _store;
+        }
+
+        [[nodiscard]] MemVectorStore &store() {
+            return _store;
+        }
+
+        [[nodiscard]] const FlatOption &flat_option() const {
+            return _flat;
+        }
+
+    private:
+        [[nodiscard]] ThreadPool *pool() const;
+
+    private:
+        bool _is_available{false};
+        IndexOption _option;
+        FlatOption _flat;
+        MemVectorStore _store;
+        MetricDistance _distance;
+        // owned pool of nthreads, nullptr for the shared one or a serial index
+        std::unique_ptr<ThreadPool> _pool;
+    };
+
+}  // namespace zircon
+
+#endif  // ZIRCON_INDEX_FLAT_INDEX_H_
@@ -0,0 +1,622 @@
+// Copyright 2023 The Elastic-AI Authors.
+// part of Elastic AI Search
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#include "zircon/index/hnsw_index.h"
+#include "zircon/core/allocator.h"
+#include "zircon/index/brute_force.h"
+#include "zircon/utility/id_filter.h"
+#include "zircon/utility/metrics.h"
+#include "turbo/log/logging.h"
+#include "turbo/memory/prefetch.h"
+#include <algorithm>
+#include <cmath>
+#include <functional>
+#include <limits>
+#include <memory>
+#include <queue>
+
+namespace zircon {
+
+    namespace {
+        constexpr std::size_t kLinksPerLine = Allocator::alignment / sizeof(location_t);
+
+        std::size_t link_stride(std::size_t max_neighbors) {
+            return (1 + max_neighbors + kLinksPerLine - 1) / kLinksPerLine * kLinksPerLine;
+        }
+
+        SearchMetrics &search_metrics() {
+            static SearchMetrics metrics("hnsw");
+            return metrics;
+        }
+    }  // namespace
+
+    HnswIndex::~HnswIndex() {
+        auto &allocator = Allocator::get_instance();
+        const std::size_t n = _upper_links.size();
+        for (std::size_t i = 0; i < n; ++i) {
+            if (_upper_links[i] != nullptr) {
+                allocator.deallocate(reinterpret_cast<uint8_t *>(_upper_links[i]),
+                                     _levels[i] * _link_stride * sizeof(location_t));
+            }
+        }
+        if (_level0_links != nullptr) {
+            allocator.deallocate(reinterpret_cast<uint8_t *>(_level0_links),
+                                 n * _link0_stride * sizeof(location_t));
+        }
+    }
+
+    turbo::Status HnswIndex::initialize(const IndexOption &option, const HnswOption &hnsw) {
+        if (_is_available) {
+            return turbo::failed_precondition_error("index already initialized");
+        }
+        if (hnsw.m < 2) {
+            return turbo::invalid_argument_error("hnsw m must not less than 2, but {}", hnsw.m);
+        }
+        auto rs = _distance.initialize(option.metric, option.dimension);
+        if (!rs.ok()) {
+            return rs;
+        }
+        if (option.store_option.encoding != EncodingType::ENCODING_NONE) {
+            return turbo::invalid_argument_error("hnsw index need a float store");
+        }
+        _option = option;
+        _hnsw = hnsw;
+        auto &store_option = _option.store_option;
+        store_option.vector_byte_size = static_cast<uint32_t>(option.dimension * sizeof(float));
+        // removed nodes stay in the graph, their locations can not be reused.
+        store_option.enable_replace_vacant = false;
+        // cosine read the norms kept by the store, normalized cosine has the vectors normalized when added
+        store_option.dimension = option.dimension;
+        if (option.metric == MetricType::METRIC_COSINE) {
+            store_option.keep_norms = true;
+        } else if (option.metric == MetricType::METRIC_NORMALIZED_COSINE) {
+            store_option.normalize = true;
+        }
+        rs = _store.initialize(store_option);
+        if (!rs.ok()) {
+            return rs;
+        }
+        _use_norms = _store.keeps_norms() && _distance.use_norms();
+
+        _max_m = _hnsw.m;
+        _max_m0 = 2 * _hnsw.m;
+        _link_stride = link_stride(_max_m);
+        _link0_stride = link_stride(_max_m0);
+        _level_mult = 1.0 / std::log(static_cast<double>(_hnsw.m));
+
+        const std::size_t n = store_option.max_elements;
+        const std::size_t bytes = n * _link0_stride * sizeof(location_t);
+        try {
+            _level0_links = reinterpret_cast<location_t *>(Allocator::get_instance().allocate(bytes));
+        } catch (std::exception &e) {
+            return turbo::resource_exhausted_error("allocate hnsw links failed: {}", e.what());
+        }
+        std::memset(_level0_links, 0, bytes);
+        _upper_links.assign(n, nullptr);
+        _levels.assign(n, 0);
+        _rng.seed(_hnsw.random_seed);
+        _is_available = true;
+        return turbo::ok_status();
+    }
+
+    location_t *HnswIndex::link_list(location_t loc, int level) const {
+        if (level == 0) {
+            return _level0_links + loc * _link0_stride;
+        }
+        return _upper_links[loc] + (level - 1) * _link_stride;
+    }
+
+    std::size_t HnswIndex::copy_links(location_t loc, int level, location_t *out) const {
+        std::shared_lock<std::shared_mutex> lock(*_node_lock.get_lock(loc));
+        const location_t *list = link_list(loc, level);
+        std::size_t n = list[0];
+        std::memcpy(out, list + 1, n * sizeof(location_t));
+        return n;
+    }
+
+    int HnswIndex::random_level() {
+        std::unique_lock<std::mutex> lock(_rng_lock);
+        std::uniform_real_distribution<double> dist(0.0, 1.0);
+        return static_cast<int>(-std::log(1.0 - dist(_rng)) * _level_mult);
+    }
+
+    int HnswIndex::max_level() const {
+        std::shared_lock<std::shared_mutex> lock(_entry_lock);
+        return _max_level;
+    }
+
+    location_t HnswIndex::entry_point() const {
+        std::shared_lock<std::shared_mutex> lock(_entry_lock);
+        return _entry_point;
+    }
+
+    std::vector<location_t> HnswIndex::neighbors(location_t loc, int level) const {
+        TLOG_CHECK(_is_available, "should init be using");
+        TLOG_CHECK(loc < _store.current_index() && level <= _levels[loc], "overflow");
+        std::vector<location_t> result(level == 0 ? _max_m0 : _max_m);
+        result.resize(copy_links(loc, level, result.data()));
+        return result;
+    }
+
+    location_t HnswIndex::greedy_search(location_t ep, const float *query, float query_norm, int from_level,
+                                        int to_level, QueryStats *stats) const {
+        float best = distance_to(query, query_norm, ep);
+        std::vector<location_t> links(_max_m);
+        uint64_t expanded = 0;
+        uint64_t distances = 1;
+        for (int level = from_level; level >= to_level; --level) {
+            bool changed = true;
+            while (changed) {
+                changed = false;
+                auto n = copy_links(ep, level, links.data());
+                ++expanded;
+                distances += n;
+                for (std::size_t i = 0; i < n; ++i) {
+                    float d = distance_to(query, query_norm, links[i]);
+                    if (d < best) {
+                        best = d;
+                        ep = links[i];
+                        changed = true;
+                    }
+                }
+            }
+        }
+        if (stats != nullptr) {
+            stats->nodes_visited += expanded;
+            stats->distance_computations += distances;
+        }
+        return ep;
+    }
+
+    bool HnswIndex::accept(location_t loc, const IdFilter *filter) const {
+        if (_store.is_deleted(loc)) {
+            return false;
+        }
+        return filter == nullptr || filter->is_member(_store.get_label(loc).value());
+    }
+
+    void HnswIndex::accept_block(const location_t *locs, std::size_t n, const IdFilter *filter, label_type *labels,
+                                 uint64_t *mask) const {
+        // deleted nodes have no label
+        for (std::size_t i = 0; i < n; ++i) {
+            labels[i] = _store.get_label(locs[i]).value();
+        }
+        if (filter != nullptr) {
+            filter->filter_block(labels, n, mask);
+        } else {
+            std::fill(mask, mask + (n + 63) / 64, ~uint64_t(0));
+        }
+        for (std::size_t i = 0; i < n; ++i) {
+            if (labels[i] == constants::kUnknownLabel) {
+                mask[i / 64] &= ~(uint64_t(1) << (i % 64));
+            }
+        }
+    }
+
+    class HnswIndex::LayerSearch {
+    public:
+        LayerSearch(const HnswIndex &index, const float *query, float query_norm, std::size_t ef, int level,
+                    bool skip_deleted, const IdFilter *filter)
+                : _index(index), _query(query), _query_norm(query_norm), _ef(ef), _level(level), _skip_deleted(skip_deleted),
+                  _filter(filter), _visited(index._visited_pool.get(index._option.store_option.max_elements)),
+                  _links(index._max_m0), _labels(index._max_m0), _mask((index._max_m0 + 63) / 64) {}
+
+        ~LayerSearch() {
+            _index._visited_pool.release(std::move(_visited));
+        }
+
+        void start(location_t ep) {
+            float d = _index.distance_to(_query, _query_norm, ep);
+            if (!_skip_deleted || _index.accept(ep, _filter)) {
+                _top.emplace(d, ep);
+                _lower_bound = d;
+            }
+            _candidates.emplace(d, ep);
+            _visited->visit(ep);
+        }
+
+        // pop the nearest candidate with unvisited neighbors and prefetch them,
+        // false once no candidate can improve the results.
+        bool expand() {
+            _fresh = 0;
+            while (!_candidates.empty()) {
+                auto current = _candidates.top();
+                if (current.first > _lower_bound && _top.size() >= _ef) {
+                    return false;
+                }
+                _candidates.pop();
+                ++_expanded;
+                auto n = _index.copy_links(current.second, _level, _links.data());
+                // keep the unvisited neighbors, their labels are checked by one filter call
+                for (std::size_t i = 0; i < n; ++i) {
+                    if (!_visited->visited(_links[i])) {
+                        _visited->visit(_links[i]);
+                        _links[_fresh++] = _links[i];
+                    }
+                }
+                if (_fresh == 0) {
+                    continue;
+                }
+                for (std::size_t i = 0; i < _fresh; ++i) {
+                    turbo::prefetch_to_local_cache(_index.vector_data(_links[i]));
+                }
+                if (_skip_deleted) {
+                    _index.accept_block(_links.data(), _fresh, _filter, _labels.data(), _mask.data());
+                    // the bits past fresh in the last word are not defined
+                    std::size_t accepted = 0;
+                    for (std::size_t w = 0; w * 64 < _fresh; ++w) {
+                        const std::size_t bits = std::min<std::size_t>(64, _fresh - w * 64);
+                        const uint64_t valid = bits == 64 ? ~uint64_t(0) : (uint64_t(1) << bits) - 1;
+                        accepted += __builtin_popcountll(_mask[w] & valid);
+                    }
+                    _rejected += _fresh - accepted;
+                }
+                _distances += _fresh;
+                return true;
+            }
+            return false;
+        }
+
+        // score the neighbors prefetched by the last expand
+        void score() {
+            for (std::size_t i = 0; i < _fresh; ++i) {
+                auto nb = _links[i];
+                float d = _index.distance_to(_query, _query_norm, nb);
+                if (_top.size() < _ef || d < _lower_bound) {
+                    _candidates.emplace(d, nb);
+                    if (!_skip_deleted || (_mask[i / 64] >> (i % 64)) & 1) {
+                        _top.emplace(d, nb);
+                    }
+                    if (_top.size() > _ef) {
+                        _top.pop();
+                    }
+                    if (!_top.empty()) {
+                        _lower_bound = _top.top().first;
+                    }
+                }
+            }
+            _fresh = 0;
+        }
+
+        // prefetch the neighbor list the next expand is likely to read
+        void prefetch_next() const {
+            if (!_candidates.empty()) {
+                turbo::prefetch_to_local_cache(_index.link_list(_candidates.top().second, _level));
+            }
+        }
+
+        void add_stats(QueryStats &stats) const {
+            stats.nodes_visited += _expanded;
+            stats.distance_computations += _distances;
+            stats.filter_rejected += _rejected;
+        }
+
+        // the results, nearest first, the search is left empty
+        std::vector<Candidate> finish() {
+            std::vector<Candidate> result(_top.size());
+            for (auto i = result.size(); i > 0; --i) {
+                result[i - 1] = _top.top();
+                _top.pop();
+            }
+            return result;
+        }
+
+    private:
+        const HnswIndex &_index;
+        const float *_query;
+        const float _query_norm;
+        const std::size_t _ef;
+        const int _level;
+        const bool _skip_deleted;
+        const IdFilter *_filter;
+        std::unique_ptr<VisitedList> _visited;
+        // top is a max heap of the results, candidates a min heap to expand
+        std::priority_queue<Candidate> _top;
+        std::priority_queue<Candidate, std::vector<Candidate>, std::greater<>> _candidates;
+        std::vector<location_t> _links;
+        std::vector<label_type> _labels;
+        std::vector<uint64_t> _mask;
+        // neighbors in links expanded and not scored yet
+        std::size_t _fresh{0};
+        float _lower_bound{std::numeric_limits<float>::max()};
+        uint64_t _expanded{0};
+        // the entry point
+        uint64_t _distances{1};
+        uint64_t _rejected{0};
+    };
+
+    std::vector<HnswIndex::Candidate>
+    HnswIndex::search_layer(location_t ep, const float *query, float query_norm, std::size_t ef, int level,
+                            bool skip_deleted, const IdFilter *filter, QueryStats *stats) const {
+        LayerSearch search(*this, query, query_norm, ef, level, skip_deleted, filter);
+        search.start(ep);
+        while (search.expand()) {
+            search.score();
+        }
+        if (stats != nullptr) {
+            search.add_stats(*stats);
+        }
+        return search.finish();
+    }
+
+    void HnswIndex::select_neighbors(std::vector<Candidate> &candidates, std::size_t m) const {
+        std::sort(candidates.begin(), candidates.end());
+        if (candidates.size() <= m) {
+            return;
+        }
+        std::vector<Candidate> kept;
+        kept.reserve(m);
+        for (auto &c : candidates) {
+            if (kept.size() >= m) {
+                break;
+            }
+            const float *cv = vector_data(c.second);
+            const float cv_norm = query_norm(c.second);
+            bool good = true;
+            for (auto &k : kept) {
+                if (distance_to(cv, cv_norm, k.second) < c.first) {
+                    good = false;
+                    break;
+                }
+            }
+            if (good) {
+                kept.push_back(c);
+            }
+        }
+        candidates.swap(kept);
+    }
+
+    location_t HnswIndex::connect(location_t loc, std::vector<Candidate> &candidates, int level) {
+        select_neighbors(candidates, _max_m);
+        {
+            std::unique_lock<std::shared_mutex> lock(*_node_lock.get_lock(loc));
+            location_t *list = link_list(loc, level);
+            list[0] = static_cast<location_t>(candidates.size());
+            for (std::size_t i = 0; i < candidates.size(); ++i) {
+                list[i + 1] = candidates[i].second;
+            }
+        }
+        // back links, the lock of loc is released first, a thread never hold
+        // two node locks, they are hashed and may be the same one.
+        const std::size_t max_m = level == 0 ? _max_m0 : _max_m;
+        std::vector<Candidate> pruned;
+        for (auto &c : candidates) {
+            auto nb = c.second;
+            std::unique_lock<std::shared_mutex> lock(*_node_lock.get_lock(nb));
+            location_t *list = link_list(nb, level);
+            std::size_t n = list[0];
+            if (n < max_m) {
+                list[n + 1] = loc;
+                list[0] = static_cast<location_t>(n + 1);
+                continue;
+            }
+            const float *nv = vector_data(nb);
+            const float nv_norm = query_norm(nb);
+            pruned.clear();
+            pruned.emplace_back(c.first, loc);
+            for (std::size_t i = 0; i < n; ++i) {
+                pruned.emplace_back(distance_to(nv, nv_norm, list[i + 1]), list[i + 1]);
+            }
+            select_neighbors(pruned, max_m);
+            list[0] = static_cast<location_t>(pruned.size());
+            for (std::size_t i = 0; i < pruned.size(); ++i) {
+                list[i + 1] = pruned[i].second;
+            }
+        }
+        return candidates.front().second;
+    }
+
+    turbo::ResultStatus<location_t> HnswIndex::add_vector(label_type label, turbo::Span<float> vector) {
+        TLOG_CHECK(_is_available, "should init be using");
+        if (vector.size() != _option.dimension) {
+            return turbo::invalid_argument_error("vector dimension {} not match the index {}", vector.size(),
+                                                 _option.dimension);
+        }
+        auto r = _store.add_vector(label, turbo::Span<uint8_t>(reinterpret_cast<uint8_t *>(vector.data()),
+                                                               vector.size() * sizeof(float)));
+        if (!r.ok()) {
+            return r.status();
+        }
+        const location_t loc = r.value();
+        const int level = random_level();
+        if (level > 0) {
+            const std::size_t bytes = level * _link_stride * sizeof(location_t);
+            _upper_links[loc] = reinterpret_cast<location_t *>(Allocator::get_instance().allocate(bytes));
+            std::memset(_upper_links[loc], 0, bytes);
+        }
+        _levels[loc] = level;
+
+        std::unique_lock<std::mutex> level_guard(_level_lock, std::defer_lock);
+        location_t ep;
+        int max_level;
+        {
+            std::shared_lock<std::shared_mutex> lock(_entry_lock);
+            ep = _entry_point;
+            max_level = _max_level;
+        }
+        if (level > max_level) {
+            level_guard.lock();
+            std::shared_lock<std::shared_mutex> lock(_entry_lock);
+            ep = _entry_point;
+            max_level = _max_level;
+        }
+        if (ep == constants::kUnknownLocation) {
+            std::unique_lock<std::shared_mutex> lock(_entry_lock);
+            _entry_point = loc;
+            _max_level = level;
+            return loc;
+        }
+
+        const float *query = vector_data(loc);
+        const float norm = query_norm(loc);
+        if (level < max_level) {
+            ep = greedy_search(ep, query, norm, max_level, level + 1);
+        }
+        for (int l = std::min(level, max_level); l >= 0; --l) {
+            auto candidates = search_layer(ep, query, norm, _hnsw.ef_construction, l, false);
+            ep = connect(loc, candidates, l);
+        }
+        if (level > max_level) {
+            std::unique_lock<std::shared_mutex> lock(_entry_lock);
+            _entry_point = loc;
+            _max_level = level;
+        }
+        return loc;
+    }
+
+    turbo::Status HnswIndex::remove_vector(label_type label) {
+        TLOG_CHECK(_is_available, "should init be using");
+        auto r = _store.remove_vector(label);
+        if (!r.ok()) {
+            return r.status();
+        }
+        return turbo::ok_status();
+    }
+
+    turbo::Status
+    HnswIndex::search(turbo::Span<float> query, const SearchOption &option, std::vector<QueryResult> &result) const {
+        TLOG_CHECK(_is_available, "should init be using");
+        if (query.size() != _option.dimension) {
+            return turbo::invalid_argument_error("query dimension {} not match the index {}", query.size(),
+                                                 _option.dimension);
+        }
+        result.clear();
+        location_t ep;
+        int max_level;
+        {
+            std::shared_lock<std::shared_mutex> lock(_entry_lock);
+            ep = _entry_point;
+            max_level = _max_level;
+        }
+        if (ep == constants::kUnknownLocation || option.k == 0) {
+            return turbo::ok_status();
+        }
+        const std::size_t ef = std::max(option.ef == 0 ? std::size_t(_hnsw.ef) : option.ef, option.k);
+        SearchRecorder recorder(search_metrics(), option.stats);
+        if (option.filter != nullptr) {
+            // few members, scoring them directly is cheaper than a traversal
+            // that mostly visits rejected nodes.
+            auto limit = std::max(static_cast<std::size_t>(option.brute_force_ratio * _store.size()), ef);
+            std::vector<label_type> members;
+            if (option.filter->collect_members(limit, members)) {
+                brute_force_search(_store, _distance, query.data(), members, option.k, result, &recorder.stats);
+                return turbo::ok_status();
+            }
+        }
+        const float norm = query_norm(query.data());
+        if (max_level > 0) {
+            ep = greedy_search(ep, query.data(), norm, max_level, 1, &recorder.stats);
+        }
+        auto top = search_layer(ep, query.data(), norm, ef, 0, true, option.filter, &recorder.stats);
+        const std::size_t k = std::min(option.k, top.size());
+        result.reserve(k);
+        for (std::size_t i = 0; i < k; ++i) {
+            result.push_back({_store.get_label(top[i].second).value(), top[i].first});
+        }
+        return turbo::ok_status();
+    }
+
+    turbo::Status HnswIndex::search_batch(turbo::Span<float> queries, std::size_t nq, const SearchOption &option,
+                                          std::vector<std::vector<QueryResult>> &results) const {
+        TLOG_CHECK(_is_available, "should init be using");
+        if (queries.size() != nq * _option.dimension) {
+            return turbo::invalid_argument_error("queries size {} not match {} queries of dimension {}",
+                                                 queries.size(), nq, _option.dimension);
+        }
+        results.clear();
+        results.resize(nq);
+        location_t ep;
+        int max_level;
+        {
+            std::shared_lock<std::shared_mutex> lock(_entry_lock);
+            ep = _entry_point;
+            max_level = _max_level;
+        }
+        if (ep == constants::kUnknownLocation || option.k == 0 || nq == 0) {
+            return turbo::ok_status();
+        }
+        const std::size_t ef = std::max(option.ef == 0 ? std::size_t(_hnsw.ef) : option.ef, option.k);
+        const float *data = queries.data();
+        const std::size_t dim = _option.dimension;
+        if (option.filter != nullptr) {
+            // the members are the same for every query
+            auto limit = std::max(static_cast<std::size_t>(option.brute_force_ratio * _store.size()), ef);
+            std::vector<label_type> members;
+            if (option.filter->collect_members(limit, members)) {
+                for (std::size_t q = 0; q < nq; ++q) {
+                    SearchRecorder recorder(search_metrics(), option.stats);
+                    brute_force_search(_store, _distance, data + q * dim, members, option.k, results[q],
+                                       &recorder.stats);
+                }
+                return turbo::ok_status();
+            }
+        }
+        std::vector<std::unique_ptr<SearchRecorder>> recorders(kBatchWidth);
+        std::vector<std::unique_ptr<LayerSearch>> searches(kBatchWidth);
+        std::vector<std::size_t> active;
+        for (std::size_t first = 0; first < nq; first += kBatchWidth) {
+            const std::size_t width = std::min(kBatchWidth, nq - first);
+            active.clear();
+            // the upper levels touch a few nodes per query, only level 0 is interleaved
+            for (std::size_t i = 0; i < width; ++i) {
+                const float *query = data + (first + i) * dim;
+                recorders[i] = std::make_unique<SearchRecorder>(search_metrics(), option.stats);
+                const float norm = query_norm(query);
+                auto start = ep;
+                if (max_level > 0) {
+                    start = greedy_search(ep, query, norm, max_level, 1, &recorders[i]->stats);
+                }
+                searches[i] = std::make_unique<LayerSearch>(*this, query, norm, ef, 0, true, option.filter);
+                searches[i]->start(start);
+                active.push_back(i);
+            }
+            auto finish = [&](std::size_t i) {
+                searches[i]->add_stats(recorders[i]->stats);
+                auto top = searches[i]->finish();
+                auto &result = results[first + i];
+                const std::size_t k = std::min(option.k, top.size());
+                result.reserve(k);
+                for (std::size_t j = 0; j < k; ++j) {
+                    result.push_back({_store.get_label(top[j].second).value(), top[j].first});
+                }
+                searches[i].reset();
+                recorders[i].reset();
+            };
+            // a query runs one step per round, expand (prefetch the neighbors) or
+            // score (then prefetch the next neighbor list), so every memory access
+            // is issued one round, the steps of the other queries, before its use.
+            std::vector<bool> expanded(width, false);
+            while (!active.empty()) {
+                std::size_t kept = 0;
+                for (auto i : active) {
+                    if (expanded[i]) {
+                        searches[i]->score();
+                        searches[i]->prefetch_next();
+                        expanded[i] = false;
+                        active[kept++] = i;
+                    } else if (searches[i]->expand()) {
+                        expanded[i] = true;
+                        active[kept++] = i;
+                    } else {
+                        finish(i);
+                    }
+                }
+                active.resize(kept);
+            }
+        }
+        return turbo::ok_status();
+    }
+
+}  // namespace zircon
@@ -0,0 +1,187 @@
+// Copyright 2023 The Elastic-AI Authors.
+// part of Elastic AI Search
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#ifndef ZIRCON_INDEX_HNSW_INDEX_H_
+#define ZIRCON_INDEX_HNSW_INDEX_H_
+
+#include <mutex>
+#include <random>
+#include <shared_mutex>
+#include <utility>
+#include <vector>
+#include "turbo/concurrent/hash_lock.h"
+#include "zircon/core/index.h"
+#include "zircon/index/visited_list.h"
+#include "zircon/store/mem_vector_store.h"
+#include "zircon/utility/metric_distance.h"
+
+namespace zircon {
+
+    /**
+     * @brief hierarchical navigable small world graph index.
+     *        the vectors live in a MemVectorStore and the store location is the
+     *        node id. the neighbor lists are flat arrays of location_t, a count
+     *        followed by the neighbors, every list padded to a cache line. level 0
+     *        lists of all nodes are one array, the upper level lists of a node
+     *        are one array per node.
+     *        a neighbor list is guarded by a hashed per node shared lock, a thread
+     *        never hold two of them, so inserts and searches run on many threads.
+     *        removed vectors stay in the graph as route nodes and are never
+     *        returned, so the store do not reuse vacant locations.
+     *        a search filter is checked while traversing, a filter selective
+     *        enough is searched by brute force over its members instead.
+     *        the norms of METRIC_COSINE are kept by the store, the vectors of
+     *        METRIC_NORMALIZED_COSINE are normalized when added.
+     */
+    class HnswIndex : public Index {
+    public:
+        HnswIndex() = default;
+
+        ~HnswIndex() override;
+
+        turbo::Status initialize(const IndexOption &option, const HnswOption &hnsw = HnswOption());
+
+        turbo::ResultStatus<location_t> add_vector(label_type label, turbo::Span<float> vector) override;
+
+        turbo::Status remove_vector(label_type label) override;
+
+        turbo::Status
+        search(turbo::Span<float> query, const SearchOption &option, std::vector<QueryResult> &result) const override;
+
+        /**
+         * @brief up to kBatchWidth queries are traversed at once, every round
+         *        score the neighbors of the node a query expanded in the previous
+         *        round, then expands its next node and prefetch the neighbors, so
+         *        the cache misses of one query overlap the distances of the others.
+         *        the results are the ones of search.
+         */
+        turbo::Status search_batch(turbo::Span<float> queries, std::size_t nq, const SearchOption &option,
+                                   std::vector<std::vector<QueryResult>> &results) const override;
+
+        // queries of a batch traversed at the same time
+        static constexpr std::size_t kBatchWidth = 16;
+
+        [[nodiscard]] std::size_t size() const override {
+            return _store.size();
+        }
+
+        [[nodiscard]] const MemVectorStore &store() const {
+            return _store;
+        }
+
+        [[nodiscard]] const HnswOption &hnsw_option() const {
+            return _hnsw;
+        }
+
+        [[nodiscard]] int max_level() const;
+
+        [[nodiscard]] location_t entry_point() const;
+
+        // copy of the neighbors of a node at a level, mainly for testing.
+        [[nodiscard]] std::vector<location_t> neighbors(location_t loc, int level) const;
+
+    private:
+        using Candidate = std::pair<float, location_t>;
+
+        [[nodiscard]] const float *vector_data(location_t loc) const {
+            return reinterpret_cast<const float *>(_store.get_vector(loc).data());
+        }
+
+        // l2 norm of a query for distance_to, -1 if the distances use no norms
+        [[nodiscard]] float query_norm(const float *query) const {
+            return _use_norms ? _distance.norm(query) : -1.0f;
+        }
+
+        // the norm of the node loc taken as a query
+        [[nodiscard]] float query_norm(location_t loc) const {
+            return _use_norms ? _store.get_norm(loc) : -1.0f;
+        }
+
+        // distance of query to the node loc, a single inner product for METRIC_COSINE
+        [[nodiscard]] float distance_to(const float *query, float query_norm, location_t loc) const {
+            if (query_norm < 0.0f) {
+                return _distance(query, vector_data(loc));
+            }
+            return _distance(query, query_norm, vector_data(loc), _store.get_norm(loc));
+        }
+
+        // [count, neighbors...] of a node at a level
+        [[nodiscard]] location_t *link_list(location_t loc, int level) const;
+
+        [[nodiscard]] std::size_t copy_links(location_t loc, int level, location_t *out) const;
+
+        int random_level();
+
+        // stats, if not null, get the counts of the traversal
+        [[nodiscard]] location_t greedy_search(location_t ep, const float *query, float query_norm, int from_level,
+                                               int to_level, QueryStats *stats = nullptr) const;
+
+        // the state of one search_layer, advanced a node at a time, see search_batch
+        class LayerSearch;
+
+        // up to ef nearest nodes of the level, nearest first. with skip_deleted the
+        // deleted nodes and the labels out of the filter are traversed but not returned.
+        [[nodiscard]] std::vector<Candidate>
+        search_layer(location_t ep, const float *query, float query_norm, std::size_t ef, int level,
+                     bool skip_deleted, const IdFilter *filter = nullptr, QueryStats *stats = nullptr) const;
+
+        [[nodiscard]] bool accept(location_t loc, const IdFilter *filter) const;
+
+        // bit i of mask set if locs[i] is alive and in the filter
+        void accept_block(const location_t *locs, std::size_t n, const IdFilter *filter, label_type *labels,
+                          uint64_t *mask) const;
+
+        // keep at most m candidates that are not closer to a kept one than to the base
+        void select_neighbors(std::vector<Candidate> &candidates, std::size_t m) const;
+
+        location_t connect(location_t loc, std::vector<Candidate> &candidates, int level);
+
+    private:
+        bool _is_available{false};
+        IndexOption _option;
+        HnswOption _hnsw;
+        MemVectorStore _store;
+        MetricDistance _distance;
+        // METRIC_COSINE, the store keep the norms of the vectors
+        bool _use_norms{false};
+
+        std::size_t _max_m{0};
+        std::size_t _max_m0{0};
+        // in location_t, padded to cache lines
+        std::size_t _link_stride{0};
+        std::size_t _link0_stride{0};
+        double _level_mult{0.0};
+
+        location_t *_level0_links{nullptr};
+        std::vector<location_t *> _upper_links;
+        std::vector<int> _levels;
+
+        mutable turbo::HashLock<location_t> _node_lock;
+        // guard the entry point and the max level
+        mutable std::shared_mutex _entry_lock;
+        location_t _entry_point{constants::kUnknownLocation};
+        int _max_level{-1};
+        // taken by the insert that may raise the max level
+        std::mutex _level_lock;
+
+        std::mutex _rng_lock;
+        std::mt19937_64 _rng;
+
+        mutable VisitedListPool _visited_pool;
+    };
+
+}  // namespace zircon
+
+#endif  // ZIRCON_INDEX_HNSW_INDEX_H_
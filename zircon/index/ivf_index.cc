@@ -0,0 +1,450 @@
+// Copyright 2023 The Elastic-AI Authors.
+// part of Elastic AI Search
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#include "zircon/index/ivf_index.h"
+#include "zircon/quantizer/kmeans.h"
+#include "zircon/utility/id_filter.h"
+#include "zircon/utility/metrics.h"
+#include "turbo/log/logging.h"
+#include <algorithm>
+#include <cstring>
+#include <mutex>
+#include <numeric>
+#include <queue>
+#include <utility>
+
+namespace zircon {
+
+    namespace {
+
+        using Entry = std::pair<float, label_type>;
+
+        SearchMetrics &search_metrics() {
+            static SearchMetrics metrics("ivf");
+            return metrics;
+        }
+
+        uint64_t make_slot(uint32_t list, std::size_t offset) {
+            return (static_cast<uint64_t>(list) << 32) | static_cast<uint64_t>(offset);
+        }
+
+        void finish(std::priority_queue<Entry> &heap, std::vector<QueryResult> &result) {
+            result.resize(heap.size());
+            for (auto i = result.size(); i > 0; --i) {
+                result[i - 1] = {heap.top().second, heap.top().first};
+                heap.pop();
+            }
+        }
+
+        void push(std::priority_queue<Entry> &heap, std::size_t k, float d, label_type label) {
+            if (heap.size() < k) {
+                heap.emplace(d, label);
+            } else if (d < heap.top().first) {
+                heap.pop();
+                heap.emplace(d, label);
+            }
+        }
+    }  // namespace
+
+    turbo::Status IvfIndex::initialize(const IndexOption &option, const IvfOption &ivf) {
+        if (_is_available) {
+            return turbo::failed_precondition_error("index already initialized");
+        }
+        if (ivf.nlist == 0 || ivf.list_block == 0) {
+            return turbo::invalid_argument_error("nlist and list_block must be positive");
+        }
+        auto rs = _distance.initialize(option.metric, option.dimension);
+        if (!rs.ok()) {
+            return rs;
+        }
+        if (option.store_option.encoding != EncodingType::ENCODING_NONE) {
+            return turbo::invalid_argument_error("the ivf index encode the posting lists, not the store");
+        }
+        const bool quantized = ivf.code != IvfCode::IVF_FLAT;
+        if (quantized && option.metric != MetricType::METRIC_L2 && option.metric != MetricType::METRIC_IP &&
+            option.metric != MetricType::METRIC_NORMALIZED_COSINE) {
+            return turbo::invalid_argument_error("metric not support by quantized ivf codes");
+        }
+        switch (ivf.code) {
+            case IvfCode::IVF_FLAT:
+                _code_size = option.dimension * sizeof(float);
+                break;
+            case IvfCode::IVF_SQ8:
+            case IvfCode::IVF_FP16:
+                rs = _sq.initialize(ivf.code == IvfCode::IVF_SQ8 ? EncodingType::ENCODING_SQ8
+                                                                 : EncodingType::ENCODING_FP16, option.dimension);
+                if (!rs.ok()) {
+                    return rs;
+                }
+                _code_size = _sq.code_size();
+                break;
+            case IvfCode::IVF_PQ:
+                rs = _pq.initialize(option.dimension, ivf.pq_m, ivf.pq_nbits);
+                if (!rs.ok()) {
+                    return rs;
+                }
+                _code_size = _pq.code_size();
+                break;
+        }
+        _option = option;
+        _ivf = ivf;
+        auto &store_option = _option.store_option;
+        store_option.vector_byte_size = sizeof(uint64_t);
+        rs = _store.initialize(store_option);
+        if (!rs.ok()) {
+            return rs;
+        }
+        _lists = std::make_unique<PostingList[]>(_ivf.nlist);
+        if (_ivf.nthreads > 1) {
+            _pool = std::make_unique<ThreadPool>(_ivf.nthreads);
+        }
+        _is_available = true;
+        return turbo::ok_status();
+    }
+
+    ThreadPool *IvfIndex::pool() const {
+        if (_ivf.nthreads == 1) {
+            return nullptr;
+        }
+        return _pool != nullptr ? _pool.get() : &ThreadPool::default_pool();
+    }
+
+    turbo::Status IvfIndex::train(turbo::Span<float> samples) {
+        TLOG_CHECK(_is_available, "should init be using");
+        if (_is_trained) {
+            return turbo::failed_precondition_error("index already trained");
+        }
+        const std::size_t dim = _option.dimension;
+        if (samples.empty() || samples.size() % dim != 0) {
+            return turbo::invalid_argument_error("samples size {} is not n * dimension {}", samples.size(), dim);
+        }
+        const std::size_t n = samples.size() / dim;
+        MiniBatchKMeansOption kmeans;
+        kmeans.niter = _ivf.kmeans_iter;
+        kmeans.batch_size = _ivf.kmeans_batch;
+        kmeans.seed = _ivf.seed;
+        std::vector<float> centroids(_ivf.nlist * dim);
+        auto rs = minibatch_kmeans_train(samples.data(), n, dim, _ivf.nlist, kmeans, centroids.data(), pool());
+        if (!rs.ok()) {
+            return rs;
+        }
+        if (_ivf.code == IvfCode::IVF_SQ8 || _ivf.code == IvfCode::IVF_FP16) {
+            rs = _sq.train(samples);
+        } else if (_ivf.code == IvfCode::IVF_PQ) {
+            // the codebooks are shared by the lists, trained on the residuals
+            std::vector<uint32_t> assigned(n);
+            if (auto *p = pool(); p != nullptr) {
+                parallel_kmeans_assign(*p, samples.data(), n, dim, centroids.data(), _ivf.nlist, assigned.data());
+            } else {
+                kmeans_assign(samples.data(), n, dim, centroids.data(), _ivf.nlist, assigned.data());
+            }
+            std::vector<float> residuals(samples.size());
+            for (std::size_t i = 0; i < n; ++i) {
+                const float *c = centroids.data() + assigned[i] * dim;
+                for (std::size_t d = 0; d < dim; ++d) {
+                    residuals[i * dim + d] = samples[i * dim + d] - c[d];
+                }
+            }
+            KMeansOption pq_kmeans;
+            pq_kmeans.seed = _ivf.seed;
+            rs = _pq.train(turbo::Span<float>(residuals.data(), residuals.size()), pq_kmeans);
+        }
+        if (!rs.ok()) {
+            return rs;
+        }
+        _centroids = std::move(centroids);
+        _is_trained = true;
+        return turbo::ok_status();
+    }
+
+    uint32_t IvfIndex::assign(const float *vector) const {
+        std::vector<float> dis(_ivf.nlist);
+        _distance.batch(vector, _centroids.data(), _ivf.nlist, dis.data());
+        return static_cast<uint32_t>(std::min_element(dis.begin(), dis.end()) - dis.begin());
+    }
+
+    void IvfIndex::encode(const float *vector, uint32_t list, uint8_t *code) const {
+        switch (_ivf.code) {
+            case IvfCode::IVF_FLAT:
+                std::memcpy(code, vector, _code_size);
+                break;
+            case IvfCode::IVF_SQ8:
+            case IvfCode::IVF_FP16:
+                _sq.encode(vector, code);
+                break;
+            case IvfCode::IVF_PQ: {
+                const std::size_t dim = _option.dimension;
+                const float *c = _centroids.data() + list * dim;
+                std::vector<float> residual(dim);
+                for (std::size_t d = 0; d < dim; ++d) {
+                    residual[d] = vector[d] - c[d];
+                }
+                _pq.encode(residual.data(), code);
+                break;
+            }
+        }
+    }
+
+    const uint8_t *IvfIndex::code_at(const PostingList &list, std::size_t offset) const {
+        return list.blocks[offset / _ivf.list_block].data() + (offset % _ivf.list_block) * _code_size;
+    }
+
+    turbo::ResultStatus<location_t> IvfIndex::add_vector(label_type label, turbo::Span<float> vector) {
+        TLOG_CHECK(_is_available, "should init be using");
+        if (!_is_trained) {
+            return turbo::failed_precondition_error("index should be trained before adding vectors");
+        }
+        if (vector.size() != _option.dimension) {
+            return turbo::invalid_argument_error("vector dimension {} not match the index {}", vector.size(),
+                                                 _option.dimension);
+        }
+        const uint32_t li = assign(vector.data());
+        std::vector<uint8_t> code(_code_size);
+        encode(vector.data(), li, code.data());
+
+        LabelLockGuard label_guard(&_store, label);
+        auto &list = _lists[li];
+        std::unique_lock<std::shared_mutex> lock(list.mutex);
+        const std::size_t offset = list.ids.size();
+        if (list.blocks.size() * _ivf.list_block == offset) {
+            VectorBatch block;
+            auto rs = block.init(_code_size, _ivf.list_block);
+            if (!rs.ok()) {
+                return rs;
+            }
+            list.blocks.push_back(std::move(block));
+        }
+        uint64_t slot = make_slot(li, offset);
+        auto r = _store.add_vector(label, turbo::Span<uint8_t>(reinterpret_cast<uint8_t *>(&slot), sizeof(slot)));
+        if (!r.ok()) {
+            return r.status();
+        }
+        list.blocks.back().add_vector(code.data(), 1);
+        // visible to the scans once the code is written
+        list.ids.push_back(r.value());
+        return r.value();
+    }
+
+    turbo::Status IvfIndex::remove_vector(label_type label) {
+        TLOG_CHECK(_is_available, "should init be using");
+        LabelLockGuard label_guard(&_store, label);
+        auto loc = _store.get_location(label);
+        if (!loc.ok()) {
+            return loc.status();
+        }
+        uint64_t slot;
+        std::memcpy(&slot, _store.get_vector(loc.value()).data(), sizeof(slot));
+        {
+            // out of the list before the location can be reused by another label
+            auto &list = _lists[slot >> 32];
+            std::unique_lock<std::shared_mutex> lock(list.mutex);
+            list.ids[slot & 0xffffffffu] = constants::kUnknownLocation;
+        }
+        auto r = _store.remove_vector(label);
+        if (!r.ok()) {
+            return r.status();
+        }
+        return turbo::ok_status();
+    }
+
+    std::size_t IvfIndex::list_size(std::size_t i) const {
+        TLOG_CHECK(i < _ivf.nlist);
+        std::shared_lock<std::shared_mutex> lock(_lists[i].mutex);
+        return _lists[i].ids.size();
+    }
+
+    void IvfIndex::prepare_list(const float *query, uint32_t list, float coarse, float *lut, float &bias) const {
+        bias = 0.0f;
+        if (_ivf.code != IvfCode::IVF_PQ) {
+            return;
+        }
+        if (_option.metric == MetricType::METRIC_L2) {
+            // |q - (c + r)|^2 = |(q - c) - r|^2, the table of the query residual
+            const std::size_t dim = _option.dimension;
+            const float *c = _centroids.data() + list * dim;
+            std::vector<float> residual(dim);
+            for (std::size_t d = 0; d < dim; ++d) {
+                residual[d] = query[d] - c[d];
+            }
+            (void) _pq.compute_lut(MetricType::METRIC_L2, residual.data(), lut);
+            return;
+        }
+        // -ip(q, c + r) = -ip(q, c) - ip(q, r), with the 1 of the cosine in the coarse distance
+        (void) _pq.compute_lut(MetricType::METRIC_IP, query, lut);
+        bias = coarse;
+    }
+
+    float IvfIndex::score(const float *query, const float *lut, float bias, const uint8_t *code) const {
+        switch (_ivf.code) {
+            case IvfCode::IVF_FLAT:
+                return _distance(query, reinterpret_cast<const float *>(code));
+            case IvfCode::IVF_SQ8:
+            case IvfCode::IVF_FP16:
+                return _sq.distance(_option.metric, query, code);
+            case IvfCode::IVF_PQ:
+                return bias + _pq.adc_distance(lut, code);
+        }
+        return 0.0f;
+    }
+
+    turbo::Status
+    IvfIndex::search(turbo::Span<float> query, const SearchOption &option, std::vector<QueryResult> &result) const {
+        TLOG_CHECK(_is_available, "should init be using");
+        if (query.size() != _option.dimension) {
+            return turbo::invalid_argument_error("query dimension {} not match the index {}", query.size(),
+                                                 _option.dimension);
+        }
+        result.clear();
+        if (option.k == 0 || !_is_trained) {
+            return turbo::ok_status();
+        }
+        SearchRecorder recorder(search_metrics(), option.stats);
+        auto &stats = recorder.stats;
+        std::vector<float> coarse(_ivf.nlist);
+        _distance.batch(query.data(), _centroids.data(), _ivf.nlist, coarse.data());
+        stats.distance_computations += _ivf.nlist;
+        if (option.filter != nullptr) {
+            // few members, scoring them where they are is cheaper than the probes
+            auto limit = std::max(static_cast<std::size_t>(option.brute_force_ratio * _store.size()), option.k);
+            std::vector<label_type> members;
+            if (option.filter->collect_members(limit, members)) {
+                search_members(query.data(), coarse, members, option.k, result, stats);
+                return turbo::ok_status();
+            }
+        }
+        const std::size_t nprobe = std::min<std::size_t>(option.nprobe != 0 ? option.nprobe : _ivf.nprobe,
+                                                         _ivf.nlist);
+        std::vector<uint32_t> probes(_ivf.nlist);
+        std::iota(probes.begin(), probes.end(), 0);
+        std::partial_sort(probes.begin(), probes.begin() + nprobe, probes.end(),
+                          [&coarse](uint32_t a, uint32_t b) { return coarse[a] < coarse[b]; });
+
+        const std::size_t block = _ivf.list_block;
+        std::vector<float> lut(_ivf.code == IvfCode::IVF_PQ ? _pq.m() * _pq.ksub() : 0);
+        std::vector<float> dis(block);
+        std::vector<label_type> labels(block);
+        std::vector<uint64_t> mask((block + 63) / 64);
+        std::priority_queue<Entry> heap;
+        const bool batched = _ivf.code == IvfCode::IVF_FLAT;
+        stats.lists_probed += nprobe;
+        for (std::size_t p = 0; p < nprobe; ++p) {
+            const uint32_t li = probes[p];
+            float bias;
+            prepare_list(query.data(), li, coarse[li], lut.data(), bias);
+            auto &list = _lists[li];
+            std::shared_lock<std::shared_mutex> lock(list.mutex);
+            const std::size_t n = list.ids.size();
+            for (std::size_t first = 0; first < n; first += block) {
+                const std::size_t count = std::min(block, n - first);
+                const uint8_t *codes = list.blocks[first / block].data();
+                for (std::size_t i = 0; i < count; ++i) {
+                    const location_t id = list.ids[first + i];
+                    labels[i] = id == constants::kUnknownLocation ? constants::kUnknownLabel
+                                                                  : _store.get_label(id).value();
+                }
+                if (option.filter == nullptr) {
+                    stats.distance_computations += count;
+                    if (batched) {
+                        _distance.batch(query.data(), reinterpret_cast<const float *>(codes), count, dis.data());
+                    } else {
+                        for (std::size_t i = 0; i < count; ++i) {
+                            dis[i] = score(query.data(), lut.data(), bias, codes + i * _code_size);
+                        }
+                    }
+                    for (std::size_t i = 0; i < count; ++i) {
+                        if (labels[i] != constants::kUnknownLabel) {
+                            push(heap, option.k, dis[i], labels[i]);
+                        }
+                    }
+                    continue;
+                }
+                option.filter->filter_block(labels.data(), count, mask.data());
+                std::size_t scored = 0;
+                for (std::size_t w = 0; w * 64 < count; ++w) {
+                    for (uint64_t bits = mask[w]; bits != 0; bits &= bits - 1) {
+                        const std::size_t i = w * 64 + __builtin_ctzll(bits);
+                        if (labels[i] != constants::kUnknownLabel) {
+                            push(heap, option.k, score(query.data(), lut.data(), bias, codes + i * _code_size),
+                                 labels[i]);
+                            ++scored;
+                        }
+                    }
+                }
+                stats.distance_computations += scored;
+                stats.filter_rejected += count - scored;
+            }
+        }
+        finish(heap, result);
+        return turbo::ok_status();
+    }
+
+    void IvfIndex::search_members(const float *query, const std::vector<float> &coarse,
+                                  const std::vector<label_type> &members, std::size_t k,
+                                  std::vector<QueryResult> &result, QueryStats &stats) const {
+        std::vector<location_t> locations(members.size());
+        _store.get_locations(turbo::Span<const label_type>(members.data(), members.size()),
+                             turbo::Span<location_t>(locations.data(), locations.size()));
+        struct Member {
+            uint64_t slot;
+            location_t location;
+            label_type label;
+
+            bool operator<(const Member &rhs) const {
+                return slot < rhs.slot;
+            }
+        };
+        // by list, so the pq table of a list is built once
+        std::vector<Member> slots;
+        slots.reserve(members.size());
+        for (std::size_t i = 0; i < members.size(); ++i) {
+            if (locations[i] == constants::kUnknownLocation) {
+                continue;
+            }
+            uint64_t slot;
+            std::memcpy(&slot, _store.get_vector(locations[i]).data(), sizeof(slot));
+            slots.push_back({slot, locations[i], members[i]});
+        }
+        std::sort(slots.begin(), slots.end());
+        std::vector<float> lut(_ivf.code == IvfCode::IVF_PQ ? _pq.m() * _pq.ksub() : 0);
+        std::priority_queue<Entry> heap;
+        std::size_t scored = 0;
+        for (std::size_t i = 0; i < slots.size();) {
+            const auto li = static_cast<uint32_t>(slots[i].slot >> 32);
+            if (li >= _ivf.nlist) {
+                // the slot of a vector being added, not yet in its list
+                ++i;
+                continue;
+            }
+            float bias;
+            prepare_list(query, li, coarse[li], lut.data(), bias);
+            auto &list = _lists[li];
+            std::shared_lock<std::shared_mutex> lock(list.mutex);
+            ++stats.lists_probed;
+            for (; i < slots.size() && (slots[i].slot >> 32) == li; ++i) {
+                const std::size_t offset = slots[i].slot & 0xffffffffu;
+                // removed since the lookup, or still being added
+                if (offset >= list.ids.size() || list.ids[offset] != slots[i].location) {
+                    continue;
+                }
+                push(heap, k, score(query, lut.data(), bias, code_at(list, offset)), slots[i].label);
+                ++scored;
+            }
+        }
+        stats.distance_computations += scored;
+        stats.filter_rejected += members.size() - scored;
+        finish(heap, result);
+    }
+
+}  // namespace zircon
@@ -0,0 +1,139 @@
+// Copyright 2023 The Elastic-AI Authors.
+// part of Elastic AI Search
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#ifndef ZIRCON_INDEX_IVF_INDEX_H_
+#define ZIRCON_INDEX_IVF_INDEX_H_
+
+#include <memory>
+#include <shared_mutex>
+#include <vector>
+#include "zircon/core/index.h"
+#include "zircon/quantizer/product_quantizer.h"
+#include "zircon/quantizer/scalar_quantizer.h"
+#include "zircon/store/mem_vector_store.h"
+#include "zircon/store/vector_batch.h"
+#include "zircon/utility/metric_distance.h"
+#include "zircon/utility/thread_pool.h"
+
+namespace zircon {
+
+    /**
+     * @brief inverted file index. the vectors are partitioned by the nearest
+     *        of nlist coarse centroids trained with mini batch k-means, every
+     *        posting list keeps the codes of its vectors in blocks of
+     *        list_block codes one after another, and a search scores the
+     *        nprobe lists of the centroids nearest to the query only.
+     *        the store holds the label and the (list, offset) of every vector,
+     *        8 bytes per vector, the codes are the float vectors, scalar
+     *        quantized or product quantized residuals. a removed vector leave
+     *        a hole in its list, skipped by the scans.
+     *        METRIC_L2, METRIC_IP and METRIC_NORMALIZED_COSINE, IVF_FLAT also
+     *        METRIC_L1 and METRIC_COSINE.
+     */
+    class IvfIndex : public Index {
+    public:
+        IvfIndex() = default;
+
+        ~IvfIndex() override = default;
+
+        turbo::Status initialize(const IndexOption &option, const IvfOption &ivf = IvfOption());
+
+        /**
+         * @brief train the coarse centroids and the quantizer of the codes, the
+         *        samples are n float vectors of the dimension, n >= nlist. the
+         *        pq codebooks are trained on the residuals of the samples.
+         *        must be done once, before adding vectors.
+         */
+        turbo::Status train(turbo::Span<float> samples);
+
+        [[nodiscard]] bool is_trained() const {
+            return _is_trained;
+        }
+
+        // failed precondition if the index is not trained
+        turbo::ResultStatus<location_t> add_vector(label_type label, turbo::Span<float> vector) override;
+
+        turbo::Status remove_vector(label_type label) override;
+
+        turbo::Status
+        search(turbo::Span<float> query, const SearchOption &option, std::vector<QueryResult> &result) const override;
+
+        [[nodiscard]] std::size_t size() const override {
+            return _store.size();
+        }
+
+        [[nodiscard]] std::size_t nlist() const {
+            return _ivf.nlist;
+        }
+
+        // codes in list i, holes of removed vectors included
+        [[nodiscard]] std::size_t list_size(std::size_t i) const;
+
+        // nlist * dimension floats
+        [[nodiscard]] const std::vector<float> &centroids() const {
+            return _centroids;
+        }
+
+        [[nodiscard]] const IvfOption &ivf_option() const {
+            return _ivf;
+        }
+
+    private:
+        struct PostingList {
+            mutable std::shared_mutex mutex;
+            // store location of every code, kUnknownLocation for a removed one
+            std::vector<location_t> ids;
+            std::vector<VectorBatch> blocks;
+        };
+
+        [[nodiscard]] ThreadPool *pool() const;
+
+        // the nearest centroid of vector
+        [[nodiscard]] uint32_t assign(const float *vector) const;
+
+        void encode(const float *vector, uint32_t list, uint8_t *code) const;
+
+        // code of the offset-th vector of list
+        [[nodiscard]] const uint8_t *code_at(const PostingList &list, std::size_t offset) const;
+
+        // the pq bias and table of a probed list, see search
+        void prepare_list(const float *query, uint32_t list, float coarse, float *lut, float &bias) const;
+
+        [[nodiscard]] float score(const float *query, const float *lut, float bias, const uint8_t *code) const;
+
+        void search_members(const float *query, const std::vector<float> &coarse,
+                            const std::vector<label_type> &members, std::size_t k,
+                            std::vector<QueryResult> &result, QueryStats &stats) const;
+
+    private:
+        bool _is_available{false};
+        bool _is_trained{false};
+        IndexOption _option;
+        IvfOption _ivf;
+        // the scan of the codes, the float vectors for IVF_FLAT
+        MetricDistance _distance;
+        ScalarQuantizer _sq;
+        ProductQuantizer _pq;
+        std::size_t _code_size{0};
+        std::vector<float> _centroids;
+        // labels of the vectors, the slot of a location is (list << 32 | offset)
+        MemVectorStore _store;
+        std::unique_ptr<PostingList[]> _lists;
+        std::unique_ptr<ThreadPool> _pool;
+    };
+
+}  // namespace zircon
+
+#endif  // ZIRCON_INDEX_IVF_INDEX_H_
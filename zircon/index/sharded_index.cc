@@ -0,0 +1,255 @@
+// Copyright 2023 The Elastic-AI Authors.
+// part of Elastic AI Search
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#include "zircon/index/sharded_index.h"
+#include "zircon/utility/metrics.h"
+#include "turbo/log/logging.h"
+#include <algorithm>
+#include <queue>
+
+namespace zircon {
+
+    namespace {
+        SearchMetrics &search_metrics() {
+            static SearchMetrics metrics("sharded");
+            return metrics;
+        }
+
+        // splitmix64 finalizer, sequential labels spread evenly
+        inline uint64_t mix_label(uint64_t x) {
+            x ^= x >> 30;
+            x *= 0xbf58476d1ce4e5b9ULL;
+            x ^= x >> 27;
+            x *= 0x94d049bb133111ebULL;
+            x ^= x >> 31;
+            return x;
+        }
+
+        void add_stats(const QueryStats &from, QueryStats &to) {
+            to.distance_computations += from.distance_computations;
+            to.nodes_visited += from.nodes_visited;
+            to.lists_probed += from.lists_probed;
+            to.filter_rejected += from.filter_rejected;
+            to.io_reads += from.io_reads;
+        }
+
+        // head of the sorted result of one shard
+        struct MergeHead {
+            distance_type distance;
+            std::size_t list;
+            std::size_t pos;
+
+            bool operator>(const MergeHead &rhs) const {
+                return distance > rhs.distance;
+            }
+        };
+
+        // k-way merge of the nearest first lists, the k nearest of all of them
+        void merge_results(std::vector<std::vector<QueryResult>> &lists, std::size_t k,
+                           std::vector<QueryResult> &result) {
+            std::priority_queue<MergeHead, std::vector<MergeHead>, std::greater<>> heads;
+            for (std::size_t i = 0; i < lists.size(); ++i) {
+                if (!lists[i].empty()) {
+                    heads.push({lists[i][0].distance, i, 0});
+                }
+            }
+            result.clear();
+            while (!heads.empty() && result.size() < k) {
+                auto head = heads.top();
+                heads.pop();
+                result.push_back(lists[head.list][head.pos]);
+                if (++head.pos < lists[head.list].size()) {
+                    head.distance = lists[head.list][head.pos].distance;
+                    heads.push(head);
+                }
+            }
+        }
+    }  // namespace
+
+    turbo::Status ShardedIndex::prepare(const IndexOption &option, const ShardOption &shard) {
+        if (_is_available) {
+            return turbo::failed_precondition_error("index already initialized");
+        }
+        _shard = shard;
+        if (shard.policy == ShardPolicy::SHARD_RANGE) {
+            if (shard.ranges.empty()) {
+                return turbo::invalid_argument_error("range shards need ranges");
+            }
+            for (std::size_t i = 0; i < shard.ranges.size(); ++i) {
+                if (shard.ranges[i].min_id > shard.ranges[i].max_id) {
+                    return turbo::invalid_argument_error("shard range {} is empty", i);
+                }
+                if (i > 0 && shard.ranges[i].min_id <= shard.ranges[i - 1].max_id) {
+                    return turbo::invalid_argument_error("shard ranges must be ascending and disjoint");
+                }
+            }
+            _shard.nshards = static_cast<uint32_t>(shard.ranges.size());
+        } else if (shard.nshards == 0) {
+            return turbo::invalid_argument_error("nshards must be set");
+        }
+        _option = option;
+        if (_shard.nthreads > 1) {
+            _pool = std::make_unique<ThreadPool>(_shard.nthreads);
+        }
+        return turbo::ok_status();
+    }
+
+    turbo::Status ShardedIndex::initialize(const IndexOption &option, const ShardOption &shard, const FlatOption &flat) {
+        auto rs = prepare(option, shard);
+        if (!rs.ok()) {
+            return rs;
+        }
+        std::vector<std::unique_ptr<Index>> shards;
+        for (std::size_t i = 0; i < _shard.nshards; ++i) {
+            auto index = std::make_unique<FlatIndex>();
+            rs = index->initialize(option, flat);
+            if (!rs.ok()) {
+                return rs;
+            }
+            shards.push_back(std::move(index));
+        }
+        _shards = std::move(shards);
+        _is_available = true;
+        return turbo::ok_status();
+    }
+
+    turbo::Status ShardedIndex::initialize(const IndexOption &option, const ShardOption &shard, const HnswOption &hnsw) {
+        auto rs = prepare(option, shard);
+        if (!rs.ok()) {
+            return rs;
+        }
+        std::vector<std::unique_ptr<Index>> shards;
+        for (std::size_t i = 0; i < _shard.nshards; ++i) {
+            auto index = std::make_unique<HnswIndex>();
+            // the same seed would give every shard the same levels
+            auto seeded = hnsw;
+            seeded.random_seed = hnsw.random_seed + i;
+            rs = index->initialize(option, seeded);
+            if (!rs.ok()) {
+                return rs;
+            }
+            shards.push_back(std::move(index));
+        }
+        _shards = std::move(shards);
+        _is_available = true;
+        return turbo::ok_status();
+    }
+
+    ThreadPool *ShardedIndex::pool() const {
+        if (_shard.nthreads == 1) {
+            return nullptr;
+        }
+        return _pool != nullptr ? _pool.get() : &ThreadPool::default_pool();
+    }
+
+    std::size_t ShardedIndex::shard_of(label_type label) const {
+        if (_shard.policy == ShardPolicy::SHARD_HASH) {
+            return mix_label(label) % _shards.size();
+        }
+        auto &ranges = _shard.ranges;
+        // the last range starting at or below the label
+        auto it = std::upper_bound(ranges.begin(), ranges.end(), label,
+                                   [](label_type l, const IdFilterRange &r) { return l < r.min_id; });
+        if (it == ranges.begin() || !(it - 1)->is_member(label)) {
+            return _shards.size();
+        }
+        return static_cast<std::size_t>(it - 1 - ranges.begin());
+    }
+
+    turbo::ResultStatus<location_t> ShardedIndex::add_vector(label_type label, turbo::Span<float> vector) {
+        TLOG_CHECK(_is_available, "should init be using");
+        auto i = shard_of(label);
+        if (i == _shards.size()) {
+            return turbo::out_of_range_error("label {} out of every shard range", label);
+        }
+        return _shards[i]->add_vector(label, vector);
+    }
+
+    turbo::Status ShardedIndex::remove_vector(label_type label) {
+        TLOG_CHECK(_is_available, "should init be using");
+        auto i = shard_of(label);
+        if (i == _shards.size()) {
+            return turbo::not_found_error("delete label not found");
+        }
+        return _shards[i]->remove_vector(label);
+    }
+
+    std::size_t ShardedIndex::size() const {
+        std::size_t n = 0;
+        for (auto &s: _shards) {
+            n += s->size();
+        }
+        return n;
+    }
+
+    void ShardedIndex::target_shards(const IdFilter *filter, std::vector<std::size_t> &shards) const {
+        shards.clear();
+        label_type lo;
+        label_type hi;
+        if (_shard.policy != ShardPolicy::SHARD_RANGE || filter == nullptr || !filter->label_bounds(lo, hi)) {
+            for (std::size_t i = 0; i < _shards.size(); ++i) {
+                shards.push_back(i);
+            }
+            return;
+        }
+        for (std::size_t i = 0; i < _shards.size(); ++i) {
+            auto &r = _shard.ranges[i];
+            if (r.min_id <= hi && lo <= r.max_id) {
+                shards.push_back(i);
+            }
+        }
+    }
+
+    turbo::Status
+    ShardedIndex::search(turbo::Span<float> query, const SearchOption &option, std::vector<QueryResult> &result) const {
+        TLOG_CHECK(_is_available, "should init be using");
+        if (query.size() != _option.dimension) {
+            return turbo::invalid_argument_error("query dimension {} not match the index {}", query.size(),
+                                                 _option.dimension);
+        }
+        result.clear();
+        if (option.k == 0) {
+            return turbo::ok_status();
+        }
+        SearchRecorder recorder(search_metrics(), option.stats);
+        std::vector<std::size_t> targets;
+        target_shards(option.filter, targets);
+        std::vector<std::vector<QueryResult>> lists(targets.size());
+        std::vector<QueryStats> stats(targets.size());
+        std::vector<turbo::Status> status(targets.size());
+        auto run = [&](std::size_t t) {
+            auto shard_option = option;
+            shard_option.stats = &stats[t];
+            status[t] = _shards[targets[t]]->search(query, shard_option, lists[t]);
+        };
+        auto *p = pool();
+        if (p == nullptr || targets.size() < 2) {
+            for (std::size_t t = 0; t < targets.size(); ++t) {
+                run(t);
+            }
+        } else {
+            p->parallel_for(targets.size(), [&](std::size_t t, std::size_t) { run(t); });
+        }
+        for (std::size_t t = 0; t < targets.size(); ++t) {
+            if (!status[t].ok()) {
+                return status[t];
+            }
+            add_stats(stats[t], recorder.stats);
+        }
+        merge_results(lists, option.k, result);
+        return turbo::ok_status();
+    }
+
+}  // namespace zircon
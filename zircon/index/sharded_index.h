@@ -0,0 +1,129 @@
+// Copyright 2023 The Elastic-AI Authors.
+// part of Elastic AI Search
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#ifndef ZIRCON_INDEX_SHARDED_INDEX_H_
+#define ZIRCON_INDEX_SHARDED_INDEX_H_
+
+#include <memory>
+#include <vector>
+#include "zircon/core/index.h"
+#include "zircon/index/flat_index.h"
+#include "zircon/index/hnsw_index.h"
+#include "zircon/utility/id_filter.h"
+#include "zircon/utility/thread_pool.h"
+
+namespace zircon {
+
+    // how a sharded index spread the labels over its shards
+    enum class ShardPolicy {
+        // a mix of the label modulo the shards
+        SHARD_HASH = 0,
+        // the shard whose range holds the label
+        SHARD_RANGE,
+    };
+
+    struct ShardOption {
+        // shards of SHARD_HASH, SHARD_RANGE has one per range
+        uint32_t nshards{4};
+        ShardPolicy policy{ShardPolicy::SHARD_HASH};
+        // SHARD_RANGE, shard i holds the labels of ranges[i], bounds included
+        // like IdFilterRange. ascending and disjoint, a label out of all of
+        // them can not be added.
+        std::vector<IdFilterRange> ranges;
+        // threads of the fan out, the caller included. 0 use the shared pool
+        // of one thread per core, 1 search the shards on the calling thread.
+        uint32_t nthreads{0};
+    };
+
+    /**
+     * @brief several indexes of one kind, each with its own store, the labels
+     *        are spread over them by ShardOption::policy. an add or a remove
+     *        go to the shard of the label only, so writers of different shards
+     *        never meet on a lock, and a search runs on every shard in
+     *        parallel and merges the nearest of each with a k-way heap.
+     *        a filter with label_bounds skips the SHARD_RANGE shards out of them.
+     *        the option of the shards is the one given to initialize, the
+     *        store_option.max_elements is the capacity of each shard.
+     *        the shards are reachable by shard(), eg. to build them from
+     *        different threads or to search one alone, a label added to a
+     *        shard directly must be one shard_of routes to it.
+     */
+    class ShardedIndex : public Index {
+    public:
+        ShardedIndex() = default;
+
+        ~ShardedIndex() override = default;
+
+        // shards of FlatIndex, a FlatOption::nthreads of 1 leave the parallelism to the fan out
+        turbo::Status initialize(const IndexOption &option, const ShardOption &shard, const FlatOption &flat);
+
+        // shards of HnswIndex
+        turbo::Status initialize(const IndexOption &option, const ShardOption &shard, const HnswOption &hnsw);
+
+        // the location is the one in the store of the shard of the label, see shard_of
+        turbo::ResultStatus<location_t> add_vector(label_type label, turbo::Span<float> vector) override;
+
+        turbo::Status remove_vector(label_type label) override;
+
+        /**
+         * @brief option goes to every shard, its stats get the sum of the shards.
+         *        the k nearest of every shard are merged, nearest first.
+         */
+        turbo::Status
+        search(turbo::Span<float> query, const SearchOption &option, std::vector<QueryResult> &result) const override;
+
+        // the sum of the shards
+        [[nodiscard]] std::size_t size() const override;
+
+        [[nodiscard]] std::size_t nshards() const {
+            return _shards.size();
+        }
+
+        // shard of a label, nshards() if it is out of every SHARD_RANGE range
+        [[nodiscard]] std::size_t shard_of(label_type label) const;
+
+        [[nodiscard]] const Index &shard(std::size_t i) const {
+            return *_shards[i];
+        }
+
+        [[nodiscard]] Index &shard(std::size_t i) {
+            return *_shards[i];
+        }
+
+        [[nodiscard]] const ShardOption &shard_option() const {
+            return _shard;
+        }
+
+    private:
+        // check the option and fill _shard, the shards are made by the callers
+        turbo::Status prepare(const IndexOption &option, const ShardOption &shard);
+
+        [[nodiscard]] ThreadPool *pool() const;
+
+        // shards a search with filter has to visit
+        void target_shards(const IdFilter *filter, std::vector<std::size_t> &shards) const;
+
+    private:
+        bool _is_available{false};
+        IndexOption _option;
+        ShardOption _shard;
+        std::vector<std::unique_ptr<Index>> _shards;
+        // owned pool of nthreads, nullptr for the shared one or a serial fan out
+        std::unique_ptr<ThreadPool> _pool;
+    };
+
+}  // namespace zircon
+
+#endif  // ZIRCON_INDEX_SHARDED_INDEX_H_
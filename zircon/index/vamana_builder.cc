@@ -0,0 +1,429 @@
+// Copyright 2023 The Elastic-AI Authors.
+// part of Elastic AI Search
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#include "zircon/index/vamana_builder.h"
+#include "zircon/index/disk_layout.h"
+#include "turbo/files/sequential_write_file.h"
+#include "turbo/log/logging.h"
+#include <algorithm>
+#include <cstring>
+#include <limits>
+#include <numeric>
+#include <random>
+
+namespace zircon {
+
+    namespace {
+        turbo::Status write_padding(turbo::SequentialWriteFile &file, std::size_t written) {
+            static const char zeros[kDiskSectorSize] = {};
+            auto pad = align_to_sector(written) - written;
+            if (pad == 0) {
+                return turbo::ok_status();
+            }
+            return file.write(zeros, pad);
+        }
+    }  // namespace
+
+    turbo::Status VamanaBuilder::initialize(const IndexOption &option, const VamanaOption &vamana) {
+        if (_is_available) {
+            return turbo::failed_precondition_error("builder already initialized");
+        }
+        if (option.metric != MetricType::METRIC_L2 && option.metric != MetricType::METRIC_NORMALIZED_COSINE) {
+            return turbo::invalid_argument_error("vamana graph need METRIC_L2 or METRIC_NORMALIZED_COSINE");
+        }
+        if (vamana.max_degree == 0 || vamana.build_list == 0 || vamana.alpha < 1.0f) {
+            return turbo::invalid_argument_error("max_degree, build_list must be positive and alpha at least 1");
+        }
+        auto rs = _distance.initialize(option.metric, option.dimension);
+        if (!rs.ok()) {
+            return rs;
+        }
+        rs = _pq.initialize(option.dimension, vamana.pq_m, vamana.pq_nbits);
+        if (!rs.ok()) {
+            return rs;
+        }
+        if (option.store_option.encoding != EncodingType::ENCODING_NONE) {
+            return turbo::invalid_argument_error("vamana builder need a float store");
+        }
+        _option = option;
+        _vamana = vamana;
+        auto &store_option = _option.store_option;
+        store_option.vector_byte_size = static_cast<uint32_t>(option.dimension * sizeof(float));
+        // the node ids are the locations, they must stay dense
+        store_option.enable_replace_vacant = false;
+        rs = _store.initialize(store_option);
+        if (!rs.ok()) {
+            return rs;
+        }
+        _locks = std::make_unique<std::mutex[]>(kLockStripes);
+        if (_vamana.nthreads > 1) {
+            _pool = std::make_unique<ThreadPool>(_vamana.nthreads);
+        }
+        _is_available = true;
+        return turbo::ok_status();
+    }
+
+    turbo::ResultStatus<location_t> VamanaBuilder::add_vector(label_type label, turbo::Span<float> vector) {
+        TLOG_CHECK(_is_available, "should init be using");
+        if (_is_built) {
+            return turbo::failed_precondition_error("graph already built");
+        }
+        if (vector.size() != _option.dimension) {
+            return turbo::invalid_argument_error("vector dimension {} not match the index {}", vector.size(),
+                                                 _option.dimension);
+        }
+        return _store.add_vector(label, turbo::Span<uint8_t>(reinterpret_cast<uint8_t *>(vector.data()),
+                                                             vector.size() * sizeof(float)));
+    }
+
+    turbo::ResultStatus<std::size_t> VamanaBuilder::add_vectors(VectorSetReader &reader, label_type start_label) {
+        TLOG_CHECK(_is_available, "should init be using");
+        if (_is_built) {
+            return turbo::failed_precondition_error("graph already built");
+        }
+        const std::size_t chunk = _option.store_option.batch_size;
+        std::vector<float> buf(chunk * _option.dimension);
+        std::vector<label_type> labels(chunk);
+        std::size_t added = 0;
+        while (true) {
+            turbo::Span<uint8_t> span(reinterpret_cast<uint8_t *>(buf.data()), buf.size() * sizeof(float));
+            auto r = reader.read_batch(span, chunk);
+            if (!r.ok()) {
+                return r.status();
+            }
+            const std::size_t n = r.value();
+            if (n == 0) {
+                break;
+            }
+            std::iota(labels.begin(), labels.begin() + n, start_label + added);
+            auto rs = _store.add_vectors(turbo::Span<label_type>(labels.data(), n),
+                                         turbo::Span<uint8_t>(span.data(), n * _option.dimension * sizeof(float)));
+            if (!rs.ok()) {
+                return rs.status();
+            }
+            added += n;
+            if (n < chunk) {
+                break;
+            }
+        }
+        return added;
+    }
+
+    void VamanaBuilder::greedy_search(const float *query, VisitedList &visited, std::vector<Candidate> &list,
+                                      std::vector<Candidate> &expanded) const {
+        const std::size_t limit = _vamana.build_list;
+        const std::size_t R = _vamana.max_degree;
+        list.clear();
+        expanded.clear();
+        visited.visit(_medoid);
+        list.push_back({_distance(query, vector(_medoid)), static_cast<uint32_t>(_medoid), false});
+        std::vector<uint32_t> nbrs(R);
+        while (true) {
+            auto it = std::find_if(list.begin(), list.end(), [](const Candidate &c) { return !c.expanded; });
+            if (it == list.end()) {
+                break;
+            }
+            it->expanded = true;
+            const Candidate cur = *it;
+            expanded.push_back(cur);
+            std::size_t degree;
+            {
+                std::lock_guard<std::mutex> guard(lock_of(cur.id));
+                degree = _degrees[cur.id];
+                std::copy_n(_graph.data() + cur.id * R, degree, nbrs.data());
+            }
+            for (std::size_t i = 0; i < degree; ++i) {
+                const uint32_t nb = nbrs[i];
+                if (visited.visited(nb)) {
+                    continue;
+                }
+                visited.visit(nb);
+                const float d = _distance(query, vector(nb));
+                if (list.size() >= limit && d >= list.back().distance) {
+                    continue;
+                }
+                auto pos = std::upper_bound(list.begin(), list.end(), d,
+                                            [](float v, const Candidate &c) { return v < c.distance; });
+                list.insert(pos, {d, nb, false});
+                if (list.size() > limit) {
+                    list.pop_back();
+                }
+            }
+        }
+    }
+
+    void VamanaBuilder::robust_prune(std::size_t p, std::vector<Candidate> &pool, float alpha,
+                                     std::vector<uint32_t> &out) const {
+        out.clear();
+        std::sort(pool.begin(), pool.end(), [](const Candidate &a, const Candidate &b) {
+            return a.distance < b.distance || (a.distance == b.distance && a.id < b.id);
+        });
+        // expanded marks the candidates pruned
+        for (auto &c : pool) {
+            c.expanded = c.id == p;
+        }
+        for (std::size_t i = 0; i < pool.size() && out.size() < _vamana.max_degree; ++i) {
+            if (pool[i].expanded || (i > 0 && pool[i].id == pool[i - 1].id)) {
+                continue;
+            }
+            out.push_back(pool[i].id);
+            const float *v = vector(pool[i].id);
+            for (std::size_t j = i + 1; j < pool.size(); ++j) {
+                if (!pool[j].expanded && alpha * _distance(v, vector(pool[j].id)) <= pool[j].distance) {
+                    pool[j].expanded = true;
+                }
+            }
+        }
+    }
+
+    void VamanaBuilder::set_neighbors(std::size_t p, const std::vector<uint32_t> &ids) {
+        std::copy(ids.begin(), ids.end(), _graph.data() + p * _vamana.max_degree);
+        _degrees[p] = static_cast<uint32_t>(ids.size());
+    }
+
+    void VamanaBuilder::insert(std::size_t p, float alpha, VisitedList &visited, std::vector<Candidate> &list,
+                               std::vector<Candidate> &pool) {
+        const std::size_t R = _vamana.max_degree;
+        const float *x = vector(p);
+        visited.reset(_degrees.size());
+        greedy_search(x, visited, list, pool);
+        {
+            // the current neighbors stay candidates
+            std::lock_guard<std::mutex> guard(lock_of(p));
+            for (std::size_t i = 0; i < _degrees[p]; ++i) {
+                const uint32_t nb = _graph[p * R + i];
+                pool.push_back({_distance(x, vector(nb)), nb, false});
+            }
+        }
+        std::vector<uint32_t> pruned;
+        robust_prune(p, pool, alpha, pruned);
+        {
+            std::lock_guard<std::mutex> guard(lock_of(p));
+            set_neighbors(p, pruned);
+        }
+        std::vector<uint32_t> back;
+        for (const uint32_t j : pruned) {
+            std::lock_guard<std::mutex> guard(lock_of(j));
+            const uint32_t *row = _graph.data() + j * R;
+            const std::size_t degree = _degrees[j];
+            if (std::find(row, row + degree, static_cast<uint32_t>(p)) != row + degree) {
+                continue;
+            }
+            if (degree < R) {
+                _graph[j * R + degree] = static_cast<uint32_t>(p);
+                ++_degrees[j];
+                continue;
+            }
+            // full, prune the neighbors of j with p among them
+            const float *y = vector(j);
+            pool.clear();
+            for (std::size_t i = 0; i < degree; ++i) {
+                pool.push_back({_distance(y, vector(row[i])), row[i], false});
+            }
+            pool.push_back({_distance(y, x), static_cast<uint32_t>(p), false});
+            robust_prune(j, pool, alpha, back);
+            set_neighbors(j, back);
+        }
+    }
+
+    turbo::Status VamanaBuilder::train_codes() {
+        const std::size_t n = _store.current_index();
+        const std::size_t dim = _option.dimension;
+        const std::size_t nsamples = std::min<std::size_t>(std::max<uint32_t>(_vamana.pq_samples, 1), n);
+        std::vector<std::size_t> perm(n);
+        std::iota(perm.begin(), perm.end(), 0);
+        std::mt19937_64 rng(_vamana.seed);
+        std::vector<float> samples(nsamples * dim);
+        for (std::size_t i = 0; i < nsamples; ++i) {
+            std::uniform_int_distribution<std::size_t> pick(i, n - 1);
+            std::swap(perm[i], perm[pick(rng)]);
+            std::copy_n(vector(perm[i]), dim, samples.data() + i * dim);
+        }
+        KMeansOption kmeans;
+        kmeans.seed = _vamana.seed;
+        auto rs = _pq.train(turbo::Span<float>(samples.data(), samples.size()), kmeans);
+        if (!rs.ok()) {
+            return rs;
+        }
+        const std::size_t code_size = _pq.code_size();
+        _codes.assign(n * code_size, 0);
+        for (std::size_t i = 0; i < n; ++i) {
+            _pq.encode(vector(i), _codes.data() + i * code_size);
+        }
+        return turbo::ok_status();
+    }
+
+    turbo::Status VamanaBuilder::build() {
+        TLOG_CHECK(_is_available, "should init be using");
+        if (_is_built) {
+            return turbo::failed_precondition_error("graph already built");
+        }
+        const std::size_t n = _store.current_index();
+        if (n == 0) {
+            return turbo::failed_precondition_error("no vector to build");
+        }
+        if (n >= std::numeric_limits<uint32_t>::max()) {
+            return turbo::invalid_argument_error("{} vectors overflow the uint32 node ids", n);
+        }
+        const std::size_t dim = _option.dimension;
+        _graph.assign(n * _vamana.max_degree, 0);
+        _degrees.assign(n, 0);
+
+        // the medoid is the vector nearest to the mean
+        std::vector<double> sum(dim, 0.0);
+        for (std::size_t i = 0; i < n; ++i) {
+            const float *v = vector(i);
+            for (std::size_t d = 0; d < dim; ++d) {
+                sum[d] += v[d];
+            }
+        }
+        std::vector<float> mean(dim);
+        for (std::size_t d = 0; d < dim; ++d) {
+            mean[d] = static_cast<float>(sum[d] / static_cast<double>(n));
+        }
+        float best = std::numeric_limits<float>::max();
+        for (std::size_t i = 0; i < n; ++i) {
+            const float d = _distance(mean.data(), vector(i));
+            if (d < best) {
+                best = d;
+                _medoid = static_cast<location_t>(i);
+            }
+        }
+
+        std::vector<uint32_t> order(n);
+        std::iota(order.begin(), order.end(), 0);
+        std::mt19937_64 rng(_vamana.seed);
+        std::shuffle(order.begin(), order.end(), rng);
+        ThreadPool *pool = _vamana.nthreads == 1 ? nullptr
+                                                 : (_pool != nullptr ? _pool.get() : &ThreadPool::default_pool());
+        constexpr std::size_t kNodesPerTask = 64;
+        const std::size_t ntasks = (n + kNodesPerTask - 1) / kNodesPerTask;
+        for (const float alpha : {1.0f, _vamana.alpha}) {
+            auto task = [&](std::size_t t, std::size_t) {
+                auto visited = _visited_pool.get(n);
+                std::vector<Candidate> list;
+                std::vector<Candidate> expanded;
+                const std::size_t last = std::min(n, (t + 1) * kNodesPerTask);
+                for (std::size_t i = t * kNodesPerTask; i < last; ++i) {
+                    insert(order[i], alpha, *visited, list, expanded);
+                }
+                _visited_pool.release(std::move(visited));
+            };
+            if (pool != nullptr) {
+                pool->parallel_for(ntasks, task);
+            } else {
+                for (std::size_t t = 0; t < ntasks; ++t) {
+                    task(t, 0);
+                }
+            }
+        }
+        auto rs = train_codes();
+        if (!rs.ok()) {
+            return rs;
+        }
+        _is_built = true;
+        return turbo::ok_status();
+    }
+
+    turbo::Status VamanaBuilder::save_index(const std::string &path) const {
+        TLOG_CHECK(_is_available, "should init be using");
+        if (!_is_built) {
+            return turbo::failed_precondition_error("graph should be built before saving");
+        }
+        const std::size_t n = _store.current_index();
+        const std::size_t dim = _option.dimension;
+        const std::size_t R = _vamana.max_degree;
+        DiskIndexHeader header;
+        std::memset(&header, 0, sizeof(header));
+        header.magic = kDiskIndexMagic;
+        header.version = kDiskIndexVersion;
+        header.metric = static_cast<uint32_t>(_option.metric);
+        header.dimension = static_cast<uint32_t>(dim);
+        header.max_degree = static_cast<uint32_t>(R);
+        header.nvectors = n;
+        header.medoid = _medoid;
+        header.node_bytes = static_cast<uint32_t>(dim * sizeof(float) + (R + 1) * sizeof(uint32_t));
+        if (header.node_bytes <= kDiskSectorSize) {
+            header.nodes_per_sector = static_cast<uint32_t>(kDiskSectorSize / header.node_bytes);
+            header.sectors_per_node = 1;
+        } else {
+            header.nodes_per_sector = 0;
+            header.sectors_per_node = static_cast<uint32_t>(align_to_sector(header.node_bytes) / kDiskSectorSize);
+        }
+        header.pq_m = static_cast<uint32_t>(_pq.m());
+        header.pq_nbits = static_cast<uint32_t>(_pq.nbits());
+        header.graph_offset = kDiskSectorSize;
+        header.pq_offset = header.graph_offset + header.graph_sectors() * kDiskSectorSize;
+        const std::size_t pq_bytes = _pq.centroids().size() * sizeof(float);
+        header.codes_offset = header.pq_offset + align_to_sector(pq_bytes);
+        header.labels_offset = header.codes_offset + align_to_sector(_codes.size());
+        header.file_size = header.labels_offset + align_to_sector(n * sizeof(uint64_t));
+
+        turbo::SequentialWriteFile file;
+        auto rs = file.open(path);
+        if (!rs.ok()) {
+            return rs;
+        }
+        rs = file.write(reinterpret_cast<const char *>(&header), sizeof(header));
+        if (rs.ok()) {
+            rs = write_padding(file, sizeof(header));
+        }
+        // the graph sector by sector, a read of a node never cross into the next one
+        std::vector<uint8_t> sector(header.node_read_bytes());
+        const std::size_t per_read = header.nodes_per_sector != 0 ? header.nodes_per_sector : 1;
+        for (std::size_t first = 0; rs.ok() && first < n; first += per_read) {
+            std::fill(sector.begin(), sector.end(), 0);
+            for (std::size_t i = first; i < std::min(n, first + per_read); ++i) {
+                uint8_t *rec = sector.data() + header.node_read_skip(i);
+                std::memcpy(rec, vector(i), dim * sizeof(float));
+                const uint32_t degree = _degrees[i];
+                std::memcpy(rec + dim * sizeof(float), &degree, sizeof(degree));
+                std::memcpy(rec + dim * sizeof(float) + sizeof(uint32_t), _graph.data() + i * R,
+                            degree * sizeof(uint32_t));
+            }
+            rs = file.write(reinterpret_cast<const char *>(sector.data()), sector.size());
+        }
+        if (rs.ok()) {
+            rs = file.write(reinterpret_cast<const char *>(_pq.centroids().data()), pq_bytes);
+        }
+        if (rs.ok()) {
+            rs = write_padding(file, pq_bytes);
+        }
+        if (rs.ok()) {
+            rs = file.write(reinterpret_cast<const char *>(_codes.data()), _codes.size());
+        }
+        if (rs.ok()) {
+            rs = write_padding(file, _codes.size());
+        }
+        constexpr std::size_t kChunk = 4096;
+        std::vector<uint64_t> labels(kChunk);
+        for (std::size_t i = 0; rs.ok() && i < n; i += kChunk) {
+            auto cnt = std::min(kChunk, n - i);
+            for (std::size_t j = 0; j < cnt; ++j) {
+                labels[j] = _store.get_label(static_cast<location_t>(i + j)).value();
+            }
+            rs = file.write(reinterpret_cast<const char *>(labels.data()), cnt * sizeof(uint64_t));
+        }
+        if (rs.ok()) {
+            rs = write_padding(file, n * sizeof(uint64_t));
+        }
+        if (rs.ok()) {
+            rs = file.flush();
+        }
+        file.close();
+        return rs;
+    }
+
+}  // namespace zircon
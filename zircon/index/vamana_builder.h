@@ -0,0 +1,142 @@
+// Copyright 2023 The Elastic-AI Authors.
+// part of Elastic AI Search
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#ifndef ZIRCON_INDEX_VAMANA_BUILDER_H_
+#define ZIRCON_INDEX_VAMANA_BUILDER_H_
+
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+#include "zircon/core/defines.h"
+#include "zircon/core/vector_set_io.h"
+#include "zircon/index/visited_list.h"
+#include "zircon/quantizer/product_quantizer.h"
+#include "zircon/store/mem_vector_store.h"
+#include "zircon/utility/metric_distance.h"
+#include "zircon/utility/thread_pool.h"
+
+namespace zircon {
+
+    /**
+     * @brief build the vamana graph of a vector set and write it as a disk
+     *        index, see DiskIndex. the vectors are held in a float store
+     *        while building, the node ids of the graph are the locations of
+     *        the store. every node is inserted twice in a random order, first
+     *        with alpha 1 then with the alpha of the option, by a greedy
+     *        search from the medoid and a robust prune of what it visited,
+     *        the back edges are pruned once a node is over max_degree. the
+     *        inserts run on a thread pool, the neighbor lists are guarded by
+     *        striped locks. METRIC_L2 and METRIC_NORMALIZED_COSINE, the prune
+     *        needs non negative distances.
+     */
+    class VamanaBuilder {
+    public:
+        VamanaBuilder() = default;
+
+        ~VamanaBuilder() = default;
+
+        turbo::Status initialize(const IndexOption &option, const VamanaOption &vamana = VamanaOption());
+
+        // already exists if the label was added, failed precondition once built
+        turbo::ResultStatus<location_t> add_vector(label_type label, turbo::Span<float> vector);
+
+        /**
+         * @brief add the vectors of reader until its end, the i-th get the
+         *        label start_label + i. reader must be initialized for DT_FLOAT
+         *        vectors of the dimension.
+         * @return the number of vectors added.
+         */
+        turbo::ResultStatus<std::size_t> add_vectors(VectorSetReader &reader, label_type start_label);
+
+        // build the graph and the pq codes of the vectors added so far
+        turbo::Status build();
+
+        [[nodiscard]] bool is_built() const {
+            return _is_built;
+        }
+
+        // write the disk index, the builder must be built
+        turbo::Status save_index(const std::string &path) const;
+
+        [[nodiscard]] std::size_t size() const {
+            return _store.size();
+        }
+
+        [[nodiscard]] location_t medoid() const {
+            return _medoid;
+        }
+
+        [[nodiscard]] turbo::Span<const uint32_t> neighbors(location_t i) const {
+            return {_graph.data() + i * _vamana.max_degree, _degrees[i]};
+        }
+
+        // the vectors being built, eg. for load_vector_set
+        [[nodiscard]] MemVectorStore &store() {
+            return _store;
+        }
+
+    private:
+        struct Candidate {
+            float distance;
+            uint32_t id;
+            bool expanded;
+        };
+
+        [[nodiscard]] const float *vector(std::size_t i) const {
+            return reinterpret_cast<const float *>(_store.get_vector(static_cast<location_t>(i)).data());
+        }
+
+        [[nodiscard]] std::mutex &lock_of(std::size_t i) const {
+            return _locks[i % kLockStripes];
+        }
+
+        // the nodes expanded by a greedy search of query from the medoid
+        void greedy_search(const float *query, VisitedList &visited, std::vector<Candidate> &list,
+                           std::vector<Candidate> &expanded) const;
+
+        // keep at most max_degree of pool, closest first, pool is changed
+        void robust_prune(std::size_t p, std::vector<Candidate> &pool, float alpha, std::vector<uint32_t> &out) const;
+
+        void insert(std::size_t p, float alpha, VisitedList &visited, std::vector<Candidate> &list,
+                    std::vector<Candidate> &pool);
+
+        void set_neighbors(std::size_t p, const std::vector<uint32_t> &ids);
+
+        turbo::Status train_codes();
+
+    private:
+        static constexpr std::size_t kLockStripes = 4096;
+
+        bool _is_available{false};
+        bool _is_built{false};
+        IndexOption _option;
+        VamanaOption _vamana;
+        MetricDistance _distance;
+        MemVectorStore _store;
+        ProductQuantizer _pq;
+        // max_degree ids per node
+        std::vector<uint32_t> _graph;
+        std::vector<uint32_t> _degrees;
+        std::unique_ptr<std::mutex[]> _locks;
+        std::vector<uint8_t> _codes;
+        location_t _medoid{0};
+        std::unique_ptr<ThreadPool> _pool;
+        mutable VisitedListPool _visited_pool;
+    };
+
+}  // namespace zircon
+
+#endif  // ZIRCON_INDEX_VAMANA_BUILDER_H_
@@ -0,0 +1,94 @@
+// Copyright 2023 The Elastic-AI Authors.
+// part of Elastic AI Search
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#ifndef ZIRCON_INDEX_VISITED_LIST_H_
+#define ZIRCON_INDEX_VISITED_LIST_H_
+
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <mutex>
+#include <vector>
+#include "zircon/core/defines.h"
+
+namespace zircon {
+
+    /**
+     * @brief visited marks of a graph search, a location is visited if its mark
+     *        equals the current tag. a new search only bump the tag, the marks
+     *        are cleared once every 65535 searches.
+     */
+    class VisitedList {
+    public:
+        explicit VisitedList(std::size_t n) : _marks(n, 0) {}
+
+        void reset(std::size_t n) {
+            if (_marks.size() < n) {
+                _marks.resize(n, 0);
+            }
+            ++_tag;
+            if (_tag == 0) {
+                std::memset(_marks.data(), 0, _marks.size() * sizeof(uint16_t));
+                ++_tag;
+            }
+        }
+
+        [[nodiscard]] bool visited(location_t loc) const {
+            return _marks[loc] == _tag;
+        }
+
+        void visit(location_t loc) {
+            _marks[loc] = _tag;
+        }
+
+    private:
+        uint16_t _tag{0};
+        std::vector<uint16_t> _marks;
+    };
+
+    /**
+     * @brief reuse the visited lists among the searching threads.
+     */
+    class VisitedListPool {
+    public:
+        std::unique_ptr<VisitedList> get(std::size_t n) {
+            std::unique_ptr<VisitedList> list;
+            {
+                std::unique_lock<std::mutex> lock(_mutex);
+                if (!_pool.empty()) {
+                    list = std::move(_pool.back());
+                    _pool.pop_back();
+                }
+            }
+            if (!list) {
+                list = std::make_unique<VisitedList>(n);
+            }
+            list->reset(n);
+            return list;
+        }
+
+        void release(std::unique_ptr<VisitedList> list) {
+            std::unique_lock<std::mutex> lock(_mutex);
+            _pool.push_back(std::move(list));
+        }
+
+    private:
+        std::mutex _mutex;
+        std::vector<std::unique_ptr<VisitedList>> _pool;
+    };
+
+}  // namespace zircon
+
+#endif  // ZIRCON_INDEX_VISITED_LIST_H_
@@ -0,0 +1,69 @@
+// Copyright 2023 The Elastic-AI Authors.
+// part of Elastic AI Search
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#include "zircon/quantizer/binary_code_store.h"
+#include "zircon/store/mem_vector_store.h"
+#include "zircon/utility/distance_dispatch.h"
+#include "turbo/log/logging.h"
+
+namespace zircon {
+
+    turbo::Status BinaryCodeStore::initialize(const ScalarQuantizer *bq) {
+        if (bq == nullptr || bq->encoding() != EncodingType::ENCODING_BINARY) {
+            return turbo::invalid_argument_error("need a binary quantizer");
+        }
+        _bq = bq;
+        _size = 0;
+        _codes.clear();
+        return turbo::ok_status();
+    }
+
+    void BinaryCodeStore::add(const float *x, std::size_t n) {
+        TLOG_CHECK(_bq != nullptr, "should init be using");
+        const std::size_t cs = _bq->code_size();
+        _codes.resize((_size + n) * cs);
+        for (std::size_t i = 0; i < n; ++i) {
+            _bq->encode(x + i * _bq->dimension(), _codes.data() + (_size + i) * cs);
+        }
+        _size += n;
+    }
+
+    turbo::Status BinaryCodeStore::add_from_store(const MemVectorStore &store) {
+        TLOG_CHECK(_bq != nullptr, "should init be using");
+        if (store.is_encoded()) {
+            return turbo::invalid_argument_error("store must hold float vectors");
+        }
+        for (auto i = static_cast<location_t>(_size); i < store.current_index(); ++i) {
+            auto v = store.get_vector(i);
+            if (v.size() < _bq->dimension() * sizeof(float)) {
+                return turbo::invalid_argument_error("store vector size {} not match dimension {}", v.size(),
+                                                     _bq->dimension());
+            }
+            add(reinterpret_cast<const float *>(v.data()), 1);
+        }
+        return turbo::ok_status();
+    }
+
+    void BinaryCodeStore::set(std::size_t i, const float *x) {
+        TLOG_CHECK(i < _size, "code {} overflow, size {}", i, _size);
+        _bq->encode(x, _codes.data() + i * _bq->code_size());
+    }
+
+    void BinaryCodeStore::scan(const uint8_t *query_code, std::size_t first, std::size_t n, float *out) const {
+        TLOG_CHECK(first + n <= _size, "scan [{}, {}) overflow, size {}", first, first + n, _size);
+        distance::distance_kernels().batch_hamming(query_code, code(first), _bq->code_size(), n, out);
+    }
+
+}  // namespace zircon
@@ -0,0 +1,87 @@
+// Copyright 2023 The Elastic-AI Authors.
+// part of Elastic AI Search
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#ifndef ZIRCON_QUANTIZER_BINARY_CODE_STORE_H_
+#define ZIRCON_QUANTIZER_BINARY_CODE_STORE_H_
+
+#include <vector>
+#include "turbo/base/status.h"
+#include "zircon/core/defines.h"
+#include "zircon/quantizer/scalar_quantizer.h"
+
+namespace zircon {
+
+    class MemVectorStore;
+
+    /**
+     * @brief compact store of binary codes, see ENCODING_BINARY, the i-th code
+     *        is the i-th vector added. the codes are kept one after another
+     *        without padding, code_size() bytes each, so a scan is a single
+     *        pass of the one to many hamming kernel. codes built by
+     *        add_from_store follow the store locations, the nearest codes are
+     *        the candidates reranked with the float vectors of the store,
+     *        see binary_rerank_search.
+     */
+    class BinaryCodeStore {
+    public:
+        BinaryCodeStore() = default;
+
+        ~BinaryCodeStore() = default;
+
+        // bq must be a ENCODING_BINARY quantizer and outlive the store.
+        turbo::Status initialize(const ScalarQuantizer *bq);
+
+        void add(const float *x, std::size_t n);
+
+        /**
+         * @brief encode the locations [size(), current_index()) of a float store,
+         *        deleted locations are encoded as well to keep the locations aligned.
+         */
+        turbo::Status add_from_store(const MemVectorStore &store);
+
+        // encode x again into the i-th code, eg. for a location reused by the store.
+        void set(std::size_t i, const float *x);
+
+        [[nodiscard]] std::size_t size() const {
+            return _size;
+        }
+
+        [[nodiscard]] std::size_t code_size() const {
+            return _bq->code_size();
+        }
+
+        [[nodiscard]] const uint8_t *code(std::size_t i) const {
+            return _codes.data() + i * _bq->code_size();
+        }
+
+        [[nodiscard]] const ScalarQuantizer *quantizer() const {
+            return _bq;
+        }
+
+        /**
+         * @brief hamming distance of an encoded query to the codes [first, first + n),
+         *        out has n floats.
+         */
+        void scan(const uint8_t *query_code, std::size_t first, std::size_t n, float *out) const;
+
+    private:
+        const ScalarQuantizer *_bq{nullptr};
+        std::size_t _size{0};
+        std::vector<uint8_t> _codes;
+    };
+
+}  // namespace zircon
+
+#endif  // ZIRCON_QUANTIZER_BINARY_CODE_STORE_H_
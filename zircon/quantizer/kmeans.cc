@@ -0,0 +1,251 @@
+// Copyright 2023 The Elastic-AI Authors.
+// part of Elastic AI Search
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#include "zircon/quantizer/kmeans.h"
+#include "zircon/utility/distance_dispatch.h"
+#include "zircon/utility/thread_pool.h"
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <numeric>
+#include <random>
+#include <vector>
+
+namespace zircon {
+
+    namespace {
+        // rows of queries scored against all centroids at once
+        constexpr std::size_t kAssignTile = 64;
+    }  // namespace
+
+    void kmeans_assign(const float *data, std::size_t n, std::size_t dim, const float *centroids, std::size_t k,
+                       uint32_t *assign, float *dis) {
+        auto &kernels = distance::distance_kernels();
+        std::vector<float> tile(kAssignTile * k);
+        for (std::size_t i = 0; i < n; i += kAssignTile) {
+            std::size_t nq = std::min(kAssignTile, n - i);
+            kernels.matrix_l2(data + i * dim, nq, centroids, k, dim, tile.data(), k);
+            for (std::size_t r = 0; r < nq; ++r) {
+                const float *row = tile.data() + r * k;
+                auto best = static_cast<uint32_t>(std::min_element(row, row + k) - row);
+                assign[i + r] = best;
+                if (dis != nullptr) {
+                    dis[i + r] = row[best];
+                }
+            }
+        }
+    }
+
+    void parallel_kmeans_assign(ThreadPool &pool, const float *data, std::size_t n, std::size_t dim,
+                                const float *centroids, std::size_t k, uint32_t *assign, float *dis) {
+        // a few tiles per task so the tile buffer is reused
+        constexpr std::size_t kRowsPerTask = 4 * kAssignTile;
+        const std::size_t ntasks = (n + kRowsPerTask - 1) / kRowsPerTask;
+        pool.parallel_for(ntasks, [&](std::size_t task, std::size_t) {
+            const std::size_t first = task * kRowsPerTask;
+            const std::size_t count = std::min(kRowsPerTask, n - first);
+            kmeans_assign(data + first * dim, count, dim, centroids, k, assign + first,
+                          dis == nullptr ? nullptr : dis + first);
+        });
+    }
+
+    turbo::Status minibatch_kmeans_train(const float *data, std::size_t n, std::size_t dim, std::size_t k,
+                                         const MiniBatchKMeansOption &option, float *centroids,
+                                         ThreadPool *pool) {
+        if (k == 0 || dim == 0) {
+            return turbo::invalid_argument_error("k and dim must be positive");
+        }
+        if (n < k) {
+            return turbo::invalid_argument_error("{} points is not enough for {} centroids", n, k);
+        }
+        std::mt19937_64 rng(option.seed);
+        {
+            // init with k distinct points
+            std::vector<std::size_t> perm(n);
+            std::iota(perm.begin(), perm.end(), 0);
+            for (std::size_t c = 0; c < k; ++c) {
+                std::uniform_int_distribution<std::size_t> pick(c, n - 1);
+                std::swap(perm[c], perm[pick(rng)]);
+                std::copy_n(data + perm[c] * dim, dim, centroids + c * dim);
+            }
+        }
+        const std::size_t b = std::max<std::size_t>(std::min(option.batch_size, n), 1);
+        std::vector<float> batch(b * dim);
+        std::vector<uint32_t> assign(b);
+        std::vector<uint32_t> begin(k + 1);
+        std::vector<uint32_t> order(b);
+        // points seen by every centroid, the learning rate is the inverse
+        std::vector<uint64_t> seen(k, 0);
+        std::uniform_int_distribution<std::size_t> draw(0, n - 1);
+        // the centroid updates are independent, a task updates a range of them
+        constexpr std::size_t kCentroidsPerTask = 64;
+        const std::size_t update_tasks = (k + kCentroidsPerTask - 1) / kCentroidsPerTask;
+        auto update = [&](std::size_t task, std::size_t) {
+            const std::size_t first = task * kCentroidsPerTask;
+            const std::size_t last = std::min(first + kCentroidsPerTask, k);
+            std::vector<double> sum(dim);
+            for (std::size_t c = first; c < last; ++c) {
+                const std::size_t m = begin[c + 1] - begin[c];
+                if (m == 0) {
+                    continue;
+                }
+                std::fill(sum.begin(), sum.end(), 0.0);
+                for (auto j = begin[c]; j < begin[c + 1]; ++j) {
+                    const float *x = batch.data() + order[j] * dim;
+                    for (std::size_t d = 0; d < dim; ++d) {
+                        sum[d] += x[d];
+                    }
+                }
+                // c + (sum - m * c) / seen, the m sequential updates of rate 1 / seen at once
+                seen[c] += m;
+                float *cen = centroids + c * dim;
+                const double rate = 1.0 / static_cast<double>(seen[c]);
+                for (std::size_t d = 0; d < dim; ++d) {
+                    cen[d] = static_cast<float>(cen[d] + (sum[d] - static_cast<double>(m) * cen[d]) * rate);
+                }
+            }
+        };
+        for (std::size_t iter = 0; iter < option.niter; ++iter) {
+            for (std::size_t i = 0; i < b; ++i) {
+                std::copy_n(data + draw(rng) * dim, dim, batch.data() + i * dim);
+            }
+            if (pool != nullptr) {
+                parallel_kmeans_assign(*pool, batch.data(), b, dim, centroids, k, assign.data());
+            } else {
+                kmeans_assign(batch.data(), b, dim, centroids, k, assign.data());
+            }
+            // counting sort of the batch by centroid
+            std::fill(begin.begin(), begin.end(), 0);
+            for (std::size_t i = 0; i < b; ++i) {
+                ++begin[assign[i] + 1];
+            }
+            for (std::size_t c = 0; c < k; ++c) {
+                begin[c + 1] += begin[c];
+            }
+            {
+                std::vector<uint32_t> fill(begin.begin(), begin.end() - 1);
+                for (std::size_t i = 0; i < b; ++i) {
+                    order[fill[assign[i]]++] = static_cast<uint32_t>(i);
+                }
+            }
+            if (pool != nullptr) {
+                pool->parallel_for(update_tasks, update);
+            } else {
+                for (std::size_t t = 0; t < update_tasks; ++t) {
+                    update(t, 0);
+                }
+            }
+        }
+        // split the most visited centroid for every one never visited
+        for (std::size_t c = 0; c < k; ++c) {
+            if (seen[c] != 0) {
+                continue;
+            }
+            auto big = static_cast<std::size_t>(std::max_element(seen.begin(), seen.end()) - seen.begin());
+            for (std::size_t d = 0; d < dim; ++d) {
+                float v = centroids[big * dim + d];
+                float eps = (d % 2 == 0 ? 1.0f : -1.0f) * (std::abs(v) + 1.0f) / 1024.0f;
+                centroids[c * dim + d] = v + eps;
+                centroids[big * dim + d] = v - eps;
+            }
+            seen[c] = seen[big] / 2;
+            seen[big] -= seen[c];
+        }
+        return turbo::ok_status();
+    }
+
+    turbo::Status kmeans_train(const float *data, std::size_t n, std::size_t dim, std::size_t k,
+                               const KMeansOption &option, float *centroids) {
+        if (k == 0 || dim == 0) {
+            return turbo::invalid_argument_error("k and dim must be positive");
+        }
+        if (n < k) {
+            return turbo::invalid_argument_error("{} points is not enough for {} centroids", n, k);
+        }
+        std::mt19937_64 rng(option.seed);
+        std::vector<std::size_t> perm(n);
+        std::iota(perm.begin(), perm.end(), 0);
+        std::shuffle(perm.begin(), perm.end(), rng);
+
+        // sub sample the training set
+        std::vector<float> sampled;
+        std::size_t max_points = option.max_points_per_centroid == 0 ? n : k * option.max_points_per_centroid;
+        if (n > max_points) {
+            sampled.resize(max_points * dim);
+            for (std::size_t i = 0; i < max_points; ++i) {
+                std::copy_n(data + perm[i] * dim, dim, sampled.data() + i * dim);
+            }
+            data = sampled.data();
+            n = max_points;
+            std::iota(perm.begin(), perm.begin() + n, 0);
+            std::shuffle(perm.begin(), perm.begin() + n, rng);
+        }
+
+        // init with k distinct points
+        for (std::size_t c = 0; c < k; ++c) {
+            std::copy_n(data + perm[c] * dim, dim, centroids + c * dim);
+        }
+
+        std::vector<uint32_t> assign(n, std::numeric_limits<uint32_t>::max());
+        std::vector<uint32_t> next(n);
+        std::vector<std::size_t> counts(k);
+        std::vector<double> sums(k * dim);
+        for (std::size_t iter = 0; iter < option.niter; ++iter) {
+            kmeans_assign(data, n, dim, centroids, k, next.data());
+            if (next == assign) {
+                break;
+            }
+            assign.swap(next);
+
+            std::fill(counts.begin(), counts.end(), 0);
+            std::fill(sums.begin(), sums.end(), 0.0);
+            for (std::size_t i = 0; i < n; ++i) {
+                auto c = assign[i];
+                ++counts[c];
+                const float *x = data + i * dim;
+                double *s = sums.data() + c * dim;
+                for (std::size_t d = 0; d < dim; ++d) {
+                    s[d] += x[d];
+                }
+            }
+            for (std::size_t c = 0; c < k; ++c) {
+                if (counts[c] == 0) {
+                    continue;
+                }
+                for (std::size_t d = 0; d < dim; ++d) {
+                    centroids[c * dim + d] = static_cast<float>(sums[c * dim + d] / counts[c]);
+                }
+            }
+            // split the largest cluster for every empty one, the two halves
+            // are moved away from each other a little.
+            for (std::size_t c = 0; c < k; ++c) {
+                if (counts[c] != 0) {
+                    continue;
+                }
+                auto big = static_cast<std::size_t>(std::max_element(counts.begin(), counts.end()) - counts.begin());
+                for (std::size_t d = 0; d < dim; ++d) {
+                    float v = centroids[big * dim + d];
+                    float eps = (d % 2 == 0 ? 1.0f : -1.0f) * (std::abs(v) + 1.0f) / 1024.0f;
+                    centroids[c * dim + d] = v + eps;
+                    centroids[big * dim + d] = v - eps;
+                }
+                counts[c] = counts[big] / 2;
+                counts[big] -= counts[c];
+            }
+        }
+        return turbo::ok_status();
+    }
+
+}  // namespace zircon
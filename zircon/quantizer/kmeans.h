@@ -0,0 +1,83 @@
+// Copyright 2023 The Elastic-AI Authors.
+// part of Elastic AI Search
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#ifndef ZIRCON_QUANTIZER_KMEANS_H_
+#define ZIRCON_QUANTIZER_KMEANS_H_
+
+#include <cstddef>
+#include <cstdint>
+#include "turbo/base/status.h"
+
+namespace zircon {
+
+    class ThreadPool;
+
+    struct KMeansOption {
+        std::size_t niter{25};
+        // train on at most k * max_points_per_centroid random points
+        std::size_t max_points_per_centroid{256};
+        uint64_t seed{1234};
+    };
+
+    /**
+     * @brief lloyd k-means with squared l2, the assignment step is done by the
+     *        tiled distance matrix kernels. empty clusters are refilled by
+     *        splitting the largest one.
+     * @param data n vectors of dim floats, one after another.
+     * @param centroids output, k vectors of dim floats.
+     * @return invalid argument if n < k.
+     */
+    turbo::Status kmeans_train(const float *data, std::size_t n, std::size_t dim, std::size_t k,
+                               const KMeansOption &option, float *centroids);
+
+    /**
+     * @brief assign every vector to its nearest centroid.
+     * @param assign output, n centroid ids.
+     * @param dis optional output, n squared l2 to the assigned centroid.
+     */
+    void kmeans_assign(const float *data, std::size_t n, std::size_t dim, const float *centroids, std::size_t k,
+                       uint32_t *assign, float *dis = nullptr);
+
+    // kmeans_assign with the tiles of rows split over the threads of pool
+    void parallel_kmeans_assign(ThreadPool &pool, const float *data, std::size_t n, std::size_t dim,
+                                const float *centroids, std::size_t k, uint32_t *assign, float *dis = nullptr);
+
+    struct MiniBatchKMeansOption {
+        std::size_t niter{100};
+        // points drawn for every iteration
+        std::size_t batch_size{4096};
+        uint64_t seed{1234};
+    };
+
+    /**
+     * @brief mini batch k-means with squared l2, every iteration assigns a
+     *        random batch of points with the tiled distance matrix kernels and
+     *        moves every centroid toward its points with a per centroid
+     *        learning rate of 1 / points seen. the cost of an iteration does not
+     *        depend on n, for training sets too large for lloyd iterations.
+     *        the assignment and the updates are split over pool if not null,
+     *        the result does not depend on the number of threads. centroids
+     *        that never got a point are refilled by splitting the largest one.
+     * @param data n vectors of dim floats, one after another.
+     * @param centroids output, k vectors of dim floats.
+     * @return invalid argument if n < k.
+     */
+    turbo::Status minibatch_kmeans_train(const float *data, std::size_t n, std::size_t dim, std::size_t k,
+                                         const MiniBatchKMeansOption &option, float *centroids,
+                                         ThreadPool *pool = nullptr);
+
+}  // namespace zircon
+
+#endif  // ZIRCON_QUANTIZER_KMEANS_H_
@@ -0,0 +1,142 @@
+// Copyright 2023 The Elastic-AI Authors.
+// part of Elastic AI Search
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#include "zircon/quantizer/pq_code_store.h"
+#include "zircon/store/mem_vector_store.h"
+#include "zircon/utility/distance_dispatch.h"
+#include "turbo/log/logging.h"
+#include <algorithm>
+#include <cmath>
+
+namespace zircon {
+
+    turbo::Status PqCodeStore::initialize(const ProductQuantizer *pq) {
+        if (pq == nullptr || !pq->is_trained()) {
+            return turbo::invalid_argument_error("product quantizer must be trained");
+        }
+        _pq = pq;
+        _size = 0;
+        _codes.clear();
+        _blocks.clear();
+        return turbo::ok_status();
+    }
+
+    void PqCodeStore::add_code(const uint8_t *code) {
+        const std::size_t cs = _pq->code_size();
+        _codes.insert(_codes.end(), code, code + cs);
+        if (_pq->nbits() == 4) {
+            const std::size_t m = _pq->m();
+            const std::size_t b = _size / kBlockSize;
+            const std::size_t j = _size % kBlockSize;
+            if (j == 0) {
+                _blocks.resize((b + 1) * m * 16, 0);
+            }
+            uint8_t *block = _blocks.data() + b * m * 16;
+            for (std::size_t q = 0; q < m; ++q) {
+                auto c = static_cast<uint8_t>(_pq->get_code(code, q));
+                block[q * 16 + j % 16] |= j < 16 ? c : static_cast<uint8_t>(c << 4);
+            }
+        }
+        ++_size;
+    }
+
+    void PqCodeStore::add(const float *x, std::size_t n) {
+        TLOG_CHECK(_pq != nullptr, "should init be using");
+        std::vector<uint8_t> code(_pq->code_size());
+        for (std::size_t i = 0; i < n; ++i) {
+            _pq->encode(x + i * _pq->dimension(), code.data());
+            add_code(code.data());
+        }
+    }
+
+    turbo::Status PqCodeStore::add_from_store(const MemVectorStore &store) {
+        TLOG_CHECK(_pq != nullptr, "should init be using");
+        if (store.is_encoded()) {
+            return turbo::invalid_argument_error("store must hold float vectors");
+        }
+        std::vector<uint8_t> code(_pq->code_size());
+        for (auto i = static_cast<location_t>(_size); i < store.current_index(); ++i) {
+            auto v = store.get_vector(i);
+            if (v.size() < _pq->dimension() * sizeof(float)) {
+                return turbo::invalid_argument_error("store vector size {} not match dimension {}", v.size(),
+                                                     _pq->dimension());
+            }
+            _pq->encode(reinterpret_cast<const float *>(v.data()), code.data());
+            add_code(code.data());
+        }
+        return turbo::ok_status();
+    }
+
+    turbo::Status PqCodeStore::scan(MetricType metric, const float *query, float *out) const {
+        TLOG_CHECK(_pq != nullptr, "should init be using");
+        const std::size_t m = _pq->m();
+        const std::size_t ksub = _pq->ksub();
+        std::vector<float> lut(m * ksub);
+        auto rs = _pq->compute_lut(metric, query, lut.data());
+        if (!rs.ok()) {
+            return rs;
+        }
+        if (_pq->nbits() == 8) {
+            const std::size_t cs = _pq->code_size();
+            for (std::size_t i = 0; i < _size; ++i) {
+                out[i] = _pq->adc_distance(lut.data(), _codes.data() + i * cs);
+            }
+            return turbo::ok_status();
+        }
+        // quantize the lut to uint8, a bias per sub quantizer and one shared step,
+        // so the uint16 sums map back to float with one multiply add.
+        std::vector<uint8_t> qlut(m * 16);
+        float bias = 0.0f;
+        float range = 0.0f;
+        for (std::size_t q = 0; q < m; ++q) {
+            auto [lo, hi] = std::minmax_element(lut.begin() + q * 16, lut.begin() + (q + 1) * 16);
+            bias += *lo;
+            range = std::max(range, *hi - *lo);
+        }
+        const float step = range > 0.0f ? range / 255.0f : 1.0f;
+        for (std::size_t q = 0; q < m; ++q) {
+            const float lo = *std::min_element(lut.begin() + q * 16, lut.begin() + (q + 1) * 16);
+            for (std::size_t c = 0; c < 16; ++c) {
+                float v = std::nearbyint((lut[q * 16 + c] - lo) / step);
+                qlut[q * 16 + c] = static_cast<uint8_t>(std::clamp(v, 0.0f, 255.0f));
+            }
+        }
+        const std::size_t nblocks = (_size + kBlockSize - 1) / kBlockSize;
+        std::vector<uint16_t> acc(nblocks * kBlockSize);
+        distance::distance_kernels().pq4_scan(_blocks.data(), nblocks, m, qlut.data(), acc.data());
+        for (std::size_t i = 0; i < _size; ++i) {
+            out[i] = bias + static_cast<float>(acc[i]) * step;
+        }
+        return turbo::ok_status();
+    }
+
+    turbo::Status PqCodeStore::search(MetricType metric, const float *query, std::size_t k,
+                                      std::vector<std::pair<float, location_t>> &result) const {
+        std::vector<float> dis(_size);
+        auto rs = scan(metric, query, dis.data());
+        if (!rs.ok()) {
+            return rs;
+        }
+        result.resize(_size);
+        for (std::size_t i = 0; i < _size; ++i) {
+            result[i] = {dis[i], static_cast<location_t>(i)};
+        }
+        k = std::min(k, _size);
+        std::partial_sort(result.begin(), result.begin() + k, result.end());
+        result.resize(k);
+        return turbo::ok_status();
+    }
+
+}  // namespace zircon
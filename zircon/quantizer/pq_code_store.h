@@ -0,0 +1,96 @@
+// Copyright 2023 The Elastic-AI Authors.
+// part of Elastic AI Search
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#ifndef ZIRCON_QUANTIZER_PQ_CODE_STORE_H_
+#define ZIRCON_QUANTIZER_PQ_CODE_STORE_H_
+
+#include <utility>
+#include <vector>
+#include "turbo/base/status.h"
+#include "zircon/core/defines.h"
+#include "zircon/core/metric_type.h"
+#include "zircon/quantizer/product_quantizer.h"
+
+namespace zircon {
+
+    class MemVectorStore;
+
+    /**
+     * @brief compact store of product quantizer codes, the i-th code is the
+     *        i-th vector added. codes built by add_from_store follow the store
+     *        locations, so a result can be reranked against the store directly, see
+     *        rerank_search.
+     *        4 bits codes are also kept in the fast scan layout, blocks of 32
+     *        vectors, see pq4_scan_func. the fast scan quantize the lookup table
+     *        to uint8 and score a whole block with byte shuffles.
+     */
+    class PqCodeStore {
+    public:
+        static constexpr std::size_t kBlockSize = 32;
+
+        PqCodeStore() = default;
+
+        ~PqCodeStore() = default;
+
+        // pq must be trained and outlive the store.
+        turbo::Status initialize(const ProductQuantizer *pq);
+
+        void add(const float *x, std::size_t n);
+
+        /**
+         * @brief encode the locations [size(), current_index()) of a float store,
+         *        deleted locations are encoded as well to keep the locations aligned.
+         */
+        turbo::Status add_from_store(const MemVectorStore &store);
+
+        [[nodiscard]] std::size_t size() const {
+            return _size;
+        }
+
+        [[nodiscard]] const uint8_t *code(std::size_t i) const {
+            return _codes.data() + i * _pq->code_size();
+        }
+
+        [[nodiscard]] const ProductQuantizer *quantizer() const {
+            return _pq;
+        }
+
+        /**
+         * @brief approximate distance of the query to every code, out has size()
+         *        floats with the VectorDistance semantics. 4 bits codes use the fast
+         *        scan, the result then also carry the lut quantization error.
+         */
+        turbo::Status scan(MetricType metric, const float *query, float *out) const;
+
+        /**
+         * @brief the k nearest codes by approximate distance, nearest first.
+         */
+        turbo::Status search(MetricType metric, const float *query, std::size_t k,
+                             std::vector<std::pair<float, location_t>> &result) const;
+
+    private:
+        void add_code(const uint8_t *code);
+
+    private:
+        const ProductQuantizer *_pq{nullptr};
+        std::size_t _size{0};
+        std::vector<uint8_t> _codes;
+        // 4 bits only, m * 16 bytes every kBlockSize vectors
+        std::vector<uint8_t> _blocks;
+    };
+
+}  // namespace zircon
+
+#endif  // ZIRCON_QUANTIZER_PQ_CODE_STORE_H_
@@ -0,0 +1,188 @@
+// Copyright 2023 The Elastic-AI Authors.
+// part of Elastic AI Search
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#include "zircon/quantizer/product_quantizer.h"
+#include "zircon/store/mem_vector_store.h"
+#include "zircon/utility/distance_dispatch.h"
+#include "turbo/log/logging.h"
+#include <algorithm>
+#include <cstring>
+#include <random>
+
+namespace zircon {
+
+    turbo::Status ProductQuantizer::initialize(std::size_t dimension, std::size_t m, std::size_t nbits) {
+        if (dimension == 0 || m == 0 || dimension % m != 0) {
+            return turbo::invalid_argument_error("dimension {} must be divisible by m {}", dimension, m);
+        }
+        if (nbits != 4 && nbits != 8) {
+            return turbo::invalid_argument_error("nbits must be 4 or 8, but {}", nbits);
+        }
+        if (nbits == 4 && m > 256) {
+            return turbo::invalid_argument_error("m must not more than 256 for 4 bits, but {}", m);
+        }
+        _dimension = dimension;
+        _m = m;
+        _nbits = nbits;
+        _ksub = std::size_t(1) << nbits;
+        _dsub = dimension / m;
+        _is_trained = false;
+        _centroids.clear();
+        return turbo::ok_status();
+    }
+
+    turbo::Status ProductQuantizer::train(turbo::Span<float> samples, const KMeansOption &option) {
+        TLOG_CHECK(_dimension > 0, "should init be using");
+        if (samples.size() % _dimension != 0) {
+            return turbo::invalid_argument_error("samples size {} is not n * dimension {}", samples.size(),
+                                                 _dimension);
+        }
+        const std::size_t n = samples.size() / _dimension;
+        if (n < _ksub) {
+            return turbo::invalid_argument_error("need at least {} samples, but {}", _ksub, n);
+        }
+        std::vector<float> centroids(_m * _ksub * _dsub);
+        std::vector<float> sub(n * _dsub);
+        for (std::size_t q = 0; q < _m; ++q) {
+            for (std::size_t i = 0; i < n; ++i) {
+                std::copy_n(samples.data() + i * _dimension + q * _dsub, _dsub, sub.data() + i * _dsub);
+            }
+            KMeansOption op = option;
+            op.seed = option.seed + q;
+            auto rs = kmeans_train(sub.data(), n, _dsub, _ksub, op, centroids.data() + q * _ksub * _dsub);
+            if (!rs.ok()) {
+                return rs;
+            }
+        }
+        return set_centroids(centroids);
+    }
+
+    turbo::Status ProductQuantizer::train(const MemVectorStore &store, std::size_t max_samples,
+                                          const KMeansOption &option) {
+        TLOG_CHECK(_dimension > 0, "should init be using");
+        if (store.current_index() == 0) {
+            return turbo::invalid_argument_error("store is empty");
+        }
+        if (store.is_encoded() || store.get_vector(0).size() < _dimension * sizeof(float)) {
+            return turbo::invalid_argument_error("store must hold float vectors of dimension {}", _dimension);
+        }
+        std::vector<location_t> alive;
+        for (location_t i = 0; i < store.current_index(); ++i) {
+            if (!store.is_deleted(i)) {
+                alive.push_back(i);
+            }
+        }
+        std::mt19937_64 rng(option.seed);
+        std::shuffle(alive.begin(), alive.end(), rng);
+        alive.resize(std::min(alive.size(), max_samples));
+        std::vector<float> samples(alive.size() * _dimension);
+        for (std::size_t i = 0; i < alive.size(); ++i) {
+            auto v = store.get_vector(alive[i]);
+            std::memcpy(samples.data() + i * _dimension, v.data(), _dimension * sizeof(float));
+        }
+        return train(turbo::Span<float>(samples), option);
+    }
+
+    turbo::Status ProductQuantizer::set_centroids(const std::vector<float> &centroids) {
+        if (centroids.size() != _m * _ksub * _dsub) {
+            return turbo::invalid_argument_error("centroids size {} not match {}", centroids.size(),
+                                                 _m * _ksub * _dsub);
+        }
+        _centroids = centroids;
+        _is_trained = true;
+        return turbo::ok_status();
+    }
+
+    void ProductQuantizer::encode(const float *x, uint8_t *code) const {
+        TLOG_CHECK(_is_trained, "quantizer should be trained before encoding");
+        auto &kernels = distance::distance_kernels();
+        float dis[256];
+        std::memset(code, 0, code_size());
+        for (std::size_t q = 0; q < _m; ++q) {
+            kernels.batch_l2(x + q * _dsub, _centroids.data() + q * _ksub * _dsub, _dsub, _ksub, dis);
+            auto c = static_cast<uint8_t>(std::min_element(dis, dis + _ksub) - dis);
+            if (_nbits == 8) {
+                code[q] = c;
+            } else {
+                code[q >> 1] |= (q & 1) ? static_cast<uint8_t>(c << 4) : c;
+            }
+        }
+    }
+
+    void ProductQuantizer::encode(const float *x, std::size_t n, uint8_t *codes) const {
+        for (std::size_t i = 0; i < n; ++i) {
+            encode(x + i * _dimension, codes + i * code_size());
+        }
+    }
+
+    void ProductQuantizer::decode(const uint8_t *code, float *x) const {
+        TLOG_CHECK(_is_trained, "quantizer should be trained before decoding");
+        for (std::size_t q = 0; q < _m; ++q) {
+            const float *c = _centroids.data() + (q * _ksub + get_code(code, q)) * _dsub;
+            std::copy_n(c, _dsub, x + q * _dsub);
+        }
+    }
+
+    turbo::Status ProductQuantizer::compute_lut(MetricType metric, const float *query, float *lut) const {
+        TLOG_CHECK(_is_trained, "quantizer should be trained before computing lut");
+        auto &kernels = distance::distance_kernels();
+        switch (metric) {
+            case MetricType::METRIC_L2:
+                for (std::size_t q = 0; q < _m; ++q) {
+                    kernels.batch_l2(query + q * _dsub, _centroids.data() + q * _ksub * _dsub, _dsub, _ksub,
+                                     lut + q * _ksub);
+                }
+                return turbo::ok_status();
+            case MetricType::METRIC_IP:
+            case MetricType::METRIC_NORMALIZED_COSINE: {
+                // spread the 1 of 1 - ip over the sub quantizers
+                const float bias = metric == MetricType::METRIC_IP ? 0.0f : 1.0f / static_cast<float>(_m);
+                for (std::size_t q = 0; q < _m; ++q) {
+                    float *t = lut + q * _ksub;
+                    kernels.batch_ip(query + q * _dsub, _centroids.data() + q * _ksub * _dsub, _dsub, _ksub, t);
+                    for (std::size_t c = 0; c < _ksub; ++c) {
+                        t[c] = bias - t[c];
+                    }
+                }
+                return turbo::ok_status();
+            }
+            default:
+                return turbo::invalid_argument_error("metric not support by product quantizer");
+        }
+    }
+
+    float ProductQuantizer::adc_distance(const float *lut, const uint8_t *code) const {
+        float sum = 0.0f;
+        if (_nbits == 8) {
+            std::size_t q = 0;
+            float s0 = 0.0f, s1 = 0.0f, s2 = 0.0f, s3 = 0.0f;
+            for (; q + 4 <= _m; q += 4) {
+                s0 += lut[q * _ksub + code[q]];
+                s1 += lut[(q + 1) * _ksub + code[q + 1]];
+                s2 += lut[(q + 2) * _ksub + code[q + 2]];
+                s3 += lut[(q + 3) * _ksub + code[q + 3]];
+            }
+            for (; q < _m; ++q) {
+                s0 += lut[q * _ksub + code[q]];
+            }
+            return (s0 + s1) + (s2 + s3);
+        }
+        for (std::size_t q = 0; q < _m; ++q) {
+            sum += lut[q * _ksub + get_code(code, q)];
+        }
+        return sum;
+    }
+
+}  // namespace zircon
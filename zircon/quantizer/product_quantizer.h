@@ -0,0 +1,142 @@
+// Copyright 2023 The Elastic-AI Authors.
+// part of Elastic AI Search
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#ifndef ZIRCON_QUANTIZER_PRODUCT_QUANTIZER_H_
+#define ZIRCON_QUANTIZER_PRODUCT_QUANTIZER_H_
+
+#include <vector>
+#include "turbo/base/status.h"
+#include "turbo/meta/span.h"
+#include "zircon/core/metric_type.h"
+#include "zircon/quantizer/kmeans.h"
+
+namespace zircon {
+
+    class MemVectorStore;
+
+    /**
+     * @brief product quantizer, a vector is split into m sub vectors of
+     *        dimension / m floats, every sub vector is encoded as the id of
+     *        its nearest centroid of a k-means codebook of 2^nbits entries.
+     *        with nbits 8 a code is m bytes, with nbits 4 two sub quantizers
+     *        share one byte, the even one in the low nibble.
+     *        distances are computed asymmetrically, the float query against
+     *        every centroid once into a lookup table of m * ksub entries, a code
+     *        is then scored by m table lookups, see compute_lut and adc_distance.
+     */
+    class ProductQuantizer {
+    public:
+        ProductQuantizer() = default;
+
+        ~ProductQuantizer() = default;
+
+        /**
+         * @param dimension must be divisible by m.
+         * @param nbits 4 or 8. with 4 bits m is limited to 256 so the fast scan
+         *        uint16 accumulators do not overflow.
+         */
+        turbo::Status initialize(std::size_t dimension, std::size_t m, std::size_t nbits = 8);
+
+        /**
+         * @brief train the m codebooks from samples.
+         * @param samples n vectors of dimension floats, n not less than ksub.
+         */
+        turbo::Status train(turbo::Span<float> samples, const KMeansOption &option = KMeansOption());
+
+        /**
+         * @brief train from at most max_samples random alive vectors of a float store.
+         */
+        turbo::Status train(const MemVectorStore &store, std::size_t max_samples,
+                            const KMeansOption &option = KMeansOption());
+
+        [[nodiscard]] bool is_trained() const {
+            return _is_trained;
+        }
+
+        [[nodiscard]] std::size_t dimension() const {
+            return _dimension;
+        }
+
+        [[nodiscard]] std::size_t m() const {
+            return _m;
+        }
+
+        [[nodiscard]] std::size_t nbits() const {
+            return _nbits;
+        }
+
+        // centroids of every sub quantizer
+        [[nodiscard]] std::size_t ksub() const {
+            return _ksub;
+        }
+
+        // dimension of a sub vector
+        [[nodiscard]] std::size_t dsub() const {
+            return _dsub;
+        }
+
+        // bytes of one code
+        [[nodiscard]] std::size_t code_size() const {
+            return (_m * _nbits + 7) / 8;
+        }
+
+        // centroid id of the q-th sub quantizer in a code
+        [[nodiscard]] uint32_t get_code(const uint8_t *code, std::size_t q) const {
+            if (_nbits == 8) {
+                return code[q];
+            }
+            return (q & 1) ? (code[q >> 1] >> 4) : (code[q >> 1] & 0x0f);
+        }
+
+        void encode(const float *x, uint8_t *code) const;
+
+        void encode(const float *x, std::size_t n, uint8_t *codes) const;
+
+        void decode(const uint8_t *code, float *x) const;
+
+        /**
+         * @brief the lookup table of a query, lut[q * ksub + c] is the distance
+         *        between the q-th sub vector of the query and the c-th centroid
+         *        of the q-th codebook. the summed lookups have the VectorDistance
+         *        semantics, squared l2, -ip or 1 - ip for normalized cosine.
+         * @param lut m * ksub floats.
+         * @return invalid argument if the metric is not supported.
+         */
+        turbo::Status compute_lut(MetricType metric, const float *query, float *lut) const;
+
+        // sum of the table lookups of a code
+        [[nodiscard]] float adc_distance(const float *lut, const uint8_t *code) const;
+
+        // m * ksub * dsub floats, codebook by codebook
+        [[nodiscard]] const std::vector<float> &centroids() const {
+            return _centroids;
+        }
+
+        // restore trained codebooks, eg. from a snapshot
+        turbo::Status set_centroids(const std::vector<float> &centroids);
+
+    private:
+        std::size_t _dimension{0};
+        std::size_t _m{0};
+        std::size_t _nbits{0};
+        std::size_t _ksub{0};
+        std::size_t _dsub{0};
+        bool _is_trained{false};
+        std::vector<float> _centroids;
+    };
+
+}  // namespace zircon
+
+#endif  // ZIRCON_QUANTIZER_PRODUCT_QUANTIZER_H_
@@ -0,0 +1,217 @@
+// Copyright 2023 The Elastic-AI Authors.
+// part of Elastic AI Search
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#include "zircon/quantizer/scalar_quantizer.h"
+#include "zircon/utility/distance_dispatch.h"
+#include "zircon/utility/float16.h"
+#include "turbo/log/logging.h"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <limits>
+
+namespace zircon {
+
+    turbo::Status ScalarQuantizer::initialize(EncodingType type, std::size_t dimension) {
+        if (type != EncodingType::ENCODING_SQ8 && type != EncodingType::ENCODING_FP16 &&
+            type != EncodingType::ENCODING_BINARY) {
+            return turbo::invalid_argument_error("not a scalar quantizer encoding");
+        }
+        if (dimension == 0) {
+            return turbo::invalid_argument_error("dimension must be set for encoding");
+        }
+        _type = type;
+        _dimension = dimension;
+        _is_trained = _type != EncodingType::ENCODING_SQ8;
+        _vmin.clear();
+        _scale.clear();
+        if (_type == EncodingType::ENCODING_BINARY) {
+            // plain sign bits until trained
+            _vmin.assign(_dimension, 0.0f);
+            _scale.assign(_dimension, 1.0f);
+        }
+        return turbo::ok_status();
+    }
+
+    turbo::Status ScalarQuantizer::train(turbo::Span<float> samples) {
+        TLOG_CHECK(_dimension > 0, "should init be using");
+        if (_type == EncodingType::ENCODING_FP16) {
+            return turbo::ok_status();
+        }
+        if (samples.empty() || samples.size() % _dimension != 0) {
+            return turbo::invalid_argument_error("samples size {} is not n * dimension {}", samples.size(),
+                                                 _dimension);
+        }
+        const std::size_t n = samples.size() / _dimension;
+        if (_type == EncodingType::ENCODING_BINARY) {
+            std::vector<double> mean(_dimension, 0.0);
+            for (std::size_t j = 0; j < n; ++j) {
+                const float *x = samples.data() + j * _dimension;
+                for (std::size_t i = 0; i < _dimension; ++i) {
+                    mean[i] += x[i];
+                }
+            }
+            std::vector<double> dev(_dimension, 0.0);
+            for (std::size_t j = 0; j < n; ++j) {
+                const float *x = samples.data() + j * _dimension;
+                for (std::size_t i = 0; i < _dimension; ++i) {
+                    dev[i] += std::abs(x[i] - mean[i] / n);
+                }
+            }
+            std::vector<float> threshold(_dimension);
+            std::vector<float> scale(_dimension);
+            for (std::size_t i = 0; i < _dimension; ++i) {
+                threshold[i] = static_cast<float>(mean[i] / n);
+                scale[i] = static_cast<float>(dev[i] / n);
+            }
+            return set_range(threshold, scale);
+        }
+        std::vector<float> vmin(_dimension, std::numeric_limits<float>::max());
+        std::vector<float> vmax(_dimension, std::numeric_limits<float>::lowest());
+        for (std::size_t j = 0; j < n; ++j) {
+            const float *x = samples.data() + j * _dimension;
+            for (std::size_t i = 0; i < _dimension; ++i) {
+                vmin[i] = std::min(vmin[i], x[i]);
+                vmax[i] = std::max(vmax[i], x[i]);
+            }
+        }
+        std::vector<float> scale(_dimension);
+        for (std::size_t i = 0; i < _dimension; ++i) {
+            scale[i] = (vmax[i] - vmin[i]) / 255.0f;
+        }
+        return set_range(vmin, scale);
+    }
+
+    turbo::Status ScalarQuantizer::set_range(const std::vector<float> &vmin, const std::vector<float> &scale) {
+        if (_type != EncodingType::ENCODING_SQ8 && _type != EncodingType::ENCODING_BINARY) {
+            return turbo::invalid_argument_error("range only for sq8 and binary");
+        }
+        if (vmin.size() != _dimension || scale.size() != _dimension) {
+            return turbo::invalid_argument_error("range size not match dimension {}", _dimension);
+        }
+        _vmin = vmin;
+        _scale = scale;
+        _is_trained = true;
+        return turbo::ok_status();
+    }
+
+    std::size_t ScalarQuantizer::code_size() const {
+        switch (_type) {
+            case EncodingType::ENCODING_FP16:
+                return _dimension * sizeof(uint16_t);
+            case EncodingType::ENCODING_BINARY:
+                return (_dimension + 7) / 8;
+            default:
+                return _dimension;
+        }
+    }
+
+    void ScalarQuantizer::encode(const float *x, uint8_t *code) const {
+        TLOG_CHECK(_is_trained, "quantizer should be trained before encoding");
+        if (_type == EncodingType::ENCODING_FP16) {
+            auto *h = reinterpret_cast<uint16_t *>(code);
+            for (std::size_t i = 0; i < _dimension; ++i) {
+                h[i] = float_to_half(x[i]);
+            }
+            return;
+        }
+        if (_type == EncodingType::ENCODING_BINARY) {
+            std::memset(code, 0, code_size());
+            for (std::size_t i = 0; i < _dimension; ++i) {
+                code[i / 8] |= static_cast<uint8_t>(x[i] > _vmin[i]) << (i % 8);
+            }
+            return;
+        }
+        for (std::size_t i = 0; i < _dimension; ++i) {
+            if (_scale[i] <= 0.0f) {
+                code[i] = 0;
+                continue;
+            }
+            float v = std::nearbyint((x[i] - _vmin[i]) / _scale[i]);
+            code[i] = static_cast<uint8_t>(std::clamp(v, 0.0f, 255.0f));
+        }
+    }
+
+    void ScalarQuantizer::decode(const uint8_t *code, float *x) const {
+        TLOG_CHECK(_is_trained, "quantizer should be trained before decoding");
+        if (_type == EncodingType::ENCODING_FP16) {
+            auto *h = reinterpret_cast<const uint16_t *>(code);
+            for (std::size_t i = 0; i < _dimension; ++i) {
+                x[i] = half_to_float(h[i]);
+            }
+            return;
+        }
+        if (_type == EncodingType::ENCODING_BINARY) {
+            for (std::size_t i = 0; i < _dimension; ++i) {
+                x[i] = binary_value(code, i);
+            }
+            return;
+        }
+        for (std::size_t i = 0; i < _dimension; ++i) {
+            x[i] = _vmin[i] + static_cast<float>(code[i]) * _scale[i];
+        }
+    }
+
+    float ScalarQuantizer::l2(const float *query, const uint8_t *code) const {
+        auto &kernels = distance::distance_kernels();
+        if (_type == EncodingType::ENCODING_FP16) {
+            return kernels.fp16_l2(query, reinterpret_cast<const uint16_t *>(code), _dimension);
+        }
+        if (_type == EncodingType::ENCODING_BINARY) {
+            float sum = 0.0f;
+            for (std::size_t i = 0; i < _dimension; ++i) {
+                float d = query[i] - binary_value(code, i);
+                sum += d * d;
+            }
+            return sum;
+        }
+        return kernels.sq8_l2(query, code, _vmin.data(), _scale.data(), _dimension);
+    }
+
+    float ScalarQuantizer::ip(const float *query, const uint8_t *code) const {
+        auto &kernels = distance::distance_kernels();
+        if (_type == EncodingType::ENCODING_FP16) {
+            return kernels.fp16_ip(query, reinterpret_cast<const uint16_t *>(code), _dimension);
+        }
+        if (_type == EncodingType::ENCODING_BINARY) {
+            float sum = 0.0f;
+            for (std::size_t i = 0; i < _dimension; ++i) {
+                sum += query[i] * binary_value(code, i);
+            }
+            return sum;
+        }
+        return kernels.sq8_ip(query, code, _vmin.data(), _scale.data(), _dimension);
+    }
+
+    float ScalarQuantizer::hamming(const uint8_t *a, const uint8_t *b) const {
+        TLOG_CHECK(_type == EncodingType::ENCODING_BINARY, "hamming only for binary codes");
+        return distance::distance_kernels().hamming(a, b, code_size());
+    }
+
+    float ScalarQuantizer::distance(MetricType metric, const float *query, const uint8_t *code) const {
+        switch (metric) {
+            case MetricType::METRIC_L2:
+                return l2(query, code);
+            case MetricType::METRIC_IP:
+                return -ip(query, code);
+            case MetricType::METRIC_NORMALIZED_COSINE:
+                return 1.0f - ip(query, code);
+            default:
+                TLOG_CHECK(false, "metric not support by scalar quantizer");
+                return 0.0f;
+        }
+    }
+
+}  // namespace zircon
@@ -0,0 +1,116 @@
+// Copyright 2023 The Elastic-AI Authors.
+// part of Elastic AI Search
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#ifndef ZIRCON_QUANTIZER_SCALAR_QUANTIZER_H_
+#define ZIRCON_QUANTIZER_SCALAR_QUANTIZER_H_
+
+#include <vector>
+#include "turbo/base/status.h"
+#include "turbo/meta/span.h"
+#include "zircon/core/encoding_type.h"
+#include "zircon/core/metric_type.h"
+
+namespace zircon {
+
+    /**
+     * @brief per dimension scalar quantizer.
+     *        ENCODING_SQ8 map every dimension to one byte with the min/max of
+     *        that dimension trained from samples, x[i] ~ vmin[i] + code[i] * scale[i].
+     *        ENCODING_FP16 store every dimension as a half float, no training needed.
+     *        ENCODING_BINARY keep the sign of every dimension against a threshold
+     *        in one bit, bit i of byte i / 8. untrained the threshold is 0 and a
+     *        bit decode to +-1, trained it is the mean of the dimension and a bit
+     *        decode to mean +- the mean absolute deviation. the codes are 32 times
+     *        smaller than the floats, compared with hamming for a first pass.
+     *        distances are computed between a float query and a code directly,
+     *        without decoding the code to memory.
+     */
+    class ScalarQuantizer {
+    public:
+        ScalarQuantizer() = default;
+
+        ~ScalarQuantizer() = default;
+
+        turbo::Status initialize(EncodingType type, std::size_t dimension);
+
+        /**
+         * @brief train the per dimension min/max of sq8 or the thresholds of binary
+         *        from samples, nothing to do for fp16.
+         * @param samples n vectors of dimension floats, one after another.
+         */
+        turbo::Status train(turbo::Span<float> samples);
+
+        [[nodiscard]] bool is_trained() const {
+            return _is_trained;
+        }
+
+        [[nodiscard]] EncodingType encoding() const {
+            return _type;
+        }
+
+        [[nodiscard]] std::size_t dimension() const {
+            return _dimension;
+        }
+
+        // bytes of one code
+        [[nodiscard]] std::size_t code_size() const;
+
+        void encode(const float *x, uint8_t *code) const;
+
+        void decode(const uint8_t *code, float *x) const;
+
+        // squared l2 between a float query and a code
+        [[nodiscard]] float l2(const float *query, const uint8_t *code) const;
+
+        // inner product between a float query and a code
+        [[nodiscard]] float ip(const float *query, const uint8_t *code) const;
+
+        // bits differing between two binary codes, eg. an encoded query and a code
+        [[nodiscard]] float hamming(const uint8_t *a, const uint8_t *b) const;
+
+        /**
+         * @brief distance with the VectorDistance semantics, the smaller the closer.
+         * @param metric METRIC_L2, METRIC_IP or METRIC_NORMALIZED_COSINE.
+         */
+        [[nodiscard]] float distance(MetricType metric, const float *query, const uint8_t *code) const;
+
+        [[nodiscard]] const std::vector<float> &vmin() const {
+            return _vmin;
+        }
+
+        [[nodiscard]] const std::vector<float> &scale() const {
+            return _scale;
+        }
+
+        // restore a trained sq8 or binary quantizer, eg. from a snapshot
+        turbo::Status set_range(const std::vector<float> &vmin, const std::vector<float> &scale);
+
+    private:
+        // the decoded value of dimension i of a binary code
+        [[nodiscard]] float binary_value(const uint8_t *code, std::size_t i) const {
+            return (code[i / 8] >> (i % 8)) & 1u ? _vmin[i] + _scale[i] : _vmin[i] - _scale[i];
+        }
+
+    private:
+        EncodingType _type{EncodingType::ENCODING_NONE};
+        std::size_t _dimension{0};
+        bool _is_trained{false};
+        std::vector<float> _vmin;
+        std::vector<float> _scale;
+    };
+
+}  // namespace zircon
+
+#endif  // ZIRCON_QUANTIZER_SCALAR_QUANTIZER_H_
@@ -0,0 +1,173 @@
+// Copyright 2023 The Elastic-AI Authors.
+// part of Elastic AI Search
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#ifndef ZIRCON_STORE_BATCH_DIRECTORY_H_
+#define ZIRCON_STORE_BATCH_DIRECTORY_H_
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include "turbo/log/logging.h"
+#include "zircon/core/defines.h"
+#include "zircon/store/vector_batch.h"
+
+namespace zircon {
+
+    /**
+     * @brief directory of the vector batches of a store, with stable addresses.
+     *        the entries live in segments of growing size, segment s holds 2^s
+     *        entries and is never moved or freed before the directory, so an
+     *        entry, its location slots and its vectors keep their address while
+     *        the store grows. appending publishes the entry with a release store
+     *        of the size, readers index the directory without any lock.
+     *        appending is not thread safe, the store serialize the writers.
+     */
+    class BatchDirectory {
+    public:
+        struct Entry {
+            VectorBatch batch;
+            // vectors of the batch, nullptr once the memory is released
+            std::atomic<uint8_t *> base{nullptr};
+            // label of every slot, kUnknownLabel for not used or removed slots
+            std::unique_ptr<std::atomic<label_type>[]> labels;
+            // bit set for removed slots
+            std::unique_ptr<std::atomic<uint64_t>[]> tombstones;
+            // l2 norm of every slot, written with the vector, nullptr if the store keep no norms
+            std::unique_ptr<float[]> norms;
+        };
+
+        // 2^32 - 1 entries
+        static constexpr std::size_t kMaxSegments = 32;
+
+        BatchDirectory() = default;
+
+        BatchDirectory(const BatchDirectory &) = delete;
+
+        BatchDirectory &operator=(const BatchDirectory &) = delete;
+
+        ~BatchDirectory() {
+            for (auto &s: _segments) {
+                delete[] s.load(std::memory_order_relaxed);
+            }
+        }
+
+        void initialize(std::size_t batch_size, bool keep_norms = false) {
+            _batch_size = batch_size;
+            _keep_norms = keep_norms;
+        }
+
+        [[nodiscard]] bool keeps_norms() const {
+            return _keep_norms;
+        }
+
+        [[nodiscard]] std::size_t size() const {
+            return _size.load(std::memory_order_acquire);
+        }
+
+        [[nodiscard]] bool empty() const {
+            return size() == 0;
+        }
+
+        /**
+         * @brief append an entry holding vb, the slots are cleared.
+         * @return the new entry, its address never change.
+         */
+        Entry &append(VectorBatch &&vb) {
+            const auto bi = _size.load(std::memory_order_relaxed);
+            auto [s, offset] = locate(bi);
+            TLOG_CHECK(s < kMaxSegments, "batch directory overflow");
+            auto *segment = _segments[s].load(std::memory_order_relaxed);
+            if (segment == nullptr) {
+                segment = new Entry[std::size_t{1} << s];
+                _segments[s].store(segment, std::memory_order_release);
+            }
+            auto &e = segment[offset];
+            e.labels = std::make_unique<std::atomic<label_type>[]>(_batch_size);
+            e.tombstones = std::make_unique<std::atomic<uint64_t>[]>(words_per_batch());
+            if (_keep_norms) {
+                e.norms = std::make_unique<float[]>(_batch_size);
+            }
+            reset(e, std::move(vb));
+            _size.store(bi + 1, std::memory_order_release);
+            return e;
+        }
+
+        /**
+         * @brief give a released entry new memory, the slots are cleared.
+         *        readers must not use the entry until the store publishes
+         *        its locations again.
+         */
+        void reset(Entry &e, VectorBatch &&vb) {
+            for (std::size_t i = 0; i < _batch_size; ++i) {
+                e.labels[i].store(constants::kUnknownLabel, std::memory_order_relaxed);
+            }
+            for (std::size_t i = 0; i < words_per_batch(); ++i) {
+                e.tombstones[i].store(0, std::memory_order_relaxed);
+            }
+            if (e.norms != nullptr) {
+                std::fill(e.norms.get(), e.norms.get() + _batch_size, 0.0f);
+            }
+            e.batch = std::move(vb);
+            e.base.store(e.batch.data(), std::memory_order_release);
+        }
+
+        // free the vectors of the entry, the entry itself stays in place.
+        void release(Entry &e) {
+            e.base.store(nullptr, std::memory_order_release);
+            e.batch = VectorBatch();
+        }
+
+        [[nodiscard]] Entry &entry(std::size_t bi) {
+            auto [s, offset] = locate(bi);
+            return _segments[s].load(std::memory_order_acquire)[offset];
+        }
+
+        [[nodiscard]] const Entry &entry(std::size_t bi) const {
+            auto [s, offset] = locate(bi);
+            return _segments[s].load(std::memory_order_acquire)[offset];
+        }
+
+        [[nodiscard]] VectorBatch &operator[](std::size_t bi) {
+            return entry(bi).batch;
+        }
+
+        [[nodiscard]] const VectorBatch &operator[](std::size_t bi) const {
+            return entry(bi).batch;
+        }
+
+        [[nodiscard]] std::size_t words_per_batch() const {
+            return (_batch_size + 63) / 64;
+        }
+
+    private:
+        // segment and offset of the entry bi, segment s start at entry 2^s - 1
+        static std::pair<std::size_t, std::size_t> locate(std::size_t bi) {
+            const auto n = bi + 1;
+            const std::size_t s = 63 - __builtin_clzll(n);
+            return {s, n - (std::size_t{1} << s)};
+        }
+
+    private:
+        std::size_t _batch_size{0};
+        bool _keep_norms{false};
+        std::atomic<std::size_t> _size{0};
+        std::atomic<Entry *> _segments[kMaxSegments] = {};
+    };
+
+}  // namespace zircon
+
+#endif  // ZIRCON_STORE_BATCH_DIRECTORY_H_
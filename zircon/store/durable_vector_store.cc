@@ -0,0 +1,316 @@
+// Copyright 2023 The Elastic-AI Authors.
+// part of Elastic AI Search
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#include "zircon/store/durable_vector_store.h"
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <cstdio>
+#include <filesystem>
+#include <fcntl.h>
+#include <unistd.h>
+
+namespace zircon {
+
+    namespace {
+        constexpr const char *kTempSnapshot = "snapshot.tmp";
+
+        std::string snapshot_path(const std::string &dir, uint64_t lsn) {
+            char name[40];
+            std::snprintf(name, sizeof(name), "snapshot-%020llu.snap", static_cast<unsigned long long>(lsn));
+            return (std::filesystem::path(dir) / name).string();
+        }
+
+        // the snapshots of dir by lsn, the name is snapshot-<lsn>.snap
+        std::vector<std::pair<uint64_t, std::string>> list_snapshots(const std::string &dir) {
+            std::vector<std::pair<uint64_t, std::string>> out;
+            std::error_code ec;
+            for (auto &entry: std::filesystem::directory_iterator(dir, ec)) {
+                auto name = entry.path().filename().string();
+                unsigned long long lsn = 0;
+                char tail = 0;
+                if (name.size() == 34 && std::sscanf(name.c_str(), "snapshot-%20llu.sna%c", &lsn, &tail) == 2 &&
+                    tail == 'p') {
+                    out.emplace_back(lsn, entry.path().string());
+                }
+            }
+            std::sort(out.begin(), out.end());
+            return out;
+        }
+
+        // fsync a file or, with O_DIRECTORY, the entries of a directory
+        turbo::Status sync_path(const std::string &path, int flags) {
+            int fd = ::open(path.c_str(), O_RDONLY | flags);
+            if (fd < 0) {
+                return turbo::errno_to_status(errno, "open " + path);
+            }
+            auto rs = ::fsync(fd) == 0 ? turbo::ok_status() : turbo::errno_to_status(errno, "fsync " + path);
+            ::close(fd);
+            return rs;
+        }
+    }  // namespace
+
+    DurableVectorStore::~DurableVectorStore() {
+        (void) close();
+    }
+
+    turbo::Status DurableVectorStore::open(const std::string &dir, const VectorStoreOption &option,
+                                           const DurableOption &durable) {
+        TLOG_CHECK(!_is_available, "store already open");
+        _dir = dir;
+        _durable = durable;
+        std::error_code ec;
+        std::filesystem::create_directories(dir, ec);
+        if (ec) {
+            return turbo::errno_to_status(ec.value(), "create " + dir);
+        }
+        // a checkpoint that did not finish
+        std::filesystem::remove(std::filesystem::path(dir) / kTempSnapshot, ec);
+        auto snapshots = list_snapshots(dir);
+        turbo::Status rs;
+        if (snapshots.empty()) {
+            _checkpoint_lsn = 0;
+            rs = _store.initialize(option);
+        } else {
+            _checkpoint_lsn = snapshots.back().first;
+            rs = _store.load_snapshot(snapshots.back().second, durable.zero_copy);
+        }
+        if (!rs.ok()) {
+            return rs;
+        }
+        rs = _log.open(dir, durable.wal, _checkpoint_lsn);
+        if (!rs.ok()) {
+            return rs;
+        }
+        rs = _log.replay(_checkpoint_lsn, [this](const WalRecord &record) {
+            return apply(record);
+        });
+        if (!rs.ok()) {
+            return rs;
+        }
+        _checkpoint_bytes = 0;
+        _is_available = true;
+        if (durable.checkpoint_bytes > 0) {
+            _checkpointer_stop = false;
+            _checkpointer = std::thread([this]() {
+                std::unique_lock<std::mutex> lock(_checkpointer_mutex);
+                while (!_checkpointer_stop) {
+                    _checkpointer_cv.wait_for(lock, std::chrono::milliseconds(_durable.checkpoint_interval_ms));
+                    if (_checkpointer_stop) {
+                        break;
+                    }
+                    uint64_t since;
+                    {
+                        std::unique_lock<std::mutex> guard(_checkpoint_mutex);
+                        since = _log.appended_bytes() - _checkpoint_bytes;
+                    }
+                    if (since < _durable.checkpoint_bytes) {
+                        continue;
+                    }
+                    lock.unlock();
+                    auto r = checkpoint();
+                    {
+                        std::unique_lock<std::mutex> guard(_checkpoint_mutex);
+                        _checkpoint_status = r.status();
+                    }
+                    lock.lock();
+                }
+            });
+        }
+        return turbo::ok_status();
+    }
+
+    turbo::Status DurableVectorStore::apply(const WalRecord &record) {
+        switch (record.op) {
+            case WalOp::WAL_ADD:
+            case WalOp::WAL_SET: {
+                if (record.payload.size() != _store.input_byte_size()) {
+                    return turbo::data_loss_error("log record {} has {} bytes, the store take {}", record.lsn,
+                                                  record.payload.size(), _store.input_byte_size());
+                }
+                // the store only read the vector
+                auto vector = turbo::Span<uint8_t>(const_cast<uint8_t *>(record.payload.data()),
+                                                   record.payload.size());
+                // the snapshot may hold the record already, both are upserts
+                auto loc = _store.get_location(record.label);
+                if (loc.ok()) {
+                    _store.set_vector(loc.value(), vector);
+                    return turbo::ok_status();
+                }
+                return _store.add_vector(record.label, vector).status();
+            }
+            case WalOp::WAL_REMOVE:
+                // removed already if the snapshot holds the record
+                (void) _store.remove_vector(record.label);
+                return turbo::ok_status();
+        }
+        return turbo::data_loss_error("log record {} has an unknown op {}", record.lsn,
+                                      static_cast<uint32_t>(record.op));
+    }
+
+    turbo::ResultStatus<location_t> DurableVectorStore::add_vector(label_type label, turbo::Span<uint8_t> vector) {
+        TLOG_CHECK(_is_available, "should init be using");
+        if (vector.size() != _store.input_byte_size()) {
+            return turbo::invalid_argument_error("vector of {} bytes, the store take {}", vector.size(),
+                                                 _store.input_byte_size());
+        }
+        location_t loc;
+        uint64_t lsn;
+        {
+            std::shared_lock<std::shared_mutex> applying(_apply_lock);
+            LabelLockGuard guard(&_store, label);
+            auto r = _store.add_vector(label, vector);
+            if (!r.ok()) {
+                return r.status();
+            }
+            auto l = _log.append(WalOp::WAL_ADD, label, turbo::Span<const uint8_t>(vector.data(), vector.size()));
+            if (!l.ok()) {
+                return l.status();
+            }
+            loc = r.value();
+            lsn = l.value();
+        }
+        auto rs = _log.sync(lsn);
+        if (!rs.ok()) {
+            return rs;
+        }
+        return loc;
+    }
+
+    turbo::ResultStatus<location_t> DurableVectorStore::remove_vector(label_type label) {
+        TLOG_CHECK(_is_available, "should init be using");
+        location_t loc;
+        uint64_t lsn;
+        {
+            std::shared_lock<std::shared_mutex> applying(_apply_lock);
+            LabelLockGuard guard(&_store, label);
+            auto r = _store.remove_vector(label);
+            if (!r.ok()) {
+                return r.status();
+            }
+            auto l = _log.append(WalOp::WAL_REMOVE, label, turbo::Span<const uint8_t>());
+            if (!l.ok()) {
+                return l.status();
+            }
+            loc = r.value();
+            lsn = l.value();
+        }
+        auto rs = _log.sync(lsn);
+        if (!rs.ok()) {
+            return rs;
+        }
+        return loc;
+    }
+
+    turbo::Status DurableVectorStore::set_vector(label_type label, turbo::Span<uint8_t> vector) {
+        TLOG_CHECK(_is_available, "should init be using");
+        if (vector.size() != _store.input_byte_size()) {
+            return turbo::invalid_argument_error("vector of {} bytes, the store take {}", vector.size(),
+                                                 _store.input_byte_size());
+        }
+        uint64_t lsn;
+        {
+            std::shared_lock<std::shared_mutex> applying(_apply_lock);
+            LabelLockGuard guard(&_store, label);
+            auto loc = _store.get_location(label);
+            if (!loc.ok()) {
+                return loc.status();
+            }
+            _store.set_vector(loc.value(), vector);
+            auto l = _log.append(WalOp::WAL_SET, label, turbo::Span<const uint8_t>(vector.data(), vector.size()));
+            if (!l.ok()) {
+                return l.status();
+            }
+            lsn = l.value();
+        }
+        return _log.sync(lsn);
+    }
+
+    turbo::ResultStatus<uint64_t> DurableVectorStore::checkpoint() {
+        TLOG_CHECK(_is_available, "should init be using");
+        std::unique_lock<std::mutex> guard(_checkpoint_mutex);
+        uint64_t lsn;
+        uint64_t bytes;
+        {
+            // every mutation up to lsn is applied, the ones after run on while the snapshot is written
+            std::unique_lock<std::shared_mutex> lock(_apply_lock);
+            lsn = _log.last_lsn();
+            bytes = _log.appended_bytes();
+        }
+        if (lsn == _checkpoint_lsn) {
+            return lsn;
+        }
+        const auto temp = (std::filesystem::path(_dir) / kTempSnapshot).string();
+        auto rs = _store.save_snapshot(temp);
+        if (rs.ok()) {
+            rs = sync_path(temp, 0);
+        }
+        const auto path = snapshot_path(_dir, lsn);
+        if (rs.ok() && std::rename(temp.c_str(), path.c_str()) != 0) {
+            rs = turbo::errno_to_status(errno, "rename " + temp);
+        }
+        if (rs.ok()) {
+            rs = sync_path(_dir, O_DIRECTORY);
+        }
+        if (!rs.ok()) {
+            return rs;
+        }
+        // the older snapshots and the log they need are no longer used, a
+        // mapped snapshot stays readable once removed.
+        for (auto &s: list_snapshots(_dir)) {
+            if (s.first < lsn) {
+                std::error_code ec;
+                std::filesystem::remove(s.second, ec);
+            }
+        }
+        _checkpoint_lsn = lsn;
+        _checkpoint_bytes = bytes;
+        rs = _log.purge(lsn);
+        if (!rs.ok()) {
+            return rs;
+        }
+        return lsn;
+    }
+
+    void DurableVectorStore::stop_checkpoints() {
+        std::thread checkpointer;
+        {
+            std::unique_lock<std::mutex> lock(_checkpointer_mutex);
+            _checkpointer_stop = true;
+            checkpointer = std::move(_checkpointer);
+        }
+        _checkpointer_cv.notify_all();
+        if (checkpointer.joinable()) {
+            checkpointer.join();
+        }
+    }
+
+    turbo::Status DurableVectorStore::close() {
+        stop_checkpoints();
+        _is_available = false;
+        return _log.close();
+    }
+
+    uint64_t DurableVectorStore::checkpoint_lsn() const {
+        std::unique_lock<std::mutex> lock(_checkpoint_mutex);
+        return _checkpoint_lsn;
+    }
+
+    turbo::Status DurableVectorStore::checkpoint_status() const {
+        std::unique_lock<std::mutex> lock(_checkpoint_mutex);
+        return _checkpoint_status;
+    }
+
+}  // namespace zircon
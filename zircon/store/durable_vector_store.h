@@ -0,0 +1,125 @@
+// Copyright 2023 The Elastic-AI Authors.
+// part of Elastic AI Search
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#ifndef ZIRCON_STORE_DURABLE_VECTOR_STORE_H_
+#define ZIRCON_STORE_DURABLE_VECTOR_STORE_H_
+
+#include <condition_variable>
+#include <mutex>
+#include <shared_mutex>
+#include <string>
+#include <thread>
+#include "zircon/store/mem_vector_store.h"
+#include "zircon/store/write_ahead_log.h"
+
+namespace zircon {
+
+    struct DurableOption {
+        WalOption wal;
+        // a background checkpoint runs once the log grew by it since the last
+        // one, 0 disables the background checkpoints.
+        uint64_t checkpoint_bytes{1ULL << 30};
+        // how often the background checkpoint check the log size
+        uint32_t checkpoint_interval_ms{10000};
+        // map the snapshot on open, see MemVectorStore::load_snapshot
+        bool zero_copy{true};
+    };
+
+    /**
+     * @brief a MemVectorStore kept in a directory as its last snapshot,
+     *        snapshot-<lsn>.snap, and the write ahead log of the mutations
+     *        after it. a mutation is applied to the store, appended to the log
+     *        and acknowledged once the log is synced, the writers syncing at
+     *        the same time share one fdatasync. open loads the snapshot and
+     *        replays the log after its lsn, a checkpoint writes a new snapshot
+     *        and purges the log it covers, from a background thread once the
+     *        log grew by checkpoint_bytes.
+     *        the vectors are read through store(), all the writes must go
+     *        through this class.
+     */
+    class DurableVectorStore {
+    public:
+        DurableVectorStore() = default;
+
+        ~DurableVectorStore();
+
+        /**
+         * @brief open the store of dir, created if missing. option is used for
+         *        a new store only, a store with a snapshot keeps the option of it.
+         */
+        turbo::Status open(const std::string &dir, const VectorStoreOption &option,
+                           const DurableOption &durable = DurableOption());
+
+        turbo::ResultStatus<location_t> add_vector(label_type label, turbo::Span<uint8_t> vector);
+
+        turbo::ResultStatus<location_t> remove_vector(label_type label);
+
+        // replace the vector of a label, not found if it is not in the store
+        turbo::Status set_vector(label_type label, turbo::Span<uint8_t> vector);
+
+        /**
+         * @brief snapshot the store at the last lsn of the log and purge the log
+         *        up to it. writers wait only while the lsn is taken, the records
+         *        after it may be in the snapshot too, the replay applies them
+         *        as upserts and idempotent removes.
+         * @return the lsn of the snapshot.
+         */
+        turbo::ResultStatus<uint64_t> checkpoint();
+
+        // stop the background checkpoints and close the log, the store is kept in memory
+        turbo::Status close();
+
+        [[nodiscard]] const MemVectorStore &store() const {
+            return _store;
+        }
+
+        [[nodiscard]] const WriteAheadLog &log() const {
+            return _log;
+        }
+
+        [[nodiscard]] uint64_t checkpoint_lsn() const;
+
+        // the result of the last background checkpoint
+        [[nodiscard]] turbo::Status checkpoint_status() const;
+
+    private:
+        turbo::Status apply(const WalRecord &record);
+
+        void stop_checkpoints();
+
+    private:
+        bool _is_available{false};
+        std::string _dir;
+        DurableOption _durable;
+        MemVectorStore _store;
+        WriteAheadLog _log;
+        // shared by a mutation while it is applied and appended, exclusive while a checkpoint takes its lsn
+        std::shared_mutex _apply_lock;
+        // one checkpoint at a time
+        mutable std::mutex _checkpoint_mutex;
+        // guard by _checkpoint_mutex
+        uint64_t _checkpoint_lsn{0};
+        uint64_t _checkpoint_bytes{0};
+        turbo::Status _checkpoint_status;
+
+        std::mutex _checkpointer_mutex;
+        std::condition_variable _checkpointer_cv;
+        bool _checkpointer_stop{false};
+        std::thread _checkpointer;
+    };
+
+}  // namespace zircon
+
+#endif  // ZIRCON_STORE_DURABLE_VECTOR_STORE_H_
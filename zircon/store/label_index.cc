@@ -0,0 +1,142 @@
+// Copyright 2023 The Elastic-AI Authors.
+// part of Elastic AI Search
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#include "zircon/store/label_index.h"
+#include <algorithm>
+#include "turbo/log/logging.h"
+#include "zircon/utility/metrics.h"
+
+namespace zircon {
+
+    namespace {
+        // the contended waits of the shard locks of every store
+        LatencyHistogram &lock_wait() {
+            static auto &wait = MetricsRegistry::global().histogram("zircon_store_label_lock_wait_ns",
+                                                                    "wait for a label shard lock, contended only");
+            return wait;
+        }
+    }  // namespace
+
+    LabelIndex::LabelIndex(std::size_t nshards) {
+        std::size_t n = 1;
+        while (n < nshards) {
+            n <<= 1;
+        }
+        _mask = n - 1;
+        _shards = std::make_unique<Shard[]>(n);
+    }
+
+    turbo::ResultStatus<location_t> LabelIndex::find(label_type label) const {
+        auto &s = shard_of(label);
+        std::shared_lock<std::shared_mutex> lock(s.mutex, std::defer_lock);
+        lock_timed(lock, lock_wait());
+        auto itr = s.map.find(label);
+        if (itr == s.map.end()) {
+            return turbo::not_found_error("label {} not found", label);
+        }
+        return itr->second;
+    }
+
+    bool LabelIndex::contains(label_type label) const {
+        auto &s = shard_of(label);
+        std::shared_lock<std::shared_mutex> lock(s.mutex, std::defer_lock);
+        lock_timed(lock, lock_wait());
+        return s.map.find(label) != s.map.end();
+    }
+
+    std::size_t LabelIndex::find_batch(turbo::Span<const label_type> labels, turbo::Span<location_t> out) const {
+        TLOG_CHECK(out.size() >= labels.size());
+        const std::size_t n = labels.size();
+        if (n == 0) {
+            return 0;
+        }
+        if (n == 1) {
+            auto rs = find(labels[0]);
+            out[0] = rs.ok() ? rs.value() : constants::kUnknownLocation;
+            return rs.ok() ? 1 : 0;
+        }
+        // counting sort of the positions by shard
+        const std::size_t nshards = num_shards();
+        std::vector<uint32_t> begin(nshards + 1, 0);
+        std::vector<uint32_t> shard_ids(n);
+        for (std::size_t i = 0; i < n; ++i) {
+            shard_ids[i] = static_cast<uint32_t>(shard_index(labels[i]));
+            ++begin[shard_ids[i] + 1];
+        }
+        for (std::size_t s = 0; s < nshards; ++s) {
+            begin[s + 1] += begin[s];
+        }
+        std::vector<uint32_t> order(n);
+        {
+            std::vector<uint32_t> fill(begin.begin(), begin.end() - 1);
+            for (std::size_t i = 0; i < n; ++i) {
+                order[fill[shard_ids[i]]++] = static_cast<uint32_t>(i);
+            }
+        }
+        std::size_t found = 0;
+        for (std::size_t s = 0; s < nshards; ++s) {
+            if (begin[s] == begin[s + 1]) {
+                continue;
+            }
+            auto &shard = _shards[s];
+            std::shared_lock<std::shared_mutex> lock(shard.mutex, std::defer_lock);
+            lock_timed(lock, lock_wait());
+            for (auto k = begin[s]; k < begin[s + 1]; ++k) {
+                const auto i = order[k];
+                auto itr = shard.map.find(labels[i]);
+                if (itr == shard.map.end()) {
+                    out[i] = constants::kUnknownLocation;
+                } else {
+                    out[i] = itr->second;
+                    ++found;
+                }
+            }
+        }
+        return found;
+    }
+
+    std::vector<std::unique_lock<std::shared_mutex>>
+    LabelIndex::lock_shards(turbo::Span<const label_type> labels) {
+        std::vector<bool> used(num_shards(), false);
+        for (auto label: labels) {
+            used[shard_index(label)] = true;
+        }
+        std::vector<std::unique_lock<std::shared_mutex>> locks;
+        for (std::size_t s = 0; s < used.size(); ++s) {
+            if (used[s]) {
+                locks.emplace_back(_shards[s].mutex, std::defer_lock);
+                lock_timed(locks.back(), lock_wait());
+            }
+        }
+        return locks;
+    }
+
+    void LabelIndex::reserve(std::size_t n) {
+        const auto per_shard = n / num_shards() + 1;
+        for (std::size_t s = 0; s < num_shards(); ++s) {
+            _shards[s].map.reserve(per_shard);
+        }
+    }
+
+    std::size_t LabelIndex::size() const {
+        std::size_t n = 0;
+        for (std::size_t s = 0; s < num_shards(); ++s) {
+            std::shared_lock<std::shared_mutex> lock(_shards[s].mutex);
+            n += _shards[s].map.size();
+        }
+        return n;
+    }
+
+}  // namespace zircon
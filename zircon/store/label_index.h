@@ -0,0 +1,106 @@
+// Copyright 2023 The Elastic-AI Authors.
+// part of Elastic AI Search
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#ifndef ZIRCON_STORE_LABEL_INDEX_H_
+#define ZIRCON_STORE_LABEL_INDEX_H_
+
+#include <cstddef>
+#include <memory>
+#include <mutex>
+#include <shared_mutex>
+#include <vector>
+#include "turbo/container/flat_hash_map.h"
+#include "turbo/meta/span.h"
+#include "turbo/base/status.h"
+#include "zircon/core/defines.h"
+
+namespace zircon {
+
+    /**
+     * @brief label to location map split in shards by a hash of the label, every
+     *        shard with its own lock, so lookups and writes of labels of different
+     *        shards never wait on each other. the lookups lock the shard shared.
+     *        writers that must keep a shard consistent with other state lock it
+     *        themselves with lock_shards / shard_of and use the map of the shard,
+     *        several shards are always locked in ascending index order.
+     */
+    class LabelIndex {
+    public:
+        static constexpr std::size_t kDefaultShards = 64;
+
+        struct alignas(64) Shard {
+            mutable std::shared_mutex mutex;
+            // guard by mutex
+            turbo::flat_hash_map<label_type, location_t> map;
+        };
+
+        // nshards is rounded up to a power of two
+        explicit LabelIndex(std::size_t nshards = kDefaultShards);
+
+        [[nodiscard]] std::size_t num_shards() const {
+            return _mask + 1;
+        }
+
+        [[nodiscard]] std::size_t shard_index(label_type label) const {
+            // the maps hash the label too, take the bits they use the least
+            return static_cast<std::size_t>((static_cast<uint64_t>(label) * 0x9e3779b97f4a7c15ULL) >> 40) & _mask;
+        }
+
+        [[nodiscard]] Shard &shard(std::size_t i) {
+            return _shards[i];
+        }
+
+        [[nodiscard]] Shard &shard_of(label_type label) {
+            return _shards[shard_index(label)];
+        }
+
+        [[nodiscard]] const Shard &shard_of(label_type label) const {
+            return _shards[shard_index(label)];
+        }
+
+        // not found if the label is not in the index.
+        [[nodiscard]] turbo::ResultStatus<location_t> find(label_type label) const;
+
+        [[nodiscard]] bool contains(label_type label) const;
+
+        /**
+         * @brief resolve a whole set of labels, every shard is locked once.
+         *        out[i] is the location of labels[i], constants::kUnknownLocation
+         *        if it is not in the index.
+         * @return the number of labels found.
+         */
+        std::size_t find_batch(turbo::Span<const label_type> labels, turbo::Span<location_t> out) const;
+
+        /**
+         * @brief lock exclusive the shards holding labels, in ascending order.
+         * @return the locks, released when destroyed.
+         */
+        [[nodiscard]] std::vector<std::unique_lock<std::shared_mutex>>
+        lock_shards(turbo::Span<const label_type> labels);
+
+        // for the owner before it is shared, no lock is taken
+        void reserve(std::size_t n);
+
+        // locks every shard in turn
+        [[nodiscard]] std::size_t size() const;
+
+    private:
+        std::size_t _mask{0};
+        std::unique_ptr<Shard[]> _shards;
+    };
+
+}  // namespace zircon
+
+#endif  // ZIRCON_STORE_LABEL_INDEX_H_
@@ -13,34 +13,393 @@
 //
 
 #include "zircon/store/mem_vector_store.h"
+#include <algorithm>
+#include <chrono>
+#include <cstddef>
 #include "turbo/log/logging.h"
 #include "turbo/times/stop_watcher.h"
+#include "zircon/utility/metrics.h"
+#include "zircon/utility/primitive_distance.h"
 
 namespace zircon {
 
+    namespace {
+        // shared by all the stores, the label lock wait is recorded by LabelIndex too
+        struct StoreMetrics {
+            MetricCounter &batch_allocations;
+            MetricCounter &batch_bytes;
+            LatencyHistogram &meta_lock_wait;
+            LatencyHistogram &label_lock_wait;
+        };
+
+        StoreMetrics &store_metrics() {
+            static StoreMetrics metrics{
+                    MetricsRegistry::global().counter("zircon_store_batch_allocations", "vector batches allocated"),
+                    MetricsRegistry::global().counter("zircon_store_batch_bytes", "bytes of the batches allocated"),
+                    MetricsRegistry::global().histogram("zircon_store_meta_lock_wait_ns",
+                                                        "wait for the meta lock of a store, contended only"),
+                    MetricsRegistry::global().histogram("zircon_store_label_lock_wait_ns",
+                                                        "wait for a label shard lock, contended only")};
+            return metrics;
+        }
+
+        // "ZRCNSNAP"
+        constexpr uint64_t kSnapshotMagic = 0x50414e534e43525aULL;
+        // version 1 has no norms, its header ends before norms_offset, see kSnapshotHeaderSizeV1
+        constexpr uint32_t kSnapshotVersion = 2;
+        constexpr std::size_t kSnapshotAlign = Allocator::alignment;
+
+        struct SnapshotHeader {
+            uint64_t magic;
+            uint32_t version;
+            uint32_t encoding;
+            uint32_t dimension;
+            uint32_t vector_byte_size;
+            uint32_t batch_size;
+            uint32_t enable_replace_vacant;
+            uint64_t max_elements;
+            uint64_t current_index;
+            uint64_t deleted_size;
+            uint64_t nbatches;
+            // bytes of one batch block, padded to kSnapshotAlign
+            uint64_t batch_stride;
+            // vmin then scale, dimension floats each, 0 if not sq8
+            uint64_t quantizer_offset;
+            // current_index uint64 labels
+            uint64_t labels_offset;
+            // (current_index + 63) / 64 uint64 words
+            uint64_t tombstones_offset;
+            uint64_t batches_offset;
+            uint64_t file_size;
+            // current_index floats, 0 without keep_norms
+            uint64_t norms_offset;
+            // kSnapshotKeepNorms | kSnapshotNormalize
+            uint32_t flags;
+        };
+
+        constexpr uint32_t kSnapshotKeepNorms = 1;
+        constexpr uint32_t kSnapshotNormalize = 2;
+
+        constexpr std::size_t align_up(std::size_t n) {
+            return (n + kSnapshotAlign - 1) / kSnapshotAlign * kSnapshotAlign;
+        }
+
+        constexpr std::size_t kSnapshotHeaderSize = align_up(sizeof(SnapshotHeader));
+        // the first section of a version 1 file starts right after its padded header,
+        // where norms_offset and flags are in version 2
+        constexpr std::size_t kSnapshotHeaderSizeV1 = align_up(offsetof(SnapshotHeader, norms_offset));
+
+        turbo::Status write_padding(turbo::SequentialWriteFile &file, std::size_t written) {
+            static const char zeros[kSnapshotAlign] = {};
+            auto pad = align_up(written) - written;
+            if (pad == 0) {
+                return turbo::ok_status();
+            }
+            return file.write(zeros, pad);
+        }
+    }  // namespace
+
     turbo::Status MemVectorStore::initialize(VectorStoreOption op) {
         _option = op;
-        _lid_to_label.resize(_option.max_elements, constants::kUnknownLabel);
+        if (is_encoded()) {
+            auto rs = _quantizer.initialize(_option.encoding, _option.dimension);
+            if (!rs.ok()) {
+                return rs;
+            }
+            // keep every slot aligned for the simd kernels
+            constexpr std::size_t align = turbo::simd::default_arch::alignment();
+            _option.vector_byte_size = static_cast<uint32_t>((_quantizer.code_size() + align - 1) / align * align);
+        }
+        if ((_option.keep_norms || _option.normalize) &&
+            (is_encoded() || _option.dimension == 0 || _option.vector_byte_size != _option.dimension * sizeof(float))) {
+            return turbo::invalid_argument_error("norms need a float store of the dimension");
+        }
+        _data.initialize(_option.batch_size, _option.keep_norms);
         reserve_impl(_option.max_elements);
         _is_available = true;
         return turbo::ok_status();
     }
 
+    MemVectorStore::~MemVectorStore() {
+        stop_compaction();
+    }
+
+    turbo::Status MemVectorStore::train_quantizer(turbo::Span<float> samples) {
+        TLOG_CHECK(_is_available, "should init be using");
+        if (!is_encoded()) {
+            return turbo::failed_precondition_error("store is not encoded");
+        }
+        return _quantizer.train(samples);
+    }
+
     void MemVectorStore::reset_max_elements(uint32_t max_size) {
         TLOG_CHECK(_is_available, "should init be using");
         std::unique_lock<std::shared_mutex> lm(_meta_lock);
         TLOG_CHECK(_option.max_elements < max_size);
-        _lid_to_label.resize(max_size, constants::kUnknownLabel);
+        // the batch directory grows in place, nothing is copied
         _option.max_elements = max_size;
     }
 
+    bool MemVectorStore::is_tombstoned(std::size_t loc) const {
+        const auto si = loc % _option.batch_size;
+        auto word = entry_of(loc).tombstones[si / 64].load(std::memory_order_acquire);
+        return (word >> (si % 64)) & 1u;
+    }
+
+    void MemVectorStore::set_tombstone(std::size_t loc) {
+        const auto si = loc % _option.batch_size;
+        entry_of(loc).tombstones[si / 64].fetch_or(uint64_t{1} << (si % 64), std::memory_order_release);
+    }
+
+    void MemVectorStore::clear_tombstone(std::size_t loc) {
+        const auto si = loc % _option.batch_size;
+        entry_of(loc).tombstones[si / 64].fetch_and(~(uint64_t{1} << (si % 64)), std::memory_order_release);
+    }
 
-    const std::vector<VectorBatch> &MemVectorStore::vector_batch() const {
+    turbo::Status MemVectorStore::save_snapshot(const std::string &path) const {
+        TLOG_CHECK(_is_available, "should init be using");
+        // no writer may change the metadata while it is saved
+        std::unique_lock<std::shared_mutex> lm(_meta_lock);
+        const std::size_t n = _current_idx.load();
+        SnapshotHeader header{};
+        header.magic = kSnapshotMagic;
+        header.version = kSnapshotVersion;
+        header.encoding = static_cast<uint32_t>(_option.encoding);
+        header.dimension = static_cast<uint32_t>(_option.dimension);
+        header.vector_byte_size = static_cast<uint32_t>(_option.vector_byte_size);
+        header.batch_size = static_cast<uint32_t>(_option.batch_size);
+        header.enable_replace_vacant = _option.enable_replace_vacant ? 1 : 0;
+        header.max_elements = _option.max_elements;
+        header.current_index = n;
+        header.deleted_size = _deleted_size.load();
+        header.nbatches = (n + _option.batch_size - 1) / _option.batch_size;
+        header.batch_stride = align_up(static_cast<std::size_t>(_option.batch_size) * _option.vector_byte_size);
+        const bool has_range = _option.encoding == EncodingType::ENCODING_SQ8 ||
+                               _option.encoding == EncodingType::ENCODING_BINARY;
+        std::size_t offset = kSnapshotHeaderSize;
+        header.quantizer_offset = has_range ? offset : 0;
+        if (has_range) {
+            offset += align_up(2 * _option.dimension * sizeof(float));
+        }
+        header.labels_offset = offset;
+        offset += align_up(n * sizeof(uint64_t));
+        header.tombstones_offset = offset;
+        const std::size_t nwords = (n + 63) / 64;
+        offset += align_up(nwords * sizeof(uint64_t));
+        header.norms_offset = _option.keep_norms ? offset : 0;
+        if (_option.keep_norms) {
+            offset += align_up(n * sizeof(float));
+        }
+        header.flags = (_option.keep_norms ? kSnapshotKeepNorms : 0) | (_option.normalize ? kSnapshotNormalize : 0);
+        header.batches_offset = offset;
+        offset += header.nbatches * header.batch_stride;
+        header.file_size = offset;
+
+        turbo::SequentialWriteFile file;
+        auto rs = file.open(path);
+        if (!rs.ok()) {
+            return rs;
+        }
+        rs = file.write(reinterpret_cast<const char *>(&header), sizeof(header));
+        if (rs.ok()) {
+            rs = write_padding(file, sizeof(header));
+        }
+        if (rs.ok() && has_range) {
+            auto bytes = _option.dimension * sizeof(float);
+            rs = file.write(reinterpret_cast<const char *>(_quantizer.vmin().data()), bytes);
+            if (rs.ok()) {
+                rs = file.write(reinterpret_cast<const char *>(_quantizer.scale().data()), bytes);
+            }
+            if (rs.ok()) {
+                rs = write_padding(file, 2 * bytes);
+            }
+        }
+        // labels and tombstones go through a small buffer, the slots are atomics
+        constexpr std::size_t kChunk = 4096;
+        std::vector<uint64_t> buf(kChunk);
+        for (std::size_t i = 0; rs.ok() && i < n; i += kChunk) {
+            auto cnt = std::min(kChunk, n - i);
+            for (std::size_t j = 0; j < cnt; ++j) {
+                buf[j] = entry_of(i + j).labels[(i + j) % _option.batch_size].load(std::memory_order_relaxed);
+            }
+            rs = file.write(reinterpret_cast<const char *>(buf.data()), cnt * sizeof(uint64_t));
+        }
+        if (rs.ok()) {
+            rs = write_padding(file, n * sizeof(uint64_t));
+        }
+        for (std::size_t i = 0; rs.ok() && i < nwords; i += kChunk) {
+            auto cnt = std::min(kChunk, nwords - i);
+            // the words of the file span the whole store, the batch size need not be a multiple of 64
+            for (std::size_t j = 0; j < cnt; ++j) {
+                uint64_t word = 0;
+                const auto first = (i + j) * 64;
+                const auto last = std::min(first + 64, n);
+                for (auto loc = first; loc < last; ++loc) {
+                    word |= static_cast<uint64_t>(is_tombstoned(loc)) << (loc - first);
+                }
+                buf[j] = word;
+            }
+            rs = file.write(reinterpret_cast<const char *>(buf.data()), cnt * sizeof(uint64_t));
+        }
+        if (rs.ok()) {
+            rs = write_padding(file, nwords * sizeof(uint64_t));
+        }
+        // the norms of a batch are contiguous, written a batch at a time
+        for (std::size_t b = 0; rs.ok() && _option.keep_norms && b < header.nbatches; ++b) {
+            auto cnt = std::min<std::size_t>(_option.batch_size, n - b * _option.batch_size);
+            rs = file.write(reinterpret_cast<const char *>(_data.entry(b).norms.get()), cnt * sizeof(float));
+        }
+        if (rs.ok() && _option.keep_norms) {
+            rs = write_padding(file, n * sizeof(float));
+        }
+        // whole blocks, the free tail of the last batch is used for adds after load
+        const std::size_t block_bytes = static_cast<std::size_t>(_option.batch_size) * _option.vector_byte_size;
+        for (std::size_t b = 0; rs.ok() && b < header.nbatches; ++b) {
+            const auto *base = _data.entry(b).base.load(std::memory_order_acquire);
+            rs = file.write(reinterpret_cast<const char *>(base), block_bytes);
+            if (rs.ok()) {
+                rs = write_padding(file, block_bytes);
+            }
+        }
+        if (rs.ok()) {
+            rs = file.flush();
+        }
+        file.close();
+        return rs;
+    }
+
+    turbo::Status MemVectorStore::load_snapshot(const std::string &path, bool zero_copy) {
+        TLOG_CHECK(!_is_available, "load snapshot into a fresh store");
+        auto mapping = std::make_unique<MappedFile>();
+        auto rs = mapping->open(path);
+        if (!rs.ok()) {
+            return rs;
+        }
+        if (mapping->size() < kSnapshotHeaderSizeV1) {
+            return turbo::data_loss_error("snapshot {} too small", path);
+        }
+        SnapshotHeader header{};
+        std::memcpy(&header, mapping->data(), std::min(sizeof(header), mapping->size()));
+        if (header.magic != kSnapshotMagic) {
+            return turbo::data_loss_error("{} is not a snapshot", path);
+        }
+        if (header.version == 0 || header.version > kSnapshotVersion) {
+            return turbo::unimplemented_error("snapshot version {} not supported", header.version);
+        }
+        if (header.version < 2) {
+            // those bytes are the first section of a version 1 file
+            header.norms_offset = 0;
+            header.flags = 0;
+        } else if (mapping->size() < kSnapshotHeaderSize) {
+            return turbo::data_loss_error("snapshot {} too small", path);
+        }
+        const std::size_t n = header.current_index;
+        const std::size_t nwords = (n + 63) / 64;
+        const std::size_t block_bytes = static_cast<std::size_t>(header.batch_size) * header.vector_byte_size;
+        if (header.file_size != mapping->size() || header.batch_size == 0 || n > header.max_elements ||
+            header.deleted_size > n || header.nbatches != (n + header.batch_size - 1) / header.batch_size ||
+            header.batch_stride != align_up(block_bytes) ||
+            header.labels_offset + n * sizeof(uint64_t) > header.tombstones_offset ||
+            header.tombstones_offset + nwords * sizeof(uint64_t) > header.batches_offset ||
+            header.batches_offset + header.nbatches * header.batch_stride > header.file_size ||
+            header.batches_offset % kSnapshotAlign != 0) {
+            return turbo::data_loss_error("snapshot {} is corrupted", path);
+        }
+        const bool keep_norms = (header.flags & kSnapshotKeepNorms) != 0;
+        if (keep_norms && (header.norms_offset < header.tombstones_offset + nwords * sizeof(uint64_t) ||
+                           header.norms_offset + n * sizeof(float) > header.batches_offset)) {
+            return turbo::data_loss_error("snapshot {} is corrupted", path);
+        }
+
+        VectorStoreOption op;
+        op.batch_size = header.batch_size;
+        op.max_elements = header.max_elements;
+        op.vector_byte_size = header.vector_byte_size;
+        op.enable_replace_vacant = header.enable_replace_vacant != 0;
+        op.encoding = static_cast<EncodingType>(header.encoding);
+        op.dimension = header.dimension;
+        op.keep_norms = keep_norms;
+        op.normalize = (header.flags & kSnapshotNormalize) != 0;
+        _option = op;
+        if (is_encoded()) {
+            rs = _quantizer.initialize(_option.encoding, _option.dimension);
+            if (!rs.ok()) {
+                return rs;
+            }
+            if (_option.encoding == EncodingType::ENCODING_SQ8 || _option.encoding == EncodingType::ENCODING_BINARY) {
+                auto bytes = _option.dimension * sizeof(float);
+                if (header.quantizer_offset == 0 || header.quantizer_offset + 2 * bytes > header.labels_offset) {
+                    return turbo::data_loss_error("snapshot {} is corrupted", path);
+                }
+                const auto *range = reinterpret_cast<const float *>(mapping->data() + header.quantizer_offset);
+                std::vector<float> vmin(range, range + _option.dimension);
+                std::vector<float> scale(range + _option.dimension, range + 2 * _option.dimension);
+                rs = _quantizer.set_range(vmin, scale);
+                if (!rs.ok()) {
+                    return rs;
+                }
+            }
+        }
+
+        _data.initialize(_option.batch_size, _option.keep_norms);
+        const auto *labels = reinterpret_cast<const uint64_t *>(mapping->data() + header.labels_offset);
+        const auto *tombstones = reinterpret_cast<const uint64_t *>(mapping->data() + header.tombstones_offset);
+        _label_index.reserve(n - header.deleted_size);
+        for (std::size_t i = 0; i < n; ++i) {
+            if (labels[i] != constants::kUnknownLabel) {
+                _label_index.shard_of(labels[i]).map[labels[i]] = static_cast<location_t>(i);
+            }
+        }
+        for (std::size_t i = 0; i < nwords; ++i) {
+            for (auto w = tombstones[i]; w != 0; w &= w - 1) {
+                _deleted_map.add(static_cast<uint32_t>(i * 64 + __builtin_ctzll(w)));
+            }
+        }
+        for (std::size_t b = 0; b < header.nbatches; ++b) {
+            auto *block = mapping->data() + header.batches_offset + b * header.batch_stride;
+            auto ndim = std::min<std::size_t>(header.batch_size, n - b * header.batch_size);
+            VectorBatch vb;
+            if (zero_copy) {
+                vb.init_external(block, _option.vector_byte_size, _option.batch_size, ndim);
+            } else {
+                auto r = vb.init(_option.vector_byte_size, _option.batch_size, _option.numa_node);
+                if (!r.ok()) {
+                    return r;
+                }
+                std::memcpy(vb.data(), block, block_bytes);
+                vb.resize(ndim);
+            }
+            auto &e = _data.append(std::move(vb));
+            if (keep_norms) {
+                // copied even with zero copy, the norms are small and written in place
+                const auto *norms = reinterpret_cast<const float *>(mapping->data() + header.norms_offset);
+                std::memcpy(e.norms.get(), norms + b * header.batch_size, ndim * sizeof(float));
+            }
+            for (std::size_t si = 0; si < ndim; ++si) {
+                const auto loc = b * header.batch_size + si;
+                e.labels[si].store(labels[loc], std::memory_order_relaxed);
+                if ((tombstones[loc / 64] >> (loc % 64)) & 1u) {
+                    e.tombstones[si / 64].fetch_or(uint64_t{1} << (si % 64), std::memory_order_relaxed);
+                }
+            }
+        }
+        _nbatches = header.nbatches;
+        _current_idx = n;
+        _deleted_size = header.deleted_size;
+        if (zero_copy) {
+            _mapping = std::move(mapping);
+        }
+        reserve_impl(_option.max_elements);
+        _is_available = true;
+        return turbo::ok_status();
+    }
+
+    const BatchDirectory &MemVectorStore::vector_batch() const {
         TLOG_CHECK(_is_available, "should init be using");
         return _data;
     }
 
-    std::vector<VectorBatch> &MemVectorStore::vector_batch() {
+    BatchDirectory &MemVectorStore::vector_batch() {
         TLOG_CHECK(_is_available, "should init be using");
         return _data;
     }
@@ -53,23 +412,62 @@ namespace zircon {
         //std::unique_lock<std::shared_mutex> l(_data_lock);
         TLOG_CHECK(_is_available, "should init be using");
         TLOG_CHECK(i < _current_idx.load(), "vector set size {}, but set the vector {}, overflow!", _current_idx.load(), i);
+        if (is_encoded()) {
+            TLOG_CHECK(vector.size() == _option.dimension * sizeof(float), "encoded store need float vector of {}",
+                       _option.dimension);
+            auto slot = get_vector_internal(i);
+            _quantizer.encode(reinterpret_cast<const float *>(vector.data()), slot.data());
+            return;
+        }
         auto bi = i / _option.batch_size;
         auto si = i % _option.batch_size;
         _data[bi].set_vector(si, vector);
+        finish_write(i);
+    }
+
+    void MemVectorStore::finish_write(location_t i) {
+        if (!_option.keep_norms && !_option.normalize) {
+            return;
+        }
+        auto slot = get_vector_internal(i);
+        auto vector = turbo::Span<float>(reinterpret_cast<float *>(slot.data()), _option.dimension);
+        float norm = _option.normalize ? distance::normalize_l2(vector) : distance::norm_l2(vector);
+        if (_option.keep_norms) {
+            // the norm of the vector as stored
+            if (_option.normalize && norm > 0.0f) {
+                norm = 1.0f;
+            }
+            entry_of(i).norms[i % _option.batch_size] = norm;
+        }
+    }
+
+    float MemVectorStore::get_norm(location_t i) const {
+        TLOG_CHECK(_is_available, "should init be using");
+        TLOG_CHECK(_option.keep_norms, "store keep no norms");
+        TLOG_CHECK(i < slot_size(), "vector set size {}, but get the norm {}, overflow!", _current_idx.load(), i);
+        return entry_of(i).norms[i % _option.batch_size];
+    }
+
+    const float *MemVectorStore::batch_norms(std::size_t bi) const {
+        return _data.entry(bi).norms.get();
     }
 
 
     turbo::Span<uint8_t> MemVectorStore::get_vector(location_t i) const {
         //std::shared_lock<std::shared_mutex> l(_data_lock);
         TLOG_CHECK(_is_available, "should init be using");
-        TLOG_CHECK(i < _current_idx, "vector set size {}, but get the vector {}, overflow!", _current_idx.load(), i);
+        // a location retired by a compaction under a running reader is still readable
+        TLOG_CHECK(i < slot_size(), "vector set size {}, but get the vector {}, overflow!", _current_idx.load(), i);
         return get_vector_internal(i);
     }
 
     turbo::Span<uint8_t> MemVectorStore::get_vector_internal(location_t i) const {
+        // no lock, the batches never move once allocated
         auto bi = i / _option.batch_size;
         auto si = i % _option.batch_size;
-        return _data[bi].at(si);
+        auto *base = _data.entry(bi).base.load(std::memory_order_acquire);
+        TLOG_CHECK(base != nullptr, "batch {} not allocated", bi);
+        return turbo::Span<uint8_t>{base + si * _option.vector_byte_size, _option.vector_byte_size};
     }
 
     void MemVectorStore::copy_vector(location_t i, turbo::Span<uint8_t> &des) const {
@@ -80,6 +478,14 @@ namespace zircon {
         std::memcpy(des.data(), ref.data(), ref.size());
     }
 
+    void MemVectorStore::decode_vector(location_t i, turbo::Span<float> des) const {
+        TLOG_CHECK(_is_available, "should init be using");
+        TLOG_CHECK(is_encoded(), "store is not encoded");
+        TLOG_CHECK(des.size() >= _option.dimension);
+        auto ref = get_vector_internal(i);
+        _quantizer.decode(ref.data(), des.data());
+    }
+
     void MemVectorStore::move_vector(location_t from, location_t to) {
         //std::unique_lock<std::shared_mutex> l(_data_lock);
         TLOG_CHECK(_is_available, "should init be using");
@@ -88,11 +494,19 @@ namespace zircon {
         auto vf = get_vector_internal(from);
         auto vt = get_vector_internal(to);
         std::memcpy(vt.data(), vf.data(), vf.size());
+        if (_option.keep_norms) {
+            entry_of(to).norms[to % _option.batch_size] = entry_of(from).norms[from % _option.batch_size];
+        }
     }
 
 
     turbo::ResultStatus<location_t> MemVectorStore::add_vector(label_type label, const turbo::Span<uint8_t> &query) {
         TLOG_CHECK(_is_available, "should init be using");
+        if (is_encoded() && !_quantizer.is_trained()) {
+            return turbo::failed_precondition_error("quantizer should be trained before adding vectors");
+        }
+        // a compaction must not move the location before the vector is written
+        std::shared_lock<std::shared_mutex> writing(_compact_lock);
         auto r = get_vacant(label);
         if (!r.ok()) {
             r = prefer_add_vector(label);
@@ -105,6 +519,70 @@ namespace zircon {
         return lid;
     }
 
+    turbo::ResultStatus<location_t>
+    MemVectorStore::add_vectors(turbo::Span<label_type> labels, turbo::Span<uint8_t> vectors) {
+        TLOG_CHECK(_is_available, "should init be using");
+        if (is_encoded() && !_quantizer.is_trained()) {
+            return turbo::failed_precondition_error("quantizer should be trained before adding vectors");
+        }
+        const std::size_t n = labels.size();
+        const std::size_t input_size = input_byte_size();
+        if (vectors.size() != n * input_size) {
+            return turbo::invalid_argument_error("need {} bytes for {} vectors, but got {}", n * input_size, n,
+                                                 vectors.size());
+        }
+        location_t first;
+        std::shared_lock<std::shared_mutex> writing(_compact_lock);
+        {
+            auto shards = _label_index.lock_shards(turbo::Span<const label_type>{labels.data(), n});
+            std::unique_lock<std::shared_mutex> lm(_meta_lock, std::defer_lock);
+            lock_timed(lm, store_metrics().meta_lock_wait);
+            first = _current_idx.load();
+            if (first + n > _option.max_elements) {
+                return turbo::resource_exhausted_error("no space for {} vectors", n);
+            }
+            for (std::size_t i = 0; i < n; ++i) {
+                if (!_label_index.shard_of(labels[i]).map.emplace(labels[i], first + i).second) {
+                    // roll back the labels inserted by this call
+                    for (std::size_t j = 0; j < i; ++j) {
+                        _label_index.shard_of(labels[j]).map.erase(labels[j]);
+                    }
+                    return turbo::already_exists_error("label :{} already in store", labels[i]);
+                }
+            }
+            reserve_impl(first + n);
+            for (std::size_t i = 0; i < n; ++i) {
+                const auto loc = first + i;
+                // a location retired by a compaction is still tombstoned
+                clear_tombstone(loc);
+                entry_of(loc).labels[loc % _option.batch_size].store(labels[i], std::memory_order_relaxed);
+            }
+            // the labels are published by the store of the new size
+            resize_impl(first + n);
+        }
+        if (is_encoded()) {
+            for (std::size_t i = 0; i < n; ++i) {
+                auto slot = get_vector_internal(first + i);
+                _quantizer.encode(reinterpret_cast<const float *>(vectors.data() + i * input_size), slot.data());
+            }
+            return first;
+        }
+        // copy whole chunks straight into the batches, the slots of a batch
+        // are contiguous.
+        std::size_t done = 0;
+        while (done < n) {
+            auto loc = first + done;
+            auto cnt = std::min<std::size_t>(_option.batch_size - loc % _option.batch_size, n - done);
+            auto slot = get_vector_internal(loc);
+            std::memcpy(slot.data(), vectors.data() + done * input_size, cnt * input_size);
+            done += cnt;
+        }
+        for (std::size_t i = 0; (_option.keep_norms || _option.normalize) && i < n; ++i) {
+            finish_write(first + i);
+        }
+        return first;
+    }
+
     void MemVectorStore::enable_vacant() {
         TLOG_CHECK(_is_available, "should init be using");
         _option.enable_replace_vacant = true;
@@ -116,38 +594,48 @@ namespace zircon {
     }
 
     turbo::ResultStatus<location_t> MemVectorStore::prefer_add_vector(label_type label) {
-        std::unique_lock<std::shared_mutex> lock(_label_map_lock);
+        auto &shard = _label_index.shard_of(label);
+        std::unique_lock<std::shared_mutex> lock(shard.mutex, std::defer_lock);
+        lock_timed(lock, store_metrics().label_lock_wait);
         //std::unique_lock<std::shared_mutex> ld(_data_lock);
-        std::unique_lock<std::shared_mutex> lm(_meta_lock);
+        std::unique_lock<std::shared_mutex> lm(_meta_lock, std::defer_lock);
+        lock_timed(lm, store_metrics().meta_lock_wait);
         TLOG_CHECK(_is_available, "should init be using");
         if (_current_idx >= _option.max_elements) {
             return turbo::
             resource_exhausted_error("no space");
         }
 
-        auto itr = _label_map.find(label);
-        if (itr != _label_map.end()) {
+        auto itr = shard.map.find(label);
+        if (itr != shard.map.end()) {
             return turbo::already_exists_error("");
         }
         auto lid = _current_idx.load();
-        _label_map[label] = lid;
-        _lid_to_label[lid] = label;
+        shard.map[label] = lid;
         auto new_size = _current_idx + 1;
+        reserve_impl(new_size);
+        clear_tombstone(lid);
+        entry_of(lid).labels[lid % _option.batch_size].store(label, std::memory_order_release);
         resize_impl(new_size);
         _current_idx = new_size;
         return lid;
     }
 
     turbo::ResultStatus<location_t> MemVectorStore::remove_vector(label_type label) {
-        std::unique_lock<std::shared_mutex> lock(_meta_lock);
-        std::unique_lock<std::shared_mutex> label_lock(_label_map_lock);
+        auto &shard = _label_index.shard_of(label);
+        std::unique_lock<std::shared_mutex> label_lock(shard.mutex, std::defer_lock);
+        lock_timed(label_lock, store_metrics().label_lock_wait);
         TLOG_CHECK(_is_available, "should init be using");
-        auto itr = _label_map.find(label);
-        if (itr == _label_map.end()) {
+        auto itr = shard.map.find(label);
+        if (itr == shard.map.end()) {
             return turbo::not_found_error("delete label not found");
         }
         auto lid = itr->second;
-        _lid_to_label[lid] = constants::kUnknownLabel;
+        shard.map.erase(itr);
+        std::unique_lock<std::shared_mutex> lock(_meta_lock, std::defer_lock);
+        lock_timed(lock, store_metrics().meta_lock_wait);
+        set_tombstone(lid);
+        entry_of(lid).labels[lid % _option.batch_size].store(constants::kUnknownLabel, std::memory_order_release);
         _deleted_map.add(lid);
         ++_deleted_size;
         return lid;
@@ -173,7 +661,7 @@ namespace zircon {
     }
 
     [[nodiscard]] std::size_t MemVectorStore::capacity_impl() const {
-        auto size = _data.size() * _option.batch_size;
+        auto size = _nbatches.load() * _option.batch_size;
         return size > _option.max_elements ? _option.max_elements : size;
     }
 
@@ -193,25 +681,42 @@ namespace zircon {
         if (n > _option.max_elements) {
             n = _option.max_elements;
         }
-        while (_data.size() * _option.batch_size < n) {
+        while (_nbatches * _option.batch_size < n) {
             expend();
         }
     }
 
     void MemVectorStore::expend() {
         VectorBatch vb;
-        auto r = vb.init(_option.vector_byte_size, _option.batch_size);
+        auto r = vb.init(_option.vector_byte_size, _option.batch_size, _option.numa_node);
         //auto r = _data.back().init(_vs, _option.batch_size);
         TLOG_CHECK(r.ok());
-        _data.push_back(std::move(vb));
+        store_metrics().batch_allocations.add();
+        store_metrics().batch_bytes.add(static_cast<uint64_t>(_option.vector_byte_size) * _option.batch_size);
+        // reuse the entries released by a compaction first
+        if (_nbatches < _data.size()) {
+            _data.reset(_data.entry(_nbatches), std::move(vb));
+        } else {
+            _data.append(std::move(vb));
+        }
+        ++_nbatches;
     }
 
     void MemVectorStore::shrink() {
         //std::unique_lock<std::shared_mutex> l(_data_lock);
         TLOG_CHECK(_is_available, "should init be using");
-        while (!_data.empty() && _data.back().is_empty()) {
-            _data.pop_back();
+        release_tail();
+    }
+
+    std::size_t MemVectorStore::release_tail() {
+        const auto need = (_current_idx + _option.batch_size - 1) / _option.batch_size;
+        std::size_t released = 0;
+        while (_nbatches > need) {
+            --_nbatches;
+            _data.release(_data.entry(_nbatches));
+            ++released;
         }
+        return released;
     }
 
     void MemVectorStore::pop_back(std::size_t n) {
@@ -231,7 +736,7 @@ namespace zircon {
         }
         if (n < _current_idx) {
             std::size_t need_to_pop = _current_idx - n;
-            for (auto idx = _current_idx / _option.batch_size; need_to_pop > 0; idx--) {
+            for (auto idx = (_current_idx - 1) / _option.batch_size; need_to_pop > 0; idx--) {
                 auto bs = _data[idx].size();
                 if (bs >= need_to_pop) {
                     _data[idx].resize(bs - need_to_pop);
@@ -259,32 +764,34 @@ namespace zircon {
         _current_idx = n;
     }
 
-    turbo::ResultStatus<label_type> MemVectorStore::get_label(location_t loc) {
+    turbo::ResultStatus<label_type> MemVectorStore::get_label(location_t loc) const {
         TLOG_CHECK(_is_available, "should init be using");
-        TLOG_CHECK(loc < _current_idx);
-        // this always call after is_deleted, do not need to check
-        //std::shared_lock<std::shared_mutex> lock(_meta_lock);
-        //if(_lid_to_label[loc] == constants::kUnknownLabel) {
-        //    return turbo::NotFoundError("label not exists");
-        //}
-        return _lid_to_label[loc];
+        TLOG_CHECK(loc < slot_size());
+        // this always call after is_deleted, do not need to check,
+        // kUnknownLabel for a removed or retired location
+        return entry_of(loc).labels[loc % _option.batch_size].load(std::memory_order_acquire);
     }
 
     [[nodiscard]] bool MemVectorStore::exists_label(label_type label) const {
         TLOG_CHECK(_is_available, "should init be using");
-        std::shared_lock<std::shared_mutex> lock(_label_map_lock);
-        auto itr = _label_map.find(label);
-        if (itr == _label_map.end()) {
-            return false;
-        }
-        return true;
+        return _label_index.contains(label);
+    }
+
+    [[nodiscard]] turbo::ResultStatus<location_t> MemVectorStore::get_location(label_type label) const {
+        TLOG_CHECK(_is_available, "should init be using");
+        return _label_index.find(label);
+    }
+
+    std::size_t
+    MemVectorStore::get_locations(turbo::Span<const label_type> labels, turbo::Span<location_t> out) const {
+        TLOG_CHECK(_is_available, "should init be using");
+        return _label_index.find_batch(labels, out);
     }
 
     [[nodiscard]] bool MemVectorStore::is_deleted(location_t loc) const {
-        std::shared_lock<std::shared_mutex> lock(_meta_lock);
         TLOG_CHECK(_is_available, "should init be using");
-        TLOG_CHECK(loc < _current_idx, "overflow");
-        return _lid_to_label[loc] == constants::kUnknownLabel;
+        TLOG_CHECK(loc < slot_size(), "overflow");
+        return is_tombstoned(loc);
     }
 
 
@@ -295,22 +802,151 @@ namespace zircon {
         }
         location_t lid;
 
-        std::unique_lock<std::shared_mutex> lock(_meta_lock);
-        std::unique_lock<std::shared_mutex> label_lock(_label_map_lock);
+        auto &shard = _label_index.shard_of(label);
+        std::unique_lock<std::shared_mutex> label_lock(shard.mutex, std::defer_lock);
+        lock_timed(label_lock, store_metrics().label_lock_wait);
+        std::unique_lock<std::shared_mutex> lock(_meta_lock, std::defer_lock);
+        lock_timed(lock, store_metrics().meta_lock_wait);
 
         if (_deleted_map.isEmpty()) {
             return turbo::resource_exhausted_error("no vacant to use");
         }
 
         lid = _deleted_map.minimum();
-        auto itr = _label_map.find(label);
-        if (itr != _label_map.end()) {
+        auto itr = shard.map.find(label);
+        if (itr != shard.map.end()) {
             return turbo::already_exists_error("label :{} already in store", label);
         }
         _deleted_map.remove(lid);
-        _lid_to_label[lid] = label;
+        entry_of(lid).labels[lid % _option.batch_size].store(label, std::memory_order_release);
+        clear_tombstone(lid);
         --_deleted_size;
-        _label_map[label] = lid;
+        shard.map[label] = lid;
         return lid;
     }
+
+    turbo::ResultStatus<CompactResult>
+    MemVectorStore::compact(const CompactOption &option, std::vector<std::pair<location_t, location_t>> *remap) {
+        TLOG_CHECK(_is_available, "should init be using");
+        if (option.moves_per_step == 0) {
+            return turbo::invalid_argument_error("moves_per_step should be positive");
+        }
+        CompactResult result;
+        for (bool done = false; !done;) {
+            std::unique_lock<std::shared_mutex> writing(_compact_lock);
+            std::unique_lock<std::shared_mutex> lock(_meta_lock, std::defer_lock);
+            lock_timed(lock, store_metrics().meta_lock_wait);
+            bool busy = false;
+            for (std::size_t step = 0; step < option.moves_per_step; ++step) {
+                if (_deleted_map.isEmpty()) {
+                    done = true;
+                    break;
+                }
+                const auto last = static_cast<location_t>(_current_idx - 1);
+                if (is_tombstoned(last)) {
+                    // a hole at the tail is just cut, it stays tombstoned
+                    _deleted_map.remove(last);
+                    --_deleted_size;
+                    resize_impl(last);
+                    ++result.reclaimed;
+                    continue;
+                }
+                const auto hole = static_cast<location_t>(_deleted_map.minimum());
+                auto &from = entry_of(last).labels[last % _option.batch_size];
+                const auto label = from.load(std::memory_order_relaxed);
+                auto *op_lock = _label_op_lock.get_lock(label);
+                if (!op_lock->try_lock()) {
+                    // a writer is on the label, leave the rest to the next run
+                    result.complete = false;
+                    done = true;
+                    break;
+                }
+                // the shard is locked before the meta lock by the writers, only try
+                // it here and retry the step once the writer is gone
+                auto &shard = _label_index.shard_of(label);
+                std::unique_lock<std::shared_mutex> shard_lock(shard.mutex, std::try_to_lock);
+                if (!shard_lock.owns_lock()) {
+                    op_lock->unlock();
+                    busy = true;
+                    break;
+                }
+                // copy first, the hole still reads as removed
+                move_vector(last, hole);
+                entry_of(hole).labels[hole % _option.batch_size].store(label, std::memory_order_release);
+                clear_tombstone(hole);
+                _deleted_map.remove(hole);
+                shard.map[label] = hole;
+                if (option.on_move) {
+                    option.on_move(last, hole);
+                }
+                if (remap != nullptr) {
+                    remap->emplace_back(last, hole);
+                }
+                // then retire the old one
+                set_tombstone(last);
+                from.store(constants::kUnknownLabel, std::memory_order_release);
+                --_deleted_size;
+                resize_impl(last);
+                op_lock->unlock();
+                ++result.moved;
+                ++result.reclaimed;
+            }
+            if (busy) {
+                lock.unlock();
+                writing.unlock();
+                std::this_thread::yield();
+            }
+        }
+        if (option.release_memory) {
+            std::unique_lock<std::shared_mutex> reading(_data_lock);
+            std::unique_lock<std::shared_mutex> writing(_compact_lock);
+            std::unique_lock<std::shared_mutex> lock(_meta_lock);
+            result.released_batches = release_tail();
+        }
+        return result;
+    }
+
+    turbo::Status MemVectorStore::start_compaction(const CompactOption &option) {
+        TLOG_CHECK(_is_available, "should init be using");
+        if (option.moves_per_step == 0) {
+            return turbo::invalid_argument_error("moves_per_step should be positive");
+        }
+        std::unique_lock<std::mutex> lock(_compactor_mutex);
+        if (_compactor.joinable()) {
+            return turbo::already_exists_error("compaction is running");
+        }
+        _compactor_stop = false;
+        _compactor = std::thread([this, option]() {
+            std::unique_lock<std::mutex> lock(_compactor_mutex);
+            while (!_compactor_stop) {
+                _compactor_cv.wait_for(lock, std::chrono::milliseconds(option.interval_ms));
+                if (_compactor_stop) {
+                    break;
+                }
+                auto deleted = _deleted_size.load();
+                auto total = _current_idx.load();
+                if (deleted == 0 || static_cast<double>(deleted) < option.min_deleted_ratio * total) {
+                    continue;
+                }
+                lock.unlock();
+                // can not fail, the option is checked on start
+                (void) compact(option);
+                lock.lock();
+            }
+        });
+        return turbo::ok_status();
+    }
+
+    void MemVectorStore::stop_compaction() {
+        std::thread compactor;
+        {
+            std::unique_lock<std::mutex> lock(_compactor_mutex);
+            _compactor_stop = true;
+            compactor = std::move(_compactor);
+        }
+        _compactor_cv.notify_all();
+        if (compactor.joinable()) {
+            compactor.join();
+        }
+    }
 }  // namespace zircon
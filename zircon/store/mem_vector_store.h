@@ -16,39 +16,133 @@
 #ifndef ZIRCON_MEM_STORE_VECTOR_STORE_H_
 #define ZIRCON_MEM_STORE_VECTOR_STORE_H_
 
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <memory>
+#include <mutex>
 #include <vector>
 #include <string_view>
 #include <shared_mutex>
+#include <thread>
 #include "turbo/files/sequential_write_file.h"
 #include "turbo/files/sequential_read_file.h"
 #include "bluebird/bits/bitmap.h"
 #include "turbo/container/flat_hash_map.h"
 #include "turbo/concurrent/hash_lock.h"
+#include "zircon/store/batch_directory.h"
+#include "zircon/store/label_index.h"
 #include "zircon/store/vector_batch.h"
 #include "zircon/core/defines.h"
+#include "zircon/quantizer/scalar_quantizer.h"
+#include "zircon/utility/mapped_file.h"
 
 namespace zircon {
 
+    struct CompactOption {
+        // moves done under one lock acquisition, writers run between the steps
+        std::size_t moves_per_step{256};
+        // free the batches left empty at the tail, see MemVectorStore::compact
+        bool release_memory{true};
+        // background compaction runs once deleted_size() / current_index() reach it
+        double min_deleted_ratio{0.2};
+        // how often the background compaction check the ratio
+        uint32_t interval_ms{1000};
+        // called with the old and the new location of every moved vector, under
+        // the locks of the store, before the old location is retired.
+        std::function<void(location_t from, location_t to)> on_move;
+    };
+
+    struct CompactResult {
+        std::size_t moved{0};
+        // locations cut from the tail
+        std::size_t reclaimed{0};
+        std::size_t released_batches{0};
+        // false if a label held by a writer stopped the compaction early
+        bool complete{true};
+    };
+
     class MemVectorStore {
     public:
         MemVectorStore() = default;
 
-        ~MemVectorStore() = default;
+        ~MemVectorStore();
 
         turbo::Status initialize(VectorStoreOption op);
 
-        [[nodiscard]] const std::vector<VectorBatch> &vector_batch() const;
-
-        [[nodiscard]] std::vector<VectorBatch> &vector_batch();
+        /**
+         * @brief write a snapshot of the store to path. the file is a fixed header
+         *        followed by the quantizer range, the label of every location, the
+         *        deleted bitmap, the norms with keep_norms and the batch blocks,
+         *        every section 64 byte aligned so the blocks can be used in place
+         *        once mapped. the labels of the
+         *        locations are the label map, it is rebuilt from them on load.
+         *        the metadata is consistent with concurrent writers, vectors being
+         *        set at the same time may be saved half written.
+         *        the layout is the one of the host, no byte order conversion is done.
+         */
+        turbo::Status save_snapshot(const std::string &path) const;
+
+        /**
+         * @brief initialize the store from a snapshot written by save_snapshot.
+         * @param zero_copy map the file and let the batches point into the mapping,
+         *        pages are loaded on first touch, writing to a loaded vector copy
+         *        the page and never change the file. with false the blocks are
+         *        copied into allocated batches and the file is closed.
+         */
+        turbo::Status load_snapshot(const std::string &path, bool zero_copy = true);
+
+        // batch i holds the locations [i * batch size, (i + 1) * batch size)
+        [[nodiscard]] const BatchDirectory &vector_batch() const;
+
+        [[nodiscard]] BatchDirectory &vector_batch();
 
         [[nodiscard]] uint32_t get_batch_size() const;
 
+        /**
+         * @brief train the quantizer of an encoded store, the samples are
+         *        n float vectors of dimension. must be done before adding
+         *        vectors to a ENCODING_SQ8 store.
+         */
+        turbo::Status train_quantizer(turbo::Span<float> samples);
+
+        [[nodiscard]] bool is_encoded() const {
+            return _option.encoding != EncodingType::ENCODING_NONE;
+        }
+
+        [[nodiscard]] const ScalarQuantizer &quantizer() const {
+            return _quantizer;
+        }
+
+        // bytes of a vector given to add_vector or set_vector, dimension floats for an encoded store
+        [[nodiscard]] std::size_t input_byte_size() const {
+            return is_encoded() ? _option.dimension * sizeof(float) : _option.vector_byte_size;
+        }
+
+        [[nodiscard]] bool keeps_norms() const {
+            return _option.keep_norms;
+        }
+
+        [[nodiscard]] bool is_normalized() const {
+            return _option.normalize;
+        }
+
+        // l2 norm of the vector at location i as stored, keep_norms only.
+        [[nodiscard]] float get_norm(location_t i) const;
+
+        // norms of the locations of batch bi one after another, nullptr without keep_norms.
+        [[nodiscard]] const float *batch_norms(std::size_t bi) const;
+
+        // for an encoded store, vector is dimension floats and encoded into the slot.
         void set_vector(location_t i, turbo::Span<uint8_t> vector);
 
         [[nodiscard]] turbo::Span<uint8_t> get_vector(location_t i) const;
 
         void copy_vector(location_t, turbo::Span<uint8_t> &des) const;
 
+        // decode an encoded vector to dimension floats.
+        void decode_vector(location_t i, turbo::Span<float> des) const;
+
         void enable_vacant();
 
         void disable_vacant();
@@ -57,6 +151,19 @@ namespace zircon {
 
         turbo::ResultStatus<location_t> add_vector(label_type label, const turbo::Span<uint8_t> &vector);
 
+        /**
+         * @brief add labels.size() vectors in one go, vectors holds them one after
+         *        another with the same layout add_vector takes. the locations are
+         *        reserved and the labels inserted under a single lock acquisition,
+         *        the vectors are then copied batch by batch. vacant locations are
+         *        not reused, the new vectors take the locations
+         *        [first, first + labels.size()).
+         * @return the first location, already exists if any label is in the store
+         *         or repeated, resource exhausted if there is not enough space. the
+         *         store is not changed on error.
+         */
+        turbo::ResultStatus<location_t> add_vectors(turbo::Span<label_type> labels, turbo::Span<uint8_t> vectors);
+
         turbo::ResultStatus<location_t> prefer_add_vector(label_type label);
 
         turbo::ResultStatus<location_t> remove_vector(label_type label);
@@ -71,14 +178,55 @@ namespace zircon {
 
         [[nodiscard]] std::size_t available() const;
 
-        turbo::ResultStatus<label_type> get_label(location_t loc);
+        turbo::ResultStatus<label_type> get_label(location_t loc) const;
 
         [[nodiscard]] bool exists_label(label_type label) const;
 
+        // not found if the label is not in the store or removed
+        [[nodiscard]] turbo::ResultStatus<location_t> get_location(label_type label) const;
+
+        /**
+         * @brief get_location of a whole set of labels, every shard of the label
+         *        index is locked once. out[i] is constants::kUnknownLocation if
+         *        labels[i] is not in the store.
+         * @return the number of labels found.
+         */
+        std::size_t get_locations(turbo::Span<const label_type> labels, turbo::Span<location_t> out) const;
+
         [[nodiscard]] bool is_deleted(location_t loc) const;
 
         [[nodiscard]] turbo::ResultStatus<location_t> get_vacant(label_type label);
 
+        /**
+         * @brief fill the holes left by removed vectors with the live vectors of
+         *        the tail, then cut the tail. runs in steps of moves_per_step
+         *        under the locks of the store, readers never wait and writers
+         *        wait at most one step. a moved vector is copied first, then
+         *        published at its new location, then the old one is retired, a
+         *        reader scanning at the same time may see it twice but never
+         *        miss it. retired locations read as removed. the labels being
+         *        moved are try locked with their label op lock, callers that
+         *        write a location outside add_vector / add_vectors must hold it.
+         *        with release_memory the empty tail batches are freed under the
+         *        update lock, readers that may run at the same time must hold
+         *        UpdateSharedLockGuard. a store used by an index that keep
+         *        locations must remap them through on_move or the remap list.
+         * @param remap if not null, the (from, to) pairs of the moved vectors are appended.
+         */
+        turbo::ResultStatus<CompactResult>
+        compact(const CompactOption &option = CompactOption(),
+                std::vector<std::pair<location_t, location_t>> *remap = nullptr);
+
+        /**
+         * @brief run compact with option on a thread of the store every
+         *        option.interval_ms while the deleted ratio reach
+         *        option.min_deleted_ratio. stopped by stop_compaction or the
+         *        destructor. already exists if it is running.
+         */
+        turbo::Status start_compaction(const CompactOption &option);
+
+        void stop_compaction();
+
         inline std::shared_mutex *get_label_op_mutex(label_type label) const {
             return _label_op_lock.get_lock(label);
         }
@@ -105,9 +253,36 @@ namespace zircon {
 
         turbo::Span<uint8_t> get_vector_internal(location_t i) const;
 
+        // normalize the float vector just written at location i and keep its norm, as the option say.
+        void finish_write(location_t i);
+
+        // slots of the batch holding location loc
+        [[nodiscard]] BatchDirectory::Entry &entry_of(std::size_t loc) {
+            return _data.entry(loc / _option.batch_size);
+        }
+
+        [[nodiscard]] const BatchDirectory::Entry &entry_of(std::size_t loc) const {
+            return _data.entry(loc / _option.batch_size);
+        }
+
+        [[nodiscard]] bool is_tombstoned(std::size_t loc) const;
+
+        void set_tombstone(std::size_t loc);
+
+        void clear_tombstone(std::size_t loc);
+
+        // locations with slots, retired locations included
+        [[nodiscard]] std::size_t slot_size() const {
+            return _data.size() * _option.batch_size;
+        }
+
+        // free the vectors of the batches above the current index, return the count.
+        std::size_t release_tail();
+
     private:
         bool _is_available{false};
         VectorStoreOption _option;
+        ScalarQuantizer _quantizer;
         // guard by _data_lock
         std::atomic<std::size_t> _current_idx{0};
         // guard by _meta_lock
@@ -121,15 +296,25 @@ namespace zircon {
         // function span, so user should use LabelLockGuard/LabelSharedLockGuard
         // lock it outsize this scope
         turbo::HashLock<label_type> _label_op_lock;
-        // guard by _meta_lock
-        std::vector<label_type> _lid_to_label;
-        mutable std::shared_mutex _label_map_lock;  // lock for _label_map_lock
-        // guard by _label_map_lock
-        turbo::flat_hash_map<label_type, location_t> _label_map;
+        // the writers lock, in this order, _compact_lock, the shards of the
+        // labels in ascending order, then _meta_lock.
+        LabelIndex _label_index;
         //
         mutable std::shared_mutex _data_lock;
-        // guard by _data_lock
-        std::vector<VectorBatch> _data;
+        // shared by add_vector and add_vectors while they write, exclusive by a compaction step
+        mutable std::shared_mutex _compact_lock;
+        // the snapshot the first batches point into, must outlive _data
+        std::unique_ptr<MappedFile> _mapping;
+        // entries appended under _meta_lock, read lock free. the slots are
+        // written under _meta_lock, the vectors by the owner of the location.
+        BatchDirectory _data;
+        // batches with memory, the entries above were released by a compaction
+        std::atomic<std::size_t> _nbatches{0};
+
+        std::mutex _compactor_mutex;
+        std::condition_variable _compactor_cv;
+        bool _compactor_stop{false};
+        std::thread _compactor;
     };
 
     class UpdateLockGuard {
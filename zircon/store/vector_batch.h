@@ -27,8 +27,8 @@ namespace zircon {
         VectorBatch() = default;
 
         ~VectorBatch() {
-            if (_data) {
-                Allocator::get_instance().deallocate(_data, _capacity * _vector_byte_size);
+            if (_data && _owned) {
+                Allocator::get_instance().deallocate_batch(_data, _capacity * _vector_byte_size);
                 _data = nullptr;
             }
         }
@@ -38,34 +38,61 @@ namespace zircon {
             _capacity = rhs._capacity;
             _data = rhs._data;
             _vector_byte_size = rhs._vector_byte_size;
+            _owned = rhs._owned;
             rhs._ndim = 0;
             rhs._data = nullptr;
             rhs._capacity = 0;
         }
 
         VectorBatch &operator=(VectorBatch &&rhs) noexcept {
+            if (this == &rhs) {
+                return *this;
+            }
+            if (_data && _owned) {
+                Allocator::get_instance().deallocate_batch(_data, _capacity * _vector_byte_size);
+            }
             _ndim = rhs._ndim;
             _capacity = rhs._capacity;
             _data = rhs._data;
             _vector_byte_size = rhs._vector_byte_size;
+            _owned = rhs._owned;
             rhs._ndim = 0;
             rhs._data = nullptr;
             rhs._capacity = 0;
             return *this;
         }
 
-        [[nodiscard]] turbo::Status init(std::size_t vector_byte_size, std::size_t n) {
+        // numa_node is where the memory is placed when the allocator use the arena, -1 for the calling cpu.
+        [[nodiscard]] turbo::Status init(std::size_t vector_byte_size, std::size_t n, int numa_node = -1) {
             _ndim = 0;
             _capacity = n;
             _vector_byte_size = vector_byte_size;
+            _owned = true;
             try {
-                _data = Allocator::get_instance().allocate(_capacity * _vector_byte_size);
+                _data = Allocator::get_instance().allocate_batch(_capacity * _vector_byte_size, numa_node);
             } catch (std::exception &e) {
                 return turbo::unavailable_error(e.what());
             }
             return turbo::ok_status();
         }
 
+        /**
+         * @brief use memory not owned by the batch, eg. a mapped snapshot.
+         *        data must hold n vectors and outlive the batch.
+         */
+        void init_external(uint8_t *data, std::size_t vector_byte_size, std::size_t n, std::size_t ndim) {
+            TLOG_CHECK(ndim <= n);
+            _data = data;
+            _owned = false;
+            _ndim = ndim;
+            _capacity = n;
+            _vector_byte_size = vector_byte_size;
+        }
+
+        [[nodiscard]] bool is_owned() const {
+            return _owned;
+        }
+
         [[nodiscard]] bool is_full() const {
             return _ndim == _capacity;
         }
@@ -108,16 +135,16 @@ namespace zircon {
 
         std::size_t add_vector(const turbo::Span<uint8_t> &vector) {
             auto i = _ndim++;
-            TLOG_CHECK(_ndim < _capacity);
+            TLOG_CHECK(_ndim <= _capacity);
             TLOG_CHECK(vector.size() == _vector_byte_size);
-            std::memcpy(vector.data(), _data + i * _vector_byte_size, vector.size());
+            std::memcpy(_data + i * _vector_byte_size, vector.data(), vector.size());
             return i;
         }
 
         std::size_t add_vector(const turbo::Span<uint8_t> &vector, std::size_t nvec) {
             auto i = _ndim;
             _ndim += nvec;
-            TLOG_CHECK(_ndim < _capacity);
+            TLOG_CHECK(_ndim <= _capacity);
             TLOG_CHECK(vector.size() == _vector_byte_size * nvec);
             std::memcpy(_data + i * _vector_byte_size, vector.data(), vector.size());
             return i;
@@ -126,7 +153,7 @@ namespace zircon {
         std::size_t add_vector(uint8_t *vector, std::size_t nvec) {
             auto i = _ndim;
             _ndim += nvec;
-            TLOG_CHECK(_ndim < _capacity);
+            TLOG_CHECK(_ndim <= _capacity);
             std::memcpy(_data + i * _vector_byte_size, vector, nvec * _vector_byte_size);
             return i;
         }
@@ -144,7 +171,7 @@ namespace zircon {
         }
 
         void set_vector(std::size_t i, uint8_t *vector, std::size_t nvec) {
-            TLOG_CHECK(i + nvec < _ndim);
+            TLOG_CHECK(i + nvec <= _ndim);
             std::memcpy(_data + i * _vector_byte_size, vector, nvec * _vector_byte_size);
         }
 
@@ -155,7 +182,7 @@ namespace zircon {
 
         void clear_vector(std::size_t start, std::size_t end) {
             TLOG_CHECK(start < _ndim);
-            TLOG_CHECK(end < _ndim);
+            TLOG_CHECK(end <= _ndim);
             std::memset(_data + start * _vector_byte_size, 0, (end - start) * _vector_byte_size);
         }
 
@@ -189,6 +216,19 @@ namespace zircon {
             return turbo::Span<uint8_t>{_data, _vector_byte_size * _ndim};
         }
 
+        // the vectors are stored one after another, the first size() of them are valid.
+        [[nodiscard]] const uint8_t *data() const {
+            return _data;
+        }
+
+        [[nodiscard]] uint8_t *data() {
+            return _data;
+        }
+
+        [[nodiscard]] std::size_t vector_byte_size() const {
+            return _vector_byte_size;
+        }
+
     private:
         /// no lint
         TURBO_NON_COPYABLE(VectorBatch);
@@ -198,6 +238,7 @@ namespace zircon {
         std::size_t _ndim{0};
         std::size_t _capacity{0};
         uint8_t *_data{nullptr};
+        bool _owned{true};
     };
 
 }  // namespace zircon
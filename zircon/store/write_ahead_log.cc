@@ -0,0 +1,453 @@
+// Copyright 2023 The Elastic-AI Authors.
+// part of Elastic AI Search
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#include "zircon/store/write_ahead_log.h"
+#include <algorithm>
+#include <array>
+#include <cerrno>
+#include <chrono>
+#include <cstddef>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <thread>
+#include <fcntl.h>
+#include <unistd.h>
+#include "turbo/log/logging.h"
+
+namespace zircon {
+
+    namespace {
+        // "ZRCNWAL1"
+        constexpr uint64_t kWalMagic = 0x314c41574e43525aULL;
+
+        struct SegmentHeader {
+            uint64_t magic;
+            uint64_t first_lsn;
+        };
+
+        struct RecordHeader {
+            uint32_t size;
+            // crc32c of the payload then of the header after this field
+            uint32_t crc;
+            uint64_t lsn;
+            uint32_t op;
+            uint32_t reserved;
+            uint64_t label;
+        };
+
+        constexpr std::size_t kCrcSkip = offsetof(RecordHeader, lsn);
+
+        uint32_t crc32c(uint32_t crc, const uint8_t *p, std::size_t n) {
+            static const auto table = []() {
+                std::array<uint32_t, 256> t{};
+                for (uint32_t i = 0; i < 256; ++i) {
+                    uint32_t c = i;
+                    for (int k = 0; k < 8; ++k) {
+                        c = (c & 1u) ? (c >> 1) ^ 0x82f63b78u : c >> 1;
+                    }
+                    t[i] = c;
+                }
+                return t;
+            }();
+            crc = ~crc;
+            for (std::size_t i = 0; i < n; ++i) {
+                crc = table[(crc ^ p[i]) & 0xffu] ^ (crc >> 8);
+            }
+            return ~crc;
+        }
+
+        uint32_t record_crc(uint32_t payload_crc, const RecordHeader &h) {
+            return crc32c(payload_crc, reinterpret_cast<const uint8_t *>(&h) + kCrcSkip, sizeof(h) - kCrcSkip);
+        }
+
+        std::string segment_path(const std::string &dir, uint64_t first_lsn) {
+            char name[32];
+            std::snprintf(name, sizeof(name), "wal-%020llu.log", static_cast<unsigned long long>(first_lsn));
+            return (std::filesystem::path(dir) / name).string();
+        }
+
+        // the segments of dir by first lsn, the name is wal-<first lsn>.log
+        turbo::Status list_segments(const std::string &dir, std::vector<std::pair<uint64_t, std::string>> &out) {
+            std::error_code ec;
+            for (auto &entry: std::filesystem::directory_iterator(dir, ec)) {
+                auto name = entry.path().filename().string();
+                unsigned long long lsn = 0;
+                char tail = 0;
+                if (name.size() == 28 && std::sscanf(name.c_str(), "wal-%20llu.lo%c", &lsn, &tail) == 2 &&
+                    tail == 'g') {
+                    out.emplace_back(lsn, entry.path().string());
+                }
+            }
+            if (ec) {
+                return turbo::errno_to_status(ec.value(), "list " + dir);
+            }
+            std::sort(out.begin(), out.end());
+            return turbo::ok_status();
+        }
+
+        turbo::Status read_file(const std::string &path, std::vector<uint8_t> &out) {
+            int fd = ::open(path.c_str(), O_RDONLY);
+            if (fd < 0) {
+                return turbo::errno_to_status(errno, "open " + path);
+            }
+            out.clear();
+            uint8_t buf[1 << 16];
+            while (true) {
+                auto n = ::read(fd, buf, sizeof(buf));
+                if (n < 0 && errno == EINTR) {
+                    continue;
+                }
+                if (n < 0) {
+                    auto rs = turbo::errno_to_status(errno, "read " + path);
+                    ::close(fd);
+                    return rs;
+                }
+                if (n == 0) {
+                    break;
+                }
+                out.insert(out.end(), buf, buf + n);
+            }
+            ::close(fd);
+            return turbo::ok_status();
+        }
+
+        turbo::Status write_fully(int fd, const uint8_t *p, std::size_t n) {
+            while (n > 0) {
+                auto w = ::write(fd, p, n);
+                if (w < 0 && errno == EINTR) {
+                    continue;
+                }
+                if (w < 0) {
+                    return turbo::errno_to_status(errno, "write log segment");
+                }
+                p += w;
+                n -= static_cast<std::size_t>(w);
+            }
+            return turbo::ok_status();
+        }
+
+        // make a new file of dir survive a crash
+        turbo::Status sync_dir(const std::string &dir) {
+            int fd = ::open(dir.c_str(), O_RDONLY | O_DIRECTORY);
+            if (fd < 0) {
+                return turbo::errno_to_status(errno, "open " + dir);
+            }
+            auto rs = ::fsync(fd) == 0 ? turbo::ok_status() : turbo::errno_to_status(errno, "fsync " + dir);
+            ::close(fd);
+            return rs;
+        }
+
+        /**
+         * scan the records of a segment, fn is called with every good one.
+         * @return the end of the last good record, a torn or corrupted record stops the scan.
+         */
+        std::size_t scan_segment(const std::vector<uint8_t> &data, uint64_t first_lsn,
+                                 const std::function<bool(const WalRecord &)> &fn) {
+            std::size_t offset = sizeof(SegmentHeader);
+            uint64_t expect = first_lsn;
+            while (offset + sizeof(RecordHeader) <= data.size()) {
+                RecordHeader h;
+                std::memcpy(&h, data.data() + offset, sizeof(h));
+                if (h.lsn != expect || h.size > data.size() - offset - sizeof(h)) {
+                    break;
+                }
+                const uint8_t *payload = data.data() + offset + sizeof(h);
+                if (record_crc(crc32c(0, payload, h.size), h) != h.crc) {
+                    break;
+                }
+                WalRecord record;
+                record.lsn = h.lsn;
+                record.op = static_cast<WalOp>(h.op);
+                record.label = h.label;
+                record.payload = turbo::Span<const uint8_t>(payload, h.size);
+                if (!fn(record)) {
+                    break;
+                }
+                offset += sizeof(h) + h.size;
+                ++expect;
+            }
+            return offset;
+        }
+    }  // namespace
+
+    WriteAheadLog::~WriteAheadLog() {
+        (void) close();
+    }
+
+    turbo::Status WriteAheadLog::open(const std::string &dir, const WalOption &option, uint64_t last_lsn) {
+        TLOG_CHECK(_fd < 0, "log already open");
+        _dir = dir;
+        _option = option;
+        std::error_code ec;
+        std::filesystem::create_directories(dir, ec);
+        if (ec) {
+            return turbo::errno_to_status(ec.value(), "create " + dir);
+        }
+        std::vector<std::pair<uint64_t, std::string>> segments;
+        auto rs = list_segments(dir, segments);
+        if (!rs.ok()) {
+            return rs;
+        }
+        uint64_t last = 0;
+        std::size_t tail_end = 0;
+        std::vector<uint8_t> data;
+        for (std::size_t i = 0; i < segments.size(); ++i) {
+            const bool is_last = i + 1 == segments.size();
+            const auto first = segments[i].first;
+            const auto path = segments[i].second;
+            rs = read_file(path, data);
+            if (!rs.ok()) {
+                return rs;
+            }
+            if (i > 0 && first != last + 1) {
+                return turbo::data_loss_error("log segment {} does not follow lsn {}", path, last);
+            }
+            SegmentHeader h{};
+            if (data.size() >= sizeof(h)) {
+                std::memcpy(&h, data.data(), sizeof(h));
+            }
+            if (data.size() < sizeof(h) || h.magic != kWalMagic || h.first_lsn != first) {
+                if (!is_last) {
+                    return turbo::data_loss_error("log segment {} is corrupted", path);
+                }
+                // the crash came before the header was written, the segment is started again
+                std::filesystem::remove(path, ec);
+                segments.pop_back();
+                last = first - 1;
+                break;
+            }
+            last = first - 1;
+            auto end = scan_segment(data, first, [&](const WalRecord &r) {
+                last = r.lsn;
+                return true;
+            });
+            if (end != data.size()) {
+                if (!is_last) {
+                    return turbo::data_loss_error("log segment {} is corrupted at {}", path, end);
+                }
+                // a torn write of the last records, they were never acknowledged
+                if (::truncate(path.c_str(), static_cast<off_t>(end)) != 0) {
+                    return turbo::errno_to_status(errno, "truncate " + path);
+                }
+            }
+            tail_end = end;
+        }
+        if (!segments.empty() && last < last_lsn) {
+            // all the records are older than the snapshot the log continue from
+            for (auto &segment: segments) {
+                std::filesystem::remove(segment.second, ec);
+            }
+            segments.clear();
+        }
+        _segments = segments;
+        _last_lsn = std::max(last, last_lsn);
+        _durable_lsn = _last_lsn;
+        _appended_bytes = 0;
+        _error = turbo::ok_status();
+        if (!_segments.empty()) {
+            const auto &path = _segments.back().second;
+            _fd = ::open(path.c_str(), O_WRONLY | O_APPEND);
+            if (_fd < 0) {
+                return turbo::errno_to_status(errno, "open " + path);
+            }
+            _segment_size = tail_end;
+            return turbo::ok_status();
+        }
+        return open_segment(_last_lsn + 1);
+    }
+
+    turbo::Status WriteAheadLog::open_segment(uint64_t first_lsn) {
+        auto path = segment_path(_dir, first_lsn);
+        int fd = ::open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_APPEND, 0644);
+        if (fd < 0) {
+            return turbo::errno_to_status(errno, "create " + path);
+        }
+        SegmentHeader h{kWalMagic, first_lsn};
+        auto rs = write_fully(fd, reinterpret_cast<const uint8_t *>(&h), sizeof(h));
+        if (rs.ok() && _option.fsync && ::fdatasync(fd) != 0) {
+            rs = turbo::errno_to_status(errno, "fdatasync " + path);
+        }
+        if (rs.ok() && _option.fsync) {
+            rs = sync_dir(_dir);
+        }
+        if (!rs.ok()) {
+            ::close(fd);
+            return rs;
+        }
+        _fd = fd;
+        _segment_size = sizeof(h);
+        std::unique_lock<std::mutex> lock(_mutex);
+        _segments.emplace_back(first_lsn, std::move(path));
+        return turbo::ok_status();
+    }
+
+    turbo::Status
+    WriteAheadLog::replay(uint64_t after, const std::function<turbo::Status(const WalRecord &)> &fn) const {
+        std::vector<std::pair<uint64_t, std::string>> segments = this->segments();
+        std::vector<uint8_t> data;
+        turbo::Status rs;
+        for (std::size_t i = 0; i < segments.size() && rs.ok(); ++i) {
+            // every record of the segment is not after after
+            if (i + 1 < segments.size() && segments[i + 1].first <= after + 1) {
+                continue;
+            }
+            rs = read_file(segments[i].second, data);
+            if (!rs.ok()) {
+                return rs;
+            }
+            scan_segment(data, segments[i].first, [&](const WalRecord &r) {
+                if (r.lsn > after) {
+                    rs = fn(r);
+                }
+                return rs.ok();
+            });
+        }
+        return rs;
+    }
+
+    turbo::ResultStatus<uint64_t>
+    WriteAheadLog::append(WalOp op, label_type label, turbo::Span<const uint8_t> payload) {
+        const uint32_t payload_crc = crc32c(0, payload.data(), payload.size());
+        RecordHeader h{};
+        h.size = static_cast<uint32_t>(payload.size());
+        h.op = static_cast<uint32_t>(op);
+        h.label = label;
+        std::unique_lock<std::mutex> lock(_mutex);
+        if (!_error.ok()) {
+            return _error;
+        }
+        if (_fd < 0) {
+            return turbo::failed_precondition_error("log is not open");
+        }
+        h.lsn = ++_last_lsn;
+        h.crc = record_crc(payload_crc, h);
+        const auto offset = _buffer.size();
+        _buffer.resize(offset + sizeof(h) + payload.size());
+        std::memcpy(_buffer.data() + offset, &h, sizeof(h));
+        if (!payload.empty()) {
+            std::memcpy(_buffer.data() + offset + sizeof(h), payload.data(), payload.size());
+        }
+        _appended_bytes += sizeof(h) + payload.size();
+        return h.lsn;
+    }
+
+    turbo::Status WriteAheadLog::sync(uint64_t lsn) {
+        std::unique_lock<std::mutex> lock(_mutex);
+        lsn = std::min(lsn, _last_lsn);
+        while (_durable_lsn < lsn && _error.ok()) {
+            if (_syncing) {
+                _synced_cv.wait(lock);
+                continue;
+            }
+            // this thread writes for every writer waiting, the others wait for it
+            _syncing = true;
+            if (_option.group_commit_us > 0) {
+                lock.unlock();
+                std::this_thread::sleep_for(std::chrono::microseconds(_option.group_commit_us));
+                lock.lock();
+            }
+            std::vector<uint8_t> buffer;
+            buffer.swap(_buffer);
+            const uint64_t last = _last_lsn;
+            lock.unlock();
+            auto rs = write_out(buffer, last);
+            lock.lock();
+            _syncing = false;
+            if (rs.ok()) {
+                _durable_lsn = last;
+            } else {
+                _error = rs;
+            }
+            // keep the capacity for the next group
+            if (_buffer.empty()) {
+                buffer.clear();
+                _buffer.swap(buffer);
+            }
+            _synced_cv.notify_all();
+        }
+        return _error;
+    }
+
+    turbo::Status WriteAheadLog::write_out(const std::vector<uint8_t> &buffer, uint64_t last) {
+        if (buffer.empty()) {
+            return turbo::ok_status();
+        }
+        auto rs = write_fully(_fd, buffer.data(), buffer.size());
+        if (!rs.ok()) {
+            return rs;
+        }
+        if (_option.fsync && ::fdatasync(_fd) != 0) {
+            return turbo::errno_to_status(errno, "fdatasync log segment");
+        }
+        _segment_size += buffer.size();
+        if (_segment_size < _option.segment_bytes) {
+            return turbo::ok_status();
+        }
+        ::close(_fd);
+        _fd = -1;
+        return open_segment(last + 1);
+    }
+
+    turbo::Status WriteAheadLog::purge(uint64_t lsn) {
+        std::unique_lock<std::mutex> lock(_mutex);
+        std::size_t n = 0;
+        while (n + 1 < _segments.size() && _segments[n + 1].first <= lsn + 1) {
+            std::error_code ec;
+            std::filesystem::remove(_segments[n].second, ec);
+            if (ec) {
+                _segments.erase(_segments.begin(), _segments.begin() + n);
+                return turbo::errno_to_status(ec.value(), "remove " + _segments.front().second);
+            }
+            ++n;
+        }
+        _segments.erase(_segments.begin(), _segments.begin() + n);
+        return turbo::ok_status();
+    }
+
+    turbo::Status WriteAheadLog::close() {
+        if (_fd < 0) {
+            return turbo::ok_status();
+        }
+        auto rs = sync(last_lsn());
+        // a failed roll leaves no segment open
+        if (_fd >= 0) {
+            ::close(_fd);
+            _fd = -1;
+        }
+        return rs;
+    }
+
+    uint64_t WriteAheadLog::last_lsn() const {
+        std::unique_lock<std::mutex> lock(_mutex);
+        return _last_lsn;
+    }
+
+    uint64_t WriteAheadLog::durable_lsn() const {
+        std::unique_lock<std::mutex> lock(_mutex);
+        return _durable_lsn;
+    }
+
+    uint64_t WriteAheadLog::appended_bytes() const {
+        std::unique_lock<std::mutex> lock(_mutex);
+        return _appended_bytes;
+    }
+
+    std::vector<std::pair<uint64_t, std::string>> WriteAheadLog::segments() const {
+        std::unique_lock<std::mutex> lock(_mutex);
+        return _segments;
+    }
+
+}  // namespace zircon
@@ -0,0 +1,143 @@
+// Copyright 2023 The Elastic-AI Authors.
+// part of Elastic AI Search
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#ifndef ZIRCON_STORE_WRITE_AHEAD_LOG_H_
+#define ZIRCON_STORE_WRITE_AHEAD_LOG_H_
+
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <utility>
+#include <vector>
+#include "turbo/base/status.h"
+#include "turbo/meta/span.h"
+#include "zircon/core/defines.h"
+
+namespace zircon {
+
+    struct WalOption {
+        // the active segment is closed and a new one started once it reach it
+        uint64_t segment_bytes{64ULL << 20};
+        // a sync waits that long for more writers before it writes, 0 only
+        // groups the writers arriving while the previous sync runs.
+        uint32_t group_commit_us{0};
+        // false skips fdatasync, the records survive a crash of the process
+        // but not one of the host.
+        bool fsync{true};
+    };
+
+    enum class WalOp : uint32_t {
+        WAL_ADD = 1,
+        WAL_REMOVE = 2,
+        WAL_SET = 3,
+    };
+
+    struct WalRecord {
+        uint64_t lsn{0};
+        WalOp op{WalOp::WAL_ADD};
+        label_type label{constants::kUnknownLabel};
+        // the vector of an add or a set, empty for a remove
+        turbo::Span<const uint8_t> payload;
+    };
+
+    /**
+     * @brief append only log of the mutations of a store, in segment files
+     *        wal-<first lsn>.log of a directory. every record has a log
+     *        sequence number, the lsns are consecutive over the segments.
+     *        append only buffers the record, sync writes the buffer and
+     *        fdatasync it, the writers waiting at the same time share one
+     *        write and one fdatasync (group commit). a record is a fixed header
+     *        with a crc32c of the record, a torn record at the end of the last
+     *        segment is cut when the log is opened.
+     *        append and sync are thread safe, open, replay and close are not.
+     */
+    class WriteAheadLog {
+    public:
+        WriteAheadLog() = default;
+
+        ~WriteAheadLog();
+
+        /**
+         * @brief open the log in dir, created if missing. the segments are read
+         *        to find the last lsn, new records go to the end of the last one.
+         * @param last_lsn the lsn the log continue from if it has less records,
+         *        eg. the lsn of a snapshot whose log was purged.
+         */
+        turbo::Status open(const std::string &dir, const WalOption &option = WalOption(), uint64_t last_lsn = 0);
+
+        /**
+         * @brief call fn with the records after lsn after, in lsn order. must be
+         *        done before the first append, stop at the first error of fn.
+         */
+        turbo::Status replay(uint64_t after, const std::function<turbo::Status(const WalRecord &)> &fn) const;
+
+        // buffer a record, the returned lsn is durable once sync(lsn) returns
+        turbo::ResultStatus<uint64_t> append(WalOp op, label_type label, turbo::Span<const uint8_t> payload);
+
+        // wait until the records up to lsn are written and synced
+        turbo::Status sync(uint64_t lsn);
+
+        /**
+         * @brief remove the segments all of whose records are not after lsn, a
+         *        checkpoint up to lsn makes them useless. the active segment is
+         *        never removed.
+         */
+        turbo::Status purge(uint64_t lsn);
+
+        // sync the buffered records and close the segment
+        turbo::Status close();
+
+        [[nodiscard]] uint64_t last_lsn() const;
+
+        [[nodiscard]] uint64_t durable_lsn() const;
+
+        // bytes of the records appended since open
+        [[nodiscard]] uint64_t appended_bytes() const;
+
+        // first lsn and path of every segment, oldest first
+        [[nodiscard]] std::vector<std::pair<uint64_t, std::string>> segments() const;
+
+    private:
+        WriteAheadLog(const WriteAheadLog &) = delete;
+
+        WriteAheadLog &operator=(const WriteAheadLog &) = delete;
+
+        // write the records up to last, roll the segment if it is full. only the syncing thread
+        turbo::Status write_out(const std::vector<uint8_t> &buffer, uint64_t last);
+
+        turbo::Status open_segment(uint64_t first_lsn);
+
+    private:
+        std::string _dir;
+        WalOption _option;
+        mutable std::mutex _mutex;
+        std::condition_variable _synced_cv;
+        // guard by _mutex
+        uint64_t _last_lsn{0};
+        uint64_t _durable_lsn{0};
+        uint64_t _appended_bytes{0};
+        std::vector<uint8_t> _buffer;
+        bool _syncing{false};
+        turbo::Status _error;
+        std::vector<std::pair<uint64_t, std::string>> _segments;
+        // the active segment, written by the syncing thread only
+        int _fd{-1};
+        uint64_t _segment_size{0};
+    };
+
+}  // namespace zircon
+
+#endif  // ZIRCON_STORE_WRITE_AHEAD_LOG_H_
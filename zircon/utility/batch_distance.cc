@@ -0,0 +1,71 @@
+// Copyright 2023 The Elastic-AI Authors.
+// part of Elastic AI Search
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#include "zircon/utility/batch_distance.h"
+#include "zircon/utility/distance_dispatch.h"
+#include "turbo/log/logging.h"
+
+namespace zircon::distance {
+
+    namespace {
+        const float *batch_base(turbo::Span<float> query, const VectorBatch &batch) {
+            TLOG_CHECK(query.size() * sizeof(float) == batch.vector_byte_size(),
+                       "query dimension {} not match the batch vector bytes {}", query.size(),
+                       batch.vector_byte_size());
+            return reinterpret_cast<const float *>(batch.data());
+        }
+    }  // namespace
+
+    void batch_l1(turbo::Span<float> query, const VectorBatch &batch, float *out) {
+        distance_kernels().batch_l1(query.data(), batch_base(query, batch), query.size(), batch.size(), out);
+    }
+
+    void batch_l2(turbo::Span<float> query, const VectorBatch &batch, float *out) {
+        distance_kernels().batch_l2(query.data(), batch_base(query, batch), query.size(), batch.size(), out);
+    }
+
+    void batch_ip(turbo::Span<float> query, const VectorBatch &batch, float *out) {
+        distance_kernels().batch_ip(query.data(), batch_base(query, batch), query.size(), batch.size(), out);
+    }
+
+    void batch_poincare(turbo::Span<float> query, const VectorBatch &batch, float *out) {
+        distance_kernels().batch_poincare(query.data(), batch_base(query, batch), query.size(), batch.size(), out);
+    }
+
+    void batch_lorentz(turbo::Span<float> query, const VectorBatch &batch, float *out) {
+        distance_kernels().batch_lorentz(query.data(), batch_base(query, batch), query.size(), batch.size(), out);
+    }
+
+    void batch_l1(turbo::Span<float> query, const float *base, std::size_t n, float *out) {
+        distance_kernels().batch_l1(query.data(), base, query.size(), n, out);
+    }
+
+    void batch_l2(turbo::Span<float> query, const float *base, std::size_t n, float *out) {
+        distance_kernels().batch_l2(query.data(), base, query.size(), n, out);
+    }
+
+    void batch_ip(turbo::Span<float> query, const float *base, std::size_t n, float *out) {
+        distance_kernels().batch_ip(query.data(), base, query.size(), n, out);
+    }
+
+    void batch_poincare(turbo::Span<float> query, const float *base, std::size_t n, float *out) {
+        distance_kernels().batch_poincare(query.data(), base, query.size(), n, out);
+    }
+
+    void batch_lorentz(turbo::Span<float> query, const float *base, std::size_t n, float *out) {
+        distance_kernels().batch_lorentz(query.data(), base, query.size(), n, out);
+    }
+
+}  // namespace zircon::distance
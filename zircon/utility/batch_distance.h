@@ -0,0 +1,91 @@
+// Copyright 2023 The Elastic-AI Authors.
+// part of Elastic AI Search
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#ifndef ZIRCON_UTILITY_BATCH_DISTANCE_H_
+#define ZIRCON_UTILITY_BATCH_DISTANCE_H_
+
+#include "turbo/meta/span.h"
+#include "zircon/store/vector_batch.h"
+
+namespace zircon::distance {
+
+    /**
+     * @ingroup zircon_utility_distance
+     * @brief Compute the L1 distance between the query and every vector of the batch.
+     *        the query is loaded once for several vectors of the batch, and the
+     *        batch memory is streamed in order with prefetch.
+     * @param query The query vector, must have the dimension of the batch vectors.
+     * @param batch The float vectors to compare with.
+     * @param out The result, must have room for batch.size() floats,
+     *        out[i] is the distance of the i-th vector.
+     */
+    void batch_l1(turbo::Span<float> query, const VectorBatch &batch, float *out);
+
+    /**
+     * @ingroup zircon_utility_distance
+     * @brief Compute the squared L2 distance between the query and every vector of the batch.
+     * @param query The query vector, must have the dimension of the batch vectors.
+     * @param batch The float vectors to compare with.
+     * @param out The result, must have room for batch.size() floats.
+     */
+    void batch_l2(turbo::Span<float> query, const VectorBatch &batch, float *out);
+
+    /**
+     * @ingroup zircon_utility_distance
+     * @brief Compute the inner product between the query and every vector of the batch.
+     * @param query The query vector, must have the dimension of the batch vectors.
+     * @param batch The float vectors to compare with.
+     * @param out The result, must have room for batch.size() floats.
+     */
+    void batch_ip(turbo::Span<float> query, const VectorBatch &batch, float *out);
+
+    /**
+     * @ingroup zircon_utility_distance
+     * @brief Compute the poincare ball distance between the query and every vector of the batch.
+     *        the squared norm of the query is computed once, the one of every
+     *        vector in the same pass as its difference to the query.
+     * @param query The query vector, must have the dimension of the batch vectors.
+     * @param batch The float vectors to compare with.
+     * @param out The result, must have room for batch.size() floats.
+     */
+    void batch_poincare(turbo::Span<float> query, const VectorBatch &batch, float *out);
+
+    /**
+     * @ingroup zircon_utility_distance
+     * @brief Compute the lorentz model distance between the query and every vector of the batch.
+     * @param query The query vector, must have the dimension of the batch vectors.
+     * @param batch The float vectors to compare with.
+     * @param out The result, must have room for batch.size() floats.
+     */
+    void batch_lorentz(turbo::Span<float> query, const VectorBatch &batch, float *out);
+
+    /**
+     * @ingroup zircon_utility_distance
+     * @brief the same as the VectorBatch version, for n vectors stored contiguously
+     *        in base, with the dimension of the query.
+     */
+    void batch_l1(turbo::Span<float> query, const float *base, std::size_t n, float *out);
+
+    void batch_l2(turbo::Span<float> query, const float *base, std::size_t n, float *out);
+
+    void batch_ip(turbo::Span<float> query, const float *base, std::size_t n, float *out);
+
+    void batch_poincare(turbo::Span<float> query, const float *base, std::size_t n, float *out);
+
+    void batch_lorentz(turbo::Span<float> query, const float *base, std::size_t n, float *out);
+
+}  // namespace zircon::distance
+
+#endif  // ZIRCON_UTILITY_BATCH_DISTANCE_H_
@@ -24,6 +24,7 @@
 #include "turbo/log/logging.h"
 #include "turbo/base/bits.h"
 #include "zircon/core/metric_type.h"
+#include "zircon/utility/primitive_distance.h"
 
 namespace zircon {
 
@@ -34,6 +35,85 @@ namespace zircon {
         void normalize(turbo::Span<float> a) const;
     };
 
+    /// all the specializations return a distance, the smaller the closer.
+
+    template<>
+    struct VectorDistance<MetricType::METRIC_L1> {
+        float distance(turbo::Span<float> a, turbo::Span<float> b) const {
+            return distance::distance_l1(a, b);
+        }
+    };
+
+    template<>
+    struct VectorDistance<MetricType::METRIC_L2> {
+        float distance(turbo::Span<float> a, turbo::Span<float> b) const {
+            return distance::distance_l2(a, b);
+        }
+    };
+
+    template<>
+    struct VectorDistance<MetricType::METRIC_IP> {
+        // negative inner product, so that the smaller the closer.
+        float distance(turbo::Span<float> a, turbo::Span<float> b) const {
+            return -distance::distance_ip(a, b);
+        }
+    };
+
+    template<>
+    struct VectorDistance<MetricType::METRIC_COSINE> {
+        float distance(turbo::Span<float> a, turbo::Span<float> b) const {
+            return distance::distance_cosine(a, b);
+        }
+
+        // cosine does not depend on the norms, a normalized vector keeps its distances.
+        void normalize(turbo::Span<float> a) const {
+            distance::normalize_l2(a);
+        }
+    };
+
+    template<>
+    struct VectorDistance<MetricType::METRIC_NORMALIZED_COSINE> {
+        // the vectors are unit length, cosine is just the inner product.
+        float distance(turbo::Span<float> a, turbo::Span<float> b) const {
+            return 1.0f - distance::distance_ip(a, b);
+        }
+
+        // bring a vector to unit length before it is stored or searched.
+        void normalize(turbo::Span<float> a) const {
+            distance::normalize_l2(a);
+        }
+    };
+
+    template<>
+    struct VectorDistance<MetricType::METRIC_POINCARE> {
+        // the vectors are points of the unit ball.
+        float distance(turbo::Span<float> a, turbo::Span<float> b) const {
+            return distance::distance_poincare(a, b);
+        }
+    };
+
+    template<>
+    struct VectorDistance<MetricType::METRIC_LORENTZ> {
+        // the vectors are points of the hyperboloid, the first coordinate is the time one.
+        float distance(turbo::Span<float> a, turbo::Span<float> b) const {
+            return distance::distance_lorentz(a, b);
+        }
+    };
+
+    template<>
+    struct VectorDistance<MetricType::METRIC_HAMMING> {
+        float distance(turbo::Span<uint8_t> a, turbo::Span<uint8_t> b) const {
+            return distance::distance_hamming(a, b);
+        }
+    };
+
+    template<>
+    struct VectorDistance<MetricType::METRIC_JACCARD> {
+        float distance(turbo::Span<uint8_t> a, turbo::Span<uint8_t> b) const {
+            return distance::distance_jaccard(a, b);
+        }
+    };
+
 
 }  // namespace zircon
 
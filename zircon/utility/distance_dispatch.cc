@@ -0,0 +1,92 @@
+// Copyright 2023 The Elastic-AI Authors.
+// part of Elastic AI Search
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#include "zircon/utility/distance_dispatch.h"
+#include <cstdlib>
+#include <cstring>
+
+namespace zircon::distance {
+
+    namespace {
+
+        [[maybe_unused]] bool cpu_support_avx2() {
+#if defined(__x86_64__) || defined(_M_X64)
+            return __builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma") &&
+                   __builtin_cpu_supports("popcnt") && __builtin_cpu_supports("f16c");
+#else
+            return false;
+#endif
+        }
+
+        [[maybe_unused]] bool cpu_support_avx512() {
+#if defined(__x86_64__) || defined(_M_X64)
+            return cpu_support_avx2() && __builtin_cpu_supports("avx512f") &&
+                   __builtin_cpu_supports("avx512bw") && __builtin_cpu_supports("avx512dq") &&
+                   __builtin_cpu_supports("avx512vl");
+#else
+            return false;
+#endif
+        }
+
+        [[maybe_unused]] bool cpu_support_avx512_vpopcnt() {
+#if defined(__x86_64__) || defined(_M_X64)
+            return cpu_support_avx512() && __builtin_cpu_supports("avx512vpopcntdq");
+#else
+            return false;
+#endif
+        }
+
+        const DistanceKernels *select_kernels() {
+            auto kernels = available_distance_kernels();
+            const char *force = std::getenv("ZIRCON_SIMD_ARCH");
+            if (force != nullptr) {
+                for (auto *k : kernels) {
+                    if (std::strcmp(k->arch_name, force) == 0) {
+                        return k;
+                    }
+                }
+            }
+            return kernels.back();
+        }
+    }  // namespace
+
+    std::vector<const DistanceKernels *> available_distance_kernels() {
+        std::vector<const DistanceKernels *> kernels;
+#if defined(__x86_64__) || defined(_M_X64)
+        kernels.push_back(detail::sse2_distance_kernels());
+        if (cpu_support_avx2()) {
+            kernels.push_back(detail::avx2_distance_kernels());
+        }
+        if (cpu_support_avx512()) {
+            kernels.push_back(detail::avx512_distance_kernels());
+        }
+        if (cpu_support_avx512_vpopcnt()) {
+            kernels.push_back(detail::avx512_vpopcnt_distance_kernels());
+        }
+#elif defined(__aarch64__) || defined(_M_ARM64)
+        // neon is mandatory on aarch64
+        kernels.push_back(detail::neon_distance_kernels());
+#else
+        kernels.push_back(detail::generic_distance_kernels());
+#endif
+        return kernels;
+    }
+
+    const DistanceKernels &distance_kernels() {
+        static const DistanceKernels *kernels = select_kernels();
+        return *kernels;
+    }
+
+}  // namespace zircon::distance
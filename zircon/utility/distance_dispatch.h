@@ -0,0 +1,155 @@
+// Copyright 2023 The Elastic-AI Authors.
+// part of Elastic AI Search
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#ifndef ZIRCON_UTILITY_DISTANCE_DISPATCH_H_
+#define ZIRCON_UTILITY_DISTANCE_DISPATCH_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace zircon::distance {
+
+    typedef float (*float_distance_func)(const float *a, const float *b, std::size_t size);
+
+    typedef float (*binary_distance_func)(const uint8_t *a, const uint8_t *b, std::size_t nbytes);
+
+    // query against n vectors of dim floats stored one after another in base,
+    // out[i] is the distance between query and the i-th vector.
+    typedef void (*batch_distance_func)(const float *query, const float *base, std::size_t dim, std::size_t n,
+                                        float *out);
+
+    // packed bits query against n codes of nbytes stored one after another in base,
+    // out[i] is the binary distance between query and the i-th code.
+    typedef void (*batch_binary_distance_func)(const uint8_t *query, const uint8_t *base, std::size_t nbytes,
+                                               std::size_t n, float *out);
+
+    // nq queries against nb vectors, both stored one after another with dim floats,
+    // out[i * ldo + j] is the distance between the i-th query and the j-th vector.
+    typedef void (*matrix_distance_func)(const float *queries, std::size_t nq, const float *base, std::size_t nb,
+                                         std::size_t dim, float *out, std::size_t ldo);
+
+    // float query against a sq8 code, the code decode to vmin[i] + code[i] * scale[i].
+    typedef float (*sq8_distance_func)(const float *query, const uint8_t *code, const float *vmin,
+                                       const float *scale, std::size_t dim);
+
+    // float query against a half float code.
+    typedef float (*fp16_distance_func)(const float *query, const uint16_t *code, std::size_t dim);
+
+    // 4 bit pq fast scan over blocks of 32 codes. a block holds m groups of 16 bytes,
+    // byte j of group q is the code of vector j in the low nibble and of vector
+    // j + 16 in the high nibble. lut is m groups of 16 uint8 distances.
+    // out[b * 32 + j] is the summed distance of vector j in block b.
+    typedef void (*pq4_scan_func)(const uint8_t *codes, std::size_t nblocks, std::size_t m, const uint8_t *lut,
+                                  uint16_t *out);
+
+    // bit i of mask set if lo <= values[i] <= hi, mask has (n + 63) / 64 words, overwritten.
+    typedef void (*range_mask_func)(const uint64_t *values, std::size_t n, uint64_t lo, uint64_t hi,
+                                    uint64_t *mask);
+
+    /**
+     * @ingroup zircon_utility_distance
+     * @brief table of the distance kernels built for one instruction set.
+     *        every instruction set the target cpu family may have is built
+     *        into the library, the best one the running cpu supports is
+     *        picked once at startup, see distance_kernels().
+     */
+    struct DistanceKernels {
+        const char *arch_name{nullptr};
+        /// SUM(|a[i] - b[i]|)
+        float_distance_func l1{nullptr};
+        /// SUM((a[i] - b[i])^2), squared l2
+        float_distance_func l2{nullptr};
+        /// SUM(a[i] * b[i])
+        float_distance_func ip{nullptr};
+        /// 1 - ip(a, b) / (|a| * |b|)
+        float_distance_func cosine{nullptr};
+        /// acosh(1 + 2|a - b|^2 / ((1 - |a|^2)(1 - |b|^2))), points of the unit poincare ball
+        float_distance_func poincare{nullptr};
+        /// acosh(-<a, b>_L), points of the hyperboloid with a[0] the time coordinate
+        float_distance_func lorentz{nullptr};
+        /// popcount(a ^ b) over packed bits
+        binary_distance_func hamming{nullptr};
+        /// 1 - popcount(a & b) / popcount(a | b) over packed bits
+        binary_distance_func jaccard{nullptr};
+        /// one to many version of hamming, the first pass of binary codes
+        batch_binary_distance_func batch_hamming{nullptr};
+        /// one to many version of l1
+        batch_distance_func batch_l1{nullptr};
+        /// one to many version of l2
+        batch_distance_func batch_l2{nullptr};
+        /// one to many version of ip
+        batch_distance_func batch_ip{nullptr};
+        /// one to many version of poincare
+        batch_distance_func batch_poincare{nullptr};
+        /// one to many version of lorentz
+        batch_distance_func batch_lorentz{nullptr};
+        /// many to many version of l1, tiled with register blocks
+        matrix_distance_func matrix_l1{nullptr};
+        /// many to many version of l2, tiled with register blocks
+        matrix_distance_func matrix_l2{nullptr};
+        /// many to many version of ip, tiled with register blocks
+        matrix_distance_func matrix_ip{nullptr};
+        /// squared l2 of a float query and a sq8 code
+        sq8_distance_func sq8_l2{nullptr};
+        /// ip of a float query and a sq8 code
+        sq8_distance_func sq8_ip{nullptr};
+        /// squared l2 of a float query and a fp16 code
+        fp16_distance_func fp16_l2{nullptr};
+        /// ip of a float query and a fp16 code
+        fp16_distance_func fp16_ip{nullptr};
+        /// 4 bit pq fast scan with byte shuffles
+        pq4_scan_func pq4_scan{nullptr};
+        /// label range check of the id filters
+        range_mask_func range_mask{nullptr};
+    };
+
+    /**
+     * @ingroup zircon_utility_distance
+     * @brief the kernels selected for the running cpu. the selection is done once,
+     *        the environment variable ZIRCON_SIMD_ARCH (sse2, avx2, avx512,
+     *        avx512_vpopcnt, neon) force a lower instruction set if the cpu
+     *        support it.
+     * @return the selected kernel table.
+     */
+    const DistanceKernels &distance_kernels();
+
+    /**
+     * @ingroup zircon_utility_distance
+     * @brief all kernel tables built in and supported by the running cpu,
+     *        ordered from the baseline to the best one. mainly for testing.
+     */
+    std::vector<const DistanceKernels *> available_distance_kernels();
+
+    namespace detail {
+#if defined(__x86_64__) || defined(_M_X64)
+        const DistanceKernels *sse2_distance_kernels();
+
+        const DistanceKernels *avx2_distance_kernels();
+
+        const DistanceKernels *avx512_distance_kernels();
+
+        // the avx512 table with the binary kernels on VPOPCNTDQ
+        const DistanceKernels *avx512_vpopcnt_distance_kernels();
+#elif defined(__aarch64__) || defined(_M_ARM64)
+        const DistanceKernels *neon_distance_kernels();
+#else
+        const DistanceKernels *generic_distance_kernels();
+#endif
+    }  // namespace detail
+
+}  // namespace zircon::distance
+
+#endif  // ZIRCON_UTILITY_DISTANCE_DISPATCH_H_
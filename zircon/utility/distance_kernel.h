@@ -0,0 +1,872 @@
+// Copyright 2023 The Elastic-AI Authors.
+// part of Elastic AI Search
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#ifndef ZIRCON_UTILITY_DISTANCE_KERNEL_H_
+#define ZIRCON_UTILITY_DISTANCE_KERNEL_H_
+
+// arch templated kernels, this header is only included by the
+// utility/kernel/distance_<arch>.cc translation units, every one of them
+// is compiled with its own instruction set flags. do not include it from
+// code built with the baseline flags, call through distance_kernels() instead.
+
+#include <cstdint>
+#include <cstring>
+#include <cmath>
+#include <algorithm>
+#include "turbo/simd/simd.h"
+#include "turbo/memory/prefetch.h"
+#include "zircon/utility/distance_dispatch.h"
+#include "zircon/utility/float16.h"
+#if defined(__x86_64__) || defined(_M_X64)
+#include <immintrin.h>
+#elif defined(__aarch64__)
+#include <arm_neon.h>
+#endif
+
+namespace zircon::distance::detail {
+
+    template<typename Arch>
+    float l1_kernel(const float *a, const float *b, std::size_t size) {
+        using b_type = turbo::simd::batch<float, Arch>;
+        constexpr std::size_t inc = b_type::size;
+        std::size_t i = 0;
+        b_type sum0 = b_type::broadcast(0.0f);
+        b_type sum1 = b_type::broadcast(0.0f);
+        for (; i + 2 * inc <= size; i += 2 * inc) {
+            sum0 += turbo::simd::fabs(b_type::load_unaligned(a + i) - b_type::load_unaligned(b + i));
+            sum1 += turbo::simd::fabs(b_type::load_unaligned(a + i + inc) - b_type::load_unaligned(b + i + inc));
+        }
+        for (; i + inc <= size; i += inc) {
+            sum0 += turbo::simd::fabs(b_type::load_unaligned(a + i) - b_type::load_unaligned(b + i));
+        }
+        float sum = turbo::simd::reduce_add(sum0 + sum1);
+        for (; i < size; ++i) {
+            sum += std::fabs(a[i] - b[i]);
+        }
+        return sum;
+    }
+
+    template<typename Arch>
+    float l2_kernel(const float *a, const float *b, std::size_t size) {
+        using b_type = turbo::simd::batch<float, Arch>;
+        constexpr std::size_t inc = b_type::size;
+        std::size_t i = 0;
+        b_type sum0 = b_type::broadcast(0.0f);
+        b_type sum1 = b_type::broadcast(0.0f);
+        for (; i + 2 * inc <= size; i += 2 * inc) {
+            b_type d0 = b_type::load_unaligned(a + i) - b_type::load_unaligned(b + i);
+            b_type d1 = b_type::load_unaligned(a + i + inc) - b_type::load_unaligned(b + i + inc);
+            sum0 = turbo::simd::fma(d0, d0, sum0);
+            sum1 = turbo::simd::fma(d1, d1, sum1);
+        }
+        for (; i + inc <= size; i += inc) {
+            b_type d0 = b_type::load_unaligned(a + i) - b_type::load_unaligned(b + i);
+            sum0 = turbo::simd::fma(d0, d0, sum0);
+        }
+        float sum = turbo::simd::reduce_add(sum0 + sum1);
+        for (; i < size; ++i) {
+            float d = a[i] - b[i];
+            sum += d * d;
+        }
+        return sum;
+    }
+
+    template<typename Arch>
+    float ip_kernel(const float *a, const float *b, std::size_t size) {
+        using b_type = turbo::simd::batch<float, Arch>;
+        constexpr std::size_t inc = b_type::size;
+        std::size_t i = 0;
+        b_type sum0 = b_type::broadcast(0.0f);
+        b_type sum1 = b_type::broadcast(0.0f);
+        for (; i + 2 * inc <= size; i += 2 * inc) {
+            sum0 = turbo::simd::fma(b_type::load_unaligned(a + i), b_type::load_unaligned(b + i), sum0);
+            sum1 = turbo::simd::fma(b_type::load_unaligned(a + i + inc), b_type::load_unaligned(b + i + inc), sum1);
+        }
+        for (; i + inc <= size; i += inc) {
+            sum0 = turbo::simd::fma(b_type::load_unaligned(a + i), b_type::load_unaligned(b + i), sum0);
+        }
+        float sum = turbo::simd::reduce_add(sum0 + sum1);
+        for (; i < size; ++i) {
+            sum += a[i] * b[i];
+        }
+        return sum;
+    }
+
+    // dot(a, b), |a|^2 and |b|^2 in one pass over the memory.
+    template<typename Arch>
+    float cosine_kernel(const float *a, const float *b, std::size_t size) {
+        using b_type = turbo::simd::batch<float, Arch>;
+        constexpr std::size_t inc = b_type::size;
+        std::size_t i = 0;
+        b_type ab = b_type::broadcast(0.0f);
+        b_type aa = b_type::broadcast(0.0f);
+        b_type bb = b_type::broadcast(0.0f);
+        for (; i + inc <= size; i += inc) {
+            b_type avec = b_type::load_unaligned(a + i);
+            b_type bvec = b_type::load_unaligned(b + i);
+            ab = turbo::simd::fma(avec, bvec, ab);
+            aa = turbo::simd::fma(avec, avec, aa);
+            bb = turbo::simd::fma(bvec, bvec, bb);
+        }
+        float dot = turbo::simd::reduce_add(ab);
+        float na = turbo::simd::reduce_add(aa);
+        float nb = turbo::simd::reduce_add(bb);
+        for (; i < size; ++i) {
+            dot += a[i] * b[i];
+            na += a[i] * a[i];
+            nb += b[i] * b[i];
+        }
+        float norm = na * nb;
+        if (norm <= 0.0f) {
+            return 1.0f;
+        }
+        return 1.0f - dot / std::sqrt(norm);
+    }
+
+    // points of the poincare ball on or beyond the boundary are taken at
+    // this distance inside it, so they get a large but finite distance.
+    static constexpr float kPoincareBoundaryEps = 1e-7f;
+
+    // acosh(1 + t) for t >= 0. log1p keeps the small distances that acosh(z)
+    // loses to the rounding of z - 1, the large t branch keeps t * t from
+    // overflowing, acosh(1 + t) is log(2 + 2t) there to the float precision.
+    template<typename Arch>
+    inline float acosh1p(float t) {
+        if (t > 1e6f) {
+            return std::log(2.0f * t + 2.0f);
+        }
+        return std::log1p(t + std::sqrt(t * (t + 2.0f)));
+    }
+
+    // acosh(1 + 2 |a - b|^2 / ((1 - |a|^2)(1 - |b|^2))) from the squared
+    // difference and the squared norms.
+    template<typename Arch>
+    inline float poincare_from_parts(float diff, float aa, float bb) {
+        float ca = std::max(1.0f - aa, kPoincareBoundaryEps);
+        float cb = std::max(1.0f - bb, kPoincareBoundaryEps);
+        return acosh1p<Arch>(2.0f * diff / (ca * cb));
+    }
+
+    // points on the hyperboloid, a[0] the time coordinate. -<a, b>_L - 1 is
+    // (|a - b|^2 - 2 (a[0] - b[0])^2) / 2 there, taken from the differences
+    // it does not cancel for close points like the lorentz product does.
+    template<typename Arch>
+    inline float lorentz_from_l2(float l2, float a0, float b0) {
+        float d0 = a0 - b0;
+        return acosh1p<Arch>(std::max(0.0f, 0.5f * (l2 - 2.0f * d0 * d0)));
+    }
+
+    // |a - b|^2, |a|^2 and |b|^2 in one pass over the memory.
+    template<typename Arch>
+    float poincare_kernel(const float *a, const float *b, std::size_t size) {
+        using b_type = turbo::simd::batch<float, Arch>;
+        constexpr std::size_t inc = b_type::size;
+        std::size_t i = 0;
+        b_type dd = b_type::broadcast(0.0f);
+        b_type aa = b_type::broadcast(0.0f);
+        b_type bb = b_type::broadcast(0.0f);
+        for (; i + inc <= size; i += inc) {
+            b_type avec = b_type::load_unaligned(a + i);
+            b_type bvec = b_type::load_unaligned(b + i);
+            b_type d = avec - bvec;
+            dd = turbo::simd::fma(d, d, dd);
+            aa = turbo::simd::fma(avec, avec, aa);
+            bb = turbo::simd::fma(bvec, bvec, bb);
+        }
+        float diff = turbo::simd::reduce_add(dd);
+        float na = turbo::simd::reduce_add(aa);
+        float nb = turbo::simd::reduce_add(bb);
+        for (; i < size; ++i) {
+            float d = a[i] - b[i];
+            diff += d * d;
+            na += a[i] * a[i];
+            nb += b[i] * b[i];
+        }
+        return poincare_from_parts<Arch>(diff, na, nb);
+    }
+
+    template<typename Arch>
+    float lorentz_kernel(const float *a, const float *b, std::size_t size) {
+        if (size == 0) {
+            return 0.0f;
+        }
+        return lorentz_from_l2<Arch>(l2_kernel<Arch>(a, b, size), a[0], b[0]);
+    }
+
+    // helpers are templated on the arch as well, so every translation unit
+    // keeps its own copy compiled with its own flags.
+    template<typename Arch>
+    inline uint64_t load_word(const uint8_t *p) {
+        uint64_t w;
+        std::memcpy(&w, p, sizeof(w));
+        return w;
+    }
+
+#if defined(__aarch64__)
+    // bytes counts of vcntq_u8 widened pairwise, a uint16 lane take 32 steps
+    // of 16 bytes without overflow, so the sum is flushed every 32 steps.
+    template<typename F>
+    inline uint64_t neon_popcount_sum(std::size_t nsteps, F &&bytes) {
+        uint64_t count = 0;
+        std::size_t s = 0;
+        while (s < nsteps) {
+            const std::size_t end = std::min(nsteps, s + 32);
+            uint16x8_t acc = vdupq_n_u16(0);
+            for (; s < end; ++s) {
+                acc = vpadalq_u8(acc, vcntq_u8(bytes(s)));
+            }
+            count += vaddlvq_u16(acc);
+        }
+        return count;
+    }
+#endif
+
+    template<typename Arch>
+    float hamming_kernel(const uint8_t *a, const uint8_t *b, std::size_t nbytes) {
+        uint64_t c0 = 0;
+        uint64_t c1 = 0;
+        std::size_t i = 0;
+#if defined(__aarch64__)
+        c0 = neon_popcount_sum(nbytes / 16, [a, b](std::size_t s) {
+            return veorq_u8(vld1q_u8(a + s * 16), vld1q_u8(b + s * 16));
+        });
+        i = nbytes - nbytes % 16;
+#endif
+        for (; i + 16 <= nbytes; i += 16) {
+            c0 += __builtin_popcountll(load_word<Arch>(a + i) ^ load_word<Arch>(b + i));
+            c1 += __builtin_popcountll(load_word<Arch>(a + i + 8) ^ load_word<Arch>(b + i + 8));
+        }
+        for (; i + 8 <= nbytes; i += 8) {
+            c0 += __builtin_popcountll(load_word<Arch>(a + i) ^ load_word<Arch>(b + i));
+        }
+        for (; i < nbytes; ++i) {
+            c1 += __builtin_popcount(static_cast<unsigned>(a[i] ^ b[i]));
+        }
+        return static_cast<float>(c0 + c1);
+    }
+
+    template<typename Arch>
+    float jaccard_kernel(const uint8_t *a, const uint8_t *b, std::size_t nbytes) {
+        uint64_t inter = 0;
+        uint64_t uni = 0;
+        std::size_t i = 0;
+#if defined(__aarch64__)
+        inter = neon_popcount_sum(nbytes / 16, [a, b](std::size_t s) {
+            return vandq_u8(vld1q_u8(a + s * 16), vld1q_u8(b + s * 16));
+        });
+        uni = neon_popcount_sum(nbytes / 16, [a, b](std::size_t s) {
+            return vorrq_u8(vld1q_u8(a + s * 16), vld1q_u8(b + s * 16));
+        });
+        i = nbytes - nbytes % 16;
+#endif
+        for (; i + 8 <= nbytes; i += 8) {
+            uint64_t wa = load_word<Arch>(a + i);
+            uint64_t wb = load_word<Arch>(b + i);
+            inter += __builtin_popcountll(wa & wb);
+            uni += __builtin_popcountll(wa | wb);
+        }
+        for (; i < nbytes; ++i) {
+            inter += __builtin_popcount(static_cast<unsigned>(a[i] & b[i]));
+            uni += __builtin_popcount(static_cast<unsigned>(a[i] | b[i]));
+        }
+        if (uni == 0) {
+            return 0.0f;
+        }
+        return 1.0f - static_cast<float>(inter) / static_cast<float>(uni);
+    }
+
+    template<typename Arch>
+    inline void prefetch_bytes(const void *ptr, std::size_t nbytes) {
+        auto p = static_cast<const char *>(ptr);
+        for (std::size_t i = 0; i < nbytes; i += 64) {
+            turbo::prefetch_to_local_cache(p + i);
+        }
+    }
+
+    // one packed query against n codes of nbytes stored one after another.
+    template<typename Arch>
+    void batch_hamming_kernel(const uint8_t *query, const uint8_t *base, std::size_t nbytes, std::size_t n,
+                              float *out) {
+        constexpr std::size_t kAhead = 8;
+        for (std::size_t j = 0; j < n; ++j) {
+            if (j % kAhead == 0 && j + kAhead < n) {
+                prefetch_bytes<Arch>(base + (j + kAhead) * nbytes, std::min(kAhead, n - j - kAhead) * nbytes);
+            }
+            out[j] = hamming_kernel<Arch>(query, base + j * nbytes, nbytes);
+        }
+    }
+
+    template<typename Arch>
+    struct L1Op {
+        using b_type = turbo::simd::batch<float, Arch>;
+
+        static b_type accumulate(const b_type &q, const b_type &x, const b_type &acc) {
+            return acc + turbo::simd::fabs(q - x);
+        }
+
+        static float accumulate(float q, float x, float acc) {
+            return acc + std::fabs(q - x);
+        }
+    };
+
+    template<typename Arch>
+    struct L2Op {
+        using b_type = turbo::simd::batch<float, Arch>;
+
+        static b_type accumulate(const b_type &q, const b_type &x, const b_type &acc) {
+            b_type d = q - x;
+            return turbo::simd::fma(d, d, acc);
+        }
+
+        static float accumulate(float q, float x, float acc) {
+            float d = q - x;
+            return acc + d * d;
+        }
+    };
+
+    template<typename Arch>
+    struct IpOp {
+        using b_type = turbo::simd::batch<float, Arch>;
+
+        static b_type accumulate(const b_type &q, const b_type &x, const b_type &acc) {
+            return turbo::simd::fma(q, x, acc);
+        }
+
+        static float accumulate(float q, float x, float acc) {
+            return acc + q * x;
+        }
+    };
+
+    // one query against n contiguous vectors. four base vectors are scored per
+    // pass, so each query register is loaded once for four vectors, and the next
+    // four vectors are prefetched while the current ones are computed.
+    template<typename Arch, template<typename> class Op>
+    void batch_kernel(const float *query, const float *base, std::size_t dim, std::size_t n, float *out) {
+        using b_type = turbo::simd::batch<float, Arch>;
+        using op = Op<Arch>;
+        constexpr std::size_t inc = b_type::size;
+        constexpr std::size_t kRows = 4;
+        const std::size_t vec_size = dim - dim % inc;
+        const std::size_t row_bytes = dim * sizeof(float);
+        std::size_t j = 0;
+        for (; j + kRows <= n; j += kRows) {
+            const float *x0 = base + j * dim;
+            const float *x1 = x0 + dim;
+            const float *x2 = x1 + dim;
+            const float *x3 = x2 + dim;
+            if (j + kRows < n) {
+                std::size_t ahead = std::min(kRows, n - j - kRows);
+                prefetch_bytes<Arch>(x0 + kRows * dim, ahead * row_bytes);
+            }
+            b_type s0 = b_type::broadcast(0.0f);
+            b_type s1 = b_type::broadcast(0.0f);
+            b_type s2 = b_type::broadcast(0.0f);
+            b_type s3 = b_type::broadcast(0.0f);
+            for (std::size_t i = 0; i < vec_size; i += inc) {
+                b_type q = b_type::load_unaligned(query + i);
+                s0 = op::accumulate(q, b_type::load_unaligned(x0 + i), s0);
+                s1 = op::accumulate(q, b_type::load_unaligned(x1 + i), s1);
+                s2 = op::accumulate(q, b_type::load_unaligned(x2 + i), s2);
+                s3 = op::accumulate(q, b_type::load_unaligned(x3 + i), s3);
+            }
+            float r0 = turbo::simd::reduce_add(s0);
+            float r1 = turbo::simd::reduce_add(s1);
+            float r2 = turbo::simd::reduce_add(s2);
+            float r3 = turbo::simd::reduce_add(s3);
+            for (std::size_t i = vec_size; i < dim; ++i) {
+                r0 = op::accumulate(query[i], x0[i], r0);
+                r1 = op::accumulate(query[i], x1[i], r1);
+                r2 = op::accumulate(query[i], x2[i], r2);
+                r3 = op::accumulate(query[i], x3[i], r3);
+            }
+            out[j] = r0;
+            out[j + 1] = r1;
+            out[j + 2] = r2;
+            out[j + 3] = r3;
+        }
+        for (; j < n; ++j) {
+            const float *x = base + j * dim;
+            b_type s = b_type::broadcast(0.0f);
+            for (std::size_t i = 0; i < vec_size; i += inc) {
+                s = op::accumulate(b_type::load_unaligned(query + i), b_type::load_unaligned(x + i), s);
+            }
+            float r = turbo::simd::reduce_add(s);
+            for (std::size_t i = vec_size; i < dim; ++i) {
+                r = op::accumulate(query[i], x[i], r);
+            }
+            out[j] = r;
+        }
+    }
+
+    // one query against n contiguous poincare points. the squared norm of the
+    // query is computed once, the squared norm of every base vector in the same
+    // pass as its difference to the query, so each of them is read once.
+    template<typename Arch>
+    void batch_poincare_kernel(const float *query, const float *base, std::size_t dim, std::size_t n,
+                               float *out) {
+        using b_type = turbo::simd::batch<float, Arch>;
+        constexpr std::size_t inc = b_type::size;
+        constexpr std::size_t kRows = 4;
+        const std::size_t vec_size = dim - dim % inc;
+        const std::size_t row_bytes = dim * sizeof(float);
+        const float qq = ip_kernel<Arch>(query, query, dim);
+        std::size_t j = 0;
+        for (; j + kRows <= n; j += kRows) {
+            const float *x[kRows] = {base + j * dim, base + (j + 1) * dim, base + (j + 2) * dim,
+                                     base + (j + 3) * dim};
+            if (j + kRows < n) {
+                std::size_t ahead = std::min(kRows, n - j - kRows);
+                prefetch_bytes<Arch>(x[0] + kRows * dim, ahead * row_bytes);
+            }
+            b_type dd[kRows];
+            b_type xx[kRows];
+            for (std::size_t r = 0; r < kRows; ++r) {
+                dd[r] = b_type::broadcast(0.0f);
+                xx[r] = b_type::broadcast(0.0f);
+            }
+            for (std::size_t i = 0; i < vec_size; i += inc) {
+                b_type q = b_type::load_unaligned(query + i);
+                for (std::size_t r = 0; r < kRows; ++r) {
+                    b_type v = b_type::load_unaligned(x[r] + i);
+                    b_type d = q - v;
+                    dd[r] = turbo::simd::fma(d, d, dd[r]);
+                    xx[r] = turbo::simd::fma(v, v, xx[r]);
+                }
+            }
+            for (std::size_t r = 0; r < kRows; ++r) {
+                float diff = turbo::simd::reduce_add(dd[r]);
+                float norm = turbo::simd::reduce_add(xx[r]);
+                for (std::size_t i = vec_size; i < dim; ++i) {
+                    float d = query[i] - x[r][i];
+                    diff += d * d;
+                    norm += x[r][i] * x[r][i];
+                }
+                out[j + r] = poincare_from_parts<Arch>(diff, qq, norm);
+            }
+        }
+        for (; j < n; ++j) {
+            out[j] = poincare_kernel<Arch>(query, base + j * dim, dim);
+        }
+    }
+
+    // the squared l2 of the batch kernel, corrected by the time coordinates.
+    template<typename Arch>
+    void batch_lorentz_kernel(const float *query, const float *base, std::size_t dim, std::size_t n,
+                              float *out) {
+        if (dim == 0) {
+            std::fill(out, out + n, 0.0f);
+            return;
+        }
+        batch_kernel<Arch, L2Op>(query, base, dim, n, out);
+        for (std::size_t j = 0; j < n; ++j) {
+            out[j] = lorentz_from_l2<Arch>(out[j], query[0], base[j * dim]);
+        }
+    }
+
+    // base vectors of one tile are kept hot in l2 while every query block is run over them.
+    static constexpr std::size_t kMatrixTileBytes = 256 * 1024;
+
+    // MR queries x NR base vectors register block, the NR base registers of a step
+    // are reused by MR queries and every query register by NR base vectors.
+    template<typename Arch, template<typename> class Op, std::size_t MR, std::size_t NR>
+    inline void matrix_micro_kernel(const float *queries, const float *base, std::size_t dim,
+                                    float *out, std::size_t ldo) {
+        using b_type = turbo::simd::batch<float, Arch>;
+        using op = Op<Arch>;
+        constexpr std::size_t inc = b_type::size;
+        const std::size_t vec_size = dim - dim % inc;
+        b_type acc[MR][NR];
+        for (std::size_t m = 0; m < MR; ++m) {
+            for (std::size_t n = 0; n < NR; ++n) {
+                acc[m][n] = b_type::broadcast(0.0f);
+            }
+        }
+        for (std::size_t i = 0; i < vec_size; i += inc) {
+            b_type x[NR];
+            for (std::size_t n = 0; n < NR; ++n) {
+                x[n] = b_type::load_unaligned(base + n * dim + i);
+            }
+            for (std::size_t m = 0; m < MR; ++m) {
+                b_type q = b_type::load_unaligned(queries + m * dim + i);
+                for (std::size_t n = 0; n < NR; ++n) {
+                    acc[m][n] = op::accumulate(q, x[n], acc[m][n]);
+                }
+            }
+        }
+        for (std::size_t m = 0; m < MR; ++m) {
+            const float *q = queries + m * dim;
+            for (std::size_t n = 0; n < NR; ++n) {
+                const float *x = base + n * dim;
+                float r = turbo::simd::reduce_add(acc[m][n]);
+                for (std::size_t i = vec_size; i < dim; ++i) {
+                    r = op::accumulate(q[i], x[i], r);
+                }
+                out[m * ldo + n] = r;
+            }
+        }
+    }
+
+    template<typename Arch, template<typename> class Op>
+    void matrix_kernel(const float *queries, std::size_t nq, const float *base, std::size_t nb, std::size_t dim,
+                       float *out, std::size_t ldo) {
+        // 32 registers with avx512, room for a 4x4 block, 2x4 for the 16 registers ones.
+        constexpr std::size_t MR = Arch::alignment() >= 64 ? 4 : 2;
+        constexpr std::size_t NR = 4;
+        const std::size_t row_bytes = dim * sizeof(float);
+        const std::size_t tile = std::max(NR, kMatrixTileBytes / row_bytes / NR * NR);
+        for (std::size_t jb = 0; jb < nb; jb += tile) {
+            const std::size_t nt = std::min(tile, nb - jb);
+            const std::size_t nt_main = nt - nt % NR;
+            const float *bt = base + jb * dim;
+            std::size_t i = 0;
+            for (; i + MR <= nq; i += MR) {
+                const float *qb = queries + i * dim;
+                float *ob = out + i * ldo + jb;
+                for (std::size_t j = 0; j < nt_main; j += NR) {
+                    matrix_micro_kernel<Arch, Op, MR, NR>(qb, bt + j * dim, dim, ob + j, ldo);
+                }
+                if (nt_main < nt) {
+                    for (std::size_t m = 0; m < MR; ++m) {
+                        batch_kernel<Arch, Op>(qb + m * dim, bt + nt_main * dim, dim, nt - nt_main,
+                                               ob + m * ldo + nt_main);
+                    }
+                }
+            }
+            for (; i < nq; ++i) {
+                batch_kernel<Arch, Op>(queries + i * dim, bt, dim, nt, out + i * ldo + jb);
+            }
+        }
+    }
+
+    // size() uint8 codes widened to a float batch.
+    template<typename Arch>
+    inline turbo::simd::batch<float, Arch> load_u8_as_float(const uint8_t *p) {
+        using b_type = turbo::simd::batch<float, Arch>;
+#if defined(__AVX512F__)
+        if constexpr (b_type::size == 16) {
+            __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i *>(p));
+            return b_type(_mm512_cvtepi32_ps(_mm512_cvtepu8_epi32(v)));
+        }
+#endif
+#if defined(__AVX2__)
+        if constexpr (b_type::size == 8) {
+            __m128i v = _mm_loadl_epi64(reinterpret_cast<const __m128i *>(p));
+            return b_type(_mm256_cvtepi32_ps(_mm256_cvtepu8_epi32(v)));
+        }
+#endif
+#if defined(__SSE4_1__)
+        if constexpr (b_type::size == 4) {
+            int32_t w;
+            std::memcpy(&w, p, sizeof(w));
+            return b_type(_mm_cvtepi32_ps(_mm_cvtepu8_epi32(_mm_cvtsi32_si128(w))));
+        }
+#endif
+#if defined(__aarch64__)
+        if constexpr (b_type::size == 4) {
+            uint32_t w;
+            std::memcpy(&w, p, sizeof(w));
+            uint16x8_t v = vmovl_u8(vreinterpret_u8_u32(vdup_n_u32(w)));
+            return b_type(vcvtq_f32_u32(vmovl_u16(vget_low_u16(v))));
+        }
+#endif
+        alignas(64) float tmp[b_type::size];
+        for (std::size_t i = 0; i < b_type::size; ++i) {
+            tmp[i] = static_cast<float>(p[i]);
+        }
+        return b_type::load_aligned(tmp);
+    }
+
+    // size() half floats widened to a float batch.
+    template<typename Arch>
+    inline turbo::simd::batch<float, Arch> load_f16_as_float(const uint16_t *p) {
+        using b_type = turbo::simd::batch<float, Arch>;
+#if defined(__AVX512F__)
+        if constexpr (b_type::size == 16) {
+            return b_type(_mm512_cvtph_ps(_mm256_loadu_si256(reinterpret_cast<const __m256i *>(p))));
+        }
+#endif
+#if defined(__F16C__)
+        if constexpr (b_type::size == 8) {
+            return b_type(_mm256_cvtph_ps(_mm_loadu_si128(reinterpret_cast<const __m128i *>(p))));
+        }
+        if constexpr (b_type::size == 4) {
+            return b_type(_mm_cvtph_ps(_mm_loadl_epi64(reinterpret_cast<const __m128i *>(p))));
+        }
+#endif
+#if defined(__aarch64__)
+        if constexpr (b_type::size == 4) {
+            return b_type(vcvt_f32_f16(vreinterpret_f16_u16(vld1_u16(p))));
+        }
+#endif
+        alignas(64) float tmp[b_type::size];
+        for (std::size_t i = 0; i < b_type::size; ++i) {
+            tmp[i] = half_to_float(p[i]);
+        }
+        return b_type::load_aligned(tmp);
+    }
+
+    // x[i] = vmin[i] + code[i] * scale[i], decoded in registers.
+    template<typename Arch, template<typename> class Op>
+    float sq8_kernel(const float *query, const uint8_t *code, const float *vmin, const float *scale,
+                     std::size_t dim) {
+        using b_type = turbo::simd::batch<float, Arch>;
+        using op = Op<Arch>;
+        constexpr std::size_t inc = b_type::size;
+        std::size_t i = 0;
+        b_type sum = b_type::broadcast(0.0f);
+        for (; i + inc <= dim; i += inc) {
+            b_type x = turbo::simd::fma(load_u8_as_float<Arch>(code + i), b_type::load_unaligned(scale + i),
+                                        b_type::load_unaligned(vmin + i));
+            sum = op::accumulate(b_type::load_unaligned(query + i), x, sum);
+        }
+        float r = turbo::simd::reduce_add(sum);
+        for (; i < dim; ++i) {
+            r = op::accumulate(query[i], vmin[i] + static_cast<float>(code[i]) * scale[i], r);
+        }
+        return r;
+    }
+
+    template<typename Arch, template<typename> class Op>
+    float fp16_kernel(const float *query, const uint16_t *code, std::size_t dim) {
+        using b_type = turbo::simd::batch<float, Arch>;
+        using op = Op<Arch>;
+        constexpr std::size_t inc = b_type::size;
+        std::size_t i = 0;
+        b_type sum = b_type::broadcast(0.0f);
+        for (; i + inc <= dim; i += inc) {
+            sum = op::accumulate(b_type::load_unaligned(query + i), load_f16_as_float<Arch>(code + i), sum);
+        }
+        float r = turbo::simd::reduce_add(sum);
+        for (; i < dim; ++i) {
+            r = op::accumulate(query[i], half_to_float(code[i]), r);
+        }
+        return r;
+    }
+
+    // scalar reference of the fast scan, also the fallback without byte shuffles.
+    template<typename Arch>
+    void pq4_scan_scalar(const uint8_t *codes, std::size_t nblocks, std::size_t m, const uint8_t *lut,
+                         uint16_t *out) {
+        for (std::size_t b = 0; b < nblocks; ++b) {
+            const uint8_t *block = codes + b * m * 16;
+            uint16_t *o = out + b * 32;
+            std::fill(o, o + 32, uint16_t(0));
+            for (std::size_t q = 0; q < m; ++q) {
+                const uint8_t *c = block + q * 16;
+                const uint8_t *t = lut + q * 16;
+                for (std::size_t j = 0; j < 16; ++j) {
+                    o[j] += t[c[j] & 0x0f];
+                    o[j + 16] += t[c[j] >> 4];
+                }
+            }
+        }
+    }
+
+    // the lut of 16 entries lives in a register, every code nibble is an index
+    // of a byte shuffle, so one shuffle look up 16 (sse, neon), 32 (avx2, two
+    // sub quantizers) or 64 (avx512, four sub quantizers) distances at once.
+    template<typename Arch>
+    void pq4_scan_kernel(const uint8_t *codes, std::size_t nblocks, std::size_t m, const uint8_t *lut,
+                         uint16_t *out) {
+#if defined(__AVX512BW__)
+        if constexpr (Arch::alignment() >= 64) {
+            const __m512i mask = _mm512_set1_epi8(0x0f);
+            const __m512i zero = _mm512_setzero_si512();
+            for (std::size_t b = 0; b < nblocks; ++b) {
+                const uint8_t *block = codes + b * m * 16;
+                __m512i acc[4] = {zero, zero, zero, zero};
+                for (std::size_t q = 0; q < m; q += 4) {
+                    // a zero lut lane add nothing for the missing sub quantizers
+                    __mmask64 k = q + 4 <= m ? ~__mmask64(0) : (__mmask64(1) << ((m - q) * 16)) - 1;
+                    __m512i c = _mm512_maskz_loadu_epi8(k, block + q * 16);
+                    __m512i t = _mm512_maskz_loadu_epi8(k, lut + q * 16);
+                    __m512i lo = _mm512_shuffle_epi8(t, _mm512_and_si512(c, mask));
+                    __m512i hi = _mm512_shuffle_epi8(t, _mm512_and_si512(_mm512_srli_epi16(c, 4), mask));
+                    acc[0] = _mm512_add_epi16(acc[0], _mm512_unpacklo_epi8(lo, zero));
+                    acc[1] = _mm512_add_epi16(acc[1], _mm512_unpackhi_epi8(lo, zero));
+                    acc[2] = _mm512_add_epi16(acc[2], _mm512_unpacklo_epi8(hi, zero));
+                    acc[3] = _mm512_add_epi16(acc[3], _mm512_unpackhi_epi8(hi, zero));
+                }
+                // every 128 bit lane holds one sub quantizer, sum the lanes
+                for (int a = 0; a < 4; ++a) {
+                    __m128i s = _mm_add_epi16(
+                            _mm_add_epi16(_mm512_extracti32x4_epi32(acc[a], 0), _mm512_extracti32x4_epi32(acc[a], 1)),
+                            _mm_add_epi16(_mm512_extracti32x4_epi32(acc[a], 2), _mm512_extracti32x4_epi32(acc[a], 3)));
+                    _mm_storeu_si128(reinterpret_cast<__m128i *>(out + b * 32 + a * 8), s);
+                }
+            }
+            return;
+        }
+#endif
+#if defined(__AVX2__)
+        if constexpr (Arch::alignment() >= 32) {
+            const __m256i mask = _mm256_set1_epi8(0x0f);
+            const __m256i zero = _mm256_setzero_si256();
+            for (std::size_t b = 0; b < nblocks; ++b) {
+                const uint8_t *block = codes + b * m * 16;
+                __m256i acc[4] = {zero, zero, zero, zero};
+                for (std::size_t q = 0; q < m; q += 2) {
+                    __m256i c;
+                    __m256i t;
+                    if (q + 2 <= m) {
+                        c = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(block + q * 16));
+                        t = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(lut + q * 16));
+                    } else {
+                        c = _mm256_inserti128_si256(zero, _mm_loadu_si128(reinterpret_cast<const __m128i *>(block + q * 16)), 0);
+                        t = _mm256_inserti128_si256(zero, _mm_loadu_si128(reinterpret_cast<const __m128i *>(lut + q * 16)), 0);
+                    }
+                    __m256i lo = _mm256_shuffle_epi8(t, _mm256_and_si256(c, mask));
+                    __m256i hi = _mm256_shuffle_epi8(t, _mm256_and_si256(_mm256_srli_epi16(c, 4), mask));
+                    acc[0] = _mm256_add_epi16(acc[0], _mm256_unpacklo_epi8(lo, zero));
+                    acc[1] = _mm256_add_epi16(acc[1], _mm256_unpackhi_epi8(lo, zero));
+                    acc[2] = _mm256_add_epi16(acc[2], _mm256_unpacklo_epi8(hi, zero));
+                    acc[3] = _mm256_add_epi16(acc[3], _mm256_unpackhi_epi8(hi, zero));
+                }
+                for (int a = 0; a < 4; ++a) {
+                    __m128i s = _mm_add_epi16(_mm256_castsi256_si128(acc[a]), _mm256_extracti128_si256(acc[a], 1));
+                    _mm_storeu_si128(reinterpret_cast<__m128i *>(out + b * 32 + a * 8), s);
+                }
+            }
+            return;
+        }
+#endif
+#if defined(__SSSE3__)
+        {
+            const __m128i mask = _mm_set1_epi8(0x0f);
+            const __m128i zero = _mm_setzero_si128();
+            for (std::size_t b = 0; b < nblocks; ++b) {
+                const uint8_t *block = codes + b * m * 16;
+                __m128i acc[4] = {zero, zero, zero, zero};
+                for (std::size_t q = 0; q < m; ++q) {
+                    __m128i c = _mm_loadu_si128(reinterpret_cast<const __m128i *>(block + q * 16));
+                    __m128i t = _mm_loadu_si128(reinterpret_cast<const __m128i *>(lut + q * 16));
+                    __m128i lo = _mm_shuffle_epi8(t, _mm_and_si128(c, mask));
+                    __m128i hi = _mm_shuffle_epi8(t, _mm_and_si128(_mm_srli_epi16(c, 4), mask));
+                    acc[0] = _mm_add_epi16(acc[0], _mm_unpacklo_epi8(lo, zero));
+                    acc[1] = _mm_add_epi16(acc[1], _mm_unpackhi_epi8(lo, zero));
+                    acc[2] = _mm_add_epi16(acc[2], _mm_unpacklo_epi8(hi, zero));
+                    acc[3] = _mm_add_epi16(acc[3], _mm_unpackhi_epi8(hi, zero));
+                }
+                for (int a = 0; a < 4; ++a) {
+                    _mm_storeu_si128(reinterpret_cast<__m128i *>(out + b * 32 + a * 8), acc[a]);
+                }
+            }
+            return;
+        }
+#elif defined(__aarch64__)
+        {
+            const uint8x16_t mask = vdupq_n_u8(0x0f);
+            for (std::size_t b = 0; b < nblocks; ++b) {
+                const uint8_t *block = codes + b * m * 16;
+                uint16x8_t acc[4] = {vdupq_n_u16(0), vdupq_n_u16(0), vdupq_n_u16(0), vdupq_n_u16(0)};
+                for (std::size_t q = 0; q < m; ++q) {
+                    uint8x16_t c = vld1q_u8(block + q * 16);
+                    uint8x16_t t = vld1q_u8(lut + q * 16);
+                    uint8x16_t lo = vqtbl1q_u8(t, vandq_u8(c, mask));
+                    uint8x16_t hi = vqtbl1q_u8(t, vshrq_n_u8(c, 4));
+                    acc[0] = vaddw_u8(acc[0], vget_low_u8(lo));
+                    acc[1] = vaddw_high_u8(acc[1], lo);
+                    acc[2] = vaddw_u8(acc[2], vget_low_u8(hi));
+                    acc[3] = vaddw_high_u8(acc[3], hi);
+                }
+                for (int a = 0; a < 4; ++a) {
+                    vst1q_u16(out + b * 32 + a * 8, acc[a]);
+                }
+            }
+            return;
+        }
+#endif
+        pq4_scan_scalar<Arch>(codes, nblocks, m, lut, out);
+    }
+
+    // unsigned compare of values - lo against hi - lo, one compare per value.
+    template<typename Arch>
+    void range_mask_kernel(const uint64_t *values, std::size_t n, uint64_t lo, uint64_t hi, uint64_t *mask) {
+        const uint64_t width = hi - lo;
+        std::fill(mask, mask + (n + 63) / 64, uint64_t(0));
+        std::size_t i = 0;
+#if defined(__AVX512F__)
+        if constexpr (Arch::alignment() >= 64) {
+            const __m512i vlo = _mm512_set1_epi64(static_cast<long long>(lo));
+            const __m512i vw = _mm512_set1_epi64(static_cast<long long>(width));
+            for (; i + 8 <= n; i += 8) {
+                __m512i v = _mm512_sub_epi64(_mm512_loadu_si512(values + i), vlo);
+                mask[i / 64] |= uint64_t(_mm512_cmple_epu64_mask(v, vw)) << (i % 64);
+            }
+        }
+#endif
+#if defined(__AVX2__)
+        if constexpr (Arch::alignment() >= 32) {
+            // no unsigned 64 bits compare, flip the sign bits and compare signed
+            const __m256i sign = _mm256_set1_epi64x(static_cast<long long>(0x8000000000000000ULL));
+            const __m256i vlo = _mm256_set1_epi64x(static_cast<long long>(lo));
+            const __m256i vw = _mm256_xor_si256(_mm256_set1_epi64x(static_cast<long long>(width)), sign);
+            for (; i + 4 <= n; i += 4) {
+                __m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(values + i));
+                v = _mm256_xor_si256(_mm256_sub_epi64(v, vlo), sign);
+                int gt = _mm256_movemask_pd(_mm256_castsi256_pd(_mm256_cmpgt_epi64(v, vw)));
+                mask[i / 64] |= uint64_t(~gt & 0xf) << (i % 64);
+            }
+        }
+#endif
+#if defined(__aarch64__)
+        {
+            const uint64x2_t vlo = vdupq_n_u64(lo);
+            const uint64x2_t vw = vdupq_n_u64(width);
+            for (; i + 2 <= n; i += 2) {
+                uint64x2_t le = vcleq_u64(vsubq_u64(vld1q_u64(values + i), vlo), vw);
+                uint64_t bits = (vgetq_lane_u64(le, 0) & 1u) | (vgetq_lane_u64(le, 1) & 2u);
+                mask[i / 64] |= bits << (i % 64);
+            }
+        }
+#endif
+        for (; i < n; ++i) {
+            mask[i / 64] |= uint64_t(values[i] - lo <= width) << (i % 64);
+        }
+    }
+
+    template<typename Arch>
+    DistanceKernels make_distance_kernels(const char *name) {
+        DistanceKernels kernels;
+        kernels.arch_name = name;
+        kernels.l1 = &l1_kernel<Arch>;
+        kernels.l2 = &l2_kernel<Arch>;
+        kernels.ip = &ip_kernel<Arch>;
+        kernels.cosine = &cosine_kernel<Arch>;
+        kernels.poincare = &poincare_kernel<Arch>;
+        kernels.lorentz = &lorentz_kernel<Arch>;
+        kernels.hamming = &hamming_kernel<Arch>;
+        kernels.jaccard = &jaccard_kernel<Arch>;
+        kernels.batch_hamming = &batch_hamming_kernel<Arch>;
+        kernels.batch_l1 = &batch_kernel<Arch, L1Op>;
+        kernels.batch_l2 = &batch_kernel<Arch, L2Op>;
+        kernels.batch_ip = &batch_kernel<Arch, IpOp>;
+        kernels.batch_poincare = &batch_poincare_kernel<Arch>;
+        kernels.batch_lorentz = &batch_lorentz_kernel<Arch>;
+        kernels.matrix_l1 = &matrix_kernel<Arch, L1Op>;
+        kernels.matrix_l2 = &matrix_kernel<Arch, L2Op>;
+        kernels.matrix_ip = &matrix_kernel<Arch, IpOp>;
+        kernels.sq8_l2 = &sq8_kernel<Arch, L2Op>;
+        kernels.sq8_ip = &sq8_kernel<Arch, IpOp>;
+        kernels.fp16_l2 = &fp16_kernel<Arch, L2Op>;
+        kernels.fp16_ip = &fp16_kernel<Arch, IpOp>;
+        kernels.pq4_scan = &pq4_scan_kernel<Arch>;
+        kernels.range_mask = &range_mask_kernel<Arch>;
+        return kernels;
+    }
+
+}  // namespace zircon::distance::detail
+
+#endif  // ZIRCON_UTILITY_DISTANCE_KERNEL_H_
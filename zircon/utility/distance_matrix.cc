@@ -0,0 +1,96 @@
+// Copyright 2023 The Elastic-AI Authors.
+// part of Elastic AI Search
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#include "zircon/utility/distance_matrix.h"
+#include "zircon/utility/distance_dispatch.h"
+#include "turbo/log/logging.h"
+#include <algorithm>
+
+namespace zircon::distance {
+
+    namespace {
+
+        turbo::ResultStatus<matrix_distance_func> matrix_func(MetricType metric) {
+            auto &kernels = distance_kernels();
+            switch (metric) {
+                case MetricType::METRIC_L1:
+                    return kernels.matrix_l1;
+                case MetricType::METRIC_L2:
+                    return kernels.matrix_l2;
+                case MetricType::METRIC_IP:
+                case MetricType::METRIC_NORMALIZED_COSINE:
+                    return kernels.matrix_ip;
+                default:
+                    return turbo::invalid_argument_error("metric not support by distance matrix");
+            }
+        }
+
+        // turn the inner products of the block into distances
+        void finish_block(MetricType metric, std::size_t nq, std::size_t nb, float *out, std::size_t ldo) {
+            if (metric != MetricType::METRIC_IP && metric != MetricType::METRIC_NORMALIZED_COSINE) {
+                return;
+            }
+            const float bias = metric == MetricType::METRIC_IP ? 0.0f : 1.0f;
+            for (std::size_t i = 0; i < nq; ++i) {
+                float *row = out + i * ldo;
+                for (std::size_t j = 0; j < nb; ++j) {
+                    row[j] = bias - row[j];
+                }
+            }
+        }
+    }  // namespace
+
+    turbo::Status distance_matrix(const float *queries, std::size_t nq, const float *base, std::size_t nb,
+                                  std::size_t dim, MetricType metric, float *out, std::size_t ldo) {
+        auto rs = matrix_func(metric);
+        if (!rs.ok()) {
+            return rs.status();
+        }
+        rs.value()(queries, nq, base, nb, dim, out, ldo);
+        finish_block(metric, nq, nb, out, ldo);
+        return turbo::ok_status();
+    }
+
+    turbo::Status distance_matrix(turbo::Span<float> queries, std::size_t nq, const MemVectorStore &store,
+                                  location_t begin, location_t end, MetricType metric, float *out) {
+        TLOG_CHECK(begin <= end && end <= store.current_index(), "bad location range [{}, {})", begin, end);
+        if (nq == 0 || queries.size() % nq != 0) {
+            return turbo::invalid_argument_error("queries size {} not match the query number {}", queries.size(), nq);
+        }
+        const std::size_t dim = queries.size() / nq;
+        auto rs = matrix_func(metric);
+        if (!rs.ok()) {
+            return rs.status();
+        }
+        auto &batches = store.vector_batch();
+        const std::size_t batch_size = store.get_batch_size();
+        const std::size_t ldo = end - begin;
+        for (location_t loc = begin; loc < end;) {
+            auto &vb = batches[loc / batch_size];
+            if (vb.vector_byte_size() != dim * sizeof(float)) {
+                return turbo::invalid_argument_error("query dimension {} not match the store vector bytes {}", dim,
+                                                     vb.vector_byte_size());
+            }
+            const std::size_t offset = loc % batch_size;
+            const std::size_t n = std::min<std::size_t>(vb.size() - offset, end - loc);
+            auto base = reinterpret_cast<const float *>(vb.data() + offset * vb.vector_byte_size());
+            rs.value()(queries.data(), nq, base, n, dim, out + (loc - begin), ldo);
+            loc += n;
+        }
+        finish_block(metric, nq, ldo, out, ldo);
+        return turbo::ok_status();
+    }
+
+}  // namespace zircon::distance
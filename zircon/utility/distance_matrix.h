@@ -0,0 +1,57 @@
+// Copyright 2023 The Elastic-AI Authors.
+// part of Elastic AI Search
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#ifndef ZIRCON_UTILITY_DISTANCE_MATRIX_H_
+#define ZIRCON_UTILITY_DISTANCE_MATRIX_H_
+
+#include "turbo/base/status.h"
+#include "turbo/meta/span.h"
+#include "zircon/core/metric_type.h"
+#include "zircon/core/defines.h"
+#include "zircon/store/mem_vector_store.h"
+
+namespace zircon::distance {
+
+    /**
+     * @ingroup zircon_utility_distance
+     * @brief Compute the distance between every query and every vector of the location
+     *        range [begin, end) of the store. the vectors are tiled so the tile fits
+     *        in l2 and scored by register blocks of several queries and vectors.
+     *        the values have the VectorDistance semantics, the smaller the closer,
+     *        l1, squared l2, -ip and 1 - ip for normalized cosine.
+     *        deleted locations are computed as well, check is_deleted if needed.
+     * @param queries nq float queries stored one after another.
+     * @param nq The number of queries.
+     * @param store The store, vectors must be float with the query dimension.
+     * @param begin The first location.
+     * @param end The last location, exclusive, not more than current_index().
+     * @param metric METRIC_L1, METRIC_L2, METRIC_IP or METRIC_NORMALIZED_COSINE.
+     * @param out row major nq x (end - begin) result.
+     * @return invalid argument if the metric or the dimension is not supported.
+     */
+    turbo::Status distance_matrix(turbo::Span<float> queries, std::size_t nq, const MemVectorStore &store,
+                                  location_t begin, location_t end, MetricType metric, float *out);
+
+    /**
+     * @ingroup zircon_utility_distance
+     * @brief raw version of distance_matrix, nb vectors stored contiguously in base,
+     *        out[i * ldo + j] is the distance of the i-th query and the j-th vector.
+     */
+    turbo::Status distance_matrix(const float *queries, std::size_t nq, const float *base, std::size_t nb,
+                                  std::size_t dim, MetricType metric, float *out, std::size_t ldo);
+
+}  // namespace zircon::distance
+
+#endif  // ZIRCON_UTILITY_DISTANCE_MATRIX_H_
@@ -0,0 +1,95 @@
+// Copyright 2023 The Elastic-AI Authors.
+// part of Elastic AI Search
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#ifndef ZIRCON_UTILITY_FLOAT16_H_
+#define ZIRCON_UTILITY_FLOAT16_H_
+
+#include <cstdint>
+#include <cstring>
+
+namespace zircon {
+
+    // ieee 754 half precision <-> float, portable bit manipulation version.
+    // static so every translation unit, including the simd kernel ones built
+    // with other flags, keeps its own copy.
+
+    static inline float half_to_float(uint16_t h) {
+        uint32_t sign = static_cast<uint32_t>(h & 0x8000u) << 16;
+        uint32_t exp = (h >> 10) & 0x1fu;
+        uint32_t mant = h & 0x3ffu;
+        uint32_t bits;
+        if (exp == 0) {
+            if (mant == 0) {
+                bits = sign;
+            } else {
+                // subnormal, normalize it
+                exp = 127 - 15 + 1;
+                while ((mant & 0x400u) == 0) {
+                    mant <<= 1;
+                    --exp;
+                }
+                mant &= 0x3ffu;
+                bits = sign | (exp << 23) | (mant << 13);
+            }
+        } else if (exp == 0x1f) {
+            bits = sign | 0x7f800000u | (mant << 13);
+        } else {
+            bits = sign | ((exp + 127 - 15) << 23) | (mant << 13);
+        }
+        float f;
+        std::memcpy(&f, &bits, sizeof(f));
+        return f;
+    }
+
+    // round to nearest even, overflow to inf.
+    static inline uint16_t float_to_half(float f) {
+        uint32_t bits;
+        std::memcpy(&bits, &f, sizeof(bits));
+        uint32_t sign = (bits >> 16) & 0x8000u;
+        uint32_t exp = (bits >> 23) & 0xffu;
+        uint32_t mant = bits & 0x7fffffu;
+        if (exp == 0xff) {
+            return static_cast<uint16_t>(sign | 0x7c00u | (mant ? 0x200u : 0u));
+        }
+        int32_t e = static_cast<int32_t>(exp) - 127 + 15;
+        if (e >= 0x1f) {
+            return static_cast<uint16_t>(sign | 0x7c00u);
+        }
+        if (e <= 0) {
+            if (e < -10) {
+                return static_cast<uint16_t>(sign);
+            }
+            mant |= 0x800000u;
+            uint32_t shift = static_cast<uint32_t>(14 - e);
+            uint32_t half_mant = mant >> shift;
+            uint32_t rest = mant & ((1u << shift) - 1);
+            uint32_t halfway = 1u << (shift - 1);
+            if (rest > halfway || (rest == halfway && (half_mant & 1u))) {
+                ++half_mant;
+            }
+            return static_cast<uint16_t>(sign | half_mant);
+        }
+        uint32_t half = sign | (static_cast<uint32_t>(e) << 10) | (mant >> 13);
+        uint32_t rest = mant & 0x1fffu;
+        if (rest > 0x1000u || (rest == 0x1000u && (half & 1u))) {
+            // may carry into the exponent, that is the right result
+            ++half;
+        }
+        return static_cast<uint16_t>(half);
+    }
+
+}  // namespace zircon
+
+#endif  // ZIRCON_UTILITY_FLOAT16_H_
@@ -14,7 +14,127 @@
 //
 
 #include "zircon/utility/id_filter.h"
+#include "zircon/utility/distance_dispatch.h"
+#include <algorithm>
+#include <iterator>
 
 namespace zircon {
 
+    static_assert(sizeof(label_type) == sizeof(uint64_t), "range_mask run on 64 bits labels");
+
+    void IdFilter::filter_block(const label_type *labels, std::size_t n, uint64_t *mask) const {
+        std::fill(mask, mask + detail::mask_words(n), uint64_t(0));
+        for (std::size_t i = 0; i < n; ++i) {
+            mask[i / 64] |= uint64_t(is_member(labels[i])) << (i % 64);
+        }
+    }
+
+    void IdFilterRange::filter_block(const label_type *labels, std::size_t n, uint64_t *mask) const {
+        if (min_id > max_id) {
+            std::fill(mask, mask + detail::mask_words(n), uint64_t(0));
+            return;
+        }
+        distance::distance_kernels().range_mask(reinterpret_cast<const uint64_t *>(labels), n, min_id, max_id,
+                                                mask);
+    }
+
+    bool IdFilterRange::collect_members(std::size_t limit, std::vector<label_type> &members) const {
+        if (min_id > max_id) {
+            members.clear();
+            return true;
+        }
+        if (max_id - min_id >= limit) {
+            return false;
+        }
+        members.resize(max_id - min_id + 1);
+        for (std::size_t i = 0; i < members.size(); ++i) {
+            members[i] = min_id + i;
+        }
+        return true;
+    }
+
+    void IdFilterAnd::filter_block(const label_type *labels, std::size_t n, uint64_t *mask) const {
+        detail::merge_filter_block(
+                [this](const label_type *l, std::size_t c, uint64_t *m) { _a->filter_block(l, c, m); },
+                [this](const label_type *l, std::size_t c, uint64_t *m) { _b->filter_block(l, c, m); },
+                labels, n, mask, [](uint64_t x, uint64_t y) { return x & y; });
+    }
+
+    void IdFilterOr::filter_block(const label_type *labels, std::size_t n, uint64_t *mask) const {
+        detail::merge_filter_block(
+                [this](const label_type *l, std::size_t c, uint64_t *m) { _a->filter_block(l, c, m); },
+                [this](const label_type *l, std::size_t c, uint64_t *m) { _b->filter_block(l, c, m); },
+                labels, n, mask, [](uint64_t x, uint64_t y) { return x | y; });
+    }
+
+    void IdFilterXor::filter_block(const label_type *labels, std::size_t n, uint64_t *mask) const {
+        detail::merge_filter_block(
+                [this](const label_type *l, std::size_t c, uint64_t *m) { _a->filter_block(l, c, m); },
+                [this](const label_type *l, std::size_t c, uint64_t *m) { _b->filter_block(l, c, m); },
+                labels, n, mask, [](uint64_t x, uint64_t y) { return x ^ y; });
+    }
+
+    bool IdFilterAnd::collect_members(std::size_t limit, std::vector<label_type> &members) const {
+        return detail::collect_and(*_a, *_b, limit, members);
+    }
+
+    bool IdFilterOr::collect_members(std::size_t limit, std::vector<label_type> &members) const {
+        return detail::collect_or(*_a, *_b, limit, members);
+    }
+
+    bool IdFilterXor::collect_members(std::size_t limit, std::vector<label_type> &members) const {
+        return detail::collect_xor(*_a, *_b, limit, members);
+    }
+
+    bool detail::collect_and(const IdFilter &a, const IdFilter &b, std::size_t limit,
+                             std::vector<label_type> &members) {
+        // the intersection is a subset of either side, list the one that can
+        std::vector<label_type> side;
+        const IdFilter *other = &b;
+        if (!a.collect_members(limit, side)) {
+            if (!b.collect_members(limit, side)) {
+                return false;
+            }
+            other = &a;
+        }
+        members.clear();
+        for (auto id : side) {
+            if (other->is_member(id)) {
+                members.push_back(id);
+            }
+        }
+        return true;
+    }
+
+    bool detail::collect_or(const IdFilter &fa, const IdFilter &fb, std::size_t limit,
+                            std::vector<label_type> &members) {
+        std::vector<label_type> a;
+        std::vector<label_type> b;
+        if (!fa.collect_members(limit, a) || !fb.collect_members(limit, b)) {
+            return false;
+        }
+        std::sort(a.begin(), a.end());
+        std::sort(b.begin(), b.end());
+        members.clear();
+        std::set_union(a.begin(), a.end(), b.begin(), b.end(), std::back_inserter(members));
+        members.erase(std::unique(members.begin(), members.end()), members.end());
+        return members.size() <= limit;
+    }
+
+    bool detail::collect_xor(const IdFilter &fa, const IdFilter &fb, std::size_t limit,
+                             std::vector<label_type> &members) {
+        std::vector<label_type> a;
+        std::vector<label_type> b;
+        if (!fa.collect_members(limit, a) || !fb.collect_members(limit, b)) {
+            return false;
+        }
+        std::sort(a.begin(), a.end());
+        a.erase(std::unique(a.begin(), a.end()), a.end());
+        std::sort(b.begin(), b.end());
+        b.erase(std::unique(b.begin(), b.end()), b.end());
+        members.clear();
+        std::set_symmetric_difference(a.begin(), a.end(), b.begin(), b.end(), std::back_inserter(members));
+        return members.size() <= limit;
+    }
+
 }  // namespace zircon
\ No newline at end of file
@@ -17,6 +17,10 @@
 #ifndef ZIRCON_UTILITY_ID_FILTER_H_
 #define ZIRCON_UTILITY_ID_FILTER_H_
 
+#include <algorithm>
+#include <cstdint>
+#include <type_traits>
+#include <vector>
 #include "zircon/core/defines.h"
 #include "turbo/container/flat_hash_set.h"
 #include "bluebird/bits/bitmap.h"
@@ -28,17 +32,85 @@ namespace zircon {
         virtual ~IdFilter() = default;
 
         virtual bool is_member(label_type id) const = 0;
+
+        /**
+         * @brief list the members if there are not more than limit of them, the
+         *        searches use it to switch to brute force for selective filters.
+         * @return false if the filter can not list its members or has more.
+         */
+        virtual bool collect_members(std::size_t limit, std::vector<label_type> &members) const {
+            return false;
+        }
+
+        /**
+         * @brief evaluate a block of labels at once, bit i of the mask is set if
+         *        labels[i] is a member. the searches use it for the candidates
+         *        of a batch or a neighbor list, one virtual call per block.
+         * @param mask (n + 63) / 64 words, overwritten.
+         */
+        virtual void filter_block(const label_type *labels, std::size_t n, uint64_t *mask) const;
+
+        /**
+         * @brief a range of labels holding every member, bounds included, the
+         *        sharded indexes skip the shards out of it.
+         * @return false if the filter does not know one.
+         */
+        virtual bool label_bounds(label_type &min_id, label_type &max_id) const {
+            return false;
+        }
+
+        // the combinators evaluate their children in chunks of kMaxBlock labels
+        static constexpr std::size_t kMaxBlock = 256;
     };
 
-    struct IdFilterRange {
+    namespace detail {
+        inline std::size_t mask_words(std::size_t n) {
+            return (n + 63) / 64;
+        }
+
+        // evaluate a and b chunk by chunk and merge the masks word by word
+        template<typename A, typename B, typename Merge>
+        void merge_filter_block(const A &a, const B &b, const label_type *labels, std::size_t n, uint64_t *mask,
+                                Merge merge) {
+            uint64_t tmp[IdFilter::kMaxBlock / 64];
+            for (std::size_t off = 0; off < n; off += IdFilter::kMaxBlock) {
+                const std::size_t count = std::min(IdFilter::kMaxBlock, n - off);
+                uint64_t *m = mask + off / 64;
+                a(labels + off, count, m);
+                b(labels + off, count, tmp);
+                for (std::size_t w = 0; w < mask_words(count); ++w) {
+                    m[w] = merge(m[w], tmp[w]);
+                }
+            }
+        }
+
+        bool collect_and(const IdFilter &a, const IdFilter &b, std::size_t limit, std::vector<label_type> &members);
+
+        bool collect_or(const IdFilter &a, const IdFilter &b, std::size_t limit, std::vector<label_type> &members);
+
+        bool collect_xor(const IdFilter &a, const IdFilter &b, std::size_t limit, std::vector<label_type> &members);
+    }  // namespace detail
+
+    struct IdFilterRange : public IdFilter {
         label_type min_id;
         label_type max_id;
 
         IdFilterRange(label_type min_id, label_type max_id) : min_id(min_id), max_id(max_id) {}
 
-        bool is_member(label_type id) const noexcept{
+        bool is_member(label_type id) const noexcept override {
             return id >= min_id && id <= max_id;
         }
+
+        // simd range compare, see DistanceKernels::range_mask
+        void filter_block(const label_type *labels, std::size_t n, uint64_t *mask) const override;
+
+        bool collect_members(std::size_t limit, std::vector<label_type> &members) const override;
+
+        bool label_bounds(label_type &lo, label_type &hi) const override {
+            lo = min_id;
+            hi = max_id;
+            return true;
+        }
     };
 
     struct IdFilterSet : public IdFilter {
@@ -76,6 +148,21 @@ namespace zircon {
         bool is_member(label_type id) const noexcept override {
             return id_set.contains(id);
         }
+
+        void filter_block(const label_type *labels, std::size_t n, uint64_t *mask) const override {
+            std::fill(mask, mask + detail::mask_words(n), uint64_t(0));
+            for (std::size_t i = 0; i < n; ++i) {
+                mask[i / 64] |= uint64_t(id_set.contains(labels[i])) << (i % 64);
+            }
+        }
+
+        bool collect_members(std::size_t limit, std::vector<label_type> &members) const override {
+            if (id_set.size() > limit) {
+                return false;
+            }
+            members.assign(id_set.begin(), id_set.end());
+            return true;
+        }
     };
 
     struct IdFilterBitmap : public IdFilter {
@@ -106,9 +193,35 @@ namespace zircon {
             }
         }
 
+        explicit IdFilterBitmap(bluebird::Bitmap bm) : bitmap(std::move(bm)) {}
+
+        // fold two bitmaps into one container, cheaper to probe than IdFilterAnd/Or of them
+        friend IdFilterBitmap operator&(const IdFilterBitmap &a, const IdFilterBitmap &b) {
+            return IdFilterBitmap(a.bitmap & b.bitmap);
+        }
+
+        friend IdFilterBitmap operator|(const IdFilterBitmap &a, const IdFilterBitmap &b) {
+            return IdFilterBitmap(a.bitmap | b.bitmap);
+        }
+
         bool is_member(label_type lb) const noexcept override {
             return bitmap.contains(lb);
         }
+
+        void filter_block(const label_type *labels, std::size_t n, uint64_t *mask) const override {
+            std::fill(mask, mask + detail::mask_words(n), uint64_t(0));
+            for (std::size_t i = 0; i < n; ++i) {
+                mask[i / 64] |= uint64_t(bitmap.contains(labels[i])) << (i % 64);
+            }
+        }
+
+        bool collect_members(std::size_t limit, std::vector<label_type> &members) const override {
+            if (bitmap.cardinality() > limit) {
+                return false;
+            }
+            members.assign(bitmap.begin(), bitmap.end());
+            return true;
+        }
     };
 
     struct IdFilterAnd : public IdFilter {
@@ -118,6 +231,10 @@ namespace zircon {
         bool is_member(label_type lb) const noexcept override{
             return _a->is_member(lb) && _b->is_member(lb);
         }
+
+        bool collect_members(std::size_t limit, std::vector<label_type> &members) const override;
+
+        void filter_block(const label_type *labels, std::size_t n, uint64_t *mask) const override;
     };
 
     struct IdFilterOr : public IdFilter {
@@ -127,6 +244,10 @@ namespace zircon {
         bool is_member(label_type lb) const noexcept override{
             return _a->is_member(lb) || _b->is_member(lb);
         }
+
+        bool collect_members(std::size_t limit, std::vector<label_type> &members) const override;
+
+        void filter_block(const label_type *labels, std::size_t n, uint64_t *mask) const override;
     };
 
     struct IdFilterXor : public IdFilter {
@@ -136,8 +257,133 @@ namespace zircon {
         bool is_member(label_type lb) const noexcept override{
             return _a->is_member(lb) ^ _b->is_member(lb);
         }
+
+        bool collect_members(std::size_t limit, std::vector<label_type> &members) const override;
+
+        void filter_block(const label_type *labels, std::size_t n, uint64_t *mask) const override;
     };
 
+    /**
+     * @brief compile time composed filters for fixed filter shapes. the children
+     *        are held by reference with their concrete types and called qualified,
+     *        so the whole tree is inlined and only the root call is virtual.
+     *        eg. auto f = id_filter_and(tenant_range, id_filter_or(acl_a, acl_b));
+     *        the leaf filters must outlive the composed filter, composed nodes
+     *        are only two references and are held by value.
+     */
+    template<typename A, typename B>
+    struct IdFilterAndOf;
+
+    template<typename A, typename B>
+    struct IdFilterOrOf;
+
+    template<typename A, typename B>
+    struct IdFilterXorOf;
+
+    namespace detail {
+        template<typename T>
+        struct is_composed_filter : std::false_type {
+        };
+
+        template<typename A, typename B>
+        struct is_composed_filter<IdFilterAndOf<A, B>> : std::true_type {
+        };
+
+        template<typename A, typename B>
+        struct is_composed_filter<IdFilterOrOf<A, B>> : std::true_type {
+        };
+
+        template<typename A, typename B>
+        struct is_composed_filter<IdFilterXorOf<A, B>> : std::true_type {
+        };
+
+        template<typename T>
+        using filter_ref = std::conditional_t<is_composed_filter<T>::value, const T, const T &>;
+    }  // namespace detail
+
+    template<typename A, typename B>
+    struct IdFilterAndOf : public IdFilter {
+        detail::filter_ref<A> _a;
+        detail::filter_ref<B> _b;
+
+        IdFilterAndOf(const A &a, const B &b) : _a(a), _b(b) {}
+
+        bool is_member(label_type lb) const noexcept override {
+            return _a.A::is_member(lb) && _b.B::is_member(lb);
+        }
+
+        void filter_block(const label_type *labels, std::size_t n, uint64_t *mask) const override {
+            detail::merge_filter_block(
+                    [this](const label_type *l, std::size_t c, uint64_t *m) { _a.A::filter_block(l, c, m); },
+                    [this](const label_type *l, std::size_t c, uint64_t *m) { _b.B::filter_block(l, c, m); },
+                    labels, n, mask, [](uint64_t x, uint64_t y) { return x & y; });
+        }
+
+        bool collect_members(std::size_t limit, std::vector<label_type> &members) const override {
+            return detail::collect_and(_a, _b, limit, members);
+        }
+    };
+
+    template<typename A, typename B>
+    struct IdFilterOrOf : public IdFilter {
+        detail::filter_ref<A> _a;
+        detail::filter_ref<B> _b;
+
+        IdFilterOrOf(const A &a, const B &b) : _a(a), _b(b) {}
+
+        bool is_member(label_type lb) const noexcept override {
+            return _a.A::is_member(lb) || _b.B::is_member(lb);
+        }
+
+        void filter_block(const label_type *labels, std::size_t n, uint64_t *mask) const override {
+            detail::merge_filter_block(
+                    [this](const label_type *l, std::size_t c, uint64_t *m) { _a.A::filter_block(l, c, m); },
+                    [this](const label_type *l, std::size_t c, uint64_t *m) { _b.B::filter_block(l, c, m); },
+                    labels, n, mask, [](uint64_t x, uint64_t y) { return x | y; });
+        }
+
+        bool collect_members(std::size_t limit, std::vector<label_type> &members) const override {
+            return detail::collect_or(_a, _b, limit, members);
+        }
+    };
+
+    template<typename A, typename B>
+    struct IdFilterXorOf : public IdFilter {
+        detail::filter_ref<A> _a;
+        detail::filter_ref<B> _b;
+
+        IdFilterXorOf(const A &a, const B &b) : _a(a), _b(b) {}
+
+        bool is_member(label_type lb) const noexcept override {
+            return _a.A::is_member(lb) ^ _b.B::is_member(lb);
+        }
+
+        void filter_block(const label_type *labels, std::size_t n, uint64_t *mask) const override {
+            detail::merge_filter_block(
+                    [this](const label_type *l, std::size_t c, uint64_t *m) { _a.A::filter_block(l, c, m); },
+                    [this](const label_type *l, std::size_t c, uint64_t *m) { _b.B::filter_block(l, c, m); },
+                    labels, n, mask, [](uint64_t x, uint64_t y) { return x ^ y; });
+        }
+
+        bool collect_members(std::size_t limit, std::vector<label_type> &members) const override {
+            return detail::collect_xor(_a, _b, limit, members);
+        }
+    };
+
+    template<typename A, typename B>
+    IdFilterAndOf<A, B> id_filter_and(const A &a, const B &b) {
+        return IdFilterAndOf<A, B>(a, b);
+    }
+
+    template<typename A, typename B>
+    IdFilterOrOf<A, B> id_filter_or(const A &a, const B &b) {
+        return IdFilterOrOf<A, B>(a, b);
+    }
+
+    template<typename A, typename B>
+    IdFilterXorOf<A, B> id_filter_xor(const A &a, const B &b) {
+        return IdFilterXorOf<A, B>(a, b);
+    }
 
 }  // namespace zircon
 
@@ -0,0 +1,26 @@
+// Copyright 2023 The Elastic-AI Authors.
+// part of Elastic AI Search
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+// compiled with -mavx2 -mfma -mf16c -mpopcnt, see zircon/CMakeLists.txt
+#include "zircon/utility/distance_kernel.h"
+
+namespace zircon::distance::detail {
+
+    const DistanceKernels *avx2_distance_kernels() {
+        static const DistanceKernels kernels = make_distance_kernels<turbo::simd::fma3<turbo::simd::avx2>>("avx2");
+        return &kernels;
+    }
+
+}  // namespace zircon::distance::detail
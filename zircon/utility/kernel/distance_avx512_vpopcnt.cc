@@ -0,0 +1,111 @@
+// Copyright 2023 The Elastic-AI Authors.
+// part of Elastic AI Search
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+// compiled with the avx512 flags and -mavx512vpopcntdq, see zircon/CMakeLists.txt.
+// only the binary kernels are built here, the rest of the table is the one of
+// distance_avx512.cc, so no kernel template is instantiated with this flag.
+#include "zircon/utility/distance_dispatch.h"
+#include <immintrin.h>
+
+namespace zircon::distance::detail {
+
+    namespace {
+
+        // bytes [0, n) of p, zero above, n < 64
+        inline __m512i load_tail(const uint8_t *p, std::size_t n) {
+            return _mm512_maskz_loadu_epi8(_cvtu64_mask64((uint64_t{1} << n) - 1), p);
+        }
+
+        float hamming_vpopcnt(const uint8_t *a, const uint8_t *b, std::size_t nbytes) {
+            __m512i c0 = _mm512_setzero_si512();
+            __m512i c1 = _mm512_setzero_si512();
+            std::size_t i = 0;
+            for (; i + 128 <= nbytes; i += 128) {
+                c0 = _mm512_add_epi64(c0, _mm512_popcnt_epi64(
+                        _mm512_xor_si512(_mm512_loadu_si512(a + i), _mm512_loadu_si512(b + i))));
+                c1 = _mm512_add_epi64(c1, _mm512_popcnt_epi64(
+                        _mm512_xor_si512(_mm512_loadu_si512(a + i + 64), _mm512_loadu_si512(b + i + 64))));
+            }
+            for (; i + 64 <= nbytes; i += 64) {
+                c0 = _mm512_add_epi64(c0, _mm512_popcnt_epi64(
+                        _mm512_xor_si512(_mm512_loadu_si512(a + i), _mm512_loadu_si512(b + i))));
+            }
+            if (i < nbytes) {
+                c1 = _mm512_add_epi64(c1, _mm512_popcnt_epi64(
+                        _mm512_xor_si512(load_tail(a + i, nbytes - i), load_tail(b + i, nbytes - i))));
+            }
+            return static_cast<float>(_mm512_reduce_add_epi64(_mm512_add_epi64(c0, c1)));
+        }
+
+        float jaccard_vpopcnt(const uint8_t *a, const uint8_t *b, std::size_t nbytes) {
+            __m512i inter = _mm512_setzero_si512();
+            __m512i uni = _mm512_setzero_si512();
+            std::size_t i = 0;
+            for (; i < nbytes; i += 64) {
+                __m512i va;
+                __m512i vb;
+                if (i + 64 <= nbytes) {
+                    va = _mm512_loadu_si512(a + i);
+                    vb = _mm512_loadu_si512(b + i);
+                } else {
+                    va = load_tail(a + i, nbytes - i);
+                    vb = load_tail(b + i, nbytes - i);
+                }
+                inter = _mm512_add_epi64(inter, _mm512_popcnt_epi64(_mm512_and_si512(va, vb)));
+                uni = _mm512_add_epi64(uni, _mm512_popcnt_epi64(_mm512_or_si512(va, vb)));
+            }
+            auto u = _mm512_reduce_add_epi64(uni);
+            if (u == 0) {
+                return 0.0f;
+            }
+            return 1.0f - static_cast<float>(_mm512_reduce_add_epi64(inter)) / static_cast<float>(u);
+        }
+
+        // codes up to 64 bytes keep the query in one register, the common
+        // case of sign bit codes of up to 512 dimensions.
+        void batch_hamming_vpopcnt(const uint8_t *query, const uint8_t *base, std::size_t nbytes, std::size_t n,
+                                   float *out) {
+            if (nbytes > 64) {
+                for (std::size_t j = 0; j < n; ++j) {
+                    out[j] = hamming_vpopcnt(query, base + j * nbytes, nbytes);
+                }
+                return;
+            }
+            const __mmask64 mask = nbytes == 64 ? ~__mmask64(0) : _cvtu64_mask64((uint64_t{1} << nbytes) - 1);
+            const __m512i q = _mm512_maskz_loadu_epi8(mask, query);
+            for (std::size_t j = 0; j < n; ++j) {
+                const uint8_t *x = base + j * nbytes;
+                if ((j & 7) == 0) {
+                    _mm_prefetch(reinterpret_cast<const char *>(x + 8 * nbytes), _MM_HINT_T0);
+                }
+                __m512i c = _mm512_popcnt_epi64(_mm512_xor_si512(q, _mm512_maskz_loadu_epi8(mask, x)));
+                out[j] = static_cast<float>(_mm512_reduce_add_epi64(c));
+            }
+        }
+    }  // namespace
+
+    const DistanceKernels *avx512_vpopcnt_distance_kernels() {
+        static const DistanceKernels kernels = [] {
+            DistanceKernels k = *avx512_distance_kernels();
+            k.arch_name = "avx512_vpopcnt";
+            k.hamming = &hamming_vpopcnt;
+            k.jaccard = &jaccard_vpopcnt;
+            k.batch_hamming = &batch_hamming_vpopcnt;
+            return k;
+        }();
+        return &kernels;
+    }
+
+}  // namespace zircon::distance::detail
@@ -0,0 +1,65 @@
+// Copyright 2023 The Elastic-AI Authors.
+// part of Elastic AI Search
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#include "zircon/utility/mapped_file.h"
+#include <cerrno>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace zircon {
+
+    MappedFile::~MappedFile() {
+        close();
+    }
+
+    turbo::Status MappedFile::open(const std::string &path) {
+        close();
+        int fd = ::open(path.c_str(), O_RDONLY);
+        if (fd < 0) {
+            return turbo::errno_to_status(errno, "open " + path);
+        }
+        struct stat st;
+        if (::fstat(fd, &st) != 0) {
+            auto rs = turbo::errno_to_status(errno, "stat " + path);
+            ::close(fd);
+            return rs;
+        }
+        if (st.st_size == 0) {
+            ::close(fd);
+            return turbo::data_loss_error("empty file {}", path);
+        }
+        auto size = static_cast<std::size_t>(st.st_size);
+        void *p = ::mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+        // the mapping keeps its own reference to the file
+        ::close(fd);
+        if (p == MAP_FAILED) {
+            return turbo::errno_to_status(errno, "mmap " + path);
+        }
+        _data = static_cast<uint8_t *>(p);
+        _size = size;
+        return turbo::ok_status();
+    }
+
+    void MappedFile::close() {
+        if (_data != nullptr) {
+            ::munmap(_data, _size);
+            _data = nullptr;
+            _size = 0;
+        }
+    }
+
+}  // namespace zircon
@@ -0,0 +1,61 @@
+// Copyright 2023 The Elastic-AI Authors.
+// part of Elastic AI Search
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#ifndef ZIRCON_UTILITY_MAPPED_FILE_H_
+#define ZIRCON_UTILITY_MAPPED_FILE_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include "turbo/base/status.h"
+
+namespace zircon {
+
+    /**
+     * @brief a whole file mapped into memory. the mapping is private, pages
+     *        are loaded on first touch and writing to them copy the page,
+     *        the file itself is never changed.
+     */
+    class MappedFile {
+    public:
+        MappedFile() = default;
+
+        ~MappedFile();
+
+        turbo::Status open(const std::string &path);
+
+        void close();
+
+        [[nodiscard]] uint8_t *data() const {
+            return _data;
+        }
+
+        [[nodiscard]] std::size_t size() const {
+            return _size;
+        }
+
+    private:
+        MappedFile(const MappedFile &) = delete;
+
+        MappedFile &operator=(const MappedFile &) = delete;
+
+    private:
+        uint8_t *_data{nullptr};
+        std::size_t _size{0};
+    };
+
+}  // namespace zircon
+
+#endif  // ZIRCON_UTILITY_MAPPED_FILE_H_
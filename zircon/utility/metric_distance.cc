@@ -0,0 +1,100 @@
+// Copyright 2023 The Elastic-AI Authors.
+// part of Elastic AI Search
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#include "zircon/utility/metric_distance.h"
+
+namespace zircon {
+
+    turbo::Status MetricDistance::initialize(MetricType metric, std::size_t dimension) {
+        if (dimension == 0) {
+            return turbo::invalid_argument_error("dimension must be set");
+        }
+        auto &kernels = distance::distance_kernels();
+        _bias = 0.0f;
+        _sign = 1.0f;
+        _batch_func = nullptr;
+        _ip_func = kernels.ip;
+        _batch_ip_func = kernels.batch_ip;
+        switch (metric) {
+            case MetricType::METRIC_L1:
+                _func = kernels.l1;
+                _batch_func = kernels.batch_l1;
+                break;
+            case MetricType::METRIC_L2:
+                _func = kernels.l2;
+                _batch_func = kernels.batch_l2;
+                break;
+            case MetricType::METRIC_IP:
+                _func = kernels.ip;
+                _batch_func = kernels.batch_ip;
+                _sign = -1.0f;
+                break;
+            case MetricType::METRIC_NORMALIZED_COSINE:
+                _func = kernels.ip;
+                _batch_func = kernels.batch_ip;
+                _bias = 1.0f;
+                _sign = -1.0f;
+                break;
+            case MetricType::METRIC_COSINE:
+                _func = kernels.cosine;
+                break;
+            case MetricType::METRIC_POINCARE:
+                _func = kernels.poincare;
+                _batch_func = kernels.batch_poincare;
+                break;
+            case MetricType::METRIC_LORENTZ:
+                // the time coordinate and at least one space one
+                if (dimension < 2) {
+                    return turbo::invalid_argument_error("lorentz need dimension >= 2");
+                }
+                _func = kernels.lorentz;
+                _batch_func = kernels.batch_lorentz;
+                break;
+            default:
+                return turbo::invalid_argument_error("metric not support for float vectors");
+        }
+        _metric = metric;
+        _dimension = dimension;
+        return turbo::ok_status();
+    }
+
+    void MetricDistance::batch(const float *query, const float *base, std::size_t n, float *out) const {
+        if (_batch_func == nullptr) {
+            for (std::size_t i = 0; i < n; ++i) {
+                out[i] = _func(query, base + i * _dimension, _dimension);
+            }
+            return;
+        }
+        _batch_func(query, base, _dimension, n, out);
+        if (_sign != 1.0f || _bias != 0.0f) {
+            for (std::size_t i = 0; i < n; ++i) {
+                out[i] = _bias + _sign * out[i];
+            }
+        }
+    }
+
+    void MetricDistance::batch(const float *query, float query_norm, const float *base, const float *norms,
+                               std::size_t n, float *out) const {
+        if (!use_norms()) {
+            batch(query, base, n, out);
+            return;
+        }
+        _batch_ip_func(query, base, _dimension, n, out);
+        for (std::size_t i = 0; i < n; ++i) {
+            out[i] = cosine(out[i], query_norm * norms[i]);
+        }
+    }
+
+}  // namespace zircon
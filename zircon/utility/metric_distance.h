@@ -0,0 +1,98 @@
+// Copyright 2023 The Elastic-AI Authors.
+// part of Elastic AI Search
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#ifndef ZIRCON_UTILITY_METRIC_DISTANCE_H_
+#define ZIRCON_UTILITY_METRIC_DISTANCE_H_
+
+#include <cmath>
+#include "turbo/base/status.h"
+#include "zircon/core/metric_type.h"
+#include "zircon/utility/distance_dispatch.h"
+
+namespace zircon {
+
+    /**
+     * @ingroup zircon_utility_distance
+     * @brief the float distance of a metric bound to the dispatched kernel, for
+     *        the indexes that pick the metric at runtime. the value has the
+     *        VectorDistance semantics, bias + sign * kernel(a, b), so -ip for
+     *        METRIC_IP and 1 - ip for METRIC_NORMALIZED_COSINE.
+     */
+    class MetricDistance {
+    public:
+        MetricDistance() = default;
+
+        // METRIC_L1, METRIC_L2, METRIC_IP, METRIC_COSINE, METRIC_NORMALIZED_COSINE,
+        // METRIC_POINCARE or METRIC_LORENTZ
+        turbo::Status initialize(MetricType metric, std::size_t dimension);
+
+        float operator()(const float *a, const float *b) const {
+            return _bias + _sign * _func(a, b, _dimension);
+        }
+
+        // out[i] is the distance between query and the i-th of n vectors stored one after another
+        void batch(const float *query, const float *base, std::size_t n, float *out) const;
+
+        // METRIC_COSINE, the norms kept by a store turn it into one inner product
+        [[nodiscard]] bool use_norms() const {
+            return _metric == MetricType::METRIC_COSINE;
+        }
+
+        // l2 norm of a vector of the dimension
+        [[nodiscard]] float norm(const float *a) const {
+            return std::sqrt(_ip_func(a, a, _dimension));
+        }
+
+        // the distance from the l2 norms of a and b, the same as operator() for the other metrics
+        float operator()(const float *a, float norm_a, const float *b, float norm_b) const {
+            if (!use_norms()) {
+                return (*this)(a, b);
+            }
+            return cosine(_ip_func(a, b, _dimension), norm_a * norm_b);
+        }
+
+        // batch with the l2 norm of the query and the n norms of the vectors
+        void batch(const float *query, float query_norm, const float *base, const float *norms, std::size_t n,
+                   float *out) const;
+
+        [[nodiscard]] MetricType metric() const {
+            return _metric;
+        }
+
+        [[nodiscard]] std::size_t dimension() const {
+            return _dimension;
+        }
+
+    private:
+        // 1 - ip / norms, 1 if one of the vectors is zero like the cosine kernels
+        static float cosine(float ip, float norms) {
+            return norms <= 0.0f ? 1.0f : 1.0f - ip / norms;
+        }
+
+    private:
+        MetricType _metric{MetricType::UNDEFINED};
+        std::size_t _dimension{0};
+        distance::float_distance_func _func{nullptr};
+        distance::batch_distance_func _batch_func{nullptr};
+        // the inner product kernels for the distances from norms
+        distance::float_distance_func _ip_func{nullptr};
+        distance::batch_distance_func _batch_ip_func{nullptr};
+        float _bias{0.0f};
+        float _sign{1.0f};
+    };
+
+}  // namespace zircon
+
+#endif  // ZIRCON_UTILITY_METRIC_DISTANCE_H_
@@ -0,0 +1,223 @@
+// Copyright 2023 The Elastic-AI Authors.
+// part of Elastic AI Search
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+#include "zircon/utility/metrics.h"
+#include <algorithm>
+#include <cstdio>
+
+namespace zircon {
+
+    std::size_t MetricCounter::cell_index() {
+        static std::atomic<std::size_t> next{0};
+        thread_local std::size_t cell = next.fetch_add(1, std::memory_order_relaxed) % kCells;
+        return cell;
+    }
+
+    uint64_t MetricCounter::value() const {
+        uint64_t sum = 0;
+        for (auto &c: _cells) {
+            sum += c.value.load(std::memory_order_relaxed);
+        }
+        return sum;
+    }
+
+    void MetricCounter::reset() {
+        for (auto &c: _cells) {
+            c.value.store(0, std::memory_order_relaxed);
+        }
+    }
+
+    std::size_t LatencyHistogram::bucket_of(uint64_t value) {
+        if (value < kSubBuckets) {
+            return static_cast<std::size_t>(value);
+        }
+        const std::size_t msb = 63 - static_cast<std::size_t>(__builtin_clzll(value));
+        const std::size_t sub = static_cast<std::size_t>(value >> (msb - kSubBits)) & (kSubBuckets - 1);
+        return (msb - kSubBits + 1) * kSubBuckets + sub;
+    }
+
+    uint64_t LatencyHistogram::bucket_upper(std::size_t b) {
+        if (b < kSubBuckets) {
+            return b;
+        }
+        const std::size_t msb = b / kSubBuckets + kSubBits - 1;
+        const uint64_t width = uint64_t{1} << (msb - kSubBits);
+        const uint64_t lower = (uint64_t{1} << msb) | (static_cast<uint64_t>(b % kSubBuckets) << (msb - kSubBits));
+        return lower + (width - 1);
+    }
+
+    HistogramSnapshot LatencyHistogram::snapshot() const {
+        HistogramSnapshot s;
+        s.buckets.resize(kBuckets);
+        for (std::size_t b = 0; b < kBuckets; ++b) {
+            s.buckets[b] = _buckets[b].load(std::memory_order_relaxed);
+            s.count += s.buckets[b];
+        }
+        s.sum = _sum.load(std::memory_order_relaxed);
+        return s;
+    }
+
+    void LatencyHistogram::reset() {
+        for (auto &b: _buckets) {
+            b.store(0, std::memory_order_relaxed);
+        }
+        _sum.store(0, std::memory_order_relaxed);
+    }
+
+    uint64_t HistogramSnapshot::percentile(double q) const {
+        if (count == 0) {
+            return 0;
+        }
+        q = std::min(std::max(q, 0.0), 1.0);
+        // the rank of the quantile, 1 based
+        auto rank = std::max<uint64_t>(1, static_cast<uint64_t>(q * static_cast<double>(count) + 0.5));
+        uint64_t seen = 0;
+        for (std::size_t b = 0; b < buckets.size(); ++b) {
+            seen += buckets[b];
+            if (seen >= rank) {
+                return LatencyHistogram::bucket_upper(b);
+            }
+        }
+        return LatencyHistogram::bucket_upper(buckets.size() - 1);
+    }
+
+    MetricsRegistry &MetricsRegistry::global() {
+        // never destroyed, the metrics may be reported to from static destructors
+        static auto *registry = new MetricsRegistry();
+        return *registry;
+    }
+
+    MetricCounter &MetricsRegistry::counter(const std::string &name, const std::string &help) {
+        std::lock_guard<std::mutex> lock(_mutex);
+        auto &e = _counters[name];
+        if (e.metric == nullptr) {
+            e.metric = std::make_unique<MetricCounter>();
+            e.help = help;
+        }
+        return *e.metric;
+    }
+
+    LatencyHistogram &MetricsRegistry::histogram(const std::string &name, const std::string &help) {
+        std::lock_guard<std::mutex> lock(_mutex);
+        auto &e = _histograms[name];
+        if (e.metric == nullptr) {
+            e.metric = std::make_unique<LatencyHistogram>();
+            e.help = help;
+        }
+        return *e.metric;
+    }
+
+    std::vector<std::pair<std::string, uint64_t>> MetricsRegistry::counters() const {
+        std::lock_guard<std::mutex> lock(_mutex);
+        std::vector<std::pair<std::string, uint64_t>> result;
+        result.reserve(_counters.size());
+        for (auto &[name, e]: _counters) {
+            result.emplace_back(name, e.metric->value());
+        }
+        return result;
+    }
+
+    std::vector<std::pair<std::string, HistogramSnapshot>> MetricsRegistry::histograms() const {
+        std::lock_guard<std::mutex> lock(_mutex);
+        std::vector<std::pair<std::string, HistogramSnapshot>> result;
+        result.reserve(_histograms.size());
+        for (auto &[name, e]: _histograms) {
+            result.emplace_back(name, e.metric->snapshot());
+        }
+        return result;
+    }
+
+    std::string MetricsRegistry::scrape() const {
+        std::lock_guard<std::mutex> lock(_mutex);
+        std::string out;
+        char line[256];
+        auto header = [&](const std::string &name, const std::string &help, const char *type) {
+            if (!help.empty()) {
+                out += "# HELP " + name + " " + help + "\n";
+            }
+            out += "# TYPE " + name + " " + type + "\n";
+        };
+        for (auto &[name, e]: _counters) {
+            header(name, e.help, "counter");
+            std::snprintf(line, sizeof(line), "%s %llu\n", name.c_str(),
+                          static_cast<unsigned long long>(e.metric->value()));
+            out += line;
+        }
+        for (auto &[name, e]: _histograms) {
+            header(name, e.help, "histogram");
+            auto s = e.metric->snapshot();
+            uint64_t cumulated = 0;
+            for (std::size_t b = 0; b < s.buckets.size(); ++b) {
+                if (s.buckets[b] == 0) {
+                    continue;
+                }
+                cumulated += s.buckets[b];
+                std::snprintf(line, sizeof(line), "%s_bucket{le=\"%llu\"} %llu\n", name.c_str(),
+                              static_cast<unsigned long long>(LatencyHistogram::bucket_upper(b)),
+                              static_cast<unsigned long long>(cumulated));
+                out += line;
+            }
+            std::snprintf(line, sizeof(line), "%s_bucket{le=\"+Inf\"} %llu\n%s_sum %llu\n%s_count %llu\n",
+                          name.c_str(), static_cast<unsigned long long>(s.count), name.c_str(),
+                          static_cast<unsigned long long>(s.sum), name.c_str(),
+                          static_cast<unsigned long long>(s.count));
+            out += line;
+        }
+        return out;
+    }
+
+    void MetricsRegistry::reset() {
+        std::lock_guard<std::mutex> lock(_mutex);
+        for (auto &[name, e]: _counters) {
+            e.metric->reset();
+        }
+        for (auto &[name, e]: _histograms) {
+            e.metric->reset();
+        }
+    }
+
+    SearchMetrics::SearchMetrics(const std::string &kind)
+            : queries(MetricsRegistry::global().counter("zircon_" + kind + "_search_queries", "searches run")),
+              distance_computations(MetricsRegistry::global().counter(
+                      "zircon_" + kind + "_search_distance_computations", "distances to vectors or codes")),
+              nodes_visited(MetricsRegistry::global().counter("zircon_" + kind + "_search_nodes_visited",
+                                                              "graph nodes expanded")),
+              lists_probed(MetricsRegistry::global().counter("zircon_" + kind + "_search_lists_probed",
+                                                             "posting lists scanned")),
+              filter_rejected(MetricsRegistry::global().counter("zircon_" + kind + "_search_filter_rejected",
+                                                                "candidates dropped by the filter or removed")),
+              io_reads(MetricsRegistry::global().counter("zircon_" + kind + "_search_io_reads", "node reads")),
+              latency(MetricsRegistry::global().histogram("zircon_" + kind + "_search_latency_ns",
+                                                          "search latency in nanoseconds")) {}
+
+    SearchRecorder::~SearchRecorder() {
+        stats.latency_ns = now_ns() - _start;
+        _metrics.queries.add();
+        _metrics.distance_computations.add(stats.distance_computations);
+        _metrics.nodes_visited.add(stats.nodes_visited);
+        _metrics.lists_probed.add(stats.lists_probed);
+        _metrics.filter_rejected.add(stats.filter_rejected);
+        _metrics.io_reads.add(stats.io_reads);
+        _metrics.latency.record(stats.latency_ns);
+        if (_out != nullptr) {
+            _out->distance_computations += stats.distance_computations;
+            _out->nodes_visited += stats.nodes_visited;
+            _out->lists_probed += stats.lists_probed;
+            _out->filter_rejected += stats.filter_rejected;
+            _out->io_reads += stats.io_reads;
+            _out->latency_ns += stats.latency_ns;
+        }
+    }
+
+}  // namespace zircon
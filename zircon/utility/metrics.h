@@ -0,0 +1,234 @@
+// Copyright 2023 The Elastic-AI Authors.
+// part of Elastic AI Search
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#ifndef ZIRCON_UTILITY_METRICS_H_
+#define ZIRCON_UTILITY_METRICS_H_
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+#include "zircon/core/defines.h"
+
+namespace zircon {
+
+    inline uint64_t now_ns() {
+        return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+                std::chrono::steady_clock::now().time_since_epoch()).count());
+    }
+
+    /**
+     * @brief monotonic counter for the hot paths. the count is split over
+     *        cache line sized cells, a thread always add to the same cell with
+     *        a relaxed atomic, so threads of different cores do not bounce one
+     *        line. value() sums the cells, it is not a snapshot of a single
+     *        instant while writers run.
+     */
+    class MetricCounter {
+    public:
+        static constexpr std::size_t kCells = 16;
+
+        void add(uint64_t n = 1) {
+            _cells[cell_index()].value.fetch_add(n, std::memory_order_relaxed);
+        }
+
+        [[nodiscard]] uint64_t value() const;
+
+        void reset();
+
+    private:
+        struct alignas(64) Cell {
+            std::atomic<uint64_t> value{0};
+        };
+
+        // the cell of the calling thread, given round robin on its first add
+        static std::size_t cell_index();
+
+        std::array<Cell, kCells> _cells;
+    };
+
+    struct HistogramSnapshot {
+        uint64_t count{0};
+        uint64_t sum{0};
+        std::vector<uint64_t> buckets;
+
+        // upper bound of the bucket holding the q quantile, q in [0, 1], 0 if empty
+        [[nodiscard]] uint64_t percentile(double q) const;
+
+        [[nodiscard]] double mean() const {
+            return count == 0 ? 0.0 : static_cast<double>(sum) / static_cast<double>(count);
+        }
+    };
+
+    /**
+     * @brief histogram of latencies in nanoseconds, or any positive value.
+     *        the buckets are log linear, kSubBuckets per power of two, so the
+     *        relative error of a percentile is below 1 / kSubBuckets. a record
+     *        is two relaxed atomic adds, the count is the sum of the buckets.
+     */
+    class LatencyHistogram {
+    public:
+        static constexpr std::size_t kSubBits = 2;
+        static constexpr std::size_t kSubBuckets = std::size_t{1} << kSubBits;
+        // values below kSubBuckets get a bucket each, then kSubBuckets per power of two
+        static constexpr std::size_t kBuckets = (64 - kSubBits + 1) * kSubBuckets;
+
+        void record(uint64_t value) {
+            _buckets[bucket_of(value)].fetch_add(1, std::memory_order_relaxed);
+            _sum.fetch_add(value, std::memory_order_relaxed);
+        }
+
+        [[nodiscard]] HistogramSnapshot snapshot() const;
+
+        void reset();
+
+        static std::size_t bucket_of(uint64_t value);
+
+        // the largest value of bucket b
+        static uint64_t bucket_upper(std::size_t b);
+
+    private:
+        std::array<std::atomic<uint64_t>, kBuckets> _buckets{};
+        std::atomic<uint64_t> _sum{0};
+    };
+
+    // record the time from the construction to the destruction of the timer
+    class ScopedLatency {
+    public:
+        explicit ScopedLatency(LatencyHistogram &histogram) : _histogram(histogram), _start(now_ns()) {}
+
+        ~ScopedLatency() {
+            _histogram.record(now_ns() - _start);
+        }
+
+        ScopedLatency(const ScopedLatency &) = delete;
+
+        ScopedLatency &operator=(const ScopedLatency &) = delete;
+
+    private:
+        LatencyHistogram &_histogram;
+        uint64_t _start;
+    };
+
+    /**
+     * @brief lock with a std::unique_lock or std::shared_lock made with
+     *        std::defer_lock, the time waited is recorded once the try lock
+     *        failed, so an uncontended lock never reads the clock.
+     */
+    template<typename Lock>
+    void lock_timed(Lock &lock, LatencyHistogram &wait) {
+        if (lock.try_lock()) {
+            return;
+        }
+        auto start = now_ns();
+        lock.lock();
+        wait.record(now_ns() - start);
+    }
+
+    /**
+     * @brief named counters and histograms of the library. a metric is created
+     *        on the first lookup of its name and lives as long as the registry,
+     *        the hot paths look it up once and keep the reference. the global
+     *        registry is the one the library reports to, see scrape.
+     */
+    class MetricsRegistry {
+    public:
+        MetricsRegistry() = default;
+
+        MetricsRegistry(const MetricsRegistry &) = delete;
+
+        MetricsRegistry &operator=(const MetricsRegistry &) = delete;
+
+        static MetricsRegistry &global();
+
+        MetricCounter &counter(const std::string &name, const std::string &help = "");
+
+        LatencyHistogram &histogram(const std::string &name, const std::string &help = "");
+
+        // current values, sorted by name
+        [[nodiscard]] std::vector<std::pair<std::string, uint64_t>> counters() const;
+
+        [[nodiscard]] std::vector<std::pair<std::string, HistogramSnapshot>> histograms() const;
+
+        /**
+         * @brief every metric in the prometheus text exposition format. the
+         *        histograms list their non empty buckets only, cumulated, with
+         *        the +Inf one, _sum and _count.
+         */
+        [[nodiscard]] std::string scrape() const;
+
+        // zero every metric, the references stay valid
+        void reset();
+
+    private:
+        template<typename T>
+        struct Entry {
+            std::string help;
+            std::unique_ptr<T> metric;
+        };
+
+        mutable std::mutex _mutex;
+        // guard by _mutex
+        std::map<std::string, Entry<MetricCounter>> _counters;
+        std::map<std::string, Entry<LatencyHistogram>> _histograms;
+    };
+
+    /**
+     * @brief the global metrics of the searches of one index kind, named
+     *        zircon_<kind>_search_<count>, the latency in nanoseconds.
+     */
+    struct SearchMetrics {
+        explicit SearchMetrics(const std::string &kind);
+
+        MetricCounter &queries;
+        MetricCounter &distance_computations;
+        MetricCounter &nodes_visited;
+        MetricCounter &lists_probed;
+        MetricCounter &filter_rejected;
+        MetricCounter &io_reads;
+        LatencyHistogram &latency;
+    };
+
+    /**
+     * @brief the counts of one search. the index adds to stats while it
+     *        searches, the destructor sets the latency, adds the counts to the
+     *        global metrics and to out if not null, eg. SearchOption::stats.
+     */
+    class SearchRecorder {
+    public:
+        SearchRecorder(SearchMetrics &metrics, QueryStats *out) : _metrics(metrics), _out(out), _start(now_ns()) {}
+
+        ~SearchRecorder();
+
+        SearchRecorder(const SearchRecorder &) = delete;
+
+        SearchRecorder &operator=(const SearchRecorder &) = delete;
+
+        QueryStats stats;
+
+    private:
+        SearchMetrics &_metrics;
+        QueryStats *_out;
+        uint64_t _start;
+    };
+
+}  // namespace zircon
+
+#endif  // ZIRCON_UTILITY_METRICS_H_
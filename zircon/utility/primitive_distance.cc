@@ -14,6 +14,8 @@
 //
 
 #include "zircon/utility/primitive_distance.h"
+#include <algorithm>
+#include <cmath>
 
 namespace zircon::distance {
 
@@ -26,25 +28,137 @@ namespace zircon::distance {
     }
 
     float distance_l1(turbo::Span<float> a, turbo::Span<float> b) {
-        using b_type = turbo::simd::batch<float, turbo::simd::default_arch>;
         bool is_aligned = turbo::is_aligned(a.data(), 64) && turbo::is_aligned(b.data(), 64);
         TLOG_CHECK(is_aligned, "the memory must be aligned");
-        std::size_t inc = b_type::size;
-        std::size_t size = a.size();
-        // size for which the vectorization is possible
-        std::size_t vec_size = size - size % inc;
-        float sum = 0.0;
-        b_type sum_vec = b_type::broadcast(0.0f);
-        for (std::size_t i = 0; i < vec_size; i += inc) {
-            b_type avec = b_type::load(&a[i], turbo::aligned_mode());
-            b_type bvec = b_type::load(&b[i], turbo::aligned_mode());
-            sum_vec += turbo::simd::fabs(avec - bvec);
+        return distance_kernels().l1(a.data(), b.data(), a.size());
+    }
+
+    float simple_distance_l2(turbo::Span<float> a, turbo::Span<float> b) {
+        float distance = 0.0f;
+        for (std::size_t i = 0; i < a.size(); ++i) {
+            float d = a[i] - b[i];
+            distance += d * d;
+        }
+        return distance;
+    }
+
+    float distance_l2(turbo::Span<float> a, turbo::Span<float> b) {
+        return distance_kernels().l2(a.data(), b.data(), a.size());
+    }
+
+    float simple_distance_ip(turbo::Span<float> a, turbo::Span<float> b) {
+        float distance = 0.0f;
+        for (std::size_t i = 0; i < a.size(); ++i) {
+            distance += a[i] * b[i];
+        }
+        return distance;
+    }
+
+    float distance_ip(turbo::Span<float> a, turbo::Span<float> b) {
+        return distance_kernels().ip(a.data(), b.data(), a.size());
+    }
+
+    float simple_distance_cosine(turbo::Span<float> a, turbo::Span<float> b) {
+        float dot = 0.0f;
+        float na = 0.0f;
+        float nb = 0.0f;
+        for (std::size_t i = 0; i < a.size(); ++i) {
+            dot += a[i] * b[i];
+            na += a[i] * a[i];
+            nb += b[i] * b[i];
+        }
+        if (na * nb <= 0.0f) {
+            return 1.0f;
+        }
+        return 1.0f - dot / std::sqrt(na * nb);
+    }
+
+    float distance_cosine(turbo::Span<float> a, turbo::Span<float> b) {
+        return distance_kernels().cosine(a.data(), b.data(), a.size());
+    }
+
+    float simple_distance_poincare(turbo::Span<float> a, turbo::Span<float> b) {
+        double diff = 0.0;
+        double na = 0.0;
+        double nb = 0.0;
+        for (std::size_t i = 0; i < a.size(); ++i) {
+            double d = double(a[i]) - double(b[i]);
+            diff += d * d;
+            na += double(a[i]) * a[i];
+            nb += double(b[i]) * b[i];
         }
+        const double eps = 1e-7;
+        double denom = std::max(1.0 - na, eps) * std::max(1.0 - nb, eps);
+        return static_cast<float>(std::acosh(1.0 + 2.0 * diff / denom));
+    }
+
+    float distance_poincare(turbo::Span<float> a, turbo::Span<float> b) {
+        return distance_kernels().poincare(a.data(), b.data(), a.size());
+    }
 
-        sum += turbo::simd::reduce_add(sum_vec);
-        for (std::size_t i = vec_size; i < size; ++i) {
-            sum += std::fabs(a[i] - b[i]);
+    float simple_distance_lorentz(turbo::Span<float> a, turbo::Span<float> b) {
+        if (a.empty()) {
+            return 0.0f;
         }
-        return sum;
+        double ip = -double(a[0]) * b[0];
+        for (std::size_t i = 1; i < a.size(); ++i) {
+            ip += double(a[i]) * b[i];
+        }
+        return static_cast<float>(std::acosh(std::max(1.0, -ip)));
+    }
+
+    float distance_lorentz(turbo::Span<float> a, turbo::Span<float> b) {
+        return distance_kernels().lorentz(a.data(), b.data(), a.size());
+    }
+
+    float norm_l2(turbo::Span<float> a) {
+        return std::sqrt(distance_kernels().ip(a.data(), a.data(), a.size()));
+    }
+
+    float normalize_l2(turbo::Span<float> a) {
+        const float norm = norm_l2(a);
+        if (norm > 0.0f) {
+            const float scale = 1.0f / norm;
+            for (auto &v: a) {
+                v *= scale;
+            }
+        }
+        return norm;
+    }
+
+    float simple_distance_hamming(turbo::Span<uint8_t> a, turbo::Span<uint8_t> b) {
+        std::size_t distance = 0;
+        for (std::size_t i = 0; i < a.size(); ++i) {
+            uint8_t x = a[i] ^ b[i];
+            for (; x; x &= x - 1) {
+                ++distance;
+            }
+        }
+        return static_cast<float>(distance);
+    }
+
+    float distance_hamming(turbo::Span<uint8_t> a, turbo::Span<uint8_t> b) {
+        return distance_kernels().hamming(a.data(), b.data(), a.size());
+    }
+
+    float simple_distance_jaccard(turbo::Span<uint8_t> a, turbo::Span<uint8_t> b) {
+        std::size_t inter = 0;
+        std::size_t uni = 0;
+        for (std::size_t i = 0; i < a.size(); ++i) {
+            for (uint8_t x = a[i] & b[i]; x; x &= x - 1) {
+                ++inter;
+            }
+            for (uint8_t x = a[i] | b[i]; x; x &= x - 1) {
+                ++uni;
+            }
+        }
+        if (uni == 0) {
+            return 0.0f;
+        }
+        return 1.0f - static_cast<float>(inter) / static_cast<float>(uni);
+    }
+
+    float distance_jaccard(turbo::Span<uint8_t> a, turbo::Span<uint8_t> b) {
+        return distance_kernels().jaccard(a.data(), b.data(), a.size());
     }
-}  // namespace zircon::distance
\ No newline at end of file
+}  // namespace zircon::distance
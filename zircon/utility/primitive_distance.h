@@ -24,6 +24,7 @@
 #include "zircon//core/allocator.h"
 #include "turbo/log/logging.h"
 #include "turbo/memory/prefetch.h"
+#include "zircon/utility/distance_dispatch.h"
 
 namespace zircon::distance {
 
@@ -42,12 +43,186 @@ namespace zircon::distance {
      * @ingroup zircon_utility_distance
      * @brief Compute the L1 distance between two vectors.
      *        SUM(|a[i] - b[i]|), SIMD implementation.
-     *        simd implementation is faster than simple_distance_l1
+     *        simd implementation is faster than simple_distance_l1,
+     *        the instruction set is selected at runtime.
      * @param a The first vector.
      * @param b The second vector.
      * @return The L1 distance between the two vectors.
      */
     float distance_l1(turbo::Span<float> a, turbo::Span<float> b);
+
+    /**
+     * @ingroup zircon_utility_distance
+     * @brief Compute the squared L2 distance between two vectors.
+     *        SUM((a[i] - b[i])^2), simple and slow implementation
+     *        for testing purposes.
+     * @param a The first vector.
+     * @param b The second vector.
+     * @return The squared L2 distance between the two vectors.
+     */
+    float simple_distance_l2(turbo::Span<float> a, turbo::Span<float> b);
+
+    /**
+     * @ingroup zircon_utility_distance
+     * @brief Compute the squared L2 distance between two vectors.
+     *        SUM((a[i] - b[i])^2), SIMD implementation selected at runtime.
+     * @param a The first vector.
+     * @param b The second vector.
+     * @return The squared L2 distance between the two vectors.
+     */
+    float distance_l2(turbo::Span<float> a, turbo::Span<float> b);
+
+    /**
+     * @ingroup zircon_utility_distance
+     * @brief Compute the inner product of two vectors.
+     *        SUM(a[i] * b[i]), simple and slow implementation
+     *        for testing purposes.
+     * @param a The first vector.
+     * @param b The second vector.
+     * @return The inner product of the two vectors.
+     */
+    float simple_distance_ip(turbo::Span<float> a, turbo::Span<float> b);
+
+    /**
+     * @ingroup zircon_utility_distance
+     * @brief Compute the inner product of two vectors.
+     *        SUM(a[i] * b[i]), SIMD implementation selected at runtime.
+     *        note this is a similarity, bigger is closer.
+     * @param a The first vector.
+     * @param b The second vector.
+     * @return The inner product of the two vectors.
+     */
+    float distance_ip(turbo::Span<float> a, turbo::Span<float> b);
+
+    /**
+     * @ingroup zircon_utility_distance
+     * @brief Compute the cosine distance between two vectors.
+     *        1 - ip(a, b) / (|a| * |b|), simple and slow implementation
+     *        for testing purposes.
+     * @param a The first vector.
+     * @param b The second vector.
+     * @return The cosine distance, 1 if one of the vectors is zero.
+     */
+    float simple_distance_cosine(turbo::Span<float> a, turbo::Span<float> b);
+
+    /**
+     * @ingroup zircon_utility_distance
+     * @brief Compute the cosine distance between two vectors.
+     *        1 - ip(a, b) / (|a| * |b|), SIMD implementation selected at runtime,
+     *        the inner product and both norms are computed in one pass.
+     * @param a The first vector.
+     * @param b The second vector.
+     * @return The cosine distance, 1 if one of the vectors is zero.
+     */
+    float distance_cosine(turbo::Span<float> a, turbo::Span<float> b);
+
+    /**
+     * @ingroup zircon_utility_distance
+     * @brief Compute the poincare ball distance between two vectors.
+     *        acosh(1 + 2|a - b|^2 / ((1 - |a|^2)(1 - |b|^2))), computed in double,
+     *        simple and slow implementation for testing purposes.
+     * @param a The first vector, |a| < 1.
+     * @param b The second vector, |b| < 1.
+     * @return The hyperbolic distance, points on or beyond the boundary are
+     *         taken just inside it.
+     */
+    float simple_distance_poincare(turbo::Span<float> a, turbo::Span<float> b);
+
+    /**
+     * @ingroup zircon_utility_distance
+     * @brief Compute the poincare ball distance between two vectors.
+     *        acosh(1 + 2|a - b|^2 / ((1 - |a|^2)(1 - |b|^2))), SIMD implementation
+     *        selected at runtime, the difference and both norms are computed in
+     *        one pass and the acosh is taken with log1p to keep the small distances.
+     * @param a The first vector, |a| < 1.
+     * @param b The second vector, |b| < 1.
+     * @return The hyperbolic distance, points on or beyond the boundary are
+     *         taken just inside it.
+     */
+    float distance_poincare(turbo::Span<float> a, turbo::Span<float> b);
+
+    /**
+     * @ingroup zircon_utility_distance
+     * @brief Compute the lorentz model distance between two vectors.
+     *        acosh(-<a, b>_L), <a, b>_L = -a[0] * b[0] + SUM(a[i] * b[i], i > 0),
+     *        computed in double, simple and slow implementation for testing purposes.
+     * @param a The first vector, on the hyperboloid <a, a>_L = -1, a[0] > 0.
+     * @param b The second vector, on the hyperboloid <b, b>_L = -1, b[0] > 0.
+     * @return The hyperbolic distance.
+     */
+    float simple_distance_lorentz(turbo::Span<float> a, turbo::Span<float> b);
+
+    /**
+     * @ingroup zircon_utility_distance
+     * @brief Compute the lorentz model distance between two vectors.
+     *        acosh(-<a, b>_L), SIMD implementation selected at runtime. the
+     *        argument is taken from the differences of the coordinates, which
+     *        is the same on the hyperboloid and does not cancel for close points.
+     * @param a The first vector, on the hyperboloid <a, a>_L = -1, a[0] > 0.
+     * @param b The second vector, on the hyperboloid <b, b>_L = -1, b[0] > 0.
+     * @return The hyperbolic distance.
+     */
+    float distance_lorentz(turbo::Span<float> a, turbo::Span<float> b);
+
+    /**
+     * @ingroup zircon_utility_distance
+     * @brief Compute the l2 norm of a vector.
+     *        sqrt(SUM(a[i] * a[i])), SIMD implementation selected at runtime.
+     * @param a The vector.
+     * @return The l2 norm of the vector.
+     */
+    float norm_l2(turbo::Span<float> a);
+
+    /**
+     * @ingroup zircon_utility_distance
+     * @brief Scale a vector to unit l2 norm in place. a zero vector is left
+     *        unchanged, the cosine kernels treat it as orthogonal to anything.
+     * @param a The vector.
+     * @return The l2 norm of the vector before the scaling.
+     */
+    float normalize_l2(turbo::Span<float> a);
+
+    /**
+     * @ingroup zircon_utility_distance
+     * @brief Compute the hamming distance between two packed bit vectors.
+     *        popcount(a ^ b), simple and slow implementation
+     *        for testing purposes.
+     * @param a The first vector.
+     * @param b The second vector.
+     * @return The number of different bits.
+     */
+    float simple_distance_hamming(turbo::Span<uint8_t> a, turbo::Span<uint8_t> b);
+
+    /**
+     * @ingroup zircon_utility_distance
+     * @brief Compute the hamming distance between two packed bit vectors.
+     *        popcount(a ^ b), 64 bits a time implementation selected at runtime.
+     * @param a The first vector.
+     * @param b The second vector.
+     * @return The number of different bits.
+     */
+    float distance_hamming(turbo::Span<uint8_t> a, turbo::Span<uint8_t> b);
+
+    /**
+     * @ingroup zircon_utility_distance
+     * @brief Compute the jaccard distance between two packed bit vectors.
+     *        1 - popcount(a & b) / popcount(a | b), simple and slow implementation
+     *        for testing purposes.
+     * @param a The first vector.
+     * @param b The second vector.
+     * @return The jaccard distance, 0 if both vectors are empty.
+     */
+    float simple_distance_jaccard(turbo::Span<uint8_t> a, turbo::Span<uint8_t> b);
+
+    /**
+     * @ingroup zircon_utility_distance
+     * @brief Compute the jaccard distance between two packed bit vectors.
+     *        1 - popcount(a & b) / popcount(a | b), implementation selected at runtime.
+     * @param a The first vector.
+     * @param b The second vector.
+     * @return The jaccard distance, 0 if both vectors are empty.
+     */
+    float distance_jaccard(turbo::Span<uint8_t> a, turbo::Span<uint8_t> b);
 }  // namespace zircon::distance
 
 #endif // ZIRCON_UTILITY_PRIMITIVE_DISTANCE_H_
@@ -0,0 +1,184 @@
+// Copyright 2023 The Elastic-AI Authors.
+// part of Elastic AI Search
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#include "zircon/utility/thread_pool.h"
+#include <algorithm>
+
+namespace zircon {
+
+    ThreadPool::ThreadPool(std::size_t nthreads) {
+        if (nthreads == 0) {
+            nthreads = std::max<std::size_t>(std::thread::hardware_concurrency(), 1);
+        }
+        const std::size_t nworkers = nthreads - 1;
+        for (std::size_t i = 0; i < nworkers; ++i) {
+            _queues.push_back(std::make_unique<Queue>());
+        }
+        for (std::size_t i = 0; i < nworkers; ++i) {
+            _workers.emplace_back([this, i]() { worker_loop(i); });
+        }
+    }
+
+    ThreadPool::~ThreadPool() {
+        {
+            std::unique_lock<std::mutex> lock(_mutex);
+            _stop = true;
+        }
+        _cv.notify_all();
+        for (auto &w: _workers) {
+            w.join();
+        }
+    }
+
+    ThreadPool &ThreadPool::default_pool() {
+        static ThreadPool pool;
+        return pool;
+    }
+
+    void ThreadPool::parallel_for(std::size_t ntasks,
+                                  const std::function<void(std::size_t task, std::size_t slot)> &fn) {
+        if (ntasks == 0) {
+            return;
+        }
+        const std::size_t caller_slot = _workers.size();
+        if (_workers.empty() || ntasks == 1) {
+            for (std::size_t i = 0; i < ntasks; ++i) {
+                fn(i, caller_slot);
+            }
+            return;
+        }
+        Job job;
+        job.fn = &fn;
+        job.remaining = ntasks;
+        // a contiguous share for every worker
+        const std::size_t nparts = std::min(ntasks, _queues.size());
+        for (std::size_t p = 0; p < nparts; ++p) {
+            Range r{&job, ntasks * p / nparts, ntasks * (p + 1) / nparts};
+            std::unique_lock<std::mutex> lock(_queues[p]->mutex);
+            _queues[p]->ranges.push_back(r);
+        }
+        {
+            std::unique_lock<std::mutex> lock(_mutex);
+            _queued += nparts;
+        }
+        _cv.notify_all();
+        Range task;
+        while (steal_of(&job, task)) {
+            run(task, caller_slot);
+        }
+        // every task is taken, wait for the running ones
+        std::unique_lock<std::mutex> lock(job.mutex);
+        job.cv.wait(lock, [&job]() { return job.done; });
+    }
+
+    void ThreadPool::run(const Range &task, std::size_t slot) {
+        auto *job = task.job;
+        (*job->fn)(task.begin, slot);
+        if (job->remaining.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+            std::unique_lock<std::mutex> lock(job->mutex);
+            job->done = true;
+            job->cv.notify_all();
+        }
+    }
+
+    bool ThreadPool::take(std::size_t slot, Range &task) {
+        auto &q = *_queues[slot];
+        std::unique_lock<std::mutex> lock(q.mutex);
+        if (q.ranges.empty()) {
+            return false;
+        }
+        auto &r = q.ranges.front();
+        task = {r.job, r.begin, r.begin + 1};
+        if (++r.begin == r.end) {
+            q.ranges.pop_front();
+            --_queued;
+        }
+        return true;
+    }
+
+    bool ThreadPool::steal(std::size_t slot, Range &task) {
+        const std::size_t n = _queues.size();
+        for (std::size_t k = 1; k < n; ++k) {
+            auto &victim = *_queues[(slot + k) % n];
+            Range stolen;
+            {
+                std::unique_lock<std::mutex> lock(victim.mutex);
+                if (victim.ranges.empty()) {
+                    continue;
+                }
+                auto &r = victim.ranges.back();
+                if (r.end - r.begin == 1) {
+                    stolen = r;
+                    victim.ranges.pop_back();
+                    --_queued;
+                } else {
+                    const auto mid = r.begin + (r.end - r.begin) / 2;
+                    stolen = {r.job, mid, r.end};
+                    r.end = mid;
+                }
+            }
+            task = {stolen.job, stolen.begin, stolen.begin + 1};
+            if (stolen.begin + 1 < stolen.end) {
+                auto &own = *_queues[slot];
+                {
+                    std::unique_lock<std::mutex> lock(own.mutex);
+                    own.ranges.push_back({stolen.job, stolen.begin + 1, stolen.end});
+                }
+                {
+                    std::unique_lock<std::mutex> lock(_mutex);
+                    ++_queued;
+                }
+                // a sleeping worker may take the rest
+                _cv.notify_one();
+            }
+            return true;
+        }
+        return false;
+    }
+
+    bool ThreadPool::steal_of(const Job *job, Range &task) {
+        for (auto &q: _queues) {
+            std::unique_lock<std::mutex> lock(q->mutex);
+            for (auto it = q->ranges.rbegin(); it != q->ranges.rend(); ++it) {
+                if (it->job != job) {
+                    continue;
+                }
+                task = {it->job, it->end - 1, it->end};
+                if (--it->end == it->begin) {
+                    q->ranges.erase(std::next(it).base());
+                    --_queued;
+                }
+                return true;
+            }
+        }
+        return false;
+    }
+
+    void ThreadPool::worker_loop(std::size_t slot) {
+        Range task;
+        while (true) {
+            if (take(slot, task) || steal(slot, task)) {
+                run(task, slot);
+                continue;
+            }
+            std::unique_lock<std::mutex> lock(_mutex);
+            _cv.wait(lock, [this]() { return _stop || _queued.load() > 0; });
+            if (_stop && _queued.load() == 0) {
+                return;
+            }
+        }
+    }
+
+}  // namespace zircon
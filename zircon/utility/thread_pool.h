@@ -0,0 +1,114 @@
+// Copyright 2023 The Elastic-AI Authors.
+// part of Elastic AI Search
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#ifndef ZIRCON_UTILITY_THREAD_POOL_H_
+#define ZIRCON_UTILITY_THREAD_POOL_H_
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace zircon {
+
+    /**
+     * @brief work stealing pool for the data parallel loops of the indexes.
+     *        parallel_for gives every worker a contiguous share of the tasks
+     *        in its own queue, a worker takes its tasks from the front and an
+     *        idle one steals the back half of the largest range it finds, so
+     *        uneven tasks are balanced without a shared counter. the calling
+     *        thread steals tasks of its own call while it waits, so many
+     *        threads may call parallel_for at once, and from a task.
+     */
+    class ThreadPool {
+    public:
+        // nthreads 0 for one worker per hardware thread, the caller counted
+        explicit ThreadPool(std::size_t nthreads = 0);
+
+        ~ThreadPool();
+
+        ThreadPool(const ThreadPool &) = delete;
+
+        ThreadPool &operator=(const ThreadPool &) = delete;
+
+        // threads that run the tasks of a parallel_for, the caller included
+        [[nodiscard]] std::size_t concurrency() const {
+            return _workers.size() + 1;
+        }
+
+        /**
+         * @brief run fn(task, slot) for every task in [0, ntasks) and wait for all
+         *        of them. slot is in [0, concurrency()) and no two tasks run at the
+         *        same time with the same slot, for per thread state. the caller
+         *        runs with the last slot.
+         *        the tasks of one call must not throw.
+         */
+        void parallel_for(std::size_t ntasks, const std::function<void(std::size_t task, std::size_t slot)> &fn);
+
+        // shared pool with one worker per hardware thread
+        static ThreadPool &default_pool();
+
+    private:
+        struct Job {
+            const std::function<void(std::size_t, std::size_t)> *fn{nullptr};
+            std::atomic<std::size_t> remaining{0};
+            // set under mutex by the last task, the caller return only once it is seen
+            std::mutex mutex;
+            std::condition_variable cv;
+            bool done{false};
+        };
+
+        struct Range {
+            Job *job{nullptr};
+            std::size_t begin{0};
+            std::size_t end{0};
+        };
+
+        struct alignas(64) Queue {
+            std::mutex mutex;
+            std::deque<Range> ranges;
+        };
+
+        // one task from the front of the own queue
+        bool take(std::size_t slot, Range &task);
+
+        // the back half of a range of another queue, the first task of it in task
+        bool steal(std::size_t slot, Range &task);
+
+        // one task of job from the back of any queue, for the caller
+        bool steal_of(const Job *job, Range &task);
+
+        static void run(const Range &task, std::size_t slot);
+
+        void worker_loop(std::size_t slot);
+
+    private:
+        std::vector<std::unique_ptr<Queue>> _queues;
+        std::vector<std::thread> _workers;
+        // tasks queued and not taken yet, the workers sleep on zero
+        std::atomic<std::size_t> _queued{0};
+        std::mutex _mutex;
+        std::condition_variable _cv;
+        bool _stop{false};
+    };
+
+}  // namespace zircon
+
+#endif  // ZIRCON_UTILITY_THREAD_POOL_H_